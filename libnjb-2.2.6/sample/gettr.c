@@ -14,13 +14,15 @@ static int progress (u_int64_t sent, u_int64_t total, const char* buf, unsigned
 
 static void usage (void)
 {
-  fprintf(stderr, "gettr [ -s size ] <trackid> <filename>\n");
+  fprintf(stderr, "gettr [ -r ] [ -s size ] <trackid> <filename>\n");
+  fprintf(stderr, "(-r means an interrupted transfer to <filename> is continued.)\n");
 }
 
 int main (int argc, char **argv)
 {
   njb_t njbs[NJB_MAX_DEVICES], *njb;
   int n, opt, debug;
+  int resume = 0;
   u_int32_t id, size;
   extern int optind;
   extern char *optarg;
@@ -29,11 +31,14 @@ int main (int argc, char **argv)
   
   debug= 0;
   size= 0;
-  while ( (opt= getopt(argc, argv, "D:s:")) != -1 ) {
+  while ( (opt= getopt(argc, argv, "D:rs:")) != -1 ) {
     switch (opt) {
     case 'D':
       debug= atoi(optarg);
       break;
+    case 'r':
+      resume= 1;
+      break;
     case 's':
       size= strtoul(optarg, &endptr, 10);
       if ( *endptr != '\0' ) {
@@ -115,7 +120,11 @@ int main (int argc, char **argv)
   }
   
   if ( size ) {
-    if ( NJB_Get_Track(njb, id, size, file, progress, NULL) == -1 ) {
+    if ( resume ) {
+      if ( NJB_Get_Track_Resume(njb, id, size, file, progress, NULL) == -1 ) {
+	NJB_Error_Dump(njb, stderr);
+      }
+    } else if ( NJB_Get_Track(njb, id, size, file, progress, NULL) == -1 ) {
       NJB_Error_Dump(njb, stderr);
     }
     printf("\n");
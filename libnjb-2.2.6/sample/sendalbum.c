@@ -0,0 +1,255 @@
+#include "common.h"
+#include <ctype.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#ifdef HAVE_LIBGEN_H
+#include <libgen.h> /* basename() */
+#endif
+
+/*
+ * This sends a number of files to the jukebox as one album, and
+ * prints how long it took. By default all tracks are sent as one
+ * batch with NJB_Send_Tracks(), with -1 they are sent one by one
+ * with NJB_Send_Track() instead, so the two can be compared.
+ * With -t the transfer counters and a trace of the USB transfers
+ * are printed afterwards.
+ */
+
+/* Function that compensate for missing libgen.h on Windows */
+#ifndef HAVE_LIBGEN_H
+static char *basename(char *in) {
+  char *p;
+  if (in == NULL)
+    return NULL;
+  p = in + strlen(in) - 1;
+  while (*p != '\\' && *p != '/' && *p != ':')
+    { p--; }
+  return ++p;
+}
+#endif
+
+static double now (void)
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return (double) tv.tv_sec + (double) tv.tv_usec / 1000000.0;
+}
+
+static int progress (u_int32_t track, u_int32_t ntracks, u_int64_t sent,
+		     u_int64_t total, u_int64_t batch_sent,
+		     u_int64_t batch_total, void *data)
+{
+  int percent = (batch_sent*100)/batch_total;
+  printf("Track %u of %u, %d%% of album\r", track + 1, ntracks, percent);
+  fflush(stdout);
+  return 0;
+}
+
+static njb_songid_t *make_songid (const char *path, const char *artist,
+				  const char *album, u_int16_t tracknum)
+{
+  njb_songid_t *songid;
+  njb_songid_frame_t *frame;
+  char *tmppath = strdup(path);
+  char *title = basename(tmppath);
+  char *ext = strrchr(title, '.');
+  const char *codec = NJB_CODEC_MP3;
+
+  if (ext != NULL) {
+    char lower[5];
+    int i;
+
+    for (i = 0; i < 4 && ext[i] != '\0'; i++) {
+      lower[i] = tolower((unsigned char) ext[i]);
+    }
+    lower[i] = '\0';
+    if (!strcmp(lower, ".wav")) {
+      codec = NJB_CODEC_WAV;
+    } else if (!strcmp(lower, ".wma")) {
+      codec = NJB_CODEC_WMA;
+    }
+    *ext = '\0';
+  }
+
+  songid = NJB_Songid_New();
+  frame = NJB_Songid_Frame_New_Codec(codec);
+  NJB_Songid_Addframe(songid, frame);
+  frame = NJB_Songid_Frame_New_Title(title);
+  NJB_Songid_Addframe(songid, frame);
+  frame = NJB_Songid_Frame_New_Artist(artist);
+  NJB_Songid_Addframe(songid, frame);
+  frame = NJB_Songid_Frame_New_Album(album);
+  NJB_Songid_Addframe(songid, frame);
+  frame = NJB_Songid_Frame_New_Tracknum(tracknum);
+  NJB_Songid_Addframe(songid, frame);
+  /* The length is not known, see NJB_Send_Track() */
+  frame = NJB_Songid_Frame_New_Length(1);
+  NJB_Songid_Addframe(songid, frame);
+  free(tmppath);
+  return songid;
+}
+
+static void usage (void)
+{
+  fprintf(stderr, "usage: sendalbum [ -D debuglvl ] [ -1 ] [ -t ] [ -a <artist> ] [ -l <album> ] <path> ...\n");
+  fprintf(stderr, "(-1 means the tracks are sent one by one instead of as a batch,\n");
+  fprintf(stderr, "-t prints the transfer counters and trace afterwards.)\n");
+  exit(1);
+}
+
+int main (int argc, char **argv)
+{
+  njb_t njbs[NJB_MAX_DEVICES], *njb;
+  njb_batch_track_t *tracks;
+  extern char *optarg;
+  extern int optind;
+  int opt;
+  int n, i, debug, rc = 0;
+  int onebyone = 0;
+  int trace = 0;
+  char *artist = "Unknown";
+  char *album = "Unknown";
+  u_int64_t bytes = 0;
+  double start, seconds;
+  char *lang;
+
+  debug = 0;
+  while ( (opt = getopt(argc, argv, "D:1ta:l:")) != -1 ) {
+    switch (opt) {
+    case 'D':
+      debug = atoi(optarg);
+      break;
+    case '1':
+      onebyone = 1;
+      break;
+    case 't':
+      trace = 1;
+      break;
+    case 'a':
+      artist = optarg;
+      break;
+    case 'l':
+      album = optarg;
+      break;
+    default:
+      usage();
+    }
+  }
+  argc -= optind;
+  argv += optind;
+  if ( argc < 1 ) {
+    usage();
+  }
+
+  if ( debug ) NJB_Set_Debug(debug);
+
+  /*
+   * Check environment variables $LANG and $LC_CTYPE
+   * to see if we want to support UTF-8 unicode
+   */
+  lang = getenv("LANG");
+  if (lang != NULL) {
+    if (strlen(lang) > 5) {
+      if (!strcmp(&lang[strlen(lang)-5], "UTF-8")) {
+	NJB_Set_Unicode(NJB_UC_UTF8);
+      }
+    }
+  }
+
+  tracks = (njb_batch_track_t *) malloc(argc * sizeof(njb_batch_track_t));
+  if (tracks == NULL) {
+    fprintf(stderr, "out of memory\n");
+    return 1;
+  }
+  for (i = 0; i < argc; i++) {
+    tracks[i].path = argv[i];
+    tracks[i].songid = make_songid(argv[i], artist, album, i + 1);
+    tracks[i].sent = 0;
+  }
+
+  if (NJB_Discover(njbs, 0, &n) == -1) {
+    fprintf(stderr, "could not locate any jukeboxes\n");
+    return 1;
+  }
+
+  if ( n == 0 ) {
+    fprintf(stderr, "no NJB devices found\n");
+    return 1;
+  }
+
+  njb = njbs;
+
+  if ( NJB_Open(njb) == -1 ) {
+    NJB_Error_Dump(njb,stderr);
+    return 1;
+  }
+
+  if ( NJB_Capture(njb) == -1 ) {
+    NJB_Error_Dump(njb,stderr);
+    return 1;
+  }
+
+  if (trace) {
+    NJB_Reset_Transfer_Stats(njb);
+    NJB_Set_Transfer_Trace(njb, 1);
+  }
+
+  start = now();
+  if (onebyone) {
+    for (i = 0; i < argc; i++) {
+      if ( NJB_Send_Track(njb, tracks[i].path, tracks[i].songid, NULL, NULL,
+			  &tracks[i].trackid) == -1 ) {
+	NJB_Error_Dump(njb,stderr);
+	rc = 1;
+	break;
+      }
+      tracks[i].sent = 1;
+      printf("Track %d of %d sent\r", i + 1, argc);
+      fflush(stdout);
+    }
+  } else {
+    if ( NJB_Send_Tracks(njb, tracks, argc, progress, NULL) == -1 ) {
+      NJB_Error_Dump(njb,stderr);
+      rc = 1;
+    }
+  }
+  seconds = now() - start;
+  printf("\n");
+
+  n = 0;
+  for (i = 0; i < argc; i++) {
+    if (tracks[i].sent) {
+      struct stat sb;
+
+      printf("NJB track ID %u: %s\n", tracks[i].trackid, tracks[i].path);
+      if (stat(tracks[i].path, &sb) == 0) {
+	bytes += sb.st_size;
+      }
+      n++;
+    }
+    NJB_Songid_Destroy(tracks[i].songid);
+  }
+  free(tracks);
+
+  printf("%d tracks, %llu bytes in %.2f s", n, (unsigned long long) bytes,
+	 seconds);
+  if (seconds > 0.0) {
+    printf(" (%.2f MB/s, %.1f tracks/min, %.2f albums/min)",
+	   (double) bytes / seconds / (1024.0 * 1024.0),
+	   (double) n * 60.0 / seconds,
+	   (rc == 0) ? 60.0 / seconds : 0.0);
+  }
+  printf("\n");
+
+  if (trace) {
+    NJB_Dump_Transfer_Trace(njb, stdout);
+  }
+
+  NJB_Release(njb);
+  NJB_Close(njb);
+
+  return rc;
+}
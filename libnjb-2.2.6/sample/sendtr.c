@@ -301,7 +301,12 @@ int main(int argc, char **argv)
     printf("\n");
     NJB_Error_Dump(njb,stderr);
   } else {
+    u_int32_t stalls, stall_ms;
+
     printf("\nNJB track ID:    %u\n", trackid);
+    if ( NJB_Get_Transfer_Stalls(njb, &stalls, &stall_ms) == 0 && stalls > 0 ) {
+      printf("Device stalls:   %u (%u ms waiting)\n", stalls, stall_ms);
+    }
   }
   printf("\n");
   
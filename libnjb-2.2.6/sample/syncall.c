@@ -0,0 +1,189 @@
+#include "common.h"
+#include <stdio.h>
+#include <string.h>
+#include <pthread.h>
+#include <sys/time.h>
+
+/*
+ * This syncs all connected jukeboxes at the same time, with one
+ * worker thread per device. Each worker retrieves the track list
+ * of its device and copies tracks from it into a directory of its
+ * own. The throughput of each device and of all devices together
+ * is printed when all workers are done.
+ */
+
+typedef struct {
+  njb_t *njb; /* The device of this worker */
+  int index; /* The number of the device */
+  const char *dir; /* Where to put the tracks */
+  u_int32_t maxtracks; /* The number of tracks to copy, 0 = all */
+  u_int32_t ntracks; /* The number of tracks copied */
+  u_int64_t bytes; /* The number of bytes copied */
+  double seconds; /* The time it took */
+  int rc; /* 0 on success */
+} worker_t;
+
+static double now (void)
+{
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return (double) tv.tv_sec + (double) tv.tv_usec / 1000000.0;
+}
+
+static void *worker (void *arg)
+{
+  worker_t *w = (worker_t *) arg;
+  njb_t *njb = w->njb;
+  njb_track_table_t *table;
+  char path[1024];
+  double start;
+  u_int32_t i;
+
+  start = now();
+  w->rc = 1;
+
+  if ( NJB_Open(njb) == -1 ) {
+    NJB_Error_Dump(njb, stderr);
+    return NULL;
+  }
+
+  if ( NJB_Capture(njb) == -1 ) {
+    NJB_Error_Dump(njb, stderr);
+    NJB_Close(njb);
+    return NULL;
+  }
+
+  table = NJB_Get_Track_Table(njb);
+  if (table == NULL) {
+    NJB_Error_Dump(njb, stderr);
+  } else {
+    w->rc = 0;
+    for (i = 0; i < table->ntracks; i++) {
+      if (w->maxtracks != 0 && w->ntracks == w->maxtracks) {
+	break;
+      }
+      snprintf(path, sizeof(path), "%s/njb%d-%u.%s", w->dir, w->index,
+	       table->trid[i], NJB_Track_Table_String(table, codec, i));
+      if ( NJB_Get_Track(njb, table->trid[i], table->size[i], path,
+			 NULL, NULL) == -1 ) {
+	NJB_Error_Dump(njb, stderr);
+	w->rc = 1;
+	break;
+      }
+      w->ntracks++;
+      w->bytes += table->size[i];
+    }
+    NJB_Track_Table_Destroy(table);
+  }
+
+  NJB_Release(njb);
+  NJB_Close(njb);
+  w->seconds = now() - start;
+  return NULL;
+}
+
+static void usage (void)
+{
+  fprintf(stderr, "usage: syncall [ -D debuglvl ] [ -n tracks ] <directory>\n");
+  exit(1);
+}
+
+int main (int argc, char **argv)
+{
+  njb_t njbs[NJB_MAX_DEVICES];
+  worker_t workers[NJB_MAX_DEVICES];
+  pthread_t threads[NJB_MAX_DEVICES];
+  extern char *optarg;
+  extern int optind;
+  int opt;
+  int n, i, debug, rc = 0;
+  u_int32_t maxtracks = 0;
+  u_int64_t bytes = 0;
+  double start, seconds;
+  char *lang;
+
+  debug = 0;
+  while ( (opt = getopt(argc, argv, "D:n:")) != -1 ) {
+    switch (opt) {
+    case 'D':
+      debug = atoi(optarg);
+      break;
+    case 'n':
+      maxtracks = strtoul(optarg, NULL, 10);
+      break;
+    default:
+      usage();
+    }
+  }
+  argc -= optind;
+  argv += optind;
+  if ( argc != 1 ) {
+    usage();
+  }
+
+  /* These are shared by all devices, so set them before the workers start */
+  if ( debug ) NJB_Set_Debug(debug);
+
+  lang = getenv("LANG");
+  if (lang != NULL) {
+    if (strlen(lang) > 5) {
+      if (!strcmp(&lang[strlen(lang)-5], "UTF-8")) {
+	NJB_Set_Unicode(NJB_UC_UTF8);
+      }
+    }
+  }
+
+  if (NJB_Discover(njbs, 0, &n) == -1) {
+    fprintf(stderr, "could not locate any jukeboxes\n");
+    return 1;
+  }
+
+  if ( n == 0 ) {
+    fprintf(stderr, "no NJB devices found\n");
+    return 1;
+  }
+
+  start = now();
+  for (i = 0; i < n; i++) {
+    memset(&workers[i], 0, sizeof(worker_t));
+    workers[i].njb = &njbs[i];
+    workers[i].index = i;
+    workers[i].dir = argv[0];
+    workers[i].maxtracks = maxtracks;
+    if (pthread_create(&threads[i], NULL, worker, &workers[i]) != 0) {
+      fprintf(stderr, "could not start worker for device %d\n", i);
+      n = i;
+      rc = 1;
+      break;
+    }
+  }
+
+  for (i = 0; i < n; i++) {
+    pthread_join(threads[i], NULL);
+  }
+  seconds = now() - start;
+
+  for (i = 0; i < n; i++) {
+    worker_t *w = &workers[i];
+
+    printf("Device %d: %u tracks, %llu bytes in %.2f s", i, w->ntracks,
+	   (unsigned long long) w->bytes, w->seconds);
+    if (w->seconds > 0.0) {
+      printf(" (%.2f MB/s)", (double) w->bytes / w->seconds / (1024.0 * 1024.0));
+    }
+    printf("%s\n", w->rc ? " FAILED" : "");
+    bytes += w->bytes;
+    if (w->rc) {
+      rc = 1;
+    }
+  }
+  printf("All %d devices: %llu bytes in %.2f s", n,
+	 (unsigned long long) bytes, seconds);
+  if (seconds > 0.0) {
+    printf(" (%.2f MB/s)", (double) bytes / seconds / (1024.0 * 1024.0));
+  }
+  printf("\n");
+
+  return rc;
+}
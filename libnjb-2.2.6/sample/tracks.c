@@ -35,11 +35,16 @@ int main (int argc, char **argv)
   int opt;
   int n, debug, rc = 1;
   int extended = 0; /* Whether to get extended track info */
+  int stream = 0; /* Whether to retrieve the tracks chunk by chunk */
+  char *record = NULL; /* File to record the USB session to */
+  char *replay = NULL; /* File to replay a USB session from */
+  u_int32_t speedup = 1; /* How much faster to replay */
+  u_int32_t first_ms, total_ms;
   njb_songid_t *songtag;
   char *lang;
   
   debug= 0;
-  while ( (opt= getopt(argc, argv, "D:E")) != -1 ) {
+  while ( (opt= getopt(argc, argv, "D:ESp:r:s:")) != -1 ) {
     switch (opt) {
     case 'D':
       debug = atoi(optarg);
@@ -47,8 +52,21 @@ int main (int argc, char **argv)
     case 'E':
       extended = 1;
       break;
+    case 'S':
+      stream = 1;
+      break;
+    case 'p':
+      replay = optarg;
+      break;
+    case 'r':
+      record = optarg;
+      break;
+    case 's':
+      speedup = strtoul(optarg, NULL, 10);
+      break;
     default:
-      fprintf(stderr, "usage: tracks [ -D debuglvl ] -E\n");
+      fprintf(stderr, "usage: tracks [ -D debuglvl ] [ -E ] [ -S ] "
+	      "[ -r recordfile | -p replayfile [ -s speedup ] ]\n");
       return 1;
     }
   }
@@ -70,16 +88,29 @@ int main (int argc, char **argv)
     }
   }
 
-  if (NJB_Discover(njbs, 0, &n) == -1) {
-    fprintf(stderr, "could not locate any jukeboxes\n");
-    return 1;
+  if (replay != NULL) {
+    /* Play back a recorded session instead of using a device */
+    if (NJB_Replay_Session(njbs, replay, speedup) == -1) {
+      fprintf(stderr, "could not replay %s\n", replay);
+      return 1;
+    }
+  } else {
+    if (NJB_Discover(njbs, 0, &n) == -1) {
+      fprintf(stderr, "could not locate any jukeboxes\n");
+      return 1;
+    }
+    
+    if ( n == 0 ) {
+      fprintf(stderr, "no NJB devices found\n");
+      return 0;
+    } 
+    
+    if (record != NULL && NJB_Record_Session(njbs, record, 0) == -1) {
+      fprintf(stderr, "could not record to %s\n", record);
+      return 1;
+    }
   }
   
-  if ( n == 0 ) {
-    fprintf(stderr, "no NJB devices found\n");
-    return 0;
-  } 
-  
   njb = njbs;
   
   if ( NJB_Open(njb) == -1 ) {
@@ -95,6 +126,9 @@ int main (int argc, char **argv)
   if (extended != 0) {
     NJB_Get_Extended_Tags(njb, 1);
   }
+  if (stream != 0) {
+    NJB_Stream_Track_Tags(njb, 1);
+  }
   
   n = 0;
   NJB_Reset_Get_Track_Tag(njb);
@@ -111,6 +145,9 @@ int main (int argc, char **argv)
   }
 
   printf("In total: %u tracks.\n", n);
+  if (NJB_Get_Track_Scan_Time(njb, &first_ms, &total_ms) == 0) {
+    printf("First track after %u ms, all tracks after %u ms.\n", first_ms, total_ms);
+  }
   
   NJB_Release(njb);
   rc = 0;
@@ -13,6 +13,8 @@
 #include "protocol.h"
 #include "protocol3.h"
 #include "usb_io.h"
+#include "xferstats.h"
+#include "usbrec.h"
 
 typedef struct njb_device_entry njb_device_entry_t;
 struct njb_device_entry {
@@ -58,13 +60,16 @@ static const int njb_device_table_size = sizeof(njb_device_table) / sizeof(njb_d
 
 /** The current debug flags for all if libnjb (global) */
 int njb_debug_flags = 0;
-/** The current subroutine depth for all of libnjb (global) */
-int __sub_depth = 0;
+/** The current subroutine depth, used to indent the debug traces */
+NJB_THREAD_LOCAL int __sub_depth = 0;
 
 #ifdef __NetBSD__
 #define MAXDEVNAMES USB_MAX_DEVNAMES
 #endif
 
+/** Whether libusb has been initialized, see njb_discover() */
+static int njb_usb_initialized = 0;
+
 /**
  * Search the USB bus for a Nomad JukeBox.  We can handle up to
  * NJB_MAX_DEVICES JukeBox's per USB simultaneously (a value arbitrarily
@@ -101,8 +106,20 @@ int njb_discover (njb_t *njbs, int limit, int *count)
   /* Set return value to "no devices" by default */
   *count = 0;
 
-  /* Initialize libusb library */
-  usb_init();
+  /*
+   * Initialize libusb library. This is only done once: libusb keeps
+   * the busses and devices it has found, so that polling for a
+   * jukebox only has to look at what changed since the last call.
+   *
+   * No libusb find filter is installed. It would apply to the whole
+   * process and drop the devices other libraries sharing libusb are
+   * looking for, such as MTP players; the loop below picks out the
+   * jukeboxes instead.
+   */
+  if (!njb_usb_initialized) {
+    usb_init();
+    njb_usb_initialized = 1;
+  }
   
   /* Try to locate busses and devices */
   usb_find_busses();
@@ -122,6 +139,8 @@ int njb_discover (njb_t *njbs, int limit, int *count)
 	    device->descriptor.idProduct == njb_device->product_id) {
 	  njbs[found].device = device;
 	  njbs[found].dev = NULL;
+	  njbs[found].xfer_stats = NULL;
+	  njbs[found].usb_session = NULL;
 	  njbs[found].device_type = njb_device->njblib_id;
 	  found ++;
 	  break;
@@ -149,6 +168,12 @@ void njb_close (njb_t *njb)
   __dsub= "njb_close";
   __enter;
   
+  /* A replayed session has no device to let go of */
+  if (usbrec_replaying(njb)) {
+    __leave;
+    return;
+  }
+  
   usb_release_interface(njb->dev, njb->usb_interface);
   
   /*
@@ -296,6 +321,15 @@ int njb_open (njb_t *njb)
   /* Initialize error stack so we can store error messages */
   initialize_errorstack(njb);
   
+  /* And the transfer counters, which are not worth failing for */
+  xferstats_init(njb);
+  
+  /* A replayed session gets its endpoints from the session log */
+  if (usbrec_replaying(njb)) {
+    __leave;
+    return 0;
+  }
+  
   /* Check what config, interface and endpoints to use */
   parse_usb_descriptor(njb);
   
@@ -17,7 +17,6 @@
 #include "byteorder.h"
 #include "datafile.h"
 
-extern int __sub_depth;
 extern int njb_unicode_flag;
 
 /* TODO: get rid of 64 bit packing */
@@ -239,6 +238,7 @@ unsigned char *datafile_pack (njb_datafile_t *df, u_int32_t *size)
 {
   __dsub= "datafile_pack";
   unsigned char *ptag;
+  char buf[UNICODE_BUF_SIZE];
   char *filename = NULL;
   u_int16_t len;
   
@@ -247,7 +247,7 @@ unsigned char *datafile_pack (njb_datafile_t *df, u_int32_t *size)
   
   /* Convert filename to ISO 8859-1 as is used on NJB 1 */
   if (njb_unicode_flag == NJB_UC_UTF8) {
-    filename = utf8tostr((unsigned char *) df->filename);
+    filename = utf8tostr_buf((unsigned char *) df->filename, buf, sizeof(buf));
   } else {
     filename = strdup(df->filename);
   }
@@ -261,7 +261,7 @@ unsigned char *datafile_pack (njb_datafile_t *df, u_int32_t *size)
   
   ptag= (unsigned char *) malloc(*size);
   if ( ptag == NULL ) {
-    free(filename);
+    unicode_buf_free(filename, buf);
     __leave;
     return NULL;
   }
@@ -275,7 +275,7 @@ unsigned char *datafile_pack (njb_datafile_t *df, u_int32_t *size)
   from_16bit_to_njb1_bytes(len, &ptag[8]);
   memcpy(&ptag[10], filename, len);
   
-  free(filename);
+  unicode_buf_free(filename, buf);
   
   __leave;
   return ptag;
@@ -321,6 +321,8 @@ static void add_bin_unistr(unsigned char *data, u_int32_t *datap, u_int32_t tagt
 unsigned char *datafile_pack3 (njb_t *njb, njb_datafile_t *df, u_int32_t *size)
 {
   __dsub= "datafile_pack3";
+  unsigned char filebuf[UNICODE_BUF_SIZE];
+  unsigned char folderbuf[UNICODE_BUF_SIZE];
   unsigned char *filename = NULL;
   unsigned char *foldername = NULL;
   unsigned char ptag[1024];
@@ -330,7 +332,8 @@ unsigned char *datafile_pack3 (njb_t *njb, njb_datafile_t *df, u_int32_t *size)
   __enter;
   
   /* Create a filename */
-  filename = strtoucs2((unsigned char *) df->filename);
+  filename = strtoucs2_buf((unsigned char *) df->filename, filebuf,
+			   sizeof(filebuf));
   if (filename == NULL) {
     NJB_ERROR(njb, EO_NOMEM);
     __leave;
@@ -339,12 +342,14 @@ unsigned char *datafile_pack3 (njb_t *njb, njb_datafile_t *df, u_int32_t *size)
 
   /* Create a folder name too */
   if (df->folder == NULL) {
-    foldername = strtoucs2((unsigned char *) "\\");
+    foldername = strtoucs2_buf((unsigned char *) "\\", folderbuf,
+			       sizeof(folderbuf));
   } else {
-    foldername = strtoucs2((unsigned char *) df->folder);
+    foldername = strtoucs2_buf((unsigned char *) df->folder, folderbuf,
+			       sizeof(folderbuf));
   }
   if (foldername == NULL) {
-    free(filename);
+    unicode_buf_free(filename, filebuf);
     NJB_ERROR(njb, EO_NOMEM);
     __leave;
     return NULL;
@@ -352,10 +357,10 @@ unsigned char *datafile_pack3 (njb_t *njb, njb_datafile_t *df, u_int32_t *size)
  
   /* Add filename tag */
   add_bin_unistr(ptag, &p, NJB3_FNAME_FRAME_ID, filename);
-  free(filename);
+  unicode_buf_free(filename, filebuf);
   /* Add folder tag */
   add_bin_unistr(ptag, &p, NJB3_DIR_FRAME_ID, foldername);
-  free(foldername);
+  unicode_buf_free(foldername, folderbuf);
 
   /* Add filesize in 32 bits */
   from_16bit_to_njb3_bytes(0x0006, &ptag[p]);
@@ -428,13 +433,14 @@ unsigned char *new_folder_pack3 (njb_t *njb, const char *name, u_int32_t *size)
   __dsub= "new_folder_pack3";
   unsigned char ptag[1024];
   unsigned char *retag;
+  unsigned char dirbuf[UNICODE_BUF_SIZE];
   unsigned char *dirname = NULL;
   u_int32_t p = 0;
   
   __enter;
   
   /* Create a filename */
-  dirname = strtoucs2((unsigned char *) name);
+  dirname = strtoucs2_buf((unsigned char *) name, dirbuf, sizeof(dirbuf));
   if (dirname == NULL) {
     NJB_ERROR(njb, EO_NOMEM);
     __leave;
@@ -451,7 +457,7 @@ unsigned char *new_folder_pack3 (njb_t *njb, const char *name, u_int32_t *size)
   from_16bit_to_njb3_bytes(0x0000, &ptag[p]); /* Terminator */
   p += 2;
   add_bin_unistr(ptag, &p, NJB3_DIR_FRAME_ID, dirname);
-  free(dirname);
+  unicode_buf_free(dirname, dirbuf);
   /* Add filesize in 32 bits */
   from_16bit_to_njb3_bytes(0x0006, &ptag[p]);
   p += 2;
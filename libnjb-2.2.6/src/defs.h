@@ -6,8 +6,25 @@
 #  define  __attribute__(x)  /*NOTHING*/
 #endif
 
+/*
+ * Thread local storage. Each thread gets its own copy of variables
+ * declared with this, so that several devices can be used from
+ * different threads. Compilers without thread local storage (such
+ * as GCC on older Mac OS X) fall back to a global variable.
+ */
+#if defined(_MSC_VER)
+#  define NJB_THREAD_LOCAL __declspec(thread)
+#elif defined(__clang__) || (defined(__GNUC__) && !defined(__APPLE__))
+#  define NJB_THREAD_LOCAL __thread
+#else
+#  define NJB_THREAD_LOCAL /*NOTHING*/
+#endif
+
+/* The current subroutine depth, one per thread (defined in base.c) */
+extern NJB_THREAD_LOCAL int __sub_depth;
+
 /* Macros for printing debug traces from subroutines */
-#define __dsub static char *subroutinename __attribute__((unused))
+#define __dsub static const char * const subroutinename __attribute__((unused))
 #define __sub subroutinename
 #define __enter if(njb_debug(DD_SUBTRACE))fprintf(stderr,"%*s==> %s\n",3*__sub_depth++,"",__sub)
 #define __leave if(njb_debug(DD_SUBTRACE))fprintf(stderr,"%*s<== %s\n",3*(--__sub_depth),"",__sub)
@@ -12,8 +12,6 @@
 #include "byteorder.h"
 #include "eax.h"
 
-extern int __sub_depth;
-
 /**
  * This adds a EAX type to the current state, i.e. a linked
  * list associated with the current device and session.
@@ -21,8 +21,6 @@
 #include "base.h"
 #include "ioutil.h"
 
-extern int __sub_depth;
-
 /**
  * This dumps out a number of bytes to a textual, hexadecimal
  * dump.
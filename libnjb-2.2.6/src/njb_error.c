@@ -13,7 +13,6 @@
 #include "protocol.h"
 #include "njb_error.h"
 
-extern int __sub_depth;
 const char *njb_status_string (unsigned char code);
 
 /**
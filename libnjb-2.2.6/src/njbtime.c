@@ -5,6 +5,15 @@
  * of the devices.
  */
 
+/* MSVC does not have these */
+#ifndef _MSC_VER
+#include "config.h"
+#include <sys/time.h>
+#include <unistd.h>
+#else
+#include <windows.h>
+#endif
+
 #include <stdlib.h>
 #include <string.h>
 #include "libnjb.h"
@@ -14,8 +23,6 @@
 #include "base.h"
 #include "byteorder.h"
 
-extern int __sub_depth;
-
 /**
  * Unpacks a raw NJB1 time structure into libnjb representation.
  * 
@@ -163,3 +170,41 @@ void *time_pack3(njb_time_t *time)
   __leave;
   return data;
 }
+
+/**
+ * This returns a millisecond timestamp, used for measuring
+ * how long certain operations take. The counter wraps around
+ * so only differences between two timestamps are meaningful.
+ *
+ * @return a timestamp in milliseconds
+ */
+u_int32_t njb_get_millis(void)
+{
+#ifdef _MSC_VER
+  return (u_int32_t) GetTickCount();
+#else
+  struct timeval tv;
+
+  gettimeofday(&tv, NULL);
+  return (u_int32_t) (tv.tv_sec * 1000 + tv.tv_usec / 1000);
+#endif
+}
+
+/**
+ * Sleeps for a number of milliseconds. Where there is no way
+ * to sleep for less than a second, a whole second is slept instead.
+ *
+ * @param ms the number of milliseconds to sleep
+ */
+void njb_sleep_millis(u_int32_t ms)
+{
+#ifdef _MSC_VER
+  Sleep(ms);
+#else
+#ifdef HAVE_USLEEP
+  usleep(ms * 1000);
+#else
+  sleep((ms + 999) / 1000);
+#endif
+#endif
+}
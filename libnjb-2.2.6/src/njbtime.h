@@ -5,5 +5,7 @@ njb_time_t *time_unpack(void *data);
 njb_time_t *time_unpack3(void *data);
 void *time_pack(njb_time_t *time);
 void *time_pack3(njb_time_t *time);
+u_int32_t njb_get_millis(void);
+void njb_sleep_millis(u_int32_t ms);
 
 #endif
@@ -16,7 +16,194 @@
 #include "playlist.h"
 
 extern int njb_unicode_flag;
-extern int __sub_depth;
+
+/**
+ * This frees the edits recorded for a playlist.
+ *
+ * @param pl the playlist
+ */
+static void playlist_clear_edits(njb_playlist_t *pl)
+{
+  njb_playlist_edit_t *edit = pl->_edits;
+
+  while (edit != NULL) {
+    njb_playlist_edit_t *tmp = edit->next;
+    free(edit);
+    edit = tmp;
+  }
+  pl->_edits = NULL;
+  pl->_lastedit = NULL;
+}
+
+/**
+ * This records an edit made to a playlist that exists on the device,
+ * so that <code>NJB_Update_Playlist()</code> can later work out what
+ * has to be sent. Nothing is recorded for new playlists, which are
+ * always created from scratch.
+ *
+ * @param pl the playlist
+ * @param op the kind of edit
+ * @param from the index (from 0) of the track concerned
+ * @param to the new index of a moved track
+ */
+static void playlist_record_edit(njb_playlist_t *pl, int op, u_int32_t from,
+				 u_int32_t to)
+{
+  njb_playlist_edit_t *edit;
+
+  if (pl->_state == NJB_PL_NEW || pl->_edits_lost) {
+    return;
+  }
+  edit = (njb_playlist_edit_t *) malloc(sizeof(njb_playlist_edit_t));
+  if (edit == NULL) {
+    /* Without the full history the playlist must be rebuilt */
+    playlist_clear_edits(pl);
+    pl->_edits_lost = 1;
+    return;
+  }
+  edit->op = op;
+  edit->from = from;
+  edit->to = to;
+  edit->next = NULL;
+  if (pl->_lastedit == NULL) {
+    pl->_edits = edit;
+  } else {
+    pl->_lastedit->next = edit;
+  }
+  pl->_lastedit = edit;
+}
+
+/**
+ * This marks a playlist as being in sync with the device, and
+ * forgets the edits recorded so far.
+ *
+ * @param pl the playlist
+ */
+void playlist_mark_synced(njb_playlist_t *pl)
+{
+  playlist_clear_edits(pl);
+  pl->_edits_lost = 0;
+  pl->_state = NJB_PL_UNCHANGED;
+}
+
+/**
+ * This works out whether the edits recorded for a playlist can be
+ * written to the device by appending tracks to the playlist already
+ * there, which is the only kind of change the devices support short
+ * of recreating the playlist. The edits are replayed on the positions
+ * of the tracks that were on the device at the last sync: if those
+ * tracks are still first and in the same order, only the tracks after
+ * them need to be sent.
+ *
+ * @param pl the playlist
+ * @param nappend a pointer to a variable that will hold the number of
+ *                tracks at the end of the playlist that are to be
+ *                appended on the device
+ * @param renamed a pointer to a variable that will be set to 1 if the
+ *                playlist was also renamed, else 0
+ * @return 0 if appending is enough, -1 if the playlist must be rebuilt
+ */
+int playlist_plan_update(njb_playlist_t *pl, u_int32_t *nappend, int *renamed)
+{
+  __dsub= "playlist_plan_update";
+  njb_playlist_edit_t *edit;
+  u_int32_t *origin;
+  u_int32_t added = 0, deleted = 0;
+  u_int32_t synced, len, i, moved;
+
+  __enter;
+
+  *nappend = 0;
+  *renamed = 0;
+
+  if (pl->_edits_lost) {
+    __leave;
+    return -1;
+  }
+
+  for (edit = pl->_edits; edit != NULL; edit = edit->next) {
+    if (edit->op == NJB_PL_EDIT_APPEND || edit->op == NJB_PL_EDIT_INSERT) {
+      added++;
+    } else if (edit->op == NJB_PL_EDIT_DELETE) {
+      deleted++;
+    }
+  }
+  if (pl->ntracks + deleted < added) {
+    __leave;
+    return -1;
+  }
+  synced = pl->ntracks + deleted - added;
+
+  /* origin[i] is the index at the last sync of track i, or NEW_TRACK */
+#define NEW_TRACK 0xffffffffU
+  origin = (u_int32_t *) malloc((synced + added + 1) * sizeof(u_int32_t));
+  if (origin == NULL) {
+    __leave;
+    return -1;
+  }
+  for (i = 0; i < synced; i++) {
+    origin[i] = i;
+  }
+  len = synced;
+
+  for (edit = pl->_edits; edit != NULL; edit = edit->next) {
+    switch (edit->op) {
+    case NJB_PL_EDIT_APPEND:
+    case NJB_PL_EDIT_INSERT:
+      if (edit->from > len) {
+	goto rebuild;
+      }
+      memmove(&origin[edit->from + 1], &origin[edit->from],
+	      (len - edit->from) * sizeof(u_int32_t));
+      origin[edit->from] = NEW_TRACK;
+      len++;
+      break;
+    case NJB_PL_EDIT_DELETE:
+      if (edit->from >= len) {
+	goto rebuild;
+      }
+      memmove(&origin[edit->from], &origin[edit->from + 1],
+	      (len - edit->from - 1) * sizeof(u_int32_t));
+      len--;
+      break;
+    case NJB_PL_EDIT_MOVE:
+      if (edit->from >= len || edit->to >= len) {
+	goto rebuild;
+      }
+      moved = origin[edit->from];
+      memmove(&origin[edit->from], &origin[edit->from + 1],
+	      (len - edit->from - 1) * sizeof(u_int32_t));
+      memmove(&origin[edit->to + 1], &origin[edit->to],
+	      (len - 1 - edit->to) * sizeof(u_int32_t));
+      origin[edit->to] = moved;
+      break;
+    case NJB_PL_EDIT_RENAME:
+      *renamed = 1;
+      break;
+    }
+  }
+
+  if (len != pl->ntracks || len < synced) {
+    goto rebuild;
+  }
+  /* Every track that was on the device must still be there, in order */
+  for (i = 0; i < synced; i++) {
+    if (origin[i] != i) {
+      goto rebuild;
+    }
+  }
+#undef NEW_TRACK
+
+  free(origin);
+  *nappend = len - synced;
+  __leave;
+  return 0;
+
+ rebuild:
+  free(origin);
+  __leave;
+  return -1;
+}
 
 /**
  * This function creates a new playlist data structure to
@@ -119,7 +306,7 @@ njb_playlist_t *playlist_unpack(void *data, size_t nbytes)
     NJB_Playlist_Addtrack(pl, track, NJB_PL_END);
   }
 
-  pl->_state = NJB_PL_UNCHANGED;
+  playlist_mark_synced(pl);
   __leave;
   return pl;
 }
@@ -141,10 +328,16 @@ void NJB_Playlist_Addtrack(njb_playlist_t *pl, njb_playlist_track_t *track,
   
   __enter;
   
-  if ( pl->_state != NJB_PL_NEW ) pl->_state= NJB_PL_CHTRACKS;
-  
   if ( pos > pl->ntracks ) pos = NJB_PL_END;
   
+  if ( pos == NJB_PL_END || pl->ntracks == 0 ) {
+    playlist_record_edit(pl, NJB_PL_EDIT_APPEND, pl->ntracks, 0);
+  } else {
+    playlist_record_edit(pl, NJB_PL_EDIT_INSERT, pos - 1, 0);
+  }
+  
+  if ( pl->_state != NJB_PL_NEW ) pl->_state= NJB_PL_CHTRACKS;
+  
   if ( pos == NJB_PL_END ) {
     if ( pl->first == NULL ) {
       pl->first= pl->cur= pl->last= track;
@@ -208,6 +401,12 @@ void NJB_Playlist_Deltrack(njb_playlist_t *pl, unsigned int pos)
   
   if ( pos > pl->ntracks ) pos = NJB_PL_END;
   
+  if ( pos == NJB_PL_END ) {
+    playlist_record_edit(pl, NJB_PL_EDIT_DELETE, pl->ntracks - 1, 0);
+  } else {
+    playlist_record_edit(pl, NJB_PL_EDIT_DELETE, pos - 1, 0);
+  }
+  
   pl->_state = NJB_PL_CHTRACKS;
   
   if ( pos == NJB_PL_START ) {
@@ -233,6 +432,8 @@ void NJB_Playlist_Deltrack(njb_playlist_t *pl, unsigned int pos)
 	}
 	if ( track->next != NULL ) {
 	  track->next->prev = track->prev;
+	} else {
+	  pl->last = track->prev;
 	}
 	
 	NJB_Playlist_Track_Destroy(track);
@@ -293,11 +494,13 @@ void NJB_Playlist_Deltrack(njb_playlist_t *pl, unsigned int pos)
 void NJB_Playlist_Deltrack_TrackID(njb_playlist_t *pl, u_int32_t trackid)
 {
   njb_playlist_track_t *track;
+  u_int32_t index = 0;
 
   NJB_Playlist_Reset_Gettrack(pl);
   while ( (track = NJB_Playlist_Gettrack(pl)) != NULL ) {
     if (trackid == track->trackid) {
       /* When the track is located in a playlist, remove it */
+      playlist_record_edit(pl, NJB_PL_EDIT_DELETE, index, 0);
       if (track->prev != NULL) {
 	track->prev->next = track->next;
       } else {
@@ -305,12 +508,91 @@ void NJB_Playlist_Deltrack_TrackID(njb_playlist_t *pl, u_int32_t trackid)
       }
       if (track->next != NULL) {
 	track->next->prev = track->prev;
+      } else {
+	pl->last = track->prev;
       }
       NJB_Playlist_Track_Destroy(track);
       pl->ntracks--;
-      pl->_state = NJB_PL_CHTRACKS;
+      if ( pl->_state != NJB_PL_NEW ) pl->_state = NJB_PL_CHTRACKS;
+    } else {
+      index++;
+    }
+  }
+}
+
+/**
+ * This function moves a track within a playlist.
+ *
+ * @param pl the playlist
+ * @param from the position of the track to move, where 
+ *             <code>NJB_PL_START</code> is the first track and
+ *             <code>NJB_PL_END</code> the last one
+ * @param to the position the track shall have after the move, 
+ *             using the same numbering
+ * @see NJB_Playlist_Addtrack()
+ * @see NJB_Playlist_Deltrack()
+ */
+void NJB_Playlist_Movetrack(njb_playlist_t *pl, unsigned int from, 
+			    unsigned int to)
+{
+  __dsub = "NJB_Playlist_Movetrack";
+  njb_playlist_track_t *track, *cur;
+  u_int32_t i;
+  
+  __enter;
+  
+  if ( pl->ntracks == 0 ) {
+    __leave;
+    return;
+  }
+  if ( from == NJB_PL_END || from > pl->ntracks ) from = pl->ntracks;
+  if ( to == NJB_PL_END || to > pl->ntracks ) to = pl->ntracks;
+  if ( from == to ) {
+    __leave;
+    return;
+  }
+  
+  playlist_record_edit(pl, NJB_PL_EDIT_MOVE, from - 1, to - 1);
+  if ( pl->_state != NJB_PL_NEW ) pl->_state = NJB_PL_CHTRACKS;
+  
+  /* Unlink the track */
+  track = pl->first;
+  for (i = 1; i < from; i++) {
+    track = track->next;
+  }
+  if ( track->prev != NULL ) {
+    track->prev->next = track->next;
+  } else {
+    pl->first = track->next;
+  }
+  if ( track->next != NULL ) {
+    track->next->prev = track->prev;
+  } else {
+    pl->last = track->prev;
+  }
+  
+  /* Link it in before the track now at the new position, or last */
+  if ( to == pl->ntracks ) {
+    track->prev = pl->last;
+    track->next = NULL;
+    pl->last->next = track;
+    pl->last = track;
+  } else {
+    cur = pl->first;
+    for (i = 1; i < to; i++) {
+      cur = cur->next;
+    }
+    track->prev = cur->prev;
+    track->next = cur;
+    if ( cur->prev != NULL ) {
+      cur->prev->next = track;
+    } else {
+      pl->first = track;
     }
+    cur->prev = track;
   }
+  
+  __leave;
 }
 
 /**
@@ -337,6 +619,7 @@ void NJB_Playlist_Destroy(njb_playlist_t *pl)
   if ( pl->name != NULL ) {
     free(pl->name);
   }
+  playlist_clear_edits(pl);
   
   free(pl);
   
@@ -416,6 +699,7 @@ int NJB_Playlist_Set_Name(njb_playlist_t *pl, const char *name)
   if ( pl->name != NULL ) free(pl->name);
   pl->name = newname;
   
+  playlist_record_edit(pl, NJB_PL_EDIT_RENAME, 0, 0);
   if ( pl->_state == NJB_PL_UNCHANGED ) pl->_state = NJB_PL_CHNAME;
   
   __leave;
@@ -3,5 +3,7 @@
 
 njb_playlist_t *playlist_unpack(void *data, size_t nbytes);
 u_int32_t playlist_pack(njb_playlist_t *pl, char *data);
+void playlist_mark_synced(njb_playlist_t *pl);
+int playlist_plan_update(njb_playlist_t *pl, u_int32_t *nappend, int *renamed);
 
 #endif
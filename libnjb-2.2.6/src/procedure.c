@@ -12,6 +12,10 @@
 #endif
 
 #include <sys/stat.h> /* stat() */
+#ifdef _MSC_VER
+#include <io.h>
+#define ftruncate _chsize /* ftruncate() */
+#endif
 #include <ctype.h> /* isspace() */
 #include <fcntl.h>
 #ifdef HAVE_LIBGEN_H
@@ -32,6 +36,11 @@
 #include "songid.h"
 #include "datafile.h"
 #include "njbtime.h"
+#include "tracktable.h"
+#include "xfertune.h"
+#include "xferstats.h"
+#include "usbrec.h"
+#include "playlist.h"
 
 static int _lib_ctr_update (njb_t *njb);
 int _file_size (njb_t *njb, const char *path, u_int64_t *size);
@@ -39,7 +48,6 @@ int _file_time (njb_t *njb, const char *path, time_t *ts);
 int NJB_Handshake (njb_t *njb);
 
 extern int njb_unicode_flag;
-extern int __sub_depth;
 
 /* Function that compensate for missing libgen.h on Windows */
 #ifndef HAVE_LIBGEN_H
@@ -93,6 +101,25 @@ static int _lib_ctr_update (njb_t *njb)
   return 0;
 }
 
+/**
+ * Remembers that the tracks on the device have been changed
+ * through this handle, so that the next call to
+ * <code>NJB_Get_Track_Table_Cached()</code> will not trust the
+ * snapshot cache. The NJB1 library counter is only bumped once
+ * per session, and series 3 devices have no counter at all.
+ */
+static void _tracks_changed (njb_t *njb)
+{
+  if (njb->device_type == NJB_DEVICE_NJB1) {
+    njb_state_t *state = (njb_state_t *) njb->protocol_state;
+    state->tracks_changed = 1;
+  }
+  if (PDE_PROTOCOL_DEVICE(njb)) {
+    njb3_state_t *state = (njb3_state_t *) njb->protocol_state;
+    state->tracks_changed = 1;
+  }
+}
+
 /**
  * This scans the USB buses for available devices, i.e. jukeboxes.
  *
@@ -210,6 +237,10 @@ void NJB_Close (njb_t *njb)
   
   /* Destroy error stack */
   destroy_errorstack(njb);
+  /* And the transfer counters */
+  xferstats_destroy(njb);
+  /* And stop any session recording or replay */
+  usbrec_stop(njb);
   
   __leave;
 }
@@ -436,6 +467,116 @@ void NJB_Get_Extended_Tags (njb_t *njb, int extended)
   __leave;
 }
 
+/**
+ * This configures libnjb to retrieve the track tags of series 3 devices
+ * one metadata chunk at a time. By default the entire track list is
+ * retrieved and parsed by <code>NJB_Reset_Get_Track_Tag()</code> before
+ * the first track can be retrieved, which takes a long time on a
+ * jukebox with many tracks. In streaming mode, only the first chunk is
+ * retrieved at reset, and the following chunks are retrieved as
+ * <code>NJB_Get_Track_Tag()</code> runs out of tracks, so the first
+ * tracks are available almost immediately and only about one chunk
+ * of tracks is kept in memory. The NJB1 always retrieves the tracks
+ * one by one, so this setting has no effect on it.
+ *
+ * Do not issue other commands to the device until all tracks have
+ * been retrieved when using this mode.
+ *
+ * @param njb a pointer to the <code>njb_t</code> object to set this mode for
+ * @param stream use 0 to retrieve all tracks at reset (default), 1 to
+ *               retrieve them chunk by chunk
+ * @see NJB_Get_Track_Scan_Time()
+ */
+void NJB_Stream_Track_Tags (njb_t *njb, int stream)
+{
+  __dsub= "NJB_Stream_Track_Tags";
+  __enter;
+
+  njb_error_clear(njb);
+
+  if (PDE_PROTOCOL_DEVICE(njb)) {
+    njb3_state_t *state = (njb3_state_t *) njb->protocol_state;
+    state->stream_track_tags = stream;
+  }
+
+  __leave;
+}
+
+/**
+ * This retrieves timing information for the last track tag scan
+ * on a series 3 device, which is useful for tuning the user experience
+ * when connecting to a full jukebox.
+ *
+ * @param njb a pointer to the <code>njb_t</code> object to get the
+ *            timing for
+ * @param first_ms a pointer to a variable that will hold the number
+ *                 of milliseconds from <code>NJB_Reset_Get_Track_Tag()</code>
+ *                 until the first track was returned by
+ *                 <code>NJB_Get_Track_Tag()</code>, or 0 if no track has
+ *                 been returned yet
+ * @param total_ms a pointer to a variable that will hold the number
+ *                 of milliseconds it took to retrieve the entire track
+ *                 list, or 0 if the scan is not yet complete
+ * @return 0 on success, -1 if the device does not record this
+ *           information (the NJB1)
+ */
+int NJB_Get_Track_Scan_Time (njb_t *njb, u_int32_t *first_ms, u_int32_t *total_ms)
+{
+  if (PDE_PROTOCOL_DEVICE(njb)) {
+    njb3_state_t *state = (njb3_state_t *) njb->protocol_state;
+
+    *first_ms = state->track_scan_first_ms;
+    *total_ms = state->track_scan_total_ms;
+    return 0;
+  }
+  return -1;
+}
+
+/**
+ * This retrieves the number of times an NJB1 was not ready to receive
+ * data during the last file or track upload, and the time spent
+ * waiting for it. This is useful for seeing how much of a large upload
+ * was spent waiting for the device. The figures are the
+ * <code>not_ready</code> and <code>not_ready_ms</code> transfer
+ * counters (see <code>NJB_Get_Transfer_Stats()</code>), counted from
+ * the start of the upload.
+ *
+ * @param njb a pointer to the <code>njb_t</code> object to get the
+ *            figures for
+ * @param stalls a pointer to a variable that will hold the number of
+ *               times the device was not ready
+ * @param stall_ms a pointer to a variable that will hold the number
+ *                 of milliseconds spent waiting for the device
+ * @return 0 on success, -1 if the device does not record this
+ *           information (the series 3 devices)
+ */
+int NJB_Get_Transfer_Stalls (njb_t *njb, u_int32_t *stalls, u_int32_t *stall_ms)
+{
+  if (njb->device_type == NJB_DEVICE_NJB1) {
+    njb_state_t *state = (njb_state_t *) njb->protocol_state;
+    njb_xfer_stats_t stats;
+
+    /*
+     * The waits are only counted in the transfer counters, so this
+     * is how far they have moved since the upload started. If they
+     * were reset in the meantime, they are all there is.
+     */
+    if (xferstats_get(njb, &stats) == -1) {
+      return -1;
+    }
+    if (stats.not_ready >= state->upload_not_ready &&
+	stats.not_ready_ms >= state->upload_not_ready_ms) {
+      *stalls = stats.not_ready - state->upload_not_ready;
+      *stall_ms = stats.not_ready_ms - state->upload_not_ready_ms;
+    } else {
+      *stalls = stats.not_ready;
+      *stall_ms = stats.not_ready_ms;
+    }
+    return 0;
+  }
+  return -1;
+}
+
 /**
  * This resets the track tag (song ID) retrieveal function. The track
  * tags can then be retrieved one by one using the <code>NJB_Get_Track_Tag()</code>
@@ -531,6 +672,276 @@ njb_songid_t *NJB_Get_Track_Tag (njb_t *njb)
   return ret;
 }
 
+/**
+ * This retrieves the metadata of all tracks on the device as a track
+ * table. This is a lot faster and uses a lot less memory than retrieving
+ * the tracks one by one with <code>NJB_Get_Track_Tag()</code> and looking
+ * up each frame with <code>NJB_Songid_Findframe()</code>, since no song
+ * IDs or frames are created for series 3 devices, and all strings are
+ * stored in one pool where equal strings (such as artist and album names)
+ * are only stored once.
+ *
+ * Typical usage:
+ *
+ * <pre>
+ * njb_track_table_t *table;
+ * u_int32_t i;
+ *
+ * table = NJB_Get_Track_Table(njb);
+ * if (table != NULL) {
+ *   for (i = 0; i < table->ntracks; i++) {
+ *     printf("%u: %s - %s\n", table->trid[i],
+ *            NJB_Track_Table_String(table, artist, i),
+ *            NJB_Track_Table_String(table, title, i));
+ *   }
+ *   NJB_Track_Table_Destroy(table);
+ * }
+ * </pre>
+ *
+ * @param njb a pointer to the <code>njb_t</code> object to get the
+ *            tracks from
+ * @return a track table, which shall be destroyed with
+ *         <code>NJB_Track_Table_Destroy()</code> after use, or NULL
+ *         on failure
+ * @see NJB_Get_Extended_Tags()
+ */
+njb_track_table_t *NJB_Get_Track_Table (njb_t *njb)
+{
+  __dsub= "NJB_Get_Track_Table";
+  track_table_builder_t *tb;
+  njb_track_table_t *table;
+
+  __enter;
+
+  njb_error_clear(njb);
+
+  tb = track_table_builder_new();
+  if (tb == NULL) {
+    NJB_ERROR(njb, EO_NOMEM);
+    __leave;
+    return NULL;
+  }
+
+  if (njb->device_type == NJB_DEVICE_NJB1) {
+    njb_songid_t *song;
+
+    NJB_Reset_Get_Track_Tag(njb);
+    while ( (song = NJB_Get_Track_Tag(njb)) != NULL ) {
+      int result = track_table_add_songid(tb, song);
+
+      NJB_Songid_Destroy(song);
+      if (result == -1) {
+	track_table_builder_destroy(tb);
+	NJB_ERROR(njb, EO_NOMEM);
+	__leave;
+	return NULL;
+      }
+    }
+    if (NJB_Error_Pending(njb)) {
+      track_table_builder_destroy(tb);
+      __leave;
+      return NULL;
+    }
+  }
+
+  if (PDE_PROTOCOL_DEVICE(njb)) {
+    if (njb3_get_track_table(njb, tb) == -1) {
+      track_table_builder_destroy(tb);
+      /* The builder is the only thing that can fail silently */
+      if (!NJB_Error_Pending(njb)) {
+	NJB_ERROR(njb, EO_NOMEM);
+      }
+      __leave;
+      return NULL;
+    }
+  }
+
+  table = track_table_finish(tb);
+  if (table == NULL) {
+    NJB_ERROR(njb, EO_NOMEM);
+  }
+
+  __leave;
+  return table;
+}
+
+/** The number of tracks sampled for the series 3 snapshot key */
+#define SNAPSHOT_SAMPLE_SIZE 16
+/** The maximum length of a snapshot key */
+#define SNAPSHOT_MAX_KEY (48 + 8 * SNAPSHOT_SAMPLE_SIZE)
+
+/**
+ * Builds the key that tells if a track table snapshot is still
+ * valid for the device. On the NJB1 this is the SDMI ID and the
+ * library counter. The series 3 devices have no library counter,
+ * so the key is made up from the SDMI ID, the disk usage and the
+ * IDs and file sizes of the first tracks in the database.
+ *
+ * @param key a buffer of at least <code>SNAPSHOT_MAX_KEY</code>
+ *        bytes that will hold the key
+ * @param keylen a pointer to a variable that will hold the length
+ *        of the key
+ * @return 0 on success, -1 on failure
+ */
+static int _snapshot_key (njb_t *njb, unsigned char *key, u_int32_t *keylen)
+{
+  __dsub= "_snapshot_key";
+  u_int32_t i = 0;
+
+  __enter;
+
+  if (NJB_Get_SDMI_ID(njb, &key[4]) == -1) {
+    __leave;
+    return -1;
+  }
+
+  if (njb->device_type == NJB_DEVICE_NJB1) {
+    njb_state_t *state = (njb_state_t *) njb->protocol_state;
+
+    memcpy(key, "NJB1", 4);
+    i = 20;
+    from_32bit_to_njb3_bytes((u_int32_t) (state->libcount >> 32), &key[i]);
+    from_32bit_to_njb3_bytes((u_int32_t) state->libcount, &key[i+4]);
+    i += 8;
+  }
+
+  if (PDE_PROTOCOL_DEVICE(njb)) {
+    njb3_state_t *state = (njb3_state_t *) njb->protocol_state;
+    u_int32_t trids[SNAPSHOT_SAMPLE_SIZE];
+    u_int32_t sizes[SNAPSHOT_SAMPLE_SIZE];
+    u_int16_t nsample = SNAPSHOT_SAMPLE_SIZE;
+    u_int64_t btotal, bfree;
+    u_int16_t j;
+
+    if (njb3_get_disk_usage(njb, &btotal, &bfree) == -1) {
+      __leave;
+      return -1;
+    }
+    if (njb3_get_track_sample(njb, trids, sizes, &nsample) == -1) {
+      __leave;
+      return -1;
+    }
+    memcpy(key, "NJB3", 4);
+    i = 20;
+    from_32bit_to_njb3_bytes((u_int32_t) (btotal >> 32), &key[i]);
+    from_32bit_to_njb3_bytes((u_int32_t) btotal, &key[i+4]);
+    from_32bit_to_njb3_bytes((u_int32_t) (bfree >> 32), &key[i+8]);
+    from_32bit_to_njb3_bytes((u_int32_t) bfree, &key[i+12]);
+    i += 16;
+    /* The extended tags add the filename and folder columns */
+    from_16bit_to_njb3_bytes((u_int16_t) state->get_extended_tag_info, &key[i]);
+    from_16bit_to_njb3_bytes(nsample, &key[i+2]);
+    i += 4;
+    for (j = 0; j < nsample; j++) {
+      from_32bit_to_njb3_bytes(trids[j], &key[i]);
+      from_32bit_to_njb3_bytes(sizes[j], &key[i+4]);
+      i += 8;
+    }
+  }
+
+  *keylen = i;
+  __leave;
+  return 0;
+}
+
+/**
+ * This retrieves the metadata of all tracks on the device as a track
+ * table, like <code>NJB_Get_Track_Table()</code>, but keeps a snapshot
+ * of the table in a cache directory. When the device has not changed
+ * since the snapshot was saved, the table is loaded from the snapshot
+ * and no track metadata at all is transferred from the device.
+ *
+ * The snapshot is keyed by the SDMI ID of the device and, on the
+ * NJB1, the library counter. Series 3 devices have no library
+ * counter, so a cheap fingerprint made up from the disk usage and
+ * the first few track IDs and sizes is used instead. Changes made
+ * through this <code>njb_t</code> object are always detected, but
+ * on series 3 devices a tag edit made by another program, that does
+ * not change the size of any file, may go unnoticed.
+ *
+ * Failing to read or write the snapshot is not an error: the
+ * tracks are then simply retrieved from the device.
+ *
+ * Only the tracks are kept in the snapshot. Playlists and datafiles
+ * must still be retrieved from the device on every connect.
+ *
+ * @param njb a pointer to the <code>njb_t</code> object to get the
+ *            tracks from
+ * @param cachedir an existing directory to keep the snapshot files in,
+ *            one file per device
+ * @return a track table, which shall be destroyed with
+ *         <code>NJB_Track_Table_Destroy()</code> after use, or NULL
+ *         on failure
+ * @see NJB_Get_Track_Table()
+ */
+njb_track_table_t *NJB_Get_Track_Table_Cached (njb_t *njb, const char *cachedir)
+{
+  __dsub= "NJB_Get_Track_Table_Cached";
+  njb_track_table_t *table;
+  unsigned char key[SNAPSHOT_MAX_KEY];
+  u_int32_t keylen;
+  int *tracks_changed = NULL;
+  char *path;
+  int i;
+
+  __enter;
+
+  njb_error_clear(njb);
+
+  if (njb->device_type == NJB_DEVICE_NJB1) {
+    njb_state_t *state = (njb_state_t *) njb->protocol_state;
+    tracks_changed = &state->tracks_changed;
+  }
+  if (PDE_PROTOCOL_DEVICE(njb)) {
+    njb3_state_t *state = (njb3_state_t *) njb->protocol_state;
+    tracks_changed = &state->tracks_changed;
+  }
+  if (tracks_changed == NULL || cachedir == NULL) {
+    NJB_ERROR(njb, EO_INVALID);
+    __leave;
+    return NULL;
+  }
+
+  if (_snapshot_key(njb, key, &keylen) == -1) {
+    __leave;
+    return NULL;
+  }
+
+  /* <cachedir>/<SDMI ID in hex>.snapshot */
+  path = (char *) malloc(strlen(cachedir) + 2 + 32 + 10);
+  if (path == NULL) {
+    NJB_ERROR(njb, EO_NOMEM);
+    __leave;
+    return NULL;
+  }
+  strcpy(path, cachedir);
+  strcat(path, "/");
+  for (i = 0; i < 16; i++) {
+    sprintf(&path[strlen(path)], "%02x", key[4+i]);
+  }
+  strcat(path, ".snapshot");
+
+  if (*tracks_changed == 0) {
+    table = track_table_load(path, key, keylen);
+    if (table != NULL) {
+      free(path);
+      __leave;
+      return table;
+    }
+  }
+
+  table = NJB_Get_Track_Table(njb);
+  if (table != NULL) {
+    *tracks_changed = 0;
+    /* A snapshot that cannot be saved is simply not used next time */
+    track_table_save(path, key, keylen, table);
+  }
+  free(path);
+
+  __leave;
+  return table;
+}
+
 /**
  * This resets the playlist retrieveal function. The playlists
  * can then be retrieved one by one using the 
@@ -947,124 +1358,283 @@ clean_up_and_return:
 }
 
 
+/** Received data is written to a file descriptor in batches this large */
+#define RECV_BATCH_SIZE 0x40000U
+/** The largest block read in one go, including the NJB1 block header */
+#define RECV_BLOCK_SIZE (NJB_XFER_BLOCK_SIZE + NJB_XFER_BLOCK_HEADER_SIZE)
+
 /**
- * This retrieves ("uploads") a track from the device to the host
- * computer by way of a file descriptor, which is good for e.g.
- * streaming stuff. The daring type can start playing back audio
- * from the file descriptor before it is finished. This is also
- * good for fetching to temporary files, which are often only
- * given as file descriptors.
+ * Where the blocks of a track or file being retrieved go. The blocks
+ * are read from USB straight into <code>buf</code>, at the point where
+ * their data belongs, and handed on from there: written to the file
+ * descriptor in large batches and passed to the callback, or left in
+ * a buffer provided by the caller. Only a block that would not fit
+ * in <code>buf</code> is read into the scratch block and copied.
+ */
+typedef struct {
+  unsigned char *buf; /**< Where the data is collected */
+  unsigned char *mem; /**< The allocation holding buf, NULL for a caller's buffer */
+  u_int32_t size; /**< The room in buf */
+  u_int32_t fill; /**< The number of bytes in buf */
+  u_int32_t handed; /**< The number of bytes in buf already handed on */
+  int batching; /**< Whether to hand on the data only when buf is full */
+  int aborted; /**< Whether the callback asked to abort */
+  int fd; /**< The file descriptor to write to, or -1 */
+  NJB_Xfer_Callback *callback; /**< Called with the data as it is handed on */
+  void *data; /**< Passed on to the callback */
+  unsigned char *scratch; /**< For blocks that do not fit in buf */
+  unsigned char saved[NJB_XFER_BLOCK_HEADER_SIZE]; /**< Data under an NJB1 block header */
+} recv_sink_t;
+
+/**
+ * This sets up a sink for a track or file being retrieved.
  *
- * @param njb a pointer to the <code>njb_t</code> object to get
- *            the track from
- * @param fileid the unique trackid (also known as file ID, they
- *               are the same things) as reported by the device
- *               from e.g. <code>NJB_Get_Track_Tag()</code>.
- * @param size the size of the track in bytes. You know this size
- *             from previous calls to <code>NJB_Get_Track_Tag()</code>
- *             and it is needed among other things for displaying a
- *             progress bar and for determining that all bytes have been
- *             correctly retrieved.
- * @param fd the file descriptor that shall be fed with the track
- *           contents. The file descriptor must be writable. On
- *           win32 make sure it is a binary descriptor and not textual.
- * @param callback a function that will be called repeatedly to report
- *             progress during transfer, used for e.g. displaying
- *             progress bars
- * @param data a voluntary parameter that can associate some 
- *             user-supplied data with each callback call. It is OK
- *             to set this to NULL of course.
- * @return 0 on success, -1 on failure
- * @see NJB_Get_Track()
+ * @param sink the sink to set up
+ * @param fd the file descriptor to write the data to, or -1
+ * @param buf a buffer to put the data in, or NULL to use an
+ *            internal buffer
+ * @param bufsize the size of <code>buf</code>
+ * @param callback called with the data as it is handed on, or NULL
+ * @param data passed on to the callback
+ * @return 0 on success, -1 if out of memory
  */
-int NJB_Get_Track_fd (njb_t *njb, u_int32_t fileid, u_int32_t size,
-		      int fd, NJB_Xfer_Callback *callback, void *data)
+static int recv_sink_init (recv_sink_t *sink, int fd, void *buf,
+			   u_int32_t bufsize, NJB_Xfer_Callback *callback,
+			   void *data)
 {
-  __dsub= "NJB_Get_Track_fd";
-
-  unsigned char *block = NULL;
-  u_int32_t bsize, offset;
-  u_int32_t remain = size;
-  int abortxfer = 0;
-  int ret;
-
-  __enter;
+  memset(sink, 0, sizeof(recv_sink_t));
+  sink->fd = fd;
+  sink->callback = callback;
+  sink->data = data;
+  if (buf != NULL) {
+    sink->buf = (unsigned char *) buf;
+    sink->size = bufsize;
+    return 0;
+  }
+  /*
+   * Writes to a file descriptor are batched. Without one the data
+   * goes to the callback block by block as before, and one block
+   * is all the room needed.
+   */
+  sink->batching = (fd > -1);
+  sink->size = sink->batching ? RECV_BATCH_SIZE : RECV_BLOCK_SIZE;
+  /* Room in front of the data for the header of the first NJB1 block */
+  sink->mem = (unsigned char *) malloc(NJB_XFER_BLOCK_HEADER_SIZE + sink->size);
+  if (sink->mem == NULL) {
+    return -1;
+  }
+  sink->buf = sink->mem + NJB_XFER_BLOCK_HEADER_SIZE;
+  return 0;
+}
 
-  njb_error_clear(njb);
+/**
+ * This frees the buffers of a sink.
+ */
+static void recv_sink_free (recv_sink_t *sink)
+{
+  if (sink->mem != NULL) {
+    free(sink->mem);
+  }
+  if (sink->scratch != NULL) {
+    free(sink->scratch);
+  }
+}
 
-  if (njb->device_type == NJB_DEVICE_NJB1) {
+/**
+ * This returns where to read the next block to. A block is
+ * <code>head</code> bytes of header followed by at most
+ * <code>blocksize</code> bytes of data, and is placed so that the
+ * data lands right after the data already collected. The header then
+ * covers the end of that data, which is saved here and put back by
+ * <code>recv_sink_commit()</code>, a lot cheaper than moving the
+ * block data down.
+ *
+ * @return where to read the block to, or NULL if out of memory
+ */
+static unsigned char *recv_sink_target (recv_sink_t *sink, u_int32_t head,
+					u_int32_t blocksize)
+{
+  if (sink->fill + blocksize <= sink->size &&
+      (sink->mem != NULL || sink->fill >= head)) {
+    unsigned char *bp = sink->buf + sink->fill - head;
 
-    if ( njb_request_file(njb, fileid) == -1 ) {
-      ret = -1;
-      goto clean_up_and_return;
-    }
-    
-    if ( njb_verify_last_command(njb) == -1 ) {
-      NJB_ERROR(njb, EO_XFERDENIED);
-      ret = -1;
-      goto clean_up_and_return;
+    if (head > 0) {
+      memcpy(sink->saved, bp, head);
     }
+    return bp;
   }
+  if (sink->scratch == NULL) {
+    sink->scratch = (unsigned char *) malloc(RECV_BLOCK_SIZE);
+  }
+  return sink->scratch;
+}
+
+/**
+ * This adds the data of a block read to where
+ * <code>recv_sink_target()</code> said. This must be called for every
+ * block, with a length of 0 if the data is not wanted.
+ *
+ * @param sink the sink
+ * @param bp where the block was read to
+ * @param head the size of the block header
+ * @param len the number of data bytes to keep
+ */
+static void recv_sink_commit (recv_sink_t *sink, unsigned char *bp,
+			      u_int32_t head, u_int32_t len)
+{
+  if (bp == sink->scratch) {
+    /* A caller's buffer only has room for the file */
+    if (len > sink->size - sink->fill) {
+      len = sink->size - sink->fill;
+    }
+    memcpy(sink->buf + sink->fill, bp + head, len);
+  } else if (head > 0) {
+    memcpy(bp, sink->saved, head);
+  }
+  sink->fill += len;
+}
+
+/**
+ * This hands on the data collected since last time: writes it to
+ * the file descriptor and then passes it to the callback, so that
+ * the data is on file when the callback sees the offset.
+ *
+ * @param njb the device object, for error reporting
+ * @param sink the sink
+ * @param offset the offset reached in the track or file
+ * @param total the size of the track or file
+ * @param force hand on the data even if the batch is not full
+ * @return 0 on success, -1 if the data could not be written
+ */
+static int recv_sink_flush (njb_t *njb, recv_sink_t *sink, u_int32_t offset,
+			    u_int32_t total, int force)
+{
+  __dsub= "recv_sink_flush";
+  unsigned char *bp = sink->buf + sink->handed;
+  u_int32_t len = sink->fill - sink->handed;
+
+  if (len == 0) {
+    return 0;
+  }
+  if (sink->batching && !force &&
+      sink->size - sink->fill >= RECV_BLOCK_SIZE) {
+    return 0;
+  }
+
+  if (sink->fd > -1) {
+    u_int32_t left = len;
+
+    while (left > 0) {
+      ssize_t bwritten = write(sink->fd, bp + (len - left), left);
+
+      if (bwritten <= 0) {
+	njb_error_add(njb, "write", -1);
+	NJB_ERROR(njb, EO_WRFILE);
+	return -1;
+      }
+      left -= bwritten;
+    }
+  }
+  if (sink->callback != NULL) {
+    if (sink->callback(offset, total, (const char *) bp, len, sink->data) == -1) {
+      sink->aborted = 1;
+    }
+  }
+  if (sink->mem != NULL) {
+    sink->fill = 0;
+  }
+  sink->handed = sink->fill;
+  return 0;
+}
+
+/**
+ * This is a helper function for retrieving tracks and files.
+ * It gets a range of bytes from a track or file and hands them
+ * to a sink, which writes them to a file descriptor and/or passes
+ * them to a callback, or collects them in a buffer.
+ *
+ * @param njb a pointer to the <code>njb_t</code> object to get
+ *            the file from
+ * @param fileid the track ID or file ID to get
+ * @param size the size of the entire track or file in bytes
+ * @param start the offset of the first byte to get
+ * @param length the number of bytes to get, the range must be
+ *               within the file
+ * @param sink where to put the bytes, see <code>recv_sink_init()</code>
+ * @return 0 on success, -1 on failure
+ * @see NJB_Get_Track_fd()
+ * @see NJB_Get_Track_Range()
+ */
+static int get_file_range (njb_t *njb, u_int32_t fileid, u_int32_t size,
+			   u_int32_t start, u_int32_t length,
+			   recv_sink_t *sink)
+{
+  __dsub= "get_file_range";
+
+  u_int32_t bsize, offset = start;
+  u_int32_t end = start + length;
+  int abortxfer = 0;
+  int ret;
+
+  __enter;
 
-  /* File transfer routine for the NJB1 */
   if (njb->device_type == NJB_DEVICE_NJB1) {
-    u_int32_t bread = 0;
-    int wasshort = 0;
+
+    if ( njb_request_file(njb, fileid) == -1 ) {
+      ret = -1;
+      goto clean_up_and_return;
+    }
     
-    block = (unsigned char *) malloc(NJB_XFER_BLOCK_SIZE + NJB_XFER_BLOCK_HEADER_SIZE);
-    if ( block == NULL ) {
-      NJB_ERROR(njb, EO_NOMEM);
+    if ( njb_verify_last_command(njb) == -1 ) {
+      NJB_ERROR(njb, EO_XFERDENIED);
       ret = -1;
       goto clean_up_and_return;
     }
-    memset(block, 0, NJB_XFER_BLOCK_SIZE + NJB_XFER_BLOCK_HEADER_SIZE);
-    offset = 0;
-    while (remain != 0 && !abortxfer) {
+  }
+
+  /* File transfer routine for the NJB1 */
+  if (njb->device_type == NJB_DEVICE_NJB1) {
+    u_int32_t bread = 0;
+    u_int32_t payload;
+    unsigned char *bp;
+    
+    while (offset < end && !abortxfer) {
       /* Request as much as possible unless the last chunk is reached */
-      bsize = (remain > NJB_XFER_BLOCK_SIZE) ? NJB_XFER_BLOCK_SIZE : remain;
+      bsize = (end - offset > NJB_XFER_BLOCK_SIZE) ? NJB_XFER_BLOCK_SIZE : end - offset;
       
-      bread = 0;
-      
-      bread = njb_receive_file_block(njb, offset, bsize, &block[0]);
-      if (bread < bsize + NJB_XFER_BLOCK_HEADER_SIZE) {
-	wasshort = 1;
-      } else {
-	wasshort = 0;
+      /* The data goes straight to the sink, the header in front of it */
+      bp = recv_sink_target(sink, NJB_XFER_BLOCK_HEADER_SIZE, bsize);
+      if (bp == NULL) {
+	NJB_ERROR(njb, EO_NOMEM);
+	ret = -1;
+	goto clean_up_and_return;
       }
       
+      bread = njb_receive_file_block(njb, offset, bsize, bp);
+      
       /* Handle errors */
       if (bread == -1) {
+	recv_sink_commit(sink, bp, NJB_XFER_BLOCK_HEADER_SIZE, 0);
 	ret = -1;
 	goto clean_up_and_return;
       }
       
-      /* Good debug messages */
-      /*
-	fprintf(stdout, "File get: recieved %04x bytes", bread);
-	if (wasshort)
-	fprintf(stdout, " - short read");
-	fprintf(stdout,"\n");
-      */
+      /* Short reads are OK, the next block starts where this one ended */
+      payload = (bread > NJB_XFER_BLOCK_HEADER_SIZE) ? 
+	bread - NJB_XFER_BLOCK_HEADER_SIZE : 0;
+      recv_sink_commit(sink, bp, NJB_XFER_BLOCK_HEADER_SIZE, payload);
+      offset += payload;
       
-      /* Write receieved bytes to file */
-      if (fd > -1 && bread > NJB_XFER_BLOCK_HEADER_SIZE) {
-	if ( (write(fd, &block[NJB_XFER_BLOCK_HEADER_SIZE], bread-NJB_XFER_BLOCK_HEADER_SIZE)) == -1 ) {
-	  njb_error_add(njb, "write", -1);
-	  NJB_ERROR(njb, EO_WRFILE);
-	  ret = -1;
-	  goto clean_up_and_return;
-	}
-      }
-      
-      remain -= (bread-NJB_XFER_BLOCK_HEADER_SIZE);
-      offset += (bread-NJB_XFER_BLOCK_HEADER_SIZE);
-      
-      if ( callback != NULL ) {
-	const char *last_block= (const char *) &block[NJB_XFER_BLOCK_HEADER_SIZE];
-	if ( callback(offset, size, last_block, bread-NJB_XFER_BLOCK_HEADER_SIZE, data) == -1 ) {
-	  abortxfer = 1;
-	}
+      if (recv_sink_flush(njb, sink, offset, size, 0) == -1) {
+	ret = -1;
+	goto clean_up_and_return;
       }
+      abortxfer = sink->aborted;
+    }
+    
+    if (recv_sink_flush(njb, sink, offset, size, 1) == -1) {
+      ret = -1;
+      goto clean_up_and_return;
     }
     
     /* This is probably not the right way to abort a file transfer */
@@ -1091,19 +1661,7 @@ int NJB_Get_Track_fd (njb_t *njb, u_int32_t fileid, u_int32_t size,
     /* FIXME: add this and test. */
     /* njb3_ctrl_playing(njb, NJB3_STOP_PLAY); */
     
-    block = (unsigned char *) malloc(NJB3_CHUNK_SIZE);
-    if (block == NULL) {
-      NJB_ERROR(njb, EO_NOMEM);
-      ret = -1;
-      goto clean_up_and_return;
-    }
-    
-    /* Start at beginning of file */
-    offset = 0;
-    remain = size;
-    
-    while (remain != 0 && abortxfer == 0) {
-      u_int32_t bwritten;
+    while (offset < end && abortxfer == 0) {
       int chunk_size;
       int chunk_remain;
       int bread;
@@ -1113,24 +1671,36 @@ int NJB_Get_Track_fd (njb_t *njb, u_int32_t fileid, u_int32_t size,
        * indexed at an offset into the file. 
        */
       chunk_size = njb3_request_file_chunk(njb, fileid, offset);
+      if ( chunk_size == -1 ) {
+	ret = -1;
+	goto clean_up_and_return;
+      }
+      /* Nothing more to get, the file is shorter than we thought */
+      if ( chunk_size == 0 ) {
+	if (end != size) {
+	  NJB_ERROR(njb, EO_EOF);
+	  ret = -1;
+	  goto clean_up_and_return;
+	}
+	size = end = offset;
+	break;
+      }
       /*
        * This addresses a particular problem exposed by the recordings
        * made on the NJB3: files are reported as being smaller than
        * they actually are. It is a firmware bug, but let's just work
        * around it. (Fixed by Richard Low on 2005-09-22.)
+       * This only applies when the range runs to the end of the file,
+       * otherwise the range simply ends inside this chunk.
        */
-      if (chunk_size > remain) {
+      if (end == size && chunk_size > end - offset) {
 	printf("LIBNJB panic: chunk_size > remain, going to get whole chunk and see what happens\n");
 	if (chunk_size == NJB3_CHUNK_SIZE) {
-	  size += (NJB3_CHUNK_SIZE) + 1 - remain;
-	  remain = NJB3_CHUNK_SIZE + 1;
+	  end = offset + NJB3_CHUNK_SIZE + 1;
 	} else {
-	  size += (chunk_size - remain);
-	  remain = chunk_size;
+	  end = offset + chunk_size;
 	}
-      } else if ( chunk_size == -1 ) {
-	ret = -1;
-	goto clean_up_and_return;
+	size = end;
       }
       
       chunk_remain = chunk_size;
@@ -1139,6 +1709,8 @@ int NJB_Get_Track_fd (njb_t *njb, u_int32_t fileid, u_int32_t size,
        * cancelling the transfer! */
       while (chunk_remain != 0) {
 	u_int32_t blocksize;
+	u_int32_t wanted;
+	unsigned char *bp;
 
 	/*
 	 * This speed-up hack works on most devices but is
@@ -1165,7 +1737,13 @@ int NJB_Get_Track_fd (njb_t *njb, u_int32_t fileid, u_int32_t size,
 	 * read, that's OK 
 	 */
 	/* printf("Requesting chunk size %08X, remaining %08X...\n", NJB3_SUBCHUNK_SIZE, chunk_remain); */
-	bread = njb3_get_file_block(njb, block, blocksize);
+	bp = recv_sink_target(sink, 0, blocksize);
+	if (bp == NULL) {
+	  NJB_ERROR(njb, EO_NOMEM);
+	  ret = -1;
+	  goto clean_up_and_return;
+	}
+	bread = njb3_get_file_block(njb, bp, blocksize);
 	/* Negative value signals error */
 	if ( bread == -1 ) {
 	  ret = -1;
@@ -1190,51 +1768,30 @@ int NJB_Get_Track_fd (njb_t *njb, u_int32_t fileid, u_int32_t size,
 	  }
 	  bread = chunk_remain;
 	}
-	
-	if (fd > -1) {
-	  /* Write the bytes to the destination file */
-	  if ( (bwritten = write(fd, block, bread) ) == -1 ) {
-	    njb_error_add(njb, "write", -1);
-	    NJB_ERROR(njb, EO_WRFILE);
-	    ret = -1;
-	    goto clean_up_and_return;
-	  } else if ( bwritten != bread ) {
-	    NJB_ERROR(njb, EO_WRFILE);
-	    ret = -1;
-	    goto clean_up_and_return;
-	  }
-	}
 	chunk_remain -= bread;
-	offset += bread;
-	
-	if ( callback != NULL) {
-	  if ( callback(offset, size, (const char *) block, bread, data) == -1 )
-	    abortxfer= 1;
-	}
-      }
-      
-      /*
-       * We have recieved a whole chunk or are at the 
-       * end of the file.
-       */
-      if (chunk_size > remain) {
-	int extraneous = chunk_size - remain;
-	if (extraneous == 1) {
-	  /* printf("LIBNJB: one extraneous byte in chunk.\n"); */
+
+	/* The rest of the chunk is drained but not part of the range */
+	if (offset >= end) {
+	  continue;
 	}
-	if (extraneous > 1) {
-	  /* This should, however, not happen. */
-	  printf("LIBNJB panic: recieved %d extraneous bytes!\n", extraneous);
+	wanted = (bread > end - offset) ? end - offset : bread;
+	
+	recv_sink_commit(sink, bp, 0, wanted);
+	offset += wanted;
+	
+	if (recv_sink_flush(njb, sink, offset, size, 0) == -1) {
+	  ret = -1;
+	  goto clean_up_and_return;
 	}
-	chunk_size = remain;
-      }
-      remain -= chunk_size;
-      if (remain < 0) {
-	printf("LIBNJB panic: Remain < 0!\n");
-	remain = 0;
+	abortxfer = sink->aborted;
       }
     }
     
+    if (recv_sink_flush(njb, sink, offset, size, 1) == -1) {
+      ret = -1;
+      goto clean_up_and_return;
+    }
+    
     /*
      * File confirmation is accomplished by requesting 
      * file offset set at the file size (e.g. one past 
@@ -1257,14 +1814,469 @@ int NJB_Get_Track_fd (njb_t *njb, u_int32_t fileid, u_int32_t size,
   
 clean_up_and_return:
   
-  if ( block != NULL ) {
-    free(block);
+  /* Keep what was received before the failure */
+  if (ret == -1) {
+    recv_sink_flush(njb, sink, offset, size, 1);
   }
   
   __leave;
   return ret;
 }
 
+/**
+ * This gets a range of bytes from a track or file, writing them to
+ * a file descriptor and/or passing them to a callback.
+ *
+ * @param njb a pointer to the <code>njb_t</code> object to get
+ *            the file from
+ * @param fileid the track ID or file ID to get
+ * @param size the size of the entire track or file in bytes
+ * @param start the offset of the first byte to get
+ * @param length the number of bytes to get
+ * @param fd the file descriptor to write the bytes to, or -1
+ * @param callback a function that will be called with the offset
+ *             reached in the file once the bytes are written
+ * @param data a voluntary parameter passed to the callback
+ * @return 0 on success, -1 on failure
+ * @see get_file_range()
+ */
+static int get_file_range_fd (njb_t *njb, u_int32_t fileid, u_int32_t size,
+			      u_int32_t start, u_int32_t length, int fd,
+			      NJB_Xfer_Callback *callback, void *data)
+{
+  __dsub= "get_file_range_fd";
+  recv_sink_t sink;
+  int ret;
+
+  if (recv_sink_init(&sink, fd, NULL, 0, callback, data) == -1) {
+    NJB_ERROR(njb, EO_NOMEM);
+    return -1;
+  }
+  ret = get_file_range(njb, fileid, size, start, length, &sink);
+  recv_sink_free(&sink);
+  return ret;
+}
+
+/**
+ * This retrieves ("uploads") a track from the device to the host
+ * computer by way of a file descriptor, which is good for e.g.
+ * streaming stuff. The daring type can start playing back audio
+ * from the file descriptor before it is finished. This is also
+ * good for fetching to temporary files, which are often only
+ * given as file descriptors.
+ *
+ * @param njb a pointer to the <code>njb_t</code> object to get
+ *            the track from
+ * @param fileid the unique trackid (also known as file ID, they
+ *               are the same things) as reported by the device
+ *               from e.g. <code>NJB_Get_Track_Tag()</code>.
+ * @param size the size of the track in bytes. You know this size
+ *             from previous calls to <code>NJB_Get_Track_Tag()</code>
+ *             and it is needed among other things for displaying a
+ *             progress bar and for determining that all bytes have been
+ *             correctly retrieved.
+ * @param fd the file descriptor that shall be fed with the track
+ *           contents. The file descriptor must be writable. On
+ *           win32 make sure it is a binary descriptor and not textual.
+ *           The contents are written in batches of a few hundred
+ *           kilobytes.
+ * @param callback a function that will be called repeatedly to report
+ *             progress during transfer, used for e.g. displaying
+ *             progress bars. It is called after each batch has been
+ *             written to the file descriptor, or after each block
+ *             if the file descriptor is -1.
+ * @param data a voluntary parameter that can associate some 
+ *             user-supplied data with each callback call. It is OK
+ *             to set this to NULL of course.
+ * @return 0 on success, -1 on failure
+ * @see NJB_Get_Track()
+ */
+int NJB_Get_Track_fd (njb_t *njb, u_int32_t fileid, u_int32_t size,
+		      int fd, NJB_Xfer_Callback *callback, void *data)
+{
+  __dsub= "NJB_Get_Track_fd";
+  int ret;
+
+  __enter;
+
+  njb_error_clear(njb);
+  ret = get_file_range_fd(njb, fileid, size, 0, size, fd, callback, data);
+
+  __leave;
+  return ret;
+}
+
+/**
+ * This retrieves a range of bytes from a track or file on the
+ * device. This can be used to only read the first part of a track,
+ * e.g. to parse its tag, or to continue a transfer that failed
+ * halfway.
+ *
+ * The bytes are written to the file descriptor, starting at its
+ * current position, and handed to the callback as they arrive. If
+ * the file descriptor is -1, the callback is the only receiver of
+ * the data.
+ *
+ * @param njb a pointer to the <code>njb_t</code> object to get
+ *            the track from
+ * @param fileid the track ID or file ID to get
+ * @param size the size of the entire track or file in bytes
+ * @param offset the offset of the first byte to get
+ * @param length the number of bytes to get. The range is cut off
+ *               at the end of the file.
+ * @param fd the file descriptor that shall be fed with the range,
+ *           or -1
+ * @param callback a function that will be called repeatedly to report
+ *             progress during transfer. The <code>sent</code>
+ *             parameter is the offset into the track or file, and
+ *             <code>total</code> is the size of it.
+ * @param data a voluntary parameter that can associate some 
+ *             user-supplied data with each callback call. It is OK
+ *             to set this to NULL of course.
+ * @return 0 on success, -1 on failure
+ * @see NJB_Get_Track_fd()
+ * @see NJB_Get_Track_Resume()
+ */
+int NJB_Get_Track_Range (njb_t *njb, u_int32_t fileid, u_int32_t size,
+			 u_int32_t offset, u_int32_t length, int fd,
+			 NJB_Xfer_Callback *callback, void *data)
+{
+  __dsub= "NJB_Get_Track_Range";
+  int ret;
+
+  __enter;
+
+  njb_error_clear(njb);
+
+  if (offset > size) {
+    NJB_ERROR(njb, EO_INVALID);
+    __leave;
+    return -1;
+  }
+  if (length > size - offset) {
+    length = size - offset;
+  }
+  ret = get_file_range_fd(njb, fileid, size, offset, length, fd,
+			  callback, data);
+
+  __leave;
+  return ret;
+}
+
+/**
+ * This retrieves a track or file from the device into memory. The
+ * data is read from USB straight into the buffer, without a bounce
+ * through a file descriptor or a block buffer, which is the cheapest
+ * way for applications that parse or play the track themselves.
+ *
+ * @param njb a pointer to the <code>njb_t</code> object to get
+ *            the track from
+ * @param fileid the track ID or file ID to get
+ * @param size the size of the track or file in bytes
+ * @param buf a buffer of at least <code>size</code> bytes to put
+ *            the track or file in
+ * @param callback a function that will be called after each block
+ *             with the offset reached. Its <code>buf</code> parameter
+ *             points at the new bytes inside the buffer.
+ * @param data a voluntary parameter that can associate some 
+ *             user-supplied data with each callback call. It is OK
+ *             to set this to NULL of course.
+ * @return 0 on success, -1 on failure
+ * @see NJB_Get_Track_fd()
+ */
+int NJB_Get_Track_Buffer (njb_t *njb, u_int32_t fileid, u_int32_t size,
+			  void *buf, NJB_Xfer_Callback *callback, void *data)
+{
+  __dsub= "NJB_Get_Track_Buffer";
+  recv_sink_t sink;
+  int ret;
+
+  __enter;
+
+  njb_error_clear(njb);
+
+  if (buf == NULL) {
+    NJB_ERROR(njb, EO_INVALID);
+    __leave;
+    return -1;
+  }
+  recv_sink_init(&sink, -1, buf, size, callback, data);
+  ret = get_file_range(njb, fileid, size, 0, size, &sink);
+  recv_sink_free(&sink);
+
+  __leave;
+  return ret;
+}
+
+/** The resume journal is rewritten at least this often (in bytes) */
+#define RESUME_JOURNAL_INTERVAL 0x100000U
+
+/**
+ * State of a resumable transfer, used by the journaling callback.
+ */
+typedef struct {
+  njb_t *njb;
+  char *journal; /**< Path to the journal */
+  u_int32_t fileid;
+  u_int32_t size;
+  u_int32_t logged; /**< The offset last written to the journal */
+  u_int32_t reached; /**< The offset written to the local file */
+  NJB_Xfer_Callback *callback; /**< The callback of the caller */
+  void *data; /**< The callback data of the caller */
+} resume_t;
+
+/**
+ * Writes the journal of a resumable transfer. The journal is a
+ * single line of text holding the file ID, the size of the file
+ * and the number of bytes that have been written to the local file.
+ *
+ * @return 0 on success, -1 on failure
+ */
+static int resume_write_journal (resume_t *r, u_int32_t offset)
+{
+  FILE *fp;
+
+  fp = fopen(r->journal, "w");
+  if (fp == NULL) {
+    return -1;
+  }
+  fprintf(fp, "NJBRESUME 1 %u %u %u\n", r->fileid, r->size, offset);
+  if (fclose(fp) != 0) {
+    return -1;
+  }
+  r->logged = offset;
+  return 0;
+}
+
+/**
+ * Reads the journal of a resumable transfer.
+ *
+ * @return the offset to resume from, or 0 if there is no journal
+ *         for this file
+ */
+static u_int32_t resume_read_journal (resume_t *r)
+{
+  FILE *fp;
+  unsigned int fileid, size, offset;
+  int n;
+
+  fp = fopen(r->journal, "r");
+  if (fp == NULL) {
+    return 0;
+  }
+  n = fscanf(fp, "NJBRESUME 1 %u %u %u", &fileid, &size, &offset);
+  fclose(fp);
+  if (n != 3 || fileid != r->fileid || size != r->size || offset > size) {
+    return 0;
+  }
+  return offset;
+}
+
+/**
+ * Transfer callback for resumable transfers. The blocks are
+ * written to the local file before the callback is called, so
+ * the offset passed in is safe to record in the journal.
+ */
+static int resume_callback (u_int64_t sent, u_int64_t total, const char *buf,
+			    unsigned len, void *data)
+{
+  resume_t *r = (resume_t *) data;
+
+  r->reached = (u_int32_t) sent;
+  if (sent - r->logged >= RESUME_JOURNAL_INTERVAL) {
+    /* If the journal can't be written we'll just resume from further back */
+    resume_write_journal(r, (u_int32_t) sent);
+  }
+  if (r->callback != NULL) {
+    return r->callback(sent, total, buf, len, r->data);
+  }
+  return 0;
+}
+
+/**
+ * This retrieves a track or file from the device into a local
+ * file, continuing a previous transfer if possible. The progress
+ * of the transfer is recorded in a small journal next to the file,
+ * named like the file with <code>.njbresume</code> appended. If the
+ * transfer fails, the partial file and the journal are kept, and
+ * calling this function again continues from the last recorded
+ * offset instead of starting over. When the transfer is complete
+ * the journal is removed.
+ *
+ * A partial file without a journal, or with a journal for another
+ * track, is discarded and the transfer starts from the beginning.
+ *
+ * @param njb a pointer to the <code>njb_t</code> object to get
+ *            the track from
+ * @param fileid the track ID or file ID to get
+ * @param size the size of the track or file in bytes
+ * @param path the path where the resulting file should be written
+ * @param callback a function that will be called repeatedly to report
+ *             progress during transfer. The first call will report
+ *             the offset the transfer was resumed from.
+ * @param data a voluntary parameter that can associate some 
+ *             user-supplied data with each callback call. It is OK
+ *             to set this to NULL of course.
+ * @return 0 on success, -1 on failure
+ * @see NJB_Get_Track()
+ * @see NJB_Get_Track_Range()
+ */
+int NJB_Get_Track_Resume (njb_t *njb, u_int32_t fileid, u_int32_t size,
+			  const char *path, NJB_Xfer_Callback *callback, void *data)
+{
+  __dsub= "NJB_Get_Track_Resume";
+  resume_t r;
+  u_int32_t offset;
+  struct stat sb;
+  int fd;
+  int ret;
+
+  __enter;
+
+  njb_error_clear(njb);
+
+  r.njb = njb;
+  r.fileid = fileid;
+  r.size = size;
+  r.logged = 0;
+  r.reached = 0;
+  r.callback = callback;
+  r.data = data;
+  r.journal = (char *) malloc(strlen(path) + 11);
+  if (r.journal == NULL) {
+    NJB_ERROR(njb, EO_NOMEM);
+    __leave;
+    return -1;
+  }
+  strcpy(r.journal, path);
+  strcat(r.journal, ".njbresume");
+
+  /* Only trust as much of the local file as the journal says */
+  offset = resume_read_journal(&r);
+  if (offset > 0 && (stat(path, &sb) == -1 || sb.st_size < offset)) {
+    offset = 0;
+  }
+
+#ifdef __WIN32__
+  fd = open(path, O_CREAT|O_WRONLY|O_BINARY, 0664);
+#else
+  fd = open(path, O_CREAT|O_WRONLY, 0664);
+#endif
+  if (fd == -1) {
+    njb_error_add(njb, "open", -1);
+    NJB_ERROR(njb, EO_TMPFILE);
+    free(r.journal);
+    __leave;
+    return -1;
+  }
+  /* Throw away anything beyond the verified offset */
+  if (ftruncate(fd, offset) == -1 || lseek(fd, offset, SEEK_SET) == -1) {
+    njb_error_add(njb, "ftruncate", -1);
+    NJB_ERROR(njb, EO_WRFILE);
+    close(fd);
+    free(r.journal);
+    __leave;
+    return -1;
+  }
+  resume_write_journal(&r, offset);
+  r.reached = offset;
+
+  if (callback != NULL && offset > 0) {
+    callback(offset, size, NULL, 0, data);
+  }
+  ret = get_file_range_fd(njb, fileid, size, offset, size - offset, fd,
+			  resume_callback, &r);
+  if (close(fd) == -1 && ret == 0) {
+    njb_error_add(njb, "close", -1);
+    NJB_ERROR(njb, EO_WRFILE);
+    ret = -1;
+  }
+
+  if (ret == 0) {
+    unlink(r.journal);
+  } else {
+    /* Everything up to the last block was written before the failure */
+    resume_write_journal(&r, r.reached);
+  }
+  free(r.journal);
+
+  __leave;
+  return ret;
+}
+
+/**
+ * This builds the path of the transfer profile for a series 3
+ * device: <code>&lt;dir&gt;/&lt;product&gt;-&lt;firmware&gt;.xfer</code>.
+ * Devices of the same model running the same firmware share a
+ * profile.
+ *
+ * @param njb a pointer to the <code>njb_t</code> object
+ * @return a newly allocated path, or NULL if profiles are not kept
+ */
+static char *_xfer_profile_path(njb_t *njb)
+{
+  njb3_state_t *state = (njb3_state_t *) njb->protocol_state;
+  const char *product;
+  char *path;
+  size_t len;
+  int i;
+
+  if (state->xfer_profile_dir == NULL) {
+    return NULL;
+  }
+  product = (state->product_name != NULL) ? state->product_name : "unknown";
+  len = strlen(state->xfer_profile_dir) + 1 + strlen(product);
+  path = (char *) malloc(len + 20);
+  if (path == NULL) {
+    return NULL;
+  }
+  strcpy(path, state->xfer_profile_dir);
+  strcat(path, "/");
+  /* Product names contain spaces and the like */
+  for (i = strlen(path); *product != '\0'; product++, i++) {
+    path[i] = isalnum((unsigned char) *product) ? *product : '_';
+  }
+  sprintf(&path[i], "-%u.%u.%u.xfer", state->fwMajor, state->fwMinor,
+	  state->fwRel);
+  return path;
+}
+
+/**
+ * This loads the transfer profile of a series 3 device into its
+ * block size tuner, if there is one.
+ *
+ * @param njb a pointer to the <code>njb_t</code> object
+ */
+static void _xfer_profile_load(njb_t *njb)
+{
+  njb3_state_t *state = (njb3_state_t *) njb->protocol_state;
+  char *path = _xfer_profile_path(njb);
+
+  if (path != NULL) {
+    /* Without a usable profile the tuner just starts probing */
+    xfer_tuner_load(&state->send_tuner, path);
+    free(path);
+  }
+  state->send_tuner.loaded = 1;
+}
+
+/**
+ * This saves the settled block size of a series 3 device to its
+ * transfer profile. Failing to save is not an error: the next
+ * session will simply probe again.
+ *
+ * @param njb a pointer to the <code>njb_t</code> object
+ */
+static void _xfer_profile_save(njb_t *njb)
+{
+  njb3_state_t *state = (njb3_state_t *) njb->protocol_state;
+  char *path = _xfer_profile_path(njb);
+
+  if (path != NULL) {
+    xfer_tuner_save(&state->send_tuner, path);
+    free(path);
+  }
+}
 
 /**
  * This is a helper function for sending tracks and files.
@@ -1274,7 +2286,8 @@ clean_up_and_return:
  *
  * @param njb a pointer to the <code>njb_t</code> object to send the
  *            file to
- * @param path the filesystem path on the local host to use as indata
+ * @param reader the function that reads the data to send
+ * @param readdata the data passed on to <code>reader</code>
  * @param size the size of the file to be sent, in bytes
  * @param fileid the file ID to send the data to; this must be
  *               established by earlier calls to the device before
@@ -1290,39 +2303,33 @@ clean_up_and_return:
  * @return 0 on success, -1 on failure
  * @see NJB_Send_Track()
  * @see NJB_Send_File()
+ * @see send_file()
  */
-static int send_file (njb_t *njb, const char *path, u_int64_t size, 
-		      u_int32_t fileid, NJB_Xfer_Callback *callback, 
-		      void *data, int operation)
+static int send_stream (njb_t *njb, NJB_Read_Callback *reader,
+			void *readdata, u_int64_t size, 
+			u_int32_t fileid, NJB_Xfer_Callback *callback, 
+			void *data, int operation)
 {
-  __dsub= "send_file";
+  __dsub= "send_stream";
   u_int64_t remain, offset;
   u_int32_t bp;
-  size_t bread;
+  int bread;
   unsigned char *block;
-  int fd;
   int abortxfer= 0;
-  int retry = 15;
-  struct stat sb;
+  u_int32_t waited;
+  u_int32_t started;
   
   __enter;
 
-#ifdef __WIN32__
-  if ( (fd = open(path, O_RDONLY|O_BINARY)) == -1 ) {
-#else
-  if ( (fd = open(path, O_RDONLY)) == -1 ) {
-#endif
-    njb_error_add(njb, "open", -1);
-    NJB_ERROR(njb, EO_SRCFILE);
-    __leave;
-    return -1;
-  }
-  
-  if ( fstat(fd, &sb) == -1 ) {
-    njb_error_add(njb, "fstat", -1);
-    NJB_ERROR(njb, EO_SRCFILE);
-    __leave;
-    return -1;
+  if (njb->device_type == NJB_DEVICE_NJB1) {
+    njb_state_t *state = (njb_state_t *) njb->protocol_state;
+    njb_xfer_stats_t stats;
+
+    /* NJB_Get_Transfer_Stalls() counts from here */
+    if (xferstats_get(njb, &stats) == 0) {
+      state->upload_not_ready = stats.not_ready;
+      state->upload_not_ready_ms = stats.not_ready_ms;
+    }
   }
 
   /* This space will be used as a reading ring buffer for the transfers */
@@ -1330,7 +2337,6 @@ static int send_file (njb_t *njb, const char *path, u_int64_t size,
   
   /* Terminate if memory block could not be allocated */
   if ( block == NULL ) {
-    close(fd);
     NJB_ERROR(njb, EO_NOMEM);
     __leave;
     return -1;
@@ -1360,6 +2366,15 @@ static int send_file (njb_t *njb, const char *path, u_int64_t size,
 	 */
 	if (state->turbo_mode == NJB_TURBO_OFF) {
 	  maxblock = NJB3_DEFAULT_SEND_FILE_BLOCK_SIZE;
+	} else if (state->turbo_mode == NJB_TURBO_TUNED) {
+	  /*
+	   * The tuner starts out at the turbo size and backs off on
+	   * devices where it does not work well.
+	   */
+	  if (!state->send_tuner.loaded) {
+	    _xfer_profile_load(njb);
+	  }
+	  maxblock = xfer_tuner_block_size(&state->send_tuner);
 	} else {
 	  /*
 	   * This hack courtesy of Richard Low.
@@ -1402,9 +2417,8 @@ static int send_file (njb_t *njb, const char *path, u_int64_t size,
 	printf("Remain %08x bytes, filling buffer with %08x bytes\n", (u_int32_t) remain, readsize);
       */
       
-      if ( (bread = read(fd, &block[bufbottom], readsize)) < 1 ) {
+      if ( (bread = reader(&block[bufbottom], readsize, readdata)) < 1 ) {
 	NJB_ERROR2(njb, "reached EOF (unexpected)", EO_SRCFILE);
-	close(fd);
 	free(block);
 	__leave;
 	return -1;
@@ -1422,7 +2436,16 @@ static int send_file (njb_t *njb, const char *path, u_int64_t size,
     
     if (PDE_PROTOCOL_DEVICE(njb)) {
       if (operation == 0) {
+	njb3_state_t *state = (njb3_state_t *) njb->protocol_state;
+	u_int32_t block_started = njb_get_millis();
+
 	bwritten = njb3_send_file_chunk(njb, &block[bp], xfersize, fileid);
+	if (bwritten != -1 && state->turbo_mode == NJB_TURBO_TUNED) {
+	  if (xfer_tuner_report(&state->send_tuner, xfersize, bwritten,
+				njb_get_millis() - block_started)) {
+	    _xfer_profile_save(njb);
+	  }
+	}
       } else if (operation == 1) {
 	bwritten = njb3_send_firmware_chunk(njb, xfersize, &block[bp]);
       }
@@ -1431,7 +2454,6 @@ static int send_file (njb_t *njb, const char *path, u_int64_t size,
     }
 
     if ( bwritten == -1 ) {
-      close(fd);
       free(block);
       __leave;
       return -1;
@@ -1457,7 +2479,6 @@ static int send_file (njb_t *njb, const char *path, u_int64_t size,
       /* DO NOTHING */
     } else if (njb->device_type == NJB_DEVICE_NJB1) {
       if ( njb_verify_last_command(njb) == -1 ) {
-	close(fd);
 	free(block);
 	
 	__leave;
@@ -1472,7 +2493,6 @@ static int send_file (njb_t *njb, const char *path, u_int64_t size,
   }
   
   free(block);
-  close(fd);
 	
   
   if (PDE_PROTOCOL_DEVICE(njb)) {
@@ -1493,8 +2513,14 @@ static int send_file (njb_t *njb, const char *path, u_int64_t size,
     }
   } else {
     /* Complete transfer for NJB1  */
-    while ( retry ) {
+    started = njb_get_millis();
+    waited = 0;
+    while ( waited <= NJB_COMPLETE_TIMEOUT_MS ) {
       if ( njb_transfer_complete(njb) == 0 ) {
+	if ( waited != 0 ) {
+	  /* This wait says nothing about the typical wait for a block */
+	  xferstats_not_ready(njb, waited);
+	}
 	if ( abortxfer ) {
 	  NJB_ERROR(njb, EO_ABORTED);
 	  __leave;
@@ -1508,21 +2534,207 @@ static int send_file (njb_t *njb, const char *path, u_int64_t size,
 	__leave;
 	return 0;
       }
+      /* The device is still busy writing the file, poll again soon */
+      njb_sleep_millis(njb_ready_delay(njb, waited, NJB_COMPLETE_MAX_DELAY_MS));
+      waited = njb_get_millis() - started;
+    }
+    NJB_ERROR(njb, EO_TIMEOUT);
+    __leave;
+    return -1;
+  }
+  __leave;
+  return 0;
+}
+
+/**
+ * This reads the next chunk of a file for <code>send_stream()</code>.
+ *
+ * @param buf the buffer to read into
+ * @param len the number of bytes to read
+ * @param data a pointer to the file descriptor to read from
+ * @return the number of bytes read, 0 at end of file or -1 on error
+ */
+static int read_fd (void *buf, u_int32_t len, void *data)
+{
+  return (int) read(*(int *) data, buf, len);
+}
+
+/**
+ * This sends a file from the local filesystem using
+ * <code>send_stream()</code>.
+ *
+ * @param njb a pointer to the <code>njb_t</code> object to send the
+ *            file to
+ * @param path the filesystem path on the local host to use as indata
+ * @param size the size of the file to be sent, in bytes
+ * @param fileid the file ID to send the data to
+ * @param callback progress callback for the transfer, may be NULL
+ * @param data user data for the callback
+ * @param operation 0 for a file or track, 1 for a firmware image
+ * @return 0 on success, -1 on failure
+ */
+static int send_file (njb_t *njb, const char *path, u_int64_t size, 
+		      u_int32_t fileid, NJB_Xfer_Callback *callback, 
+		      void *data, int operation)
+{
+  __dsub= "send_file";
+  int fd;
+  int ret;
+
+  __enter;
+
 #ifdef __WIN32__
-      /* 
-       * This is because sleep() is actually deprecated in favor of
-       * Sleep() on Windows.
-       */
-      _sleep(1);
+  if ( (fd = open(path, O_RDONLY|O_BINARY)) == -1 ) {
 #else
-      sleep(1);
+  if ( (fd = open(path, O_RDONLY)) == -1 ) {
 #endif
-      retry--;
+    njb_error_add(njb, "open", -1);
+    NJB_ERROR(njb, EO_SRCFILE);
+    __leave;
+    return -1;
+  }
+
+  ret = send_stream(njb, read_fd, &fd, size, fileid, callback, data,
+		    operation);
+  close(fd);
+
+  __leave;
+  return ret;
+}
+
+/**
+ * This prepares a track for sending: the file size and filename are
+ * added to the tag if missing, the tag is checked and then packed
+ * for the device.
+ *
+ * @param njb a pointer to the <code>njb_t</code> object
+ * @param path the file to send, or NULL if the track is read from
+ *             a stream
+ * @param songid the tag of the track
+ * @param filesize a pointer to a variable that will hold the file size;
+ *             if <code>path</code> is NULL it shall already hold it
+ * @param ptag a pointer to a variable that will hold the packed tag,
+ *             which shall be freed by the caller
+ * @param tagsize a pointer to a variable that will hold the size of
+ *             the packed tag
+ * @return 0 on success, -1 on failure
+ */
+static int _prepare_track (njb_t *njb, const char *path, njb_songid_t *songid,
+			   u_int64_t *filesize, unsigned char **ptag,
+			   u_int32_t *tagsize)
+{
+  __dsub= "_prepare_track";
+  njb_songid_frame_t *frame;
+
+  __enter;
+
+  if ( path != NULL && _file_size(njb, path, filesize) == -1 ) {
+    NJB_ERROR(njb, EO_SRCFILE);
+    __leave;
+    return -1;
+  }
+  
+  /* Add file size if missing from songid */
+  if ((frame = NJB_Songid_Findframe(songid, FR_SIZE)) == NULL) {
+    u_int32_t tmpsize = (u_int32_t) *filesize;
+    frame = NJB_Songid_Frame_New_Filesize(tmpsize);
+    NJB_Songid_Addframe(songid, frame);
+  }
+  
+  /* Add filename if missing from songid */
+  if (path != NULL &&
+      (frame = NJB_Songid_Findframe(songid, FR_FNAME)) == NULL) {
+    /* Make a copy to be sure so as not to vandalize path */
+    char *tmppath = strdup(path);
+    char *bfname = basename(tmppath);
+    frame = NJB_Songid_Frame_New_Filename(bfname);
+    NJB_Songid_Addframe(songid, frame);
+    free(tmppath);
+  }
+  
+  /* Make sure the metadata is usable */
+  if (songid_sanity_check(njb, songid) == -1) {
+    NJB_ERROR(njb, EO_INVALID);
+    __leave;
+    return -1;
+  }
+
+  if (njb->device_type == NJB_DEVICE_NJB1) {
+    *ptag = songid_pack(songid, tagsize);
+  } else {
+    *ptag = songid_pack3(songid, tagsize);
+  }
+  if (*ptag == NULL) {
+    __leave;
+    return -1;
+  }
+
+  __leave;
+  return 0;
+}
+
+/**
+ * This sends a track that has been prepared with 
+ * <code>_prepare_track()</code>: the tag is sent to create
+ * the track, then the file itself is sent.
+ *
+ * @param njb a pointer to the <code>njb_t</code> object
+ * @param path the file to send, used if <code>reader</code> is NULL
+ * @param reader the function that reads the track, or NULL
+ * @param readdata the data passed on to <code>reader</code>
+ * @param filesize the size of the file
+ * @param ptag the packed tag
+ * @param tagsize the size of the packed tag
+ * @param callback progress callback for the file transfer, may be NULL
+ * @param data user data for the callback
+ * @param trackid a pointer to a variable that will hold the new track ID
+ * @return 0 on success, -1 on failure
+ */
+static int _send_prepared_track (njb_t *njb, const char *path,
+				 NJB_Read_Callback *reader, void *readdata,
+				 u_int64_t filesize, unsigned char *ptag,
+				 u_int32_t tagsize, NJB_Xfer_Callback *callback,
+				 void *data, u_int32_t *trackid)
+{
+  __dsub= "_send_prepared_track";
+  int ret;
+
+  __enter;
+
+  if (njb->device_type == NJB_DEVICE_NJB1) {
+    njbttaghdr_t tagh;
+    
+    tagh.size = tagsize;
+    if ( njb_send_track_tag(njb, &tagh, ptag) == -1 ) {
+      NJB_ERROR(njb, EO_XFERDENIED);
+      __leave;
+      return -1;
     }
-    NJB_ERROR(njb, EO_TIMEOUT);
+    
+    *trackid = tagh.trackid;
+  }
+  
+  if (PDE_PROTOCOL_DEVICE(njb)) {
+    if ( (*trackid = njb3_create_file(njb, ptag, tagsize, NJB3_TRACK_DATABASE)) == 0 ) {
+      NJB_ERROR(njb, EO_XFERDENIED);
+      __leave;
+      return -1;
+    }
+  }
+  
+  /* The trackid referenced is not actually used with the NJB1 */
+  if (reader != NULL) {
+    ret = send_stream(njb, reader, readdata, (u_int32_t) filesize, *trackid,
+		      callback, data, 0);
+  } else {
+    ret = send_file(njb, path, (u_int32_t) filesize, *trackid,
+		    callback, data, 0);
+  }
+  if (ret == -1) {
     __leave;
     return -1;
   }
+
   __leave;
   return 0;
 }
@@ -1594,7 +2806,9 @@ int NJB_Send_Track (njb_t *njb, const char *path, njb_songid_t *songid,
 {
   __dsub= "NJB_Send_Track";
   u_int64_t btotal, bfree, filesize;
-  njb_songid_frame_t *frame;
+  unsigned char *ptag;
+  u_int32_t tagsize;
+  int ret;
   
   __enter;
   
@@ -1606,95 +2820,280 @@ int NJB_Send_Track (njb_t *njb, const char *path, njb_songid_t *songid,
     return -1;
   }
   
-  if ( _file_size(njb, path, &filesize) == -1 ) {
-    NJB_ERROR(njb, EO_SRCFILE);
+  if ( _prepare_track(njb, path, songid, &filesize, &ptag, &tagsize) == -1 ) {
     __leave;
     return -1;
   }
   
   if ( filesize > bfree ) {
     NJB_ERROR(njb, EO_TOOBIG);
+    free(ptag);
     __leave;
     return -1;
   }
   
-  /* Add file size if missing from songid */
-  if ((frame = NJB_Songid_Findframe(songid, FR_SIZE)) == NULL) {
-    u_int32_t tmpsize = (u_int32_t) filesize;
-    frame = NJB_Songid_Frame_New_Filesize(tmpsize);
-    NJB_Songid_Addframe(songid, frame);
-  }
+  _tracks_changed(njb);
   
-  /* Add filename if missing from songid */
-  if ((frame = NJB_Songid_Findframe(songid, FR_FNAME)) == NULL) {
-    /* Make a copy to be sure so as not to vandalize path */
-    char *tmppath = strdup(path);
-    char *bfname = basename(tmppath);
-    frame = NJB_Songid_Frame_New_Filename(bfname);
-    NJB_Songid_Addframe(songid, frame);
-    free(tmppath);
+  if (PDE_PROTOCOL_DEVICE(njb)) {
+    /* Request to stop playing before sending a track */
+    njb3_ctrl_playing(njb, NJB3_STOP_PLAY);
   }
   
-  /* Make sure the metadata is usable */
-  if (songid_sanity_check(njb, songid) == -1) {
-    NJB_ERROR(njb, EO_INVALID);
+  ret = _send_prepared_track(njb, path, NULL, NULL, filesize, ptag, tagsize,
+			     callback, data, trackid);
+  free(ptag);
+  
+  __leave;
+  return ret;
+}
+
+/**
+ * This sends a track to the device like <code>NJB_Send_Track()</code>,
+ * but reads it through a callback instead of from a file. This lets
+ * the track be put together on the fly, for example an audio file
+ * with a retagged header spliced on, without writing it to disk first.
+ *
+ * The reader must return exactly <code>size</code> bytes in total;
+ * running out early fails the transfer. No filename is added to the
+ * tag, so add a filename frame to <code>songid</code> if the device
+ * should show one.
+ *
+ * @param njb a pointer to the <code>njb_t</code> object to send the
+ *            track to.
+ * @param reader a function that fills a buffer with the next bytes of
+ *             the track and returns how many it read, 0 at the end or
+ *             -1 on error.
+ * @param readdata a voluntary parameter passed on to each
+ *             <code>reader</code> call.
+ * @param size the size of the track in bytes.
+ * @param songid the tag for this track, see <code>NJB_Send_Track()</code>.
+ * @param callback a function that will be called repeatedly to report
+ *             progress during transfer. This may be NULL.
+ * @param data a voluntary parameter passed on to each callback call.
+ * @param trackid a pointer to an integer that will hold the resulting
+ *             track ID after this transfer has commenced successfully.
+ * @return 0 on success, -1 on failure
+ * @see NJB_Send_Track()
+ */
+int NJB_Send_Track_Stream (njb_t *njb, NJB_Read_Callback *reader,
+	void *readdata, u_int64_t size, njb_songid_t *songid,
+	NJB_Xfer_Callback *callback, void *data, u_int32_t *trackid)
+{
+  __dsub= "NJB_Send_Track_Stream";
+  u_int64_t btotal, bfree, filesize;
+  unsigned char *ptag;
+  u_int32_t tagsize;
+  int ret;
+  
+  __enter;
+  
+  njb_error_clear(njb);
+  
+  if (NJB_Get_Disk_Usage(njb, &btotal, &bfree) == -1) {
+    NJB_ERROR(njb, EO_XFERDENIED);
     __leave;
     return -1;
   }
   
+  filesize = size;
+  if ( _prepare_track(njb, NULL, songid, &filesize, &ptag, &tagsize) == -1 ) {
+    __leave;
+    return -1;
+  }
   
-  if (njb->device_type == NJB_DEVICE_NJB1) {
-    /* Pack the tag and send it */
-    unsigned char *ptag;
-    njbttaghdr_t tagh;
-    
-    if ( (ptag = songid_pack(songid, &tagh.size)) == NULL ) return -1;
-    
-    if ( njb_send_track_tag(njb, &tagh, ptag) == -1 ) {
-      NJB_ERROR(njb, EO_XFERDENIED);
-      free(ptag);
-      __leave;
-      return -1;
-    }
-    
+  if ( filesize > bfree ) {
+    NJB_ERROR(njb, EO_TOOBIG);
     free(ptag);
-    
-    *trackid = tagh.trackid;
-    
-    /* The trackid referenced is not actually used with the NJB1 */
-    if ( send_file(njb, path, (u_int32_t) filesize, *trackid, callback, data, 0) == -1 ) {
-      __leave;
-      return -1;
+    __leave;
+    return -1;
+  }
+  
+  _tracks_changed(njb);
+  
+  if (PDE_PROTOCOL_DEVICE(njb)) {
+    /* Request to stop playing before sending a track */
+    njb3_ctrl_playing(njb, NJB3_STOP_PLAY);
+  }
+  
+  ret = _send_prepared_track(njb, NULL, reader, readdata, filesize, ptag,
+			     tagsize, callback, data, trackid);
+  free(ptag);
+  
+  __leave;
+  return ret;
+}
+
+/**
+ * Progress of one track in a batch, passed through <code>send_file()</code>
+ */
+typedef struct {
+  NJB_Batch_Callback *callback; /**< The callback of the batch */
+  void *data; /**< The user data of the batch */
+  u_int32_t track; /**< The index of the track being sent */
+  u_int32_t ntracks; /**< The number of tracks in the batch */
+  u_int64_t batch_before; /**< Bytes of the batch sent before this track */
+  u_int64_t batch_total; /**< Bytes in the whole batch */
+} batch_progress_t;
+
+/**
+ * This forwards the progress of one track to the batch callback.
+ */
+static int batch_xfer_callback (u_int64_t sent, u_int64_t total,
+				const char *buf, unsigned len, void *data)
+{
+  batch_progress_t *bp = (batch_progress_t *) data;
+
+  return bp->callback(bp->track, bp->ntracks, sent, total,
+		      bp->batch_before + sent, bp->batch_total, bp->data);
+}
+
+/**
+ * This sends ("downloads") several tracks to the device in one go,
+ * for example a whole album. The result is the same as calling
+ * <code>NJB_Send_Track()</code> for each of the tracks, but the
+ * work that does not depend on the individual track is done once
+ * for the whole batch: the free space on the device is checked
+ * against the total size of all files, and playback is stopped
+ * once. All tags are checked and packed before the first file is
+ * sent, so the transfers follow each other without delay, and a
+ * track with a bad tag fails the batch before anything has been
+ * sent.
+ *
+ * If a transfer fails or is aborted from the callback, the
+ * remaining tracks are not sent. The tracks that were sent before
+ * that have <code>sent</code> set and stay on the device.
+ *
+ * Typical usage:
+ *
+ * <pre>
+ * njb_batch_track_t tracks[2];
+ *
+ * tracks[0].path = "01.mp3";
+ * tracks[0].songid = songid1;
+ * tracks[1].path = "02.mp3";
+ * tracks[1].songid = songid2;
+ * if (NJB_Send_Tracks(njb, tracks, 2, progress, NULL) == -1) {
+ *     NJB_Error_Dump(njb, stderr);
+ * }
+ * </pre>
+ *
+ * @param njb a pointer to the <code>njb_t</code> object to send the
+ *            tracks to.
+ * @param tracks an array of tracks to send. The file size and filename
+ *            frames are added to each tag if missing, just like 
+ *            <code>NJB_Send_Track()</code> does. The <code>trackid</code>
+ *            and <code>sent</code> fields are filled in.
+ * @param ntracks the number of tracks in the array
+ * @param callback a function that will be called repeatedly to report
+ *             progress of the current track and of the whole batch.
+ *             This may be NULL if you don't want any callbacks. If it
+ *             returns -1 the current track is aborted and the rest of
+ *             the batch is not sent.
+ * @param data a voluntary parameter that can associate some 
+ *             user-supplied data with each callback call. It is OK
+ *             to set this to NULL of course.
+ * @return 0 if all tracks were sent, -1 on failure
+ * @see NJB_Send_Track()
+ */
+int NJB_Send_Tracks (njb_t *njb, njb_batch_track_t *tracks, u_int32_t ntracks,
+		     NJB_Batch_Callback *callback, void *data)
+{
+  __dsub= "NJB_Send_Tracks";
+  u_int64_t btotal, bfree;
+  u_int64_t *filesizes;
+  unsigned char **ptags;
+  u_int32_t *tagsizes;
+  batch_progress_t progress;
+  u_int32_t i;
+  int ret = 0;
+
+  __enter;
+
+  njb_error_clear(njb);
+
+  if (tracks == NULL || ntracks == 0) {
+    NJB_ERROR(njb, EO_INVALID);
+    __leave;
+    return -1;
+  }
+  for (i = 0; i < ntracks; i++) {
+    tracks[i].trackid = 0;
+    tracks[i].sent = 0;
+  }
+
+  filesizes = (u_int64_t *) malloc(ntracks * sizeof(u_int64_t));
+  ptags = (unsigned char **) calloc(ntracks, sizeof(unsigned char *));
+  tagsizes = (u_int32_t *) malloc(ntracks * sizeof(u_int32_t));
+  if (filesizes == NULL || ptags == NULL || tagsizes == NULL) {
+    NJB_ERROR(njb, EO_NOMEM);
+    ret = -1;
+    goto clean_up_and_return;
+  }
+
+  if (NJB_Get_Disk_Usage(njb, &btotal, &bfree) == -1) {
+    NJB_ERROR(njb, EO_XFERDENIED);
+    ret = -1;
+    goto clean_up_and_return;
+  }
+
+  progress.callback = callback;
+  progress.data = data;
+  progress.ntracks = ntracks;
+  progress.batch_before = 0;
+  progress.batch_total = 0;
+  for (i = 0; i < ntracks; i++) {
+    if ( _prepare_track(njb, tracks[i].path, tracks[i].songid, &filesizes[i],
+			&ptags[i], &tagsizes[i]) == -1 ) {
+      ret = -1;
+      goto clean_up_and_return;
     }
+    progress.batch_total += filesizes[i];
   }
-  
+
+  if ( progress.batch_total > bfree ) {
+    NJB_ERROR(njb, EO_TOOBIG);
+    ret = -1;
+    goto clean_up_and_return;
+  }
+
+  _tracks_changed(njb);
+
   if (PDE_PROTOCOL_DEVICE(njb)) {
-    unsigned char *ptag;
-    u_int32_t tagsize;
-    
-    /* Request to stop playing before sending a track */
+    /* Request to stop playing before sending the tracks */
     njb3_ctrl_playing(njb, NJB3_STOP_PLAY);
-    
-    if ( (ptag = songid_pack3(songid, &tagsize)) == NULL ) {
-      __leave;
-      return -1;
-    }
-    if ( (*trackid = njb3_create_file(njb, ptag, tagsize, NJB3_TRACK_DATABASE)) == 0 ) {
-      NJB_ERROR(njb, EO_XFERDENIED);
-      free(ptag);
-      __leave;
-      return -1;
+  }
+
+  for (i = 0; i < ntracks; i++) {
+    progress.track = i;
+    if ( _send_prepared_track(njb, tracks[i].path, NULL, NULL, filesizes[i],
+			      ptags[i], tagsizes[i],
+			      (callback != NULL) ? batch_xfer_callback : NULL,
+			      &progress, &tracks[i].trackid) == -1 ) {
+      ret = -1;
+      goto clean_up_and_return;
     }
-    free(ptag);
-    
-    if ( send_file(njb, path, (u_int32_t) filesize, *trackid, callback, data, 0) == -1 ) {
-      __leave;
-      return -1;
+    tracks[i].sent = 1;
+    progress.batch_before += filesizes[i];
+  }
+
+clean_up_and_return:
+  if (ptags != NULL) {
+    for (i = 0; i < ntracks; i++) {
+      if (ptags[i] != NULL) {
+	free(ptags[i]);
+      }
     }
+    free(ptags);
   }
-  
+  if (filesizes != NULL) {
+    free(filesizes);
+  }
+  if (tagsizes != NULL) {
+    free(tagsizes);
+  }
+
   __leave;
-  return 0;
+  return ret;
 }
 
 /**
@@ -2186,26 +3585,17 @@ int NJB_Delete_Playlist (njb_t *njb, u_int32_t plid)
 }
 
 /**
- * This writes back an updated (modified) or new playlist
- * to the device.
- *
- * This function <i>may</i> modify the playlist ID, i.e.
- * the <code>plid</code> member of the 
- * <code>njb_playlist_t</code> struct, which means that if
- * your program has cached this number anywhere, you need
- * to update it using the value from <code>pl->plid</code> 
- * afterwards. This stems from the fact that playlists are
- * sometimes updated by deleting the old playlist and creating 
- * a new one.
+ * This writes back a new playlist, a renamed playlist, or a playlist
+ * whose track listing has changed, by recreating it on the device.
  *
  * @param njb a pointer to the <code>njb_t</code> object
  *            to update the playlist on
  * @param pl the playlist to update.
  * @return 0 on success, -1 on failure.
  */
-int NJB_Update_Playlist (njb_t *njb, njb_playlist_t *pl)
+static int _update_playlist_full (njb_t *njb, njb_playlist_t *pl)
 {
-  __dsub= "NJB_Update_Playlist";
+  __dsub= "_update_playlist_full";
   u_int32_t *trids, *tptr;
   u_int32_t oplid = 0;
   njb_playlist_track_t *track;
@@ -2214,8 +3604,6 @@ int NJB_Update_Playlist (njb_t *njb, njb_playlist_t *pl)
   
   __enter;
   
-  njb_error_clear(njb);
-  
   /*
    * First the NJB1 specific playlist update code
    */
@@ -2405,6 +3793,154 @@ int NJB_Update_Playlist (njb_t *njb, njb_playlist_t *pl)
   return ret;
 }
 
+/**
+ * This appends tracks to a playlist that is already on the device,
+ * and renames it if needed, instead of recreating it.
+ *
+ * @param njb a pointer to the <code>njb_t</code> object
+ *            to update the playlist on
+ * @param pl the playlist to update.
+ * @param nappend the number of tracks at the end of the playlist
+ *            that are not yet on the device
+ * @param renamed 1 if the playlist has also been renamed
+ * @return 0 on success, -1 on failure.
+ */
+static int _update_playlist_delta (njb_t *njb, njb_playlist_t *pl,
+				   u_int32_t nappend, int renamed)
+{
+  __dsub= "_update_playlist_delta";
+  njb_playlist_track_t *track;
+  u_int32_t *trids = NULL;
+  u_int32_t i;
+  int ret = 0;
+
+  __enter;
+
+  if (nappend > 0) {
+    trids = (u_int32_t *) malloc(sizeof(u_int32_t) * nappend);
+    if ( trids == NULL ) {
+      NJB_ERROR(njb, EO_NOMEM);
+      __leave;
+      return -1;
+    }
+    /* The tracks to append are the last ones */
+    track = pl->last;
+    for (i = nappend; i > 0; i--) {
+      trids[i-1] = track->trackid;
+      track = track->prev;
+    }
+  }
+
+  if (njb->device_type == NJB_DEVICE_NJB1) {
+    if (renamed) {
+      char *plname;
+
+      if (njb_unicode_flag == NJB_UC_UTF8) {
+	plname = utf8tostr((unsigned char *) pl->name);
+      } else {
+	plname = strdup(pl->name);
+      }
+      if (plname == NULL) {
+	NJB_ERROR(njb, EO_NOMEM);
+	ret = -1;
+	goto clean_up_and_return;
+      }
+      ret = njb_rename_playlist(njb, pl->plid, plname);
+      free(plname);
+      if ( ret == -1 || (ret = njb_verify_last_command(njb)) == -1 ) {
+	goto clean_up_and_return;
+      }
+    }
+    if (nappend > 0) {
+      if ( njb_add_multiple_tracks_to_playlist(njb, pl->plid, trids,
+					       nappend) == -1 ) {
+	ret = -1;
+	goto clean_up_and_return;
+      }
+      ret = njb_verify_last_command(njb);
+    }
+  }
+
+  if (PDE_PROTOCOL_DEVICE(njb)) {
+    if (renamed) {
+      unsigned char *tmpname = strtoucs2((unsigned char *) pl->name);
+
+      if (tmpname == NULL) {
+	NJB_ERROR(njb, EO_NOMEM);
+	ret = -1;
+	goto clean_up_and_return;
+      }
+      ret = njb3_update_string_frame(njb, pl->plid, NJB3_PLNAME_FRAME_ID, tmpname);
+      free(tmpname);
+      if (ret == -1) {
+	goto clean_up_and_return;
+      }
+    }
+    if (nappend > 0) {
+      /* This may change the playlist ID */
+      ret = njb3_add_multiple_tracks_to_playlist(njb, &pl->plid, trids,
+						 nappend);
+    }
+  }
+
+clean_up_and_return:
+  if (trids != NULL) {
+    free(trids);
+  }
+  __leave;
+  return ret;
+}
+
+/**
+ * This writes back an updated (modified) or new playlist
+ * to the device.
+ *
+ * The edits made to a playlist since it was retrieved from
+ * or last written to the device are recorded. When they only
+ * add tracks after the ones already on the device, possibly
+ * together with a new name, just the new tracks are sent.
+ * Otherwise the playlist is recreated with its full track
+ * listing.
+ *
+ * This function <i>may</i> modify the playlist ID, i.e.
+ * the <code>plid</code> member of the 
+ * <code>njb_playlist_t</code> struct, which means that if
+ * your program has cached this number anywhere, you need
+ * to update it using the value from <code>pl->plid</code> 
+ * afterwards. This stems from the fact that playlists are
+ * sometimes updated by deleting the old playlist and creating 
+ * a new one.
+ *
+ * @param njb a pointer to the <code>njb_t</code> object
+ *            to update the playlist on
+ * @param pl the playlist to update.
+ * @return 0 on success, -1 on failure.
+ */
+int NJB_Update_Playlist (njb_t *njb, njb_playlist_t *pl)
+{
+  __dsub= "NJB_Update_Playlist";
+  u_int32_t nappend;
+  int renamed;
+  int ret;
+
+  __enter;
+
+  njb_error_clear(njb);
+
+  if ( pl->_state == NJB_PL_CHTRACKS && pl->plid != 0 &&
+       playlist_plan_update(pl, &nappend, &renamed) == 0 ) {
+    ret = _update_playlist_delta(njb, pl, nappend, renamed);
+  } else {
+    ret = _update_playlist_full(njb, pl);
+  }
+  if (ret == 0) {
+    playlist_mark_synced(pl);
+  }
+
+  __leave;
+  return ret;
+}
+
 /**
  * This deletes a track from the device.
  *
@@ -2419,6 +3955,7 @@ int NJB_Delete_Track (njb_t *njb, u_int32_t trackid)
   __enter;
   
   njb_error_clear(njb);
+  _tracks_changed(njb);
   
   if (njb->device_type == NJB_DEVICE_NJB1) {
     if ( njb_delete_track(njb, trackid) == -1 ) {
@@ -2813,6 +4350,9 @@ int _file_size (njb_t *njb, const char *path, u_int64_t *size)
  * Set the debug print mode for libnjb. The debug flag is created
  * by OR:ing up the different possible flags.
  *
+ * The debug flags are shared by all devices and threads, so set
+ * them before any worker threads are started.
+ *
  * @see debugflags
  * @param debug_flags the debug flags to use
  */
@@ -2827,6 +4367,10 @@ void NJB_Set_Debug (int debug_flags)
  * modern applications should make a call to this function and
  * set the encoding to <code>NJB_UC_UTF8</code>.
  *
+ * The encoding is shared by all devices and threads, since the
+ * song ID, playlist and datafile functions are not tied to a
+ * device. Set it once, before any worker threads are started.
+ *
  * @see unicodeflags
  * @param unicode_flag the encoding to use
  */
@@ -2899,6 +4443,7 @@ int NJB_Replace_Track_Tag (njb_t *njb, u_int32_t trackid, njb_songid_t *songid)
   __enter;
   
   njb_error_clear(njb);
+  _tracks_changed(njb);
   
   /*
    * This routine toggles all changed string frames to a
@@ -3566,6 +5111,11 @@ int NJB_Get_Hardware_Revision(njb_t *njb, u_int8_t *major, u_int8_t *minor, u_in
  * only applicable on the series 3 devices, it will have no effect
  * on the NJB1. (Command available as of libnjb 2.2.4.)
  *
+ * <code>NJB_TURBO_TUNED</code> is turbo mode with the block size
+ * for sending files tuned to the device, see
+ * <code>NJB_Set_Transfer_Profile_Dir()</code>. The tuner has not
+ * yet been tried on many devices, so it must be asked for.
+ *
  * Example usage:
  * <pre>
  * NJB_Set_Turbo_Mode(njb, NJB_TURBO_OFF);
@@ -3573,8 +5123,8 @@ int NJB_Get_Hardware_Revision(njb_t *njb, u_int8_t *major, u_int8_t *minor, u_in
  *
  * @param njb a pointer to the <code>njb_t</code> object to set
  *            the turbo mode for.
- * @param mode the turbo mode. <code>NJB_TURBO_ON</code> or
- *            <code>NJB_TURBO_OFF</code>.
+ * @param mode the turbo mode. <code>NJB_TURBO_ON</code>,
+ *            <code>NJB_TURBO_TUNED</code> or <code>NJB_TURBO_OFF</code>.
  * @return 0 if the call was successful, -1 on failure.
  */
 int NJB_Set_Turbo_Mode(njb_t *njb, u_int8_t mode)
@@ -3587,3 +5137,205 @@ int NJB_Set_Turbo_Mode(njb_t *njb, u_int8_t mode)
   }
   return 0;
 }
+
+/**
+ * This sets a directory where transfer profiles for series 3 devices
+ * are kept. In tuned turbo mode (<code>NJB_TURBO_TUNED</code>, see
+ * <code>NJB_Set_Turbo_Mode()</code>) the block size used when sending files is tuned while the first
+ * files are sent: a few block sizes are tried, sizes that cause short
+ * writes or stalls are given up, and the fastest stable size is kept.
+ * With a profile directory the result is saved in a small file per
+ * device model and firmware revision, so later sessions start out at
+ * the tuned size right away. This setting has no effect on the NJB1.
+ *
+ * Example usage:
+ * <pre>
+ * NJB_Set_Transfer_Profile_Dir(njb, "/home/user/.libnjb");
+ * </pre>
+ *
+ * @param njb a pointer to the <code>njb_t</code> object to set
+ *            the profile directory for.
+ * @param dir an existing directory to keep the profiles in, or NULL
+ *            to stop using profiles.
+ * @return 0 if the call was successful, -1 on failure.
+ */
+int NJB_Set_Transfer_Profile_Dir(njb_t *njb, const char *dir)
+{
+  __dsub= "NJB_Set_Transfer_Profile_Dir";
+
+  __enter;
+
+  /* The profile directory is silently ignored for the NJB1 */
+  if (PDE_PROTOCOL_DEVICE(njb)) {
+    njb3_state_t *state = (njb3_state_t *) njb->protocol_state;
+
+    if (state->xfer_profile_dir != NULL && dir != NULL &&
+	!strcmp(state->xfer_profile_dir, dir)) {
+      __leave;
+      return 0;
+    }
+    if (state->xfer_profile_dir != NULL) {
+      free(state->xfer_profile_dir);
+      state->xfer_profile_dir = NULL;
+    }
+    if (dir != NULL) {
+      state->xfer_profile_dir = strdup(dir);
+      if (state->xfer_profile_dir == NULL) {
+	NJB_ERROR(njb, EO_NOMEM);
+	__leave;
+	return -1;
+      }
+    }
+    /* Look for a profile again before the next transfer */
+    state->send_tuner.loaded = 0;
+  }
+
+  __leave;
+  return 0;
+}
+
+/**
+ * This retrieves the transfer counters of a device: the number of
+ * bytes and transfers in each direction, retries, short reads,
+ * transfers taking over a second, the times the device was not
+ * ready and the time spent waiting for it, and a latency histogram
+ * for each kind of transfer. The counters are always kept and cost
+ * next to nothing, so unlike the debug flags (see
+ * <code>NJB_Set_Debug()</code>) they can be left on.
+ * They count from <code>NJB_Open()</code> or from the last call to
+ * <code>NJB_Reset_Transfer_Stats()</code>.
+ *
+ * Example usage:
+ * <pre>
+ * njb_xfer_stats_t stats;
+ *
+ * if (NJB_Get_Transfer_Stats(njb, &stats) == 0) {
+ *   printf("%llu bytes sent\n", (unsigned long long) stats.bytes_out);
+ * }
+ * </pre>
+ *
+ * @param njb a pointer to the <code>njb_t</code> object to get
+ *            the counters for
+ * @param stats a pointer to a struct to copy the counters to
+ * @return 0 on success, -1 if the device has not been opened
+ */
+int NJB_Get_Transfer_Stats(njb_t *njb, njb_xfer_stats_t *stats)
+{
+  return xferstats_get(njb, stats);
+}
+
+/**
+ * This zeroes the transfer counters of a device and empties its
+ * transfer trace, for example before a sync that is to be measured.
+ *
+ * @param njb a pointer to the <code>njb_t</code> object to reset
+ *            the counters for
+ * @see NJB_Get_Transfer_Stats()
+ */
+void NJB_Reset_Transfer_Stats(njb_t *njb)
+{
+  xferstats_reset(njb);
+}
+
+/**
+ * This turns on tracing of USB transfers. The last 256 traced
+ * transfers are kept in memory, with their time, size, result and
+ * duration, and can be printed with
+ * <code>NJB_Dump_Transfer_Trace()</code> after something went slow.
+ * To keep the cost down only one in a number of transfers is traced,
+ * but transfers that fail are always traced. Tracing is off by
+ * default.
+ *
+ * @param njb a pointer to the <code>njb_t</code> object to trace
+ * @param every trace one in this many transfers, 1 to trace all of
+ *              them, or 0 to turn tracing off
+ */
+void NJB_Set_Transfer_Trace(njb_t *njb, u_int32_t every)
+{
+  xferstats_set_trace(njb, every);
+}
+
+/**
+ * This prints the transfer counters of a device, followed by the
+ * traced transfers, oldest first.
+ *
+ * @param njb a pointer to the <code>njb_t</code> object to print
+ *            the counters for
+ * @param fp the file to print to, for example <code>stderr</code>
+ * @see NJB_Set_Transfer_Trace()
+ */
+void NJB_Dump_Transfer_Trace(njb_t *njb, FILE *fp)
+{
+  xferstats_dump(njb, fp);
+}
+
+/**
+ * This starts recording all USB transfers of a device to a file, so
+ * that the session can later be replayed without the device with
+ * <code>NJB_Replay_Session()</code>. Every transfer attempt is kept,
+ * with its timing and the data read or written, until
+ * <code>NJB_Close()</code> or <code>NJB_Stop_Session()</code>. Call
+ * this after <code>NJB_Discover()</code> and before
+ * <code>NJB_Open()</code>.
+ *
+ * The log holds everything sent to and read from the device, which
+ * includes track titles, file names and the like. With the
+ * <code>NJB_REC_HASH_STRINGS</code> flag the letters of such strings
+ * are replaced with ones made up from a hash of the string before
+ * they are written, so a log can be handed out without giving away
+ * the contents of the device. Equal strings stay equal and keep their
+ * length, so such a log replays just the same, but a track sent or
+ * received during the session will not have the right contents.
+ *
+ * @param njb a pointer to the <code>njb_t</code> object to record
+ * @param path the file to record to, it will be overwritten
+ * @param flags <code>NJB_REC_HASH_STRINGS</code>, or 0
+ * @return 0 on success, -1 if the file could not be created
+ * @see recflags
+ */
+int NJB_Record_Session(njb_t *njb, const char *path, int flags)
+{
+  return usbrec_record(njb, path, flags);
+}
+
+/**
+ * This sets up an <code>njb_t</code> object that replays a session
+ * recorded with <code>NJB_Record_Session()</code> instead of talking
+ * to a device. The object is then used in place of one from
+ * <code>NJB_Discover()</code>: <code>NJB_Open()</code> it and make
+ * the same calls as in the recorded session, and every USB transfer
+ * is answered from the log. This makes a slow session repeatable
+ * for profiling the host side code.
+ *
+ * A replay that is asked for a transfer other than the next one in
+ * the log has diverged, and from then on all transfers fail and the
+ * calls return errors. Only the time spent in the USB transfers is
+ * replayed: waiting done by libnjb itself, such as polling a busy
+ * device, is not scaled by <code>speedup</code>.
+ *
+ * @param njb a pointer to the <code>njb_t</code> object to set up,
+ *            all its previous contents are overwritten
+ * @param path the file to replay
+ * @param speedup 1 to wait as long for every transfer as the
+ *                recorded one took, n to wait n times shorter,
+ *                or 0 not to wait at all
+ * @return 0 on success, -1 if the file could not be read or is
+ *         not a session log
+ */
+int NJB_Replay_Session(njb_t *njb, const char *path, u_int32_t speedup)
+{
+  return usbrec_replay(njb, path, speedup);
+}
+
+/**
+ * This stops recording or replaying a session and closes the log.
+ * It is done by <code>NJB_Close()</code>, so this is only needed to
+ * stop recording early, or after <code>NJB_Open()</code> has failed.
+ *
+ * @param njb a pointer to the <code>njb_t</code> object to stop
+ *            recording or replaying
+ */
+void NJB_Stop_Session(njb_t *njb)
+{
+  usbrec_stop(njb);
+}
@@ -29,8 +29,7 @@
 #include "datafile.h"
 #include "njbtime.h"
 #include "playlist.h"
-
-extern int __sub_depth;
+#include "xferstats.h"
 
 
 /**
@@ -55,6 +54,10 @@ int njb_init_state (njb_t *njb) {
 
   state->session_updated = 0;
   state->libcount = 0;
+  state->tracks_changed = 0;
+  state->ready_wait_ms = NJB_READY_INITIAL_MS;
+  state->upload_not_ready = 0;
+  state->upload_not_ready_ms = 0;
   state->first_eax = NULL;
   state->next_eax = NULL;
   state->reset_get_track_tag = 0;
@@ -1045,6 +1048,47 @@ int njb_send_datafile_tag (njb_t *njb, njbdfhdr_t *dfh, void *tag)
 	return 0;
 }
 
+/*
+ * This returns how long to sleep before asking the device again
+ * whether it is ready, given how long we have waited so far. The
+ * first sleep covers most of the typical wait, then the device is
+ * polled in short steps around the typical wait, and if it takes
+ * longer than usual the steps grow with the time waited.
+ */
+u_int32_t njb_ready_delay (njb_t *njb, u_int32_t waited, u_int32_t cap)
+{
+	njb_state_t *state = (njb_state_t *) njb->protocol_state;
+	u_int32_t typical = state->ready_wait_ms;
+	u_int32_t delay;
+
+	if ( waited == 0 ) {
+		delay = typical * 3 / 4;
+	} else if ( waited < typical ) {
+		delay = typical / 8;
+	} else {
+		delay = waited / 4;
+	}
+	if ( delay < NJB_READY_MIN_DELAY_MS ) {
+		delay = NJB_READY_MIN_DELAY_MS;
+	}
+	if ( delay > cap ) {
+		delay = cap;
+	}
+	return delay;
+}
+
+/*
+ * This records a wait for the device, and updates the typical
+ * wait with a running average.
+ */
+void njb_ready_learn (njb_t *njb, u_int32_t waited)
+{
+	njb_state_t *state = (njb_state_t *) njb->protocol_state;
+
+	xferstats_not_ready(njb, waited);
+	state->ready_wait_ms = (3 * state->ready_wait_ms + waited) / 4;
+}
+
 /*
  * This function transfers a block of <= NJB_XFER_BLOCK_SIZE to the
  * jukebox and returns the number of bytes actually sent. Short transfers
@@ -1059,7 +1103,9 @@ u_int32_t njb_send_file_block (njb_t *njb, void *data, u_int32_t blocksize)
 	/* We may need to retry this command if the device is not ready
 	 * to receive the file block. */
 	int retry = 1;
-	int retries = 20;
+	int stalled = 0;
+	u_int32_t started = 0;
+	u_int32_t waited = 0;
 
 	__enter;
 
@@ -1091,34 +1137,31 @@ u_int32_t njb_send_file_block (njb_t *njb, void *data, u_int32_t blocksize)
 	  if ( status ) {
 	    /* printf("Bad status byte in njb_send_file_block(): 0x%02x\n", status); */
 	    retry = 1;
-	    /* The NJB device is not following us. Sleep for a while
-	     * and retry. If usleep is not available to sleep for 200ms,
-	     * we'll just sleep for a second instead, just so it works
-	     * either way. Tony Smolar noticed that sometimes, if the file
-	     * exceeds 3 MB this need to wait for ready usually appears. 
-	     * Generally, the nomad needs to wait 200-800 ms. */
-#ifdef HAVE_USLEEP
-	    usleep(200000);
-#else
-#ifdef __WIN32__
-	    /* 
-	     * This is because sleep() is actually deprecated in favor of
-	     * Sleep() on Windows.
-	     */
-	    _sleep(1);
-#else
-	    sleep(1);
-#endif
-#endif
-	    retries --;
-	    if ( !retries ) {
-	      NJB_ERROR(njb, EO_BADSTATUS);
-	      __leave;
-	      return -1;
+	    /* The NJB device is not following us. Tony Smolar noticed
+	     * that sometimes, if the file exceeds 3 MB this need to wait
+	     * for ready usually appears. Generally, the nomad needs to 
+	     * wait 200-800 ms. Instead of sleeping for 200 ms at a time
+	     * we poll around the wait typical for this device, so that
+	     * little time is wasted once the device is ready again. */
+	    if ( !stalled ) {
+	      stalled = 1;
+	      started = njb_get_millis();
+	    } else {
+	      waited = njb_get_millis() - started;
+	      if ( waited > NJB_READY_TIMEOUT_MS ) {
+		NJB_ERROR(njb, EO_BADSTATUS);
+		__leave;
+		return -1;
+	      }
 	    }
+	    njb_sleep_millis(njb_ready_delay(njb, waited, NJB_READY_MAX_DELAY_MS));
 	  }
 	}
 
+	if ( stalled ) {
+	  njb_ready_learn(njb, njb_get_millis() - started);
+	}
+
 	bwritten = usb_pipe_write(njb, data, blocksize);
 
 	if ( bwritten == -1 ) {
@@ -41,6 +41,14 @@ typedef struct {
   char productName[33];
   u_int8_t fwMajor; /**< Firmware major revision */
   u_int8_t fwMinor; /**< Firmware minor revision */
+  /** Set when tracks are changed, so the snapshot cache is rewritten */
+  int tracks_changed;
+  /** Typical time in ms until the device is ready for a file block */
+  u_int32_t ready_wait_ms;
+  /** The not ready count of the transfer counters when the last upload started */
+  u_int32_t upload_not_ready;
+  /** The not ready time of the transfer counters when the last upload started */
+  u_int32_t upload_not_ready_ms;
 } njb_state_t;
 
 /*
@@ -55,6 +63,18 @@ typedef struct {
 #define NJB_XFER_BLOCK_SIZE	        0x0000FE00
 #define NJB_XFER_BLOCK_HEADER_SIZE      68
 
+/*
+ * Waiting for the device to become ready during uploads. The device
+ * is polled around the typical wait seen so far, with each sleep
+ * capped, until a deadline is reached.
+ */
+#define NJB_READY_INITIAL_MS		8
+#define NJB_READY_MIN_DELAY_MS		2
+#define NJB_READY_MAX_DELAY_MS		200
+#define NJB_READY_TIMEOUT_MS		4000
+#define NJB_COMPLETE_MAX_DELAY_MS	1000
+#define NJB_COMPLETE_TIMEOUT_MS		15000
+
 #define NJB_RELEASE	0x00
 #define NJB_CAPTURE	0x01
 
@@ -186,6 +206,8 @@ int njb_get_owner_string (njb_t *njb, owner_string name);
 int njb_set_owner_string (njb_t *njb, owner_string name);
 int njb_request_file (njb_t *njb, u_int32_t fileid);
 int njb_transfer_complete (njb_t *njb);
+u_int32_t njb_ready_delay (njb_t *njb, u_int32_t waited, u_int32_t cap);
+void njb_ready_learn (njb_t *njb, u_int32_t waited);
 int njb_send_track_tag (njb_t *njb, njbttaghdr_t *tagh, void *tag);
 int njb_send_datafile_tag (njb_t *njb, njbdfhdr_t *dfh, void *tag);
 int njb_replace_track_tag (njb_t *njb, njbttaghdr_t *tagh, void *tag);
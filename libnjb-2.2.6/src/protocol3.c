@@ -24,8 +24,8 @@
 #include "eax.h"
 #include "datafile.h"
 #include "njbtime.h"
-
-extern int __sub_depth;
+#include "tracktable.h"
+#include "playlist.h"
 
 /*
  * NJB2,3,Zen,Zen USB 2.0, Zen NX, Zen Xtra and Dell Digital DJ
@@ -72,6 +72,18 @@ int njb3_init_state (njb_t *njb) {
   state->hwMinor = 0;
   state->hwRel = 0;
   state->turbo_mode = NJB_TURBO_ON;
+  state->stream_track_tags = 0;
+  state->track_scan.data = NULL;
+  state->track_scan.done = 1;
+  state->track_scan_start = 0;
+  state->track_scan_first_ms = 0;
+  state->track_scan_total_ms = 0;
+  state->track_scan_yielded = 0;
+  state->tracks_changed = 0;
+  state->command_buffer = NULL;
+  state->command_buffer_size = 0;
+  xfer_tuner_init(&state->send_tuner);
+  state->xfer_profile_dir = NULL;
 
   __leave;
   return 0;
@@ -92,13 +104,14 @@ static int send_njb3_command(njb_t *njb, unsigned char *command, u_int32_t cleng
 {
   __dsub= "send_njb3_command";
   
-  unsigned char *data;
-
   /* The header differs for NJB2 and NJB Zen USB 2.0 */
-  unsigned char usb11_cmd_header[]={0x43,0x42,0x53,0x55,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,
-				   0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0};
-  unsigned char usb20_cmd_header[]={0x55,0x53,0x42,0x43,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0, 0x0,0x0,0x0,0x0,
-				   0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0,0x0};
+  static const unsigned char usb11_cmd_magic[]={0x43,0x42,0x53,0x55};
+  static const unsigned char usb20_cmd_magic[]={0x55,0x53,0x42,0x43};
+  /*
+   * The header is built on the stack, this is called for every
+   * command and every file chunk so it should not allocate anything.
+   */
+  unsigned char data[0x20];
   ssize_t cmd_len;
 
   /*
@@ -107,24 +120,23 @@ static int send_njb3_command(njb_t *njb, unsigned char *command, u_int32_t cleng
    * 4 bytes unknown 0x00 * 4
    * 4 bytes total command length (or is it 8 bytes even?)
    * 20 bytes unknown 0x00 * 20
+   *
+   * The header and the command must be sent as two separate
+   * bulk transfers: the device takes the short packet ending the
+   * header as the end of it, so they cannot be merged into one write.
    */
   
   __enter;
   
-  data = (unsigned char *) malloc (0x20);
-  if ( data == NULL ) {
-    NJB_ERROR(njb, EO_NOMEM);
-    __leave;
-    return -1;
-  }
+  memset(data, 0, sizeof(data));
 
   /* Use the apropriate header on USB 2.0 devices as
    * opposed to USB 1.1 devices. */
   if (njb_device_is_usb20(njb)) {
-    memcpy(data, usb20_cmd_header, 0x20);
+    memcpy(data, usb20_cmd_magic, 4);
     cmd_len = 0x1F;
   } else {
-    memcpy(data, usb11_cmd_header, 0x20);
+    memcpy(data, usb11_cmd_magic, 4);
     cmd_len = 0x20;
   }
 
@@ -132,14 +144,11 @@ static int send_njb3_command(njb_t *njb, unsigned char *command, u_int32_t cleng
   from_32bit_to_njb3_bytes(clength, &data[8]);
   
   if (usb_pipe_write(njb, data, cmd_len) == -1) {
-    free(data);
     NJB_ERROR(njb, EO_USBBLK);
     __leave;
     return -1;
   }
   
-  free(data);
-
   if (usb_pipe_write(njb, command, clength) == -1) {
     NJB_ERROR(njb, EO_USBBLK);
     __leave;
@@ -150,6 +159,36 @@ static int send_njb3_command(njb_t *njb, unsigned char *command, u_int32_t cleng
   return 0;
 }
 
+/**
+ * Returns the command buffer of the device, zeroed and large enough
+ * for a command of a certain size. Commands that vary in size, like
+ * tag and playlist updates, are built in this buffer instead of in a
+ * fresh allocation for each command. The buffer is kept until the
+ * device is closed.
+ *
+ * @param njb a pointer to the device object to use
+ * @param size the size of the command that will be built
+ * @return the buffer or NULL if out of memory
+ */
+static unsigned char *njb3_command_buffer(njb_t *njb, u_int32_t size)
+{
+  __dsub= "njb3_command_buffer";
+  njb3_state_t *state = (njb3_state_t *) njb->protocol_state;
+
+  if (size > state->command_buffer_size) {
+    unsigned char *buf = (unsigned char *) realloc(state->command_buffer, size);
+
+    if (buf == NULL) {
+      NJB_ERROR(njb, EO_NOMEM);
+      return NULL;
+    }
+    state->command_buffer = buf;
+    state->command_buffer_size = size;
+  }
+  memset(state->command_buffer, 0, size);
+  return state->command_buffer;
+}
+
 /**
  * This helper function just reads in the two status bytes
  * returned by many operations.
@@ -797,6 +836,7 @@ int njb3_set_owner_string (njb_t *njb, const char *name)
    * 2 bytes owner string tag 0x0113
    * then follows the n bytes of the owner string.
    */
+  unsigned char unibuf[UNICODE_BUF_SIZE];
   unsigned char *unistr;
   unsigned char *data;
   u_int16_t status;
@@ -808,12 +848,18 @@ int njb3_set_owner_string (njb_t *njb, const char *name)
   /* 8 bytes header
    * Unicode string length + extra 0x00 0x00
    */
-  unistr = strtoucs2((unsigned char *) name);
+  unistr = strtoucs2_buf((unsigned char *) name, unibuf, sizeof(unibuf));
+  if (unistr == NULL) {
+    NJB_ERROR(njb, EO_NOMEM);
+    __leave;
+    return -1;
+  }
   unilen = ucs2strlen(unistr)*2;
   cmdlen = 8 + unilen + 4;
   
   data = (unsigned char *) malloc (cmdlen);
   if ( data == NULL ) {
+    unicode_buf_free(unistr, unibuf);
     NJB_ERROR(njb, EO_NOMEM);
     __leave;
     return -1;
@@ -822,6 +868,7 @@ int njb3_set_owner_string (njb_t *njb, const char *name)
   
   memcpy(&data[0], njb3_set_owner, 0x08);
   memcpy(&data[8], unistr, unilen+2);
+  unicode_buf_free(unistr, unibuf);
   from_16bit_to_njb3_bytes(unilen+4, &data[4]);
   
   if (send_njb3_command(njb, data, cmdlen) == -1){
@@ -1789,64 +1836,128 @@ static int read_metadata_chunk(njb,
   return bread;
 }
 
-static int get_metadata_chunks(njb, 
+/**
+ * Starts an incremental metadata scan. This allocates the chunk
+ * buffer and takes a private copy of the command block, since the
+ * continuation marker for each following chunk is written into it.
+ *
+ * @param scan the scan state to initialize
+ * @param command_block the metadata retrieval command
+ * @param command_block_size the size of the command block
+ * @return 0 on success, -1 on failure
+ */
+static int metadata_scan_begin(njb, 
+			       scan,
 			       command_block, 
-			       command_block_size,
-			       create_metadata_post,
-			       add_to_metadata_post,
-			       terminate_metadata_post)
+			       command_block_size)
      njb_t *njb;
+     njb3_metadata_scan_t *scan;
      unsigned char *command_block;
      int command_block_size;
+{
+  __dsub= "metadata_scan_begin";
+  
+  __enter;
+
+  if (command_block_size > NJB3_MAX_METADATA_COMMAND) {
+    NJB_ERROR(njb, EO_INVALID);
+    __leave;
+    return -1;
+  }
+  /* Allocate a metadata scanning buffer */
+  if((scan->data = (unsigned char *) malloc(NJB3_CHUNK_SIZE+0x100)) == NULL){
+    NJB_ERROR(njb, EO_NOMEM);
+    __leave;
+    return -1;
+  }
+  memcpy(scan->command, command_block, command_block_size);
+  scan->command_size = command_block_size;
+  scan->target = NULL;
+  scan->started_frame = 0;
+  scan->chunks = 0;
+  scan->done = 0;
+
+  __leave;
+  return 0;
+}
+
+/**
+ * Ends an incremental metadata scan and releases the chunk buffer.
+ * This may be called several times, and on a scan that was never
+ * started if the state was zeroed.
+ */
+static void metadata_scan_end(njb3_metadata_scan_t *scan)
+{
+  if (scan->data != NULL) {
+    free(scan->data);
+    scan->data = NULL;
+  }
+  scan->done = 1;
+}
+
+/**
+ * Retrieves and parses the next chunk of an incremental metadata
+ * scan, calling the three metadata processing functions for every
+ * post found in it. A metadata post may span two chunks, the post
+ * under construction is kept in the scan state. When the last chunk
+ * has been parsed, <code>scan->done</code> is set.
+ *
+ * @param scan the scan state, initialized by metadata_scan_begin()
+ * @return 0 on success, -1 on failure
+ */
+static int metadata_scan_next_chunk(njb, 
+				    scan,
+				    create_metadata_post,
+				    add_to_metadata_post,
+				    terminate_metadata_post)
+     njb_t *njb;
+     njb3_metadata_scan_t *scan;
      int (*create_metadata_post) ();
      int (*add_to_metadata_post) ();
      int (*terminate_metadata_post) ();
 {
-  __dsub= "get_metadata_chunks";
+  __dsub= "metadata_scan_next_chunk";
 
-  unsigned char *data;
-  unsigned char *target;
-  int keep_reading_chunks = 1;
-  int i=0,j=0;
+  unsigned char *data = scan->data;
+  int i = 0, j = 0;
+  int next_chunk = 0;
   u_int16_t status;
-  int next_chunk = 1;
-  int read_again = 0;
-  int started_frame = 0;
+  u_int16_t read_again;
   int32_t bread;
   u_int16_t framelen;
   
   __enter;
-  
-  /* Allocate a metadata scanning buffer */
-  if((data = (unsigned char *) malloc(NJB3_CHUNK_SIZE+0x100)) == NULL){
-    NJB_ERROR(njb, EO_NOMEM);
+
+  if (scan->done) {
     __leave;
-    return -1;
+    return 0;
   }
   
   bread = read_metadata_chunk(njb,
 			      data,
-			      command_block,
-			      command_block_size);
+			      scan->command,
+			      scan->command_size);
   
   /* Read at least 16 bits of status */
   if (bread < 2) {
     NJB_ERROR(njb, EO_RDSHORT);
-    free(data);
     __leave;
     return -1;
   }
   
   /* Check the status word */
-  status = njb3_bytes_to_16bit(&data[i]);
+  status = njb3_bytes_to_16bit(&data[0]);
+  /*
+   * NJB2 sometimes(?) sends a 0x000e 0x0000 0x01f4 0x001b 0x0001 0x0000 0x0001
+   * on end-of-data.
+   */
+  if (status == NJB3_STATUS_EMPTY_CHUNK) {
+    /* This means "empty metadata/end of transmission */
+    scan->done = 1;
+    __leave;
+    return 0;
+  }
   if (status != NJB3_STATUS_OK) {
-    free(data);
-    /* FIXME: classify more errors */
-    if (status == NJB3_STATUS_EMPTY_CHUNK) {
-      /* This means "empty metadata/end of transmission */
-      __leave;
-      return 0;
-    }
     /* Everything else interpreted as "error, somekind" */
     printf("LIBNJB Panic: get_metadata_chunks() returned status code %04x!\n", status);
     NJB_ERROR(njb, EO_BADSTATUS);
@@ -1856,155 +1967,155 @@ static int get_metadata_chunks(njb,
   /* This is returned sometimes. We break here,
    * because there is no metadata to read, we 
    * already read everything. */
-  framelen = njb3_bytes_to_16bit(&data[2]);
-  if (framelen == 0) {
-    free(data);
-    __leave;
-    return 0; /* Should it be -1 ? */
+  if (scan->chunks == 0) {
+    framelen = njb3_bytes_to_16bit(&data[2]);
+    if (framelen == 0) {
+      scan->done = 1;
+      __leave;
+      return 0;
+    }
   }
-  
-  i += 2;
-  while(i < bread && keep_reading_chunks == 1){
-    /* Now we recognize the frames */
-    next_chunk = 0;
-    while (!next_chunk) {
-      u_int16_t frameid;
-      
-      /* Length of the next frame */
-      framelen = njb3_bytes_to_16bit(&data[i]) + 2;
-      
-      /* What are the contents of the next frame? */
-      frameid = njb3_bytes_to_16bit(&data[i+2]);
-      /* printf("Found frame with ID: %04x and Length: %04x\n", frameid, framelen); */
-      
-      /* Zero length frame and frameid zero means 
-	 "new chunk, read again" or "last chunk, stop reading" */
-      if ((framelen == 2) && (frameid == 0)) {
-	int result;
-	next_chunk = 1;
-	framelen = 4;
-	/* printf("Calling metadata termination routine (1)\n"); */
-	if (started_frame == 1) {
-	  result = (*terminate_metadata_post) (njb, &target);
-	  if (result == -1) {
-	    __leave;
-	    free(data);
-	    return -1;
-	  }
-	  started_frame = 0;
-	}
-      }
-      /* A zero length terminates the tag */
-      else if (framelen == 2) {
-	int result;
-	/* Call metadata post termination routine
-	 * (ends current metadata)
-	 */
-	/* printf("Calling metadata termination routine (2)\n"); */
-	if (started_frame == 1) {
-	  result = (*terminate_metadata_post) (njb, &target);
-	  if (result == -1) {
-	    __leave;
-	    free(data);
-	    return -1;
-	  }
-	  started_frame = 0;
+  scan->chunks++;
+
+  /* Now we recognize the frames */
+  i = 2;
+  while (!next_chunk) {
+    u_int16_t frameid;
+    
+    /* Length of the next frame */
+    framelen = njb3_bytes_to_16bit(&data[i]) + 2;
+    
+    /* What are the contents of the next frame? */
+    frameid = njb3_bytes_to_16bit(&data[i+2]);
+    /* printf("Found frame with ID: %04x and Length: %04x\n", frameid, framelen); */
+    
+    /* Zero length frame and frameid zero means 
+       "new chunk, read again" or "last chunk, stop reading" */
+    if ((framelen == 2) && (frameid == 0)) {
+      next_chunk = 1;
+      framelen = 4;
+      /* printf("Calling metadata termination routine (1)\n"); */
+      if (scan->started_frame == 1) {
+	if ((*terminate_metadata_post) (njb, &scan->target) == -1) {
+	  __leave;
+	  return -1;
 	}
+	scan->started_frame = 0;
       }
-      /* Recognize a new post */
-      else if (frameid == NJB3_POSTID_FRAME_ID) {
-	u_int32_t postid = njb3_bytes_to_32bit(&data[i+4]);
-	int result;
-	/* Call metadata post creation routine 
-	 * (opens a new metadata post)
-	 */
-	/* printf("Calling metadata creation routine\n"); */
-	result = (*create_metadata_post) (postid, &target);
-	if (result == -1) {
+    }
+    /* A zero length terminates the tag */
+    else if (framelen == 2) {
+      /* Call metadata post termination routine
+       * (ends current metadata)
+       */
+      /* printf("Calling metadata termination routine (2)\n"); */
+      if (scan->started_frame == 1) {
+	if ((*terminate_metadata_post) (njb, &scan->target) == -1) {
 	  __leave;
-	  free(data);
 	  return -1;
 	}
-	started_frame = 1;
-      } else {
-	unsigned char *data1 = &data[i+4];
-	int result;
-	/* Call metadata processing routine:
-	 * frameid = ID of frame
-	 * framelen = Length of frame
-	 * data = pointer to data
-	 */
-	/* printf("Calling metadata adding routine\n"); */
-	if (started_frame == 1) {
-	  result = (*add_to_metadata_post) (frameid, framelen, data1, &target);
-	  if (result == -1) {
-	    __leave;
-	    free(data);
-	    return -1;
-	  }
-	}
+	scan->started_frame = 0;
       }
-      /* Increase the counter */
-      i += framelen;
     }
-    /*
-     * The last 16 bit number of the chunk 
-     * is 0x0000 if we shall read again, and 
-     * 0x0001 if the end of reading is reached.
-     */
-    read_again = njb3_bytes_to_16bit(&data[i+8]);
-    
-    /* If this is zero, read again */
-    if (read_again == 0) {
-      for(j = i; j < i+8; j++) {
-	command_block[j-i+8]=data[j];
-      }
-      bread = read_metadata_chunk(njb,
-				  data,
-				  command_block,
-				  command_block_size);
-      
-      /* Atleast we need status */
-      if (bread < 2) {
-	free(data);
-	NJB_ERROR(njb, EO_RDSHORT);
-	__leave;
-	return -1;
-      }
-      /* Check the status word */
-      status = njb3_bytes_to_16bit(&data[0]);
-      
-      /*
-       * NJB2 sometimes(?) sends a 0x000e 0x0000 0x01f4 0x001b 0x0001 0x0000 0x0001
-       * on end-of-data.
+    /* Recognize a new post */
+    else if (frameid == NJB3_POSTID_FRAME_ID) {
+      u_int32_t postid = njb3_bytes_to_32bit(&data[i+4]);
+      /* Call metadata post creation routine 
+       * (opens a new metadata post)
        */
-      if (status == NJB3_STATUS_EMPTY_CHUNK) /* Means "end of file" */
-	keep_reading_chunks = 0;
-      else if (status != NJB3_STATUS_OK) {
-	free(data);
-	printf("LIBNJB Panic: get_metadata_chunks() returned unknown status code %04x!\n", status);
-	NJB_ERROR(njb, EO_BADSTATUS);
+      /* printf("Calling metadata creation routine\n"); */
+      if ((*create_metadata_post) (postid, &scan->target) == -1) {
 	__leave;
 	return -1;
       }
-      i=2;
+      scan->started_frame = 1;
     } else {
-      /* Should be for 0x0001 only, but we haven's seen
-       * anything else.
-       *
-       * When reading playlists, the 16-bit number at data[i+2] 
-       * == number of playlists here.
+      /* Call metadata processing routine:
+       * frameid = ID of frame
+       * framelen = Length of frame
+       * data = pointer to data
        */
-      if (read_again != 0x0001) {
-	printf("LIBNJB: Weird end marker of metadata chunk: %04x\n", read_again);
+      /* printf("Calling metadata adding routine\n"); */
+      if (scan->started_frame == 1) {
+	if ((*add_to_metadata_post) (frameid, framelen, &data[i+4], &scan->target) == -1) {
+	  __leave;
+	  return -1;
+	}
       }
-      keep_reading_chunks = 0;
     }
+    /* Increase the counter */
+    i += framelen;
+  }
+
+  /*
+   * The last 16 bit number of the chunk 
+   * is 0x0000 if we shall read again, and 
+   * 0x0001 if the end of reading is reached.
+   */
+  read_again = njb3_bytes_to_16bit(&data[i+8]);
+  
+  if (read_again == 0) {
+    /* Pass the continuation marker along with the next request */
+    for(j = i; j < i+8; j++) {
+      scan->command[j-i+8]=data[j];
+    }
+  } else {
+    /* Should be for 0x0001 only, but we haven's seen
+     * anything else.
+     *
+     * When reading playlists, the 16-bit number at data[i+2] 
+     * == number of playlists here.
+     */
+    if (read_again != 0x0001) {
+      printf("LIBNJB: Weird end marker of metadata chunk: %04x\n", read_again);
+    }
+    scan->done = 1;
   }
-  free(data);
   
   __leave;
+  return 0;
+}
+
+/**
+ * Reads and parses all the metadata chunks returned for a certain 
+ * command block in one go. 
+ */
+static int get_metadata_chunks(njb, 
+			       command_block, 
+			       command_block_size,
+			       create_metadata_post,
+			       add_to_metadata_post,
+			       terminate_metadata_post)
+     njb_t *njb;
+     unsigned char *command_block;
+     int command_block_size;
+     int (*create_metadata_post) ();
+     int (*add_to_metadata_post) ();
+     int (*terminate_metadata_post) ();
+{
+  __dsub= "get_metadata_chunks";
+  njb3_metadata_scan_t scan;
   
+  __enter;
+
+  if (metadata_scan_begin(njb, &scan, command_block, command_block_size) == -1) {
+    __leave;
+    return -1;
+  }
+  while (!scan.done) {
+    if (metadata_scan_next_chunk(njb,
+				 &scan,
+				 create_metadata_post,
+				 add_to_metadata_post,
+				 terminate_metadata_post) == -1) {
+      metadata_scan_end(&scan);
+      __leave;
+      return -1;
+    }
+  }
+  metadata_scan_end(&scan);
+  
+  __leave;
   return 0;
 }
 
@@ -2100,6 +2211,26 @@ static int parse_metadata_block(njb,
 
 
 
+/*
+ * Maps a series 3 codec ID to the libnjb codec name, or NULL
+ * if the codec is unknown.
+ */
+static const char *codec_name(u_int16_t codec)
+{
+  if (codec == NJB3_CODEC_MP3_ID || codec == NJB3_CODEC_MP3_ID_OLD) {
+    return NJB_CODEC_MP3;
+  } else if (codec == NJB3_CODEC_WAV_ID) {
+    return NJB_CODEC_WAV;
+  } else if (codec == NJB3_CODEC_WMA_ID || codec == NJB3_CODEC_PROTECTED_WMA_ID) {
+    return NJB_CODEC_WMA;
+  } else if (codec == NJB3_CODEC_AA_ID) {
+    return NJB_CODEC_AA;
+  }
+  /* Ogg Vorbis? :-) */
+  printf("LIBNJB panic: unknown codec ID %04x\n", codec);
+  return NULL;
+}
+
 /*
  * Tracklist scanning helper functions - called by the generic metadata
  * scanning routine.
@@ -2127,34 +2258,35 @@ static int add_to_songid(frameid, framelen, data, target)
 {
   njb_songid_t *song = (njb_songid_t *) *target;
   njb_songid_frame_t *frame;
+  char buf[UNICODE_BUF_SIZE];
   char *tmp;
 
   /* 0x01 0x04 = Track name, create a frame with the track name */
   if (frameid == NJB3_TITLE_FRAME_ID) {
-    tmp = ucs2tostr(data); // Check for out of mem
+    tmp = ucs2tostr_buf(data, buf, sizeof(buf)); // Check for out of mem
     frame = NJB_Songid_Frame_New_Title(tmp);
-    free(tmp);
+    unicode_buf_free(tmp, buf);
     NJB_Songid_Addframe(song, frame);
   }
   /* Create a frame with the artist name */
   else if (frameid == NJB3_ARTIST_FRAME_ID) {
-    tmp = ucs2tostr(data); // Check for out of mem
+    tmp = ucs2tostr_buf(data, buf, sizeof(buf)); // Check for out of mem
     frame = NJB_Songid_Frame_New_Artist(tmp);
-    free(tmp);
+    unicode_buf_free(tmp, buf);
     NJB_Songid_Addframe(song, frame);
   }
   /* Create a frame with the genre name */
   else if (frameid == NJB3_GENRE_FRAME_ID) {
-    tmp = ucs2tostr(data); // Check for out of mem
+    tmp = ucs2tostr_buf(data, buf, sizeof(buf)); // Check for out of mem
     frame = NJB_Songid_Frame_New_Genre(tmp);
-    free(tmp);
+    unicode_buf_free(tmp, buf);
     NJB_Songid_Addframe(song, frame);
   }
   /* Create a frame with the album name */
   else if (frameid ==  NJB3_ALBUM_FRAME_ID) {
-    tmp = ucs2tostr(data); // Check for out of mem
+    tmp = ucs2tostr_buf(data, buf, sizeof(buf)); // Check for out of mem
     frame = NJB_Songid_Frame_New_Album(tmp);
-    free(tmp);
+    unicode_buf_free(tmp, buf);
     NJB_Songid_Addframe(song, frame);
   }
   /* Create a frame with the track size */
@@ -2176,24 +2308,11 @@ static int add_to_songid(frameid, framelen, data, target)
   }
   /* Create a frame with codec type */
   else if (frameid ==  NJB3_CODEC_FRAME_ID) {
-    u_int16_t codec;
-    
-    codec = njb3_bytes_to_16bit(data);
-    if (codec == NJB3_CODEC_MP3_ID || codec == NJB3_CODEC_MP3_ID_OLD) {
-      frame = NJB_Songid_Frame_New_Codec(NJB_CODEC_MP3);
-      NJB_Songid_Addframe(song, frame);
-    } else if (codec == NJB3_CODEC_WAV_ID) {
-      frame = NJB_Songid_Frame_New_Codec(NJB_CODEC_WAV);
-      NJB_Songid_Addframe(song, frame);
-    } else if (codec == NJB3_CODEC_WMA_ID || codec == NJB3_CODEC_PROTECTED_WMA_ID) {
-      frame = NJB_Songid_Frame_New_Codec(NJB_CODEC_WMA);
-      NJB_Songid_Addframe(song, frame);
-    } else if (codec == NJB3_CODEC_AA_ID) {
-      frame = NJB_Songid_Frame_New_Codec(NJB_CODEC_AA);
+    const char *codec = codec_name(njb3_bytes_to_16bit(data));
+
+    if (codec != NULL) {
+      frame = NJB_Songid_Frame_New_Codec(codec);
       NJB_Songid_Addframe(song, frame);
-    } else {
-      /* Ogg Vorbis? :-) */
-      printf("LIBNJB panic: unknown codec ID %04x\n", codec);
     }
   }
   /* Create a frame with the track year */
@@ -2216,17 +2335,17 @@ static int add_to_songid(frameid, framelen, data, target)
   }
   /* Create a frame with the original filename */
   else if (frameid == NJB3_FNAME_FRAME_ID) {
-    tmp = ucs2tostr(data); // Check for out of mem
+    tmp = ucs2tostr_buf(data, buf, sizeof(buf)); // Check for out of mem
     frame = NJB_Songid_Frame_New_Filename(tmp);
-    free(tmp);
+    unicode_buf_free(tmp, buf);
     NJB_Songid_Addframe(song, frame);
   }
   /* Ignore data about the track directory */
   else if (frameid == NJB3_DIR_FRAME_ID) {
-    tmp = ucs2tostr(data); // Check for out of mem
+    tmp = ucs2tostr_buf(data, buf, sizeof(buf)); // Check for out of mem
     /* Currently we just ignore this string, could define a new FR_DIR or so */
     frame = NJB_Songid_Frame_New_Folder(tmp);
-    free(tmp);
+    unicode_buf_free(tmp, buf);
     NJB_Songid_Addframe(song, frame);
   }
   /* Unknown frame */
@@ -2249,10 +2368,61 @@ static int terminate_songid(njb, target)
   return 0;
 }
 
+/*
+ * Fetches chunks of the track list for a streaming scan until
+ * at least one complete track is available or the scan is over.
+ * The tracks handed out so far belong to the caller, so the list
+ * is restarted for each chunk, which keeps the memory used bounded
+ * to roughly one chunk of tracks.
+ */
+static int track_scan_fill(njb_t *njb)
+{
+  __dsub= "track_scan_fill";
+  njb3_state_t *state = (njb3_state_t *) njb->protocol_state;
+  njb3_metadata_scan_t *scan = &state->track_scan;
+
+  __enter;
+
+  state->first_songid = NULL;
+  state->next_songid = NULL;
+  while (state->first_songid == NULL && !scan->done) {
+    if (metadata_scan_next_chunk(njb,
+				 scan,
+				 create_songid,
+				 add_to_songid,
+				 terminate_songid) == -1) {
+      /* Throw away the half-built track and the rest of this chunk */
+      if (scan->started_frame == 1) {
+	NJB_Songid_Destroy((njb_songid_t *) scan->target);
+	scan->started_frame = 0;
+      }
+      metadata_scan_end(scan);
+      state->next_songid = state->first_songid;
+      destroy_song_from_njb(njb);
+      __leave;
+      return -1;
+    }
+  }
+  /* Point to the first song of this chunk (also if it is NULL) */
+  state->next_songid = state->first_songid;
+  if (scan->done) {
+    metadata_scan_end(scan);
+    state->track_scan_total_ms = njb_get_millis() - state->track_scan_start;
+  }
+
+  __leave;
+  return 0;
+}
+
 /* 
  * This routine not only gets the first track,
  * but makes a list of *ALL* tracks.  next_track_tag is a dummy
- * that follows this list.
+ * that follows this list. 
+ *
+ * In streaming mode only the first chunk of the track list is
+ * retrieved here, and the following chunks are retrieved by
+ * njb3_get_next_track_tag() once the tracks of the previous chunk
+ * have all been handed out.
  */
 int njb3_reset_get_track_tag (njb_t *njb)
 {
@@ -2319,6 +2489,11 @@ int njb3_reset_get_track_tag (njb_t *njb)
   
   /* Clean from any previous scan */
   destroy_song_from_njb(njb);
+  metadata_scan_end(&state->track_scan);
+  state->track_scan_start = njb_get_millis();
+  state->track_scan_first_ms = 0;
+  state->track_scan_total_ms = 0;
+  state->track_scan_yielded = 0;
   
   /* Use the generic metadata scan function parametrized
    * with three metadata processing functions 
@@ -2330,6 +2505,17 @@ int njb3_reset_get_track_tag (njb_t *njb)
     command = njb3_get_track_tags;
     commandlen = 0x30;
   }
+
+  if (state->stream_track_tags != 0) {
+    if (metadata_scan_begin(njb, &state->track_scan, command, commandlen) == -1) {
+      __leave;
+      return -1;
+    }
+    result = track_scan_fill(njb);
+    __leave;
+    return result;
+  }
+
   result = get_metadata_chunks(njb,
 			       command,
 			       commandlen,
@@ -2346,6 +2532,7 @@ int njb3_reset_get_track_tag (njb_t *njb)
   
   /* Point to first song (also if it is NULL) */
   state->next_songid = state->first_songid;
+  state->track_scan_total_ms = njb_get_millis() - state->track_scan_start;
   
   __leave;
   return 0;
@@ -2360,6 +2547,13 @@ njb_songid_t *njb3_get_next_track_tag (njb_t *njb)
   njb3_state_t *state = (njb3_state_t *) njb->protocol_state;
 
   __enter;
+  /* When streaming, retrieve the next chunk once this one is used up */
+  if (state->next_songid == NULL && !state->track_scan.done) {
+    if (track_scan_fill(njb) == -1) {
+      __leave;
+      return NULL;
+    }
+  }
   if (state->next_songid == NULL) {
     state->first_songid = NULL;
     /* Ignore this "error" for now: NJB_ERROR(njb, EO_EOM); */
@@ -2368,10 +2562,271 @@ njb_songid_t *njb3_get_next_track_tag (njb_t *njb)
   }
   tmp = state->next_songid;
   state->next_songid = tmp->next;
+  if (state->track_scan_yielded == 0) {
+    state->track_scan_first_ms = njb_get_millis() - state->track_scan_start;
+  }
+  state->track_scan_yielded++;
   __leave;
   return tmp;
 }
 
+/*
+ * Track table scanning helper functions - these add the tracks
+ * directly to a track table builder without creating any song IDs.
+ * The target is the builder itself throughout the scan.
+ */
+static int create_tablerow(postid, target)
+     u_int32_t postid;
+     unsigned char **target;
+{
+  track_table_builder_t *tb = (track_table_builder_t *) *target;
+
+  return track_table_add_row(tb, postid);
+}
+
+static int add_to_tablerow(frameid, framelen, data, target)
+     u_int16_t frameid;
+     u_int16_t framelen;
+     unsigned char *data;
+     unsigned char **target;
+{
+  track_table_builder_t *tb = (track_table_builder_t *) *target;
+  int column = -1;
+  int result = 0;
+
+  switch (frameid) {
+  case NJB3_TITLE_FRAME_ID:
+    column = TT_TITLE;
+    break;
+  case NJB3_ARTIST_FRAME_ID:
+    column = TT_ARTIST;
+    break;
+  case NJB3_GENRE_FRAME_ID:
+    column = TT_GENRE;
+    break;
+  case NJB3_ALBUM_FRAME_ID:
+    column = TT_ALBUM;
+    break;
+  case NJB3_FNAME_FRAME_ID:
+    column = TT_FNAME;
+    break;
+  case NJB3_DIR_FRAME_ID:
+    column = TT_FOLDER;
+    break;
+  case NJB3_CODEC_FRAME_ID:
+    {
+      const char *codec = codec_name(njb3_bytes_to_16bit(data));
+
+      if (codec != NULL) {
+	result = track_table_set_string(tb, TT_CODEC, codec);
+      }
+    }
+    break;
+  case NJB3_FILESIZE_FRAME_ID:
+    track_table_set_number(tb, TT_SIZE, njb3_bytes_to_32bit(data));
+    break;
+  case NJB3_LOCKED_FRAME_ID:
+    /* See add_to_songid() */
+    if (data[0] == 0x01 && data[1] == 0x00) {
+      track_table_set_number(tb, TT_PROTECTED, 0x0001U);
+    }
+    break;
+  case NJB3_YEAR_FRAME_ID:
+    track_table_set_number(tb, TT_YEAR, njb3_bytes_to_16bit(data));
+    break;
+  case NJB3_TRACKNO_FRAME_ID:
+    track_table_set_number(tb, TT_TRACKNUM, njb3_bytes_to_16bit(data));
+    break;
+  case NJB3_LENGTH_FRAME_ID:
+    track_table_set_number(tb, TT_LENGTH, njb3_bytes_to_16bit(data));
+    break;
+  default:
+    break;
+  }
+  if (column != -1) {
+    char buf[UNICODE_BUF_SIZE];
+    char *tmp = ucs2tostr_buf(data, buf, sizeof(buf));
+
+    if (tmp == NULL) {
+      return -1;
+    }
+    result = track_table_set_string(tb, column, tmp);
+    unicode_buf_free(tmp, buf);
+  }
+  return result;
+}
+
+static int terminate_tablerow(njb, target)
+     njb_t *njb;
+     unsigned char **target;
+{
+  return 0;
+}
+
+/**
+ * This retrieves the entire track list straight into a track table
+ * builder, without building the list of song IDs.
+ *
+ * @param tb the builder to add the tracks to
+ * @return 0 on success, -1 on failure
+ */
+int njb3_get_track_table(njb_t *njb, track_table_builder_t *tb)
+{
+  __dsub= "njb3_get_track_table";
+  unsigned char njb3_get_track_tags[]=
+    {0x00,0x06,0x00,0x01,0x00,0x00,0x00,0x02,
+     0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,
+     0x00,0x00,0x01,0x00,0xff,0xfe,0x00,0x14,
+     0x01,0x04,0x01,0x02,0x01,0x03,0x01,0x01,
+     0x00,0x0e,0x00,0x0b,0x00,0x06,0x01,0x07,
+     0x01,0x06,0x01,0x05,0x00,0x00,0x00,0x00};
+  unsigned char njb3_get_track_tags_extended[]=
+    {0x00,0x06,0x00,0x01,0x00,0x00,0x00,0x02,
+     0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,
+     0x00,0x00,0x01,0x00,0xff,0xfe,0x00,0x18,
+     0x01,0x04,0x01,0x02,0x01,0x03,0x01,0x01,
+     0x00,0x0e,0x00,0x0b,0x00,0x06,0x01,0x07,
+     0x01,0x06,0x01,0x05,0x00,0x0d,0x00,0x07,
+     0x00,0x00,0x00,0x00};
+  /* See njb3_reset_get_track_tag() for the structure of these */
+  njb3_state_t *state = (njb3_state_t *) njb->protocol_state;
+  njb3_metadata_scan_t scan;
+  int result;
+
+  __enter;
+
+  if (state->get_extended_tag_info != 0) {
+    result = metadata_scan_begin(njb, &scan, njb3_get_track_tags_extended, 0x34);
+  } else {
+    result = metadata_scan_begin(njb, &scan, njb3_get_track_tags, 0x30);
+  }
+  if (result == -1) {
+    __leave;
+    return -1;
+  }
+  /* The builder is the target of all metadata posts */
+  scan.target = (unsigned char *) tb;
+  while (!scan.done) {
+    if (metadata_scan_next_chunk(njb,
+				 &scan,
+				 create_tablerow,
+				 add_to_tablerow,
+				 terminate_tablerow) == -1) {
+      metadata_scan_end(&scan);
+      __leave;
+      return -1;
+    }
+  }
+  metadata_scan_end(&scan);
+
+  __leave;
+  return 0;
+}
+
+/*
+ * Collects the track IDs and file sizes of a track sample, see
+ * njb3_get_track_sample(). The target is the sample itself.
+ */
+typedef struct {
+  u_int32_t *trids;
+  u_int32_t *sizes;
+  u_int16_t count;
+  u_int16_t max;
+} track_sample_t;
+
+static int create_samplerow(postid, target)
+     u_int32_t postid;
+     unsigned char **target;
+{
+  track_sample_t *sample = (track_sample_t *) *target;
+
+  if (sample->count < sample->max) {
+    sample->trids[sample->count] = postid;
+    sample->sizes[sample->count] = 0;
+    sample->count++;
+  }
+  return 0;
+}
+
+static int add_to_samplerow(frameid, framelen, data, target)
+     u_int16_t frameid;
+     u_int16_t framelen;
+     unsigned char *data;
+     unsigned char **target;
+{
+  track_sample_t *sample = (track_sample_t *) *target;
+
+  if (frameid == NJB3_FILESIZE_FRAME_ID && sample->count > 0) {
+    sample->sizes[sample->count - 1] = njb3_bytes_to_32bit(data);
+  }
+  return 0;
+}
+
+static int terminate_samplerow(njb, target)
+     njb_t *njb;
+     unsigned char **target;
+{
+  return 0;
+}
+
+/**
+ * This retrieves the track IDs and file sizes of the first tracks
+ * in the track database. Only one chunk with only the file size
+ * metadata is requested, so this is cheap even on devices with
+ * huge libraries. It is used to tell if the tracks on the
+ * device have changed since the last time they were retrieved.
+ *
+ * @param trids an array that will hold the track IDs
+ * @param sizes an array that will hold the file sizes
+ * @param nsample the size of the arrays on input, on return
+ *        this will hold the number of tracks actually retrieved.
+ *        Not more than 0x100 tracks will be retrieved.
+ * @return 0 on success, -1 on failure
+ */
+int njb3_get_track_sample(njb_t *njb, u_int32_t *trids, u_int32_t *sizes, u_int16_t *nsample)
+{
+  __dsub= "njb3_get_track_sample";
+  /* Like njb3_reset_get_track_tag() but only asks for the file size */
+  unsigned char njb3_get_track_sizes[]=
+    {0x00,0x06,0x00,0x01,0x00,0x00,0x00,0x02,
+     0xff,0xff,0xff,0xff,0xff,0xff,0xff,0xff,
+     0x00,0x00,0x00,0x00,0xff,0xfe,0x00,0x02,
+     0x00,0x0e,0x00,0x00,0x00,0x00};
+  njb3_metadata_scan_t scan;
+  track_sample_t sample;
+
+  __enter;
+
+  if (*nsample > 0x100) {
+    *nsample = 0x100;
+  }
+  from_16bit_to_njb3_bytes(*nsample, &njb3_get_track_sizes[18]);
+  sample.trids = trids;
+  sample.sizes = sizes;
+  sample.count = 0;
+  sample.max = *nsample;
+
+  if (metadata_scan_begin(njb, &scan, njb3_get_track_sizes, 0x1e) == -1) {
+    __leave;
+    return -1;
+  }
+  scan.target = (unsigned char *) &sample;
+  if (metadata_scan_next_chunk(njb,
+			       &scan,
+			       create_samplerow,
+			       add_to_samplerow,
+			       terminate_samplerow) == -1) {
+    metadata_scan_end(&scan);
+    __leave;
+    return -1;
+  }
+  metadata_scan_end(&scan);
+  *nsample = sample.count;
+
+  __leave;
+  return 0;
+}
+
 /**
  * This routine is called by the playlist list retrieval
  * function to fill in each playlistlist with it's tracks.
@@ -2590,7 +3045,7 @@ static int populate_playlist(njb_t *njb, njb_playlist_t *pl)
   }
   free(data);
   /* The playlist should initially be unchanged. */
-  pl->_state = NJB_PL_UNCHANGED;
+  playlist_mark_synced(pl);
   
   __leave;
   return 0;
@@ -2627,7 +3082,7 @@ static int add_pl_to_njb(njb_t *njb, njb_playlist_t *pl)
   njb3_state_t *state = (njb3_state_t *) njb->protocol_state;
 
   /* Populate the playlist with tracks */
-  pl->_state = NJB_PL_UNCHANGED;
+  playlist_mark_synced(pl);
   /* Insert this into the list */
   if (state->first_plid == NULL) {
     state->first_plid = pl;
@@ -2688,7 +3143,7 @@ static int terminate_playlistid(njb, target)
      unsigned char **target;
 {
   njb_playlist_t *pl = (njb_playlist_t *) *target;
-  pl->_state = NJB_PL_UNCHANGED;
+  playlist_mark_synced(pl);
   if (add_pl_to_njb(njb, pl) == -1) {
     return -1;
   }
@@ -3634,13 +4089,11 @@ int njb3_update_string_frame(njb_t *njb, u_int32_t itemid, u_int16_t frameid, un
   framesize = strsize + 2;
   cmdsize =  12 + framesize;
   
-  data = malloc(cmdsize);
+  data = njb3_command_buffer(njb, cmdsize);
   if (data == NULL) {
-    NJB_ERROR(njb, EO_NOMEM);
     __leave;
     return -1;
   }
-  memset(data, 0, cmdsize);
   memcpy(&data[0], njb3_update_frame, 8);
   
   from_32bit_to_njb3_bytes(itemid, &data[4]);
@@ -3649,13 +4102,11 @@ int njb3_update_string_frame(njb_t *njb, u_int32_t itemid, u_int16_t frameid, un
   memcpy(&data[12], str, strsize);
   
   if (send_njb3_command(njb, data, cmdsize) == -1){
-    free(data);
     __leave;
     return -1;
   }
   
   if (njb3_get_status(njb, &status) == -1) {
-    free(data);
     __leave;
     return -1;
   }
@@ -3663,12 +4114,10 @@ int njb3_update_string_frame(njb_t *njb, u_int32_t itemid, u_int16_t frameid, un
   if (status != NJB3_STATUS_OK) {
     printf("LIBNJB Panic: njb3_update_string_frame() returned status code %04x!\n", status);
     NJB_ERROR(njb, EO_BADSTATUS);
-    free(data);
     __leave;
     return -1;
   }
   
-  free(data);
   __leave;
   return 0;
 }
@@ -3770,13 +4219,11 @@ int njb3_create_playlist (njb_t *njb, char *name, u_int32_t *plid)
   framesize = strsize + 2;
   cmdsize =  16 + framesize;
   
-  data = malloc(cmdsize);
+  data = njb3_command_buffer(njb, cmdsize);
   if (data == NULL) {
-    NJB_ERROR(njb, EO_NOMEM);
     __leave;
     return -1;
   }
-  memset(data, 0, cmdsize);
   memcpy(&data[0], njb3_create_pl, 8);
   
   from_16bit_to_njb3_bytes(framesize, &data[8]);
@@ -3784,17 +4231,14 @@ int njb3_create_playlist (njb_t *njb, char *name, u_int32_t *plid)
   memcpy(&data[12], name, strsize);
   
   if (send_njb3_command(njb, data, cmdsize) == -1){
-    free(data);
     __leave;
     return -1;
   }
   if ( (bread= usb_pipe_read(njb, status_data, 6)) == -1 ) {
-    free(data);
     NJB_ERROR(njb, EO_USBBLK);
     __leave;
     return -1;
   } else if ( bread < 2 ) {
-    free(data);
     NJB_ERROR(njb, EO_RDSHORT);
     __leave;
     return -1;
@@ -3803,14 +4247,12 @@ int njb3_create_playlist (njb_t *njb, char *name, u_int32_t *plid)
   if (status != NJB3_STATUS_OK) {
     printf("LIBNJB Panic: njb3_create_playlist returned status code %04x!\n", status);
     NJB_ERROR(njb, EO_BADSTATUS);
-    free(data);
     __leave;
     return -1;
   }
   /* Return the new playlist ID */
   *plid = njb3_bytes_to_32bit(&status_data[2]);
   
-  free(data);
   __leave;
   return 0;
 }
@@ -3851,13 +4293,11 @@ int njb3_add_multiple_tracks_to_playlist (njb_t *njb, u_int32_t *plid, u_int32_t
   cmdsize = 0x0c + trackcmdsize;
   
   
-  data = malloc(cmdsize);
+  data = njb3_command_buffer(njb, cmdsize);
   if (data == NULL) {
-    NJB_ERROR(njb, EO_NOMEM);
     __leave;
     return -1;
   }
-  memset(data, 0, cmdsize);
   memcpy(&data[0], njb3_addtracks, 12);
   /* add playlist ID */
   from_32bit_to_njb3_bytes(*plid, &data[4]);
@@ -3871,17 +4311,14 @@ int njb3_add_multiple_tracks_to_playlist (njb_t *njb, u_int32_t *plid, u_int32_t
   }
   /* Send the command */
   if (send_njb3_command(njb, data, cmdsize) == -1){
-    free(data);
     __leave;
     return -1;
   }
   if ( (bread= usb_pipe_read(njb, status_data, 6)) == -1 ) {
-    free(data);
     NJB_ERROR(njb, EO_USBBLK);
     __leave;
     return -1;
   } else if ( bread < 2 ) {
-    free(data);
     NJB_ERROR(njb, EO_RDSHORT);
     __leave;
     return -1;
@@ -3891,7 +4328,6 @@ int njb3_add_multiple_tracks_to_playlist (njb_t *njb, u_int32_t *plid, u_int32_t
   if (status != NJB3_STATUS_OK) {
     printf("LIBNJB Panic: njb3_add_multiple_tracks_to_playlist returned status code %04x!\n", status);
     NJB_ERROR(njb, EO_BADSTATUS);
-    free(data);
     __leave;
     return -1;
   }
@@ -4482,6 +4918,13 @@ void njb3_destroy_state(njb_t *njb) {
     key = tmp;
   }
   destroy_song_from_njb(njb);
+  metadata_scan_end(&state->track_scan);
+  if (state->command_buffer != NULL) {
+    free(state->command_buffer);
+  }
+  if (state->xfer_profile_dir != NULL) {
+    free(state->xfer_profile_dir);
+  }
   destroy_pl_from_njb(njb);
   destroy_df_from_njb(njb);
   destroy_eax_from_njb(njb);
@@ -58,6 +58,7 @@
 #define __NJB__PROTO3__H
 
 #include "libnjb.h"
+#include "xfertune.h"
 
 /* Buffer for short reads */
 #define NJB3_SHORTREAD_BUFSIZE 1024
@@ -264,6 +265,30 @@
 #define njb3_pause_play(njb) njb3_ctrl_playing(njb, NJB3_PAUSE_PLAY)
 #define njb3_resume_play(njb) njb3_ctrl_playing(njb, NJB3_RESUME_PLAY)
 
+/* Largest metadata retrieval command block we will send */
+#define NJB3_MAX_METADATA_COMMAND 0x40
+
+/* Structure to hold the state of an incremental metadata scan */
+typedef struct {
+  /** Chunk buffer, NJB3_CHUNK_SIZE + 0x100 bytes while scanning */
+  unsigned char *data;
+  /** Private copy of the command, carries the continuation marker */
+  unsigned char command[NJB3_MAX_METADATA_COMMAND];
+  /** Size of the command block */
+  int command_size;
+  /** The metadata post currently being built */
+  unsigned char *target;
+  /** Whether a post has been opened but not yet terminated */
+  int started_frame;
+  /** Number of chunks parsed so far */
+  u_int32_t chunks;
+  /** Set when the last chunk has been parsed */
+  int done;
+} njb3_metadata_scan_t;
+
+/* Defined in tracktable.h */
+struct track_table_builder_struct;
+
 /* Structure to hold protocol3 states */
 typedef struct {
   /* Get extended tags */
@@ -299,6 +324,28 @@ typedef struct {
   u_int16_t last_elapsed;
   /** Turbo or no turbo mode */
   u_int8_t turbo_mode;
+  /** Parse the track list one chunk at a time */
+  int stream_track_tags;
+  /** Ongoing streaming track list scan */
+  njb3_metadata_scan_t track_scan;
+  /** Timestamp for when the last track scan started */
+  u_int32_t track_scan_start;
+  /** Milliseconds until the first track tag was available */
+  u_int32_t track_scan_first_ms;
+  /** Milliseconds for the entire track scan */
+  u_int32_t track_scan_total_ms;
+  /** Number of track tags handed out since the scan started */
+  u_int32_t track_scan_yielded;
+  /** Set when tracks are changed, so the snapshot cache is rewritten */
+  int tracks_changed;
+  /** Reusable buffer for building commands, see njb3_command_buffer() */
+  unsigned char *command_buffer;
+  /** The allocated size of the command buffer */
+  u_int32_t command_buffer_size;
+  /** Tunes the block size used when sending files */
+  xfer_tuner_t send_tuner;
+  /** Directory for transfer profiles, NULL if profiles are not kept */
+  char *xfer_profile_dir;
 } njb3_state_t;
 
 
@@ -331,6 +378,8 @@ njb_time_t *njb3_get_time(njb_t *njb);
 int njb3_set_time(njb_t *njb, njb_time_t *time);
 int njb3_reset_get_track_tag (njb_t *njb);
 njb_songid_t *njb3_get_next_track_tag (njb_t *njb);
+int njb3_get_track_table(njb_t *njb, struct track_table_builder_struct *tb);
+int njb3_get_track_sample(njb_t *njb, u_int32_t *trids, u_int32_t *sizes, u_int16_t *nsample);
 int njb3_reset_get_playlist_tag (njb_t *njb);
 njb_playlist_t *njb3_get_next_playlist_tag (njb_t *njb);
 int njb3_reset_get_datafile_tag (njb_t *njb);
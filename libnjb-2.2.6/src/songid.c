@@ -30,7 +30,6 @@
 /* Haven't seen this one being used, but add it anyway. */
 #define FR_UNI_FNAME	"UNI_FNAME" /**< Unicode Filename metadata for NJB1 (not used) */
 
-extern int __sub_depth;
 extern int njb_unicode_flag; /**< A flag for if unicode is used or not (global) */
 
 /**
@@ -139,18 +138,28 @@ njb_songid_t *songid_unpack (void *data, size_t nbytes)
        * precedence if present.
        */
     } else if (type == ID_DATA_UNI) {
+      unsigned char clonebuf[UNICODE_BUF_SIZE];
       unsigned char *clone; /* Needed because of NJB1 byteorder */
+      char buf[UNICODE_BUF_SIZE];
       char *utf8str = NULL;
       u_int16_t i;
       
       /* Switch byteorder on the string, we use bigendian internally */
-      clone = malloc(vsize);
+      if (vsize <= sizeof(clonebuf)) {
+	clone = clonebuf;
+      } else {
+	clone = malloc(vsize);
+	if (clone == NULL) {
+	  NJB_Songid_Destroy(song);
+	  return NULL;
+	}
+      }
       for (i = 0; i < vsize; i+=2) {
 	clone[i] = value[i+1];
 	clone[i+1] = value[i];
       }
-      utf8str = ucs2tostr(clone);
-      free(clone);
+      utf8str = ucs2tostr_buf(clone, buf, sizeof(buf));
+      unicode_buf_free(clone, clonebuf);
       /* printf("Found unicode frame: %s, content %s\n", label, utf8str); */
       /*
        * After converting the Unicode frame into an UTF8 ASCII 
@@ -172,7 +181,7 @@ njb_songid_t *songid_unpack (void *data, size_t nbytes)
 	frame = NJB_Songid_Frame_New_Filename(utf8str);
 	had_uni_fname = 1;
       }
-      free(utf8str);
+      unicode_buf_free(utf8str, buf);
     } else { /* This means it is a numeric value */
       /* Depending on value size we construct different frames */
       if (vsize == 2) {
@@ -255,6 +264,7 @@ unsigned char *songid_pack (njb_songid_t *song, u_int32_t *tagsize)
     
     /* ASCII frames such as filename, artist, album... */
     if (frame->type ==  NJB_TYPE_STRING) {
+      char buf[UNICODE_BUF_SIZE];
       char *frame_ascii_content = NULL;
       u_int16_t frame_ascii_len = 0;
 
@@ -307,13 +317,15 @@ unsigned char *songid_pack (njb_songid_t *song, u_int32_t *tagsize)
 	  nframes ++;
 	}
 	/* Then also add the ASCII version */
-	frame_ascii_content = utf8tostr((unsigned char *) frame->data.strval);
+	frame_ascii_content = utf8tostr_buf((unsigned char *) frame->data.strval,
+					    buf, sizeof(buf));
       } else {
 	frame_ascii_content = strdup(frame->data.strval);
       }
 #else
       if(njb_unicode_flag == NJB_UC_UTF8) {
-	frame_ascii_content = utf8tostr(frame->data.strval);
+	frame_ascii_content = utf8tostr_buf((unsigned char *) frame->data.strval,
+					    buf, sizeof(buf));
       } else {
 	frame_ascii_content = strdup(frame->data.strval);
       }
@@ -332,7 +344,7 @@ unsigned char *songid_pack (njb_songid_t *song, u_int32_t *tagsize)
       memcpy(&tagbuffer[index], label, labelsz);
       index += labelsz;
       memcpy(&tagbuffer[index], frame_ascii_content, frame_ascii_len);
-      free(frame_ascii_content);
+      unicode_buf_free(frame_ascii_content, buf);
       index += frame_ascii_len;
       nframes ++;
       
@@ -464,6 +476,8 @@ unsigned char *songid_pack3 (njb_songid_t *song, u_int32_t *tagsize)
   unsigned char *track_genre = NULL;
   unsigned char *track_fname = NULL;
   unsigned char *track_folder = NULL;
+  /* The strings are converted in here unless they are very long */
+  unsigned char strbuf[6][UNICODE_BUF_SIZE];
   u_int8_t had_size = 0;
   u_int8_t had_year = 0;
   u_int8_t had_trackno = 0;
@@ -505,27 +519,33 @@ unsigned char *songid_pack3 (njb_songid_t *song, u_int32_t *tagsize)
     }
     /* For strings, stringlengh * 2 + 4 bytes */
     else if (!strcmp(frame->label, FR_TITLE)) {
-      track_title = strtoucs2((unsigned char *) frame->data.strval);
+      track_title = strtoucs2_buf((unsigned char *) frame->data.strval,
+				  strbuf[0], UNICODE_BUF_SIZE);
       *tagsize += (6 + 2*ucs2strlen(track_title));
     }
     else if (!strcmp(frame->label, FR_ALBUM)) {
-      track_album = strtoucs2((unsigned char *) frame->data.strval);
+      track_album = strtoucs2_buf((unsigned char *) frame->data.strval,
+				  strbuf[1], UNICODE_BUF_SIZE);
       *tagsize += (6 + 2*ucs2strlen(track_album));
     }
     else if (!strcmp(frame->label, FR_ARTIST)) {
-      track_artist = strtoucs2((unsigned char *) frame->data.strval);
+      track_artist = strtoucs2_buf((unsigned char *) frame->data.strval,
+				  strbuf[2], UNICODE_BUF_SIZE);
       *tagsize += (6 + 2*ucs2strlen(track_artist));
     }
     else if (!strcmp(frame->label, FR_GENRE)) {
-      track_genre = strtoucs2((unsigned char *) frame->data.strval);
+      track_genre = strtoucs2_buf((unsigned char *) frame->data.strval,
+				  strbuf[3], UNICODE_BUF_SIZE);
       *tagsize += (6 + 2*ucs2strlen(track_genre));
     }
     else if (!strcmp(frame->label, FR_FNAME)) {
-      track_fname = strtoucs2((unsigned char *) frame->data.strval);
+      track_fname = strtoucs2_buf((unsigned char *) frame->data.strval,
+				  strbuf[4], UNICODE_BUF_SIZE);
       *tagsize += (6 + 2*ucs2strlen(track_fname));
     }
     else if (!strcmp(frame->label, FR_FOLDER)) {
-      track_folder = strtoucs2((unsigned char *) frame->data.strval);
+      track_folder = strtoucs2_buf((unsigned char *) frame->data.strval,
+				  strbuf[5], UNICODE_BUF_SIZE);
       *tagsize += (6 + 2*ucs2strlen(track_folder));
     }
     else if (!strcmp(frame->label, FR_CODEC)) {
@@ -627,18 +647,12 @@ unsigned char *songid_pack3 (njb_songid_t *song, u_int32_t *tagsize)
   if (track_folder != NULL)
     add_bin_unistr(data, &datap, NJB3_DIR_FRAME_ID, track_folder);
   
-  if (track_title != NULL)
-    free(track_title);
-  if (track_album != NULL)
-    free(track_album);
-  if (track_artist != NULL)
-    free(track_artist);
-  if (track_genre != NULL)
-    free(track_genre);
-  if (track_fname != NULL)
-    free(track_fname);
-  if (track_folder != NULL)
-    free(track_folder);
+  unicode_buf_free(track_title, strbuf[0]);
+  unicode_buf_free(track_album, strbuf[1]);
+  unicode_buf_free(track_artist, strbuf[2]);
+  unicode_buf_free(track_genre, strbuf[3]);
+  unicode_buf_free(track_fname, strbuf[4]);
+  unicode_buf_free(track_folder, strbuf[5]);
   return data;
 }
 
@@ -0,0 +1,839 @@
+/**
+ * \file tracktable.c
+ *
+ * This file contains the functions that build the track table, a
+ * compact representation of the metadata of all tracks on a device.
+ * The table is built row by row in a growable builder, where all
+ * strings are interned into a single pool, and is then packed into
+ * one single block of memory with one array per metadata column.
+ */
+
+#ifndef _MSC_VER
+#include <unistd.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "libnjb.h"
+#include "njb_error.h"
+#include "defs.h"
+#include "base.h"
+#include "byteorder.h"
+#include "tracktable.h"
+
+/** Initial number of rows allocated by the builder */
+#define TT_INITIAL_ROWS 256
+/** Initial size of the string pool */
+#define TT_INITIAL_POOL 4096
+/** Initial number of buckets in the string hash, must be a power of 2 */
+#define TT_INITIAL_BUCKETS 1024
+
+/**
+ * One row of the table under construction.
+ */
+typedef struct {
+  u_int32_t trid; /**< The track ID */
+  u_int32_t size; /**< The file size */
+  u_int16_t length; /**< The length in seconds */
+  u_int16_t year; /**< The year */
+  u_int16_t tracknum; /**< The track number */
+  u_int16_t protect; /**< The copy protection flag */
+  u_int32_t str[TT_NSTRINGS]; /**< Offsets into the string pool */
+} tt_row_t;
+
+/**
+ * The builder holds the rows and the interned strings until the
+ * table is packed.
+ */
+struct track_table_builder_struct {
+  tt_row_t *rows; /**< The rows added so far */
+  u_int32_t nrows; /**< The number of rows added so far */
+  u_int32_t maxrows; /**< The number of rows allocated */
+  char *pool; /**< The string pool */
+  u_int32_t poolsize; /**< The number of bytes used in the pool */
+  u_int32_t maxpool; /**< The number of bytes allocated for the pool */
+  u_int32_t *buckets; /**< Hash of pool offsets, 0 is an empty bucket */
+  u_int32_t nbuckets; /**< The number of buckets */
+  u_int32_t nstrings; /**< The number of strings in the hash */
+};
+
+/**
+ * Maps the textual song ID frame labels to table columns, so that
+ * each label only has to be compared once per frame.
+ */
+static const struct {
+  const char *label;
+  int column;
+} tt_labels[] = {
+  { FR_TITLE, TT_TITLE },
+  { FR_ARTIST, TT_ARTIST },
+  { FR_ALBUM, TT_ALBUM },
+  { FR_GENRE, TT_GENRE },
+  { FR_CODEC, TT_CODEC },
+  { FR_FNAME, TT_FNAME },
+  { FR_FOLDER, TT_FOLDER },
+  { FR_SIZE, TT_SIZE },
+  { FR_LENGTH, TT_LENGTH },
+  { FR_YEAR, TT_YEAR },
+  { FR_TRACK, TT_TRACKNUM },
+  { FR_PROTECTED, TT_PROTECTED },
+  { NULL, -1 }
+};
+
+/**
+ * The FNV-1a hash of a string.
+ */
+static u_int32_t tt_hash(const char *str)
+{
+  u_int32_t hash = 2166136261U;
+
+  while (*str != '\0') {
+    hash ^= (unsigned char) *str++;
+    hash *= 16777619U;
+  }
+  return hash;
+}
+
+/**
+ * Doubles the number of buckets in the string hash and
+ * rehashes all strings.
+ *
+ * @return 0 on success, -1 on failure
+ */
+static int tt_grow_buckets(track_table_builder_t *tb)
+{
+  u_int32_t nbuckets = tb->nbuckets * 2;
+  u_int32_t *buckets;
+  u_int32_t i;
+
+  buckets = (u_int32_t *) calloc(nbuckets, sizeof(u_int32_t));
+  if (buckets == NULL) {
+    return -1;
+  }
+  for (i = 0; i < tb->nbuckets; i++) {
+    u_int32_t offset = tb->buckets[i];
+    u_int32_t b;
+
+    if (offset == 0) {
+      continue;
+    }
+    b = tt_hash(&tb->pool[offset]) & (nbuckets - 1);
+    while (buckets[b] != 0) {
+      b = (b + 1) & (nbuckets - 1);
+    }
+    buckets[b] = offset;
+  }
+  free(tb->buckets);
+  tb->buckets = buckets;
+  tb->nbuckets = nbuckets;
+  return 0;
+}
+
+/**
+ * Interns a string in the string pool of the builder.
+ *
+ * @param str the string to intern
+ * @param offset a pointer to a variable that will hold the offset
+ *               of the string in the pool
+ * @return 0 on success, -1 on failure
+ */
+static int tt_intern(track_table_builder_t *tb, const char *str, u_int32_t *offset)
+{
+  u_int32_t len;
+  u_int32_t b;
+
+  /* The empty string is always at offset 0 */
+  if (str == NULL || *str == '\0') {
+    *offset = 0;
+    return 0;
+  }
+  b = tt_hash(str) & (tb->nbuckets - 1);
+  while (tb->buckets[b] != 0) {
+    if (!strcmp(&tb->pool[tb->buckets[b]], str)) {
+      *offset = tb->buckets[b];
+      return 0;
+    }
+    b = (b + 1) & (tb->nbuckets - 1);
+  }
+
+  /* Not seen before, add it to the pool */
+  len = strlen(str) + 1;
+  if (tb->poolsize + len > tb->maxpool) {
+    u_int32_t maxpool = tb->maxpool * 2;
+    char *pool;
+
+    while (tb->poolsize + len > maxpool) {
+      maxpool *= 2;
+    }
+    pool = (char *) realloc(tb->pool, maxpool);
+    if (pool == NULL) {
+      return -1;
+    }
+    tb->pool = pool;
+    tb->maxpool = maxpool;
+  }
+  memcpy(&tb->pool[tb->poolsize], str, len);
+  tb->buckets[b] = tb->poolsize;
+  *offset = tb->poolsize;
+  tb->poolsize += len;
+  tb->nstrings++;
+
+  /* Keep the load factor of the hash below 1/2 */
+  if (tb->nstrings * 2 > tb->nbuckets) {
+    if (tt_grow_buckets(tb) == -1) {
+      return -1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Creates a new, empty track table builder.
+ *
+ * @return a new builder or NULL if out of memory
+ */
+track_table_builder_t *track_table_builder_new(void)
+{
+  __dsub= "track_table_builder_new";
+  track_table_builder_t *tb;
+
+  __enter;
+
+  tb = (track_table_builder_t *) malloc(sizeof(track_table_builder_t));
+  if (tb == NULL) {
+    __leave;
+    return NULL;
+  }
+  memset(tb, 0, sizeof(track_table_builder_t));
+  tb->rows = (tt_row_t *) malloc(TT_INITIAL_ROWS * sizeof(tt_row_t));
+  tb->pool = (char *) malloc(TT_INITIAL_POOL);
+  tb->buckets = (u_int32_t *) calloc(TT_INITIAL_BUCKETS, sizeof(u_int32_t));
+  if (tb->rows == NULL || tb->pool == NULL || tb->buckets == NULL) {
+    track_table_builder_destroy(tb);
+    __leave;
+    return NULL;
+  }
+  tb->maxrows = TT_INITIAL_ROWS;
+  tb->maxpool = TT_INITIAL_POOL;
+  tb->nbuckets = TT_INITIAL_BUCKETS;
+  /* Offset 0 is the empty string */
+  tb->pool[0] = '\0';
+  tb->poolsize = 1;
+
+  __leave;
+  return tb;
+}
+
+/**
+ * Destroys a track table builder and everything in it.
+ *
+ * @param tb the builder to destroy
+ */
+void track_table_builder_destroy(track_table_builder_t *tb)
+{
+  if (tb->rows != NULL)
+    free(tb->rows);
+  if (tb->pool != NULL)
+    free(tb->pool);
+  if (tb->buckets != NULL)
+    free(tb->buckets);
+  free(tb);
+}
+
+/**
+ * Finds the table column for a song ID frame label.
+ *
+ * @param label the song ID frame label, such as <code>FR_TITLE</code>
+ * @return the column, or -1 if the label has no column in the table
+ */
+int track_table_label_id(const char *label)
+{
+  int i;
+
+  for (i = 0; tt_labels[i].label != NULL; i++) {
+    if (!strcmp(tt_labels[i].label, label)) {
+      return tt_labels[i].column;
+    }
+  }
+  return -1;
+}
+
+/**
+ * Adds a new row to the table. The following calls to
+ * <code>track_table_set_string()</code> and
+ * <code>track_table_set_number()</code> will fill in this row.
+ *
+ * @param tb the builder to add a row to
+ * @param trid the track ID of the new row
+ * @return 0 on success, -1 on failure
+ */
+int track_table_add_row(track_table_builder_t *tb, u_int32_t trid)
+{
+  tt_row_t *row;
+
+  if (tb->nrows == tb->maxrows) {
+    tt_row_t *rows;
+
+    rows = (tt_row_t *) realloc(tb->rows, tb->maxrows * 2 * sizeof(tt_row_t));
+    if (rows == NULL) {
+      return -1;
+    }
+    tb->rows = rows;
+    tb->maxrows *= 2;
+  }
+  row = &tb->rows[tb->nrows];
+  memset(row, 0, sizeof(tt_row_t));
+  row->trid = trid;
+  tb->nrows++;
+  return 0;
+}
+
+/**
+ * Sets a string column of the last added row.
+ *
+ * @param tb the builder
+ * @param column the column, <code>TT_TITLE</code> to <code>TT_FOLDER</code>
+ * @param str the string value, which is copied into the string pool
+ * @return 0 on success, -1 on failure
+ */
+int track_table_set_string(track_table_builder_t *tb, int column, const char *str)
+{
+  if (tb->nrows == 0 || column < 0 || column >= TT_NSTRINGS) {
+    return 0;
+  }
+  return tt_intern(tb, str, &tb->rows[tb->nrows-1].str[column]);
+}
+
+/**
+ * Sets a numeric column of the last added row.
+ *
+ * @param tb the builder
+ * @param column the column, <code>TT_SIZE</code> to <code>TT_PROTECTED</code>
+ * @param value the numeric value
+ */
+void track_table_set_number(track_table_builder_t *tb, int column, u_int32_t value)
+{
+  tt_row_t *row;
+
+  if (tb->nrows == 0) {
+    return;
+  }
+  row = &tb->rows[tb->nrows-1];
+  switch (column) {
+  case TT_SIZE:
+    row->size = value;
+    break;
+  case TT_LENGTH:
+    row->length = (u_int16_t) value;
+    break;
+  case TT_YEAR:
+    row->year = (u_int16_t) value;
+    break;
+  case TT_TRACKNUM:
+    row->tracknum = (u_int16_t) value;
+    break;
+  case TT_PROTECTED:
+    row->protect = (u_int16_t) value;
+    break;
+  default:
+    break;
+  }
+}
+
+/**
+ * Adds a song ID as a new row in the table. Numeric frames that
+ * are stored as strings (as some NJB1 software does) are converted.
+ *
+ * @param tb the builder
+ * @param song the song ID to add, it is not modified
+ * @return 0 on success, -1 on failure
+ */
+int track_table_add_songid(track_table_builder_t *tb, njb_songid_t *song)
+{
+  njb_songid_frame_t *frame;
+
+  if (track_table_add_row(tb, song->trid) == -1) {
+    return -1;
+  }
+  for (frame = song->first; frame != NULL; frame = frame->next) {
+    int column = track_table_label_id(frame->label);
+
+    if (column == -1) {
+      continue;
+    }
+    if (column < TT_NSTRINGS) {
+      if (frame->type == NJB_TYPE_STRING) {
+	if (track_table_set_string(tb, column, frame->data.strval) == -1) {
+	  return -1;
+	}
+      }
+    } else if (frame->type == NJB_TYPE_UINT16) {
+      track_table_set_number(tb, column, frame->data.u_int16_val);
+    } else if (frame->type == NJB_TYPE_UINT32) {
+      track_table_set_number(tb, column, frame->data.u_int32_val);
+    } else if (frame->type == NJB_TYPE_STRING && frame->data.strval != NULL) {
+      track_table_set_number(tb, column, strtoul(frame->data.strval, NULL, 10));
+    }
+  }
+  return 0;
+}
+
+/**
+ * Rounds a size up to the next multiple of 8 bytes, so that
+ * all columns in the packed table are properly aligned.
+ */
+#define TT_ALIGN(a) (((a) + 7) & ~((size_t) 7))
+
+/**
+ * The largest number of tracks tt_alloc() accepts, low enough that
+ * the column sizes cannot overflow a 32-bit size_t.
+ */
+#define TT_MAX_ALLOC_TRACKS 0x1000000
+
+/**
+ * Allocates a track table with room for a certain number of tracks
+ * and a string pool of a certain size, as one single block of memory,
+ * and points all columns into this block.
+ *
+ * @param ntracks the number of tracks
+ * @param strings_size the size of the string pool
+ * @return the new, uninitialized track table or NULL if out of memory
+ */
+static njb_track_table_t *tt_alloc(u_int32_t ntracks, u_int32_t strings_size)
+{
+  njb_track_table_t *table;
+  unsigned char *arena;
+  size_t size32;
+  size_t size16;
+  size_t columns;
+  size_t offset;
+
+  /* Refuse sizes for which the sum below would wrap around */
+  if (ntracks > TT_MAX_ALLOC_TRACKS) {
+    return NULL;
+  }
+  size32 = TT_ALIGN(ntracks * sizeof(u_int32_t));
+  size16 = TT_ALIGN(ntracks * sizeof(u_int16_t));
+  columns = TT_ALIGN(sizeof(njb_track_table_t))
+    + (2 + TT_NSTRINGS) * size32 + 4 * size16;
+  if (strings_size > ((size_t) -1) - columns) {
+    return NULL;
+  }
+
+  arena = (unsigned char *) malloc(columns + strings_size);
+  if (arena == NULL) {
+    return NULL;
+  }
+
+  table = (njb_track_table_t *) arena;
+  offset = TT_ALIGN(sizeof(njb_track_table_t));
+  table->ntracks = ntracks;
+  table->trid = (u_int32_t *) &arena[offset];
+  offset += size32;
+  table->size = (u_int32_t *) &arena[offset];
+  offset += size32;
+  table->title = (u_int32_t *) &arena[offset];
+  offset += size32;
+  table->artist = (u_int32_t *) &arena[offset];
+  offset += size32;
+  table->album = (u_int32_t *) &arena[offset];
+  offset += size32;
+  table->genre = (u_int32_t *) &arena[offset];
+  offset += size32;
+  table->codec = (u_int32_t *) &arena[offset];
+  offset += size32;
+  table->filename = (u_int32_t *) &arena[offset];
+  offset += size32;
+  table->folder = (u_int32_t *) &arena[offset];
+  offset += size32;
+  table->length = (u_int16_t *) &arena[offset];
+  offset += size16;
+  table->year = (u_int16_t *) &arena[offset];
+  offset += size16;
+  table->tracknum = (u_int16_t *) &arena[offset];
+  offset += size16;
+  table->protect = (u_int16_t *) &arena[offset];
+  offset += size16;
+  table->strings = (char *) &arena[offset];
+  table->strings_size = strings_size;
+  return table;
+}
+
+/**
+ * Packs the rows of the builder into a track table, and destroys
+ * the builder. The table and all its columns and strings are
+ * allocated as one single block of memory.
+ *
+ * @param tb the builder, which is destroyed by this call also
+ *           on failure
+ * @return the new track table or NULL if out of memory
+ */
+njb_track_table_t *track_table_finish(track_table_builder_t *tb)
+{
+  __dsub= "track_table_finish";
+  njb_track_table_t *table;
+  u_int32_t i;
+
+  __enter;
+
+  table = tt_alloc(tb->nrows, tb->poolsize);
+  if (table == NULL) {
+    track_table_builder_destroy(tb);
+    __leave;
+    return NULL;
+  }
+
+  for (i = 0; i < tb->nrows; i++) {
+    tt_row_t *row = &tb->rows[i];
+
+    table->trid[i] = row->trid;
+    table->size[i] = row->size;
+    table->length[i] = row->length;
+    table->year[i] = row->year;
+    table->tracknum[i] = row->tracknum;
+    table->protect[i] = row->protect;
+    table->title[i] = row->str[TT_TITLE];
+    table->artist[i] = row->str[TT_ARTIST];
+    table->album[i] = row->str[TT_ALBUM];
+    table->genre[i] = row->str[TT_GENRE];
+    table->codec[i] = row->str[TT_CODEC];
+    table->filename[i] = row->str[TT_FNAME];
+    table->folder[i] = row->str[TT_FOLDER];
+  }
+  memcpy(table->strings, tb->pool, tb->poolsize);
+
+  track_table_builder_destroy(tb);
+
+  __leave;
+  return table;
+}
+
+/*
+ * Snapshot files store a track table together with a key that
+ * identifies the state of the device it was retrieved from.
+ * All integers are stored big-endian, so the files can be moved
+ * between hosts. Layout:
+ *
+ * 8 bytes magic "NJBSNAP1"
+ * 4 bytes key length, followed by the key
+ * 4 bytes number of tracks
+ * 4 bytes string pool size
+ * the 32-bit columns trid, size, title, artist, album, genre,
+ * codec, filename and folder, one after the other
+ * the 16-bit columns length, year, tracknum and protect
+ * the string pool
+ */
+#define TT_SNAPSHOT_MAGIC "NJBSNAP1"
+#define TT_SNAPSHOT_MAX_KEY 0x400
+#define TT_SNAPSHOT_MAX_TRACKS 0x100000
+/* Bytes per track in the snapshot columns: 9 x 32 bits and 4 x 16 bits */
+#define TT_SNAPSHOT_ROW_SIZE ((2 + TT_NSTRINGS) * 4 + 4 * 2)
+
+/**
+ * Writes a 32-bit column to a snapshot file.
+ */
+static int tt_write_column32(FILE *fp, u_int32_t *column, u_int32_t n, unsigned char *buf)
+{
+  u_int32_t i;
+
+  for (i = 0; i < n; i++) {
+    from_32bit_to_njb3_bytes(column[i], &buf[i*4]);
+  }
+  return (fwrite(buf, 4, n, fp) == n) ? 0 : -1;
+}
+
+/**
+ * Writes a 16-bit column to a snapshot file.
+ */
+static int tt_write_column16(FILE *fp, u_int16_t *column, u_int32_t n, unsigned char *buf)
+{
+  u_int32_t i;
+
+  for (i = 0; i < n; i++) {
+    from_16bit_to_njb3_bytes(column[i], &buf[i*2]);
+  }
+  return (fwrite(buf, 2, n, fp) == n) ? 0 : -1;
+}
+
+/**
+ * Reads a 32-bit column from a snapshot file.
+ */
+static int tt_read_column32(FILE *fp, u_int32_t *column, u_int32_t n, unsigned char *buf)
+{
+  u_int32_t i;
+
+  if (fread(buf, 4, n, fp) != n) {
+    return -1;
+  }
+  for (i = 0; i < n; i++) {
+    column[i] = njb3_bytes_to_32bit(&buf[i*4]);
+  }
+  return 0;
+}
+
+/**
+ * Reads a 16-bit column from a snapshot file.
+ */
+static int tt_read_column16(FILE *fp, u_int16_t *column, u_int32_t n, unsigned char *buf)
+{
+  u_int32_t i;
+
+  if (fread(buf, 2, n, fp) != n) {
+    return -1;
+  }
+  for (i = 0; i < n; i++) {
+    column[i] = njb3_bytes_to_16bit(&buf[i*2]);
+  }
+  return 0;
+}
+
+/**
+ * Saves a track table to a snapshot file. The file is written
+ * under a temporary name and then renamed, so that a crash will
+ * never leave a half-written snapshot behind.
+ *
+ * @param path the snapshot file to write
+ * @param key the key identifying the device state
+ * @param keylen the length of the key
+ * @param table the track table to save
+ * @return 0 on success, -1 on failure
+ */
+int track_table_save(const char *path, const unsigned char *key, u_int32_t keylen,
+		     njb_track_table_t *table)
+{
+  __dsub= "track_table_save";
+  char *tmppath;
+  unsigned char *buf;
+  unsigned char word[4];
+  FILE *fp;
+  u_int32_t n = table->ntracks;
+  int result = 0;
+
+  __enter;
+
+  tmppath = (char *) malloc(strlen(path) + 5);
+  buf = (unsigned char *) malloc(n * 4 + 4);
+  if (tmppath == NULL || buf == NULL) {
+    if (tmppath != NULL)
+      free(tmppath);
+    if (buf != NULL)
+      free(buf);
+    __leave;
+    return -1;
+  }
+  strcpy(tmppath, path);
+  strcat(tmppath, ".tmp");
+
+  fp = fopen(tmppath, "wb");
+  if (fp == NULL) {
+    free(tmppath);
+    free(buf);
+    __leave;
+    return -1;
+  }
+  if (fwrite(TT_SNAPSHOT_MAGIC, 1, 8, fp) != 8)
+    result = -1;
+  from_32bit_to_njb3_bytes(keylen, word);
+  if (result == 0 && fwrite(word, 1, 4, fp) != 4)
+    result = -1;
+  if (result == 0 && fwrite(key, 1, keylen, fp) != keylen)
+    result = -1;
+  from_32bit_to_njb3_bytes(n, word);
+  if (result == 0 && fwrite(word, 1, 4, fp) != 4)
+    result = -1;
+  from_32bit_to_njb3_bytes(table->strings_size, word);
+  if (result == 0 && fwrite(word, 1, 4, fp) != 4)
+    result = -1;
+  if (result == 0)
+    result = tt_write_column32(fp, table->trid, n, buf);
+  if (result == 0)
+    result = tt_write_column32(fp, table->size, n, buf);
+  if (result == 0)
+    result = tt_write_column32(fp, table->title, n, buf);
+  if (result == 0)
+    result = tt_write_column32(fp, table->artist, n, buf);
+  if (result == 0)
+    result = tt_write_column32(fp, table->album, n, buf);
+  if (result == 0)
+    result = tt_write_column32(fp, table->genre, n, buf);
+  if (result == 0)
+    result = tt_write_column32(fp, table->codec, n, buf);
+  if (result == 0)
+    result = tt_write_column32(fp, table->filename, n, buf);
+  if (result == 0)
+    result = tt_write_column32(fp, table->folder, n, buf);
+  if (result == 0)
+    result = tt_write_column16(fp, table->length, n, buf);
+  if (result == 0)
+    result = tt_write_column16(fp, table->year, n, buf);
+  if (result == 0)
+    result = tt_write_column16(fp, table->tracknum, n, buf);
+  if (result == 0)
+    result = tt_write_column16(fp, table->protect, n, buf);
+  if (result == 0 && 
+      fwrite(table->strings, 1, table->strings_size, fp) != table->strings_size)
+    result = -1;
+  if (fclose(fp) != 0)
+    result = -1;
+
+  if (result == 0) {
+    if (rename(tmppath, path) != 0) {
+      result = -1;
+    }
+  }
+  if (result == -1) {
+    unlink(tmppath);
+  }
+  free(tmppath);
+  free(buf);
+  __leave;
+  return result;
+}
+
+/**
+ * Loads a track table from a snapshot file, if the snapshot was
+ * saved with the same key.
+ *
+ * @param path the snapshot file to read
+ * @param key the key identifying the current device state
+ * @param keylen the length of the key
+ * @return the track table, or NULL if there is no valid snapshot
+ *         for this key
+ */
+njb_track_table_t *track_table_load(const char *path, const unsigned char *key,
+				    u_int32_t keylen)
+{
+  __dsub= "track_table_load";
+  njb_track_table_t *table = NULL;
+  unsigned char header[12];
+  unsigned char *buf = NULL;
+  unsigned char *filekey = NULL;
+  u_int32_t filekeylen;
+  u_int32_t n;
+  u_int32_t strings_size;
+  u_int32_t i;
+  long start;
+  long end;
+  int result = 0;
+  FILE *fp;
+
+  __enter;
+
+  fp = fopen(path, "rb");
+  if (fp == NULL) {
+    __leave;
+    return NULL;
+  }
+  if (fread(header, 1, 12, fp) != 12 ||
+      memcmp(header, TT_SNAPSHOT_MAGIC, 8)) {
+    goto done;
+  }
+  filekeylen = njb3_bytes_to_32bit(&header[8]);
+  if (filekeylen != keylen || keylen > TT_SNAPSHOT_MAX_KEY) {
+    goto done;
+  }
+  filekey = (unsigned char *) malloc(keylen + 8);
+  if (filekey == NULL ||
+      fread(filekey, 1, keylen + 8, fp) != keylen + 8 ||
+      memcmp(filekey, key, keylen)) {
+    goto done;
+  }
+  n = njb3_bytes_to_32bit(&filekey[keylen]);
+  strings_size = njb3_bytes_to_32bit(&filekey[keylen+4]);
+  if (n > TT_SNAPSHOT_MAX_TRACKS || strings_size == 0) {
+    goto done;
+  }
+  /*
+   * The string pool is the last thing in the file, so it can be no
+   * larger than what is left after the columns. Check this before
+   * trusting the size for an allocation.
+   */
+  start = ftell(fp);
+  if (start < 0 || fseek(fp, 0, SEEK_END) != 0) {
+    goto done;
+  }
+  end = ftell(fp);
+  if (end < start || fseek(fp, start, SEEK_SET) != 0) {
+    goto done;
+  }
+  if ((u_int32_t) (end - start) < n * TT_SNAPSHOT_ROW_SIZE ||
+      strings_size > (u_int32_t) (end - start) - n * TT_SNAPSHOT_ROW_SIZE) {
+    goto done;
+  }
+
+  buf = (unsigned char *) malloc(n * 4 + 4);
+  table = tt_alloc(n, strings_size);
+  if (buf == NULL || table == NULL) {
+    if (table != NULL)
+      free(table);
+    table = NULL;
+    goto done;
+  }
+  result = tt_read_column32(fp, table->trid, n, buf);
+  if (result == 0)
+    result = tt_read_column32(fp, table->size, n, buf);
+  if (result == 0)
+    result = tt_read_column32(fp, table->title, n, buf);
+  if (result == 0)
+    result = tt_read_column32(fp, table->artist, n, buf);
+  if (result == 0)
+    result = tt_read_column32(fp, table->album, n, buf);
+  if (result == 0)
+    result = tt_read_column32(fp, table->genre, n, buf);
+  if (result == 0)
+    result = tt_read_column32(fp, table->codec, n, buf);
+  if (result == 0)
+    result = tt_read_column32(fp, table->filename, n, buf);
+  if (result == 0)
+    result = tt_read_column32(fp, table->folder, n, buf);
+  if (result == 0)
+    result = tt_read_column16(fp, table->length, n, buf);
+  if (result == 0)
+    result = tt_read_column16(fp, table->year, n, buf);
+  if (result == 0)
+    result = tt_read_column16(fp, table->tracknum, n, buf);
+  if (result == 0)
+    result = tt_read_column16(fp, table->protect, n, buf);
+  if (result == 0 &&
+      fread(table->strings, 1, strings_size, fp) != strings_size)
+    result = -1;
+  /* The pool must be terminated and all offsets must point into it */
+  if (result == 0 && table->strings[strings_size-1] != '\0')
+    result = -1;
+  for (i = 0; result == 0 && i < n; i++) {
+    if (table->title[i] >= strings_size ||
+	table->artist[i] >= strings_size ||
+	table->album[i] >= strings_size ||
+	table->genre[i] >= strings_size ||
+	table->codec[i] >= strings_size ||
+	table->filename[i] >= strings_size ||
+	table->folder[i] >= strings_size) {
+      result = -1;
+    }
+  }
+  if (result == -1) {
+    free(table);
+    table = NULL;
+  }
+
+ done:
+  fclose(fp);
+  if (filekey != NULL)
+    free(filekey);
+  if (buf != NULL)
+    free(buf);
+  __leave;
+  return table;
+}
+
+/**
+ * This destroys a track table retrieved with
+ * <code>NJB_Get_Track_Table()</code>.
+ *
+ * @param table the track table to destroy
+ */
+void NJB_Track_Table_Destroy(njb_track_table_t *table)
+{
+  free(table);
+}
@@ -0,0 +1,35 @@
+#ifndef __NJB__TRACKTABLE__H
+#define __NJB__TRACKTABLE__H
+
+/* String columns of the track table */
+#define TT_TITLE	0
+#define TT_ARTIST	1
+#define TT_ALBUM	2
+#define TT_GENRE	3
+#define TT_CODEC	4
+#define TT_FNAME	5
+#define TT_FOLDER	6
+#define TT_NSTRINGS	7
+/* Numeric columns of the track table */
+#define TT_SIZE		7
+#define TT_LENGTH	8
+#define TT_YEAR		9
+#define TT_TRACKNUM	10
+#define TT_PROTECTED	11
+
+typedef struct track_table_builder_struct track_table_builder_t;
+
+track_table_builder_t *track_table_builder_new(void);
+void track_table_builder_destroy(track_table_builder_t *tb);
+int track_table_label_id(const char *label);
+int track_table_add_row(track_table_builder_t *tb, u_int32_t trid);
+int track_table_set_string(track_table_builder_t *tb, int column, const char *str);
+void track_table_set_number(track_table_builder_t *tb, int column, u_int32_t value);
+int track_table_add_songid(track_table_builder_t *tb, njb_songid_t *song);
+njb_track_table_t *track_table_finish(track_table_builder_t *tb);
+int track_table_save(const char *path, const unsigned char *key, u_int32_t keylen,
+		     njb_track_table_t *table);
+njb_track_table_t *track_table_load(const char *path, const unsigned char *key,
+				    u_int32_t keylen);
+
+#endif
@@ -1,10 +1,20 @@
-/**
+/** 
  * \file unicode.c
  *
  * This file contains general Unicode string manipulation functions.
  * It mainly consist of functions for converting between UCS-2 (used on
  * the devices), UTF-8 (used by several applications) and 
  * ISO 8859-1 / Codepage 1252 (fallback).
+ *
+ * The strings on the devices are really big-endian UTF-16, so
+ * characters outside the basic multilingual plane are stored as
+ * surrogate pairs, which are converted to and from the corresponding
+ * 4-byte UTF-8 sequences.
+ *
+ * Each conversion has a <code>_buf</code> variant that writes into a
+ * buffer supplied by the caller and only allocates memory when the
+ * result does not fit, which saves a malloc() and free() for every
+ * string that is only converted to be copied somewhere else.
  */
 
 #include <stdlib.h>
@@ -20,11 +30,14 @@
 #include "defs.h"
 #include "base.h"
 
-extern int __sub_depth;
 int njb_unicode_flag = NJB_UC_8859;
-#define MAX_STRING_LENGTH 512
 
-/**
+/** Code point used for characters that cannot be decoded */
+#define UNICODE_REPLACEMENT 0xFFFDU
+/** Returned by the decoders for a malformed sequence */
+#define UNICODE_INVALID 0xFFFFFFFFU
+
+/** 
  * This flag determines whether to use ISO 8859-1 / codepage 1252 
  * (default) or unicode UTF-8 for ALL strings sent into and out of
  * libnjb, for ALL sessions and devices.
@@ -37,7 +50,7 @@ void njb_set_unicode (int flag)
 	njb_unicode_flag = flag;
 }
 
-/** 
+/**
  * Gets the length (in characters, not bytes) of a unicode 
  * UCS-2 string, eg a string which physically is 0x00 0x41 0x00 0x00
  * will return a value of 1.
@@ -66,44 +79,350 @@ int ucs2strlen(const unsigned char *unicstr){
 }
 
 /**
- * This routine returns the length in bytes that this
- * UCS-2 string would occupy if encoded as UTF-8
+ * This decodes one character from a big-endian UTF-16 string,
+ * joining surrogate pairs. A surrogate without its other half
+ * decodes to U+FFFD.
+ *
+ * @param unicstr the string, not at its terminator
+ * @param nbytes a pointer to a variable that will hold the number
+ *               of bytes used, 2 or 4
+ * @return the code point
+ */
+static u_int32_t ucs2_decode(const unsigned char *unicstr, int *nbytes)
+{
+  u_int32_t c = ((u_int32_t) unicstr[0] << 8) | unicstr[1];
+  u_int32_t c2;
+
+  *nbytes = 2;
+  if (c < 0xD800U || c > 0xDFFFU) {
+    return c;
+  }
+  if (c >= 0xDC00U) {
+    /* A low surrogate first */
+    return UNICODE_REPLACEMENT;
+  }
+  c2 = ((u_int32_t) unicstr[2] << 8) | unicstr[3];
+  if (c2 < 0xDC00U || c2 > 0xDFFFU) {
+    /* Not followed by a low surrogate (also catches the terminator) */
+    return UNICODE_REPLACEMENT;
+  }
+  *nbytes = 4;
+  return 0x10000U + ((c - 0xD800U) << 10) + (c2 - 0xDC00U);
+}
+
+/**
+ * This decodes one character from a UTF-8 string. Overlong
+ * sequences, encoded surrogates and sequences with missing
+ * continuation bytes are rejected.
  *
- * @param unicstr the Unicode UCS-2 string to analyze
- * @return the number of bytes this string would occupy
- *         in UTF-8
+ * @param str the string, not at its terminator
+ * @param nbytes a pointer to a variable that will hold the number
+ *               of bytes used. For a malformed sequence this is 1,
+ *               so that decoding can resume at the next byte.
+ * @return the code point, or UNICODE_INVALID
  */
-static int ucs2utf8len(const unsigned char *unicstr){
-  int length=0;
+static u_int32_t utf8_decode(const unsigned char *str, int *nbytes)
+{
+  u_int32_t c = str[0];
+  u_int32_t min;
+  int n, i;
+
+  *nbytes = 1;
+  if (c < 0x80U) {
+    return c;
+  } else if ((c & 0xE0U) == 0xC0U) {
+    n = 2;
+    c &= 0x1FU;
+    min = 0x80U;
+  } else if ((c & 0xF0U) == 0xE0U) {
+    n = 3;
+    c &= 0x0FU;
+    min = 0x800U;
+  } else if ((c & 0xF8U) == 0xF0U) {
+    n = 4;
+    c &= 0x07U;
+    min = 0x10000U;
+  } else {
+    return UNICODE_INVALID;
+  }
+  /* A terminator is not a continuation byte, so this stops there */
+  for (i = 1; i < n; i++) {
+    if ((str[i] & 0xC0U) != 0x80U) {
+      return UNICODE_INVALID;
+    }
+    c = (c << 6) | (str[i] & 0x3FU);
+  }
+  if (c < min || c > 0x10FFFFU || (c >= 0xD800U && c <= 0xDFFFU)) {
+    return UNICODE_INVALID;
+  }
+  *nbytes = n;
+  return c;
+}
+
+/**
+ * This converts a UCS-2 string to UTF-8. Like snprintf() it never
+ * writes more than <code>bufsize</code> bytes and returns the size
+ * the whole result would need, so it can also be used to measure.
+ *
+ * @param unicstr the UCS-2 string to convert
+ * @param buf the buffer to write to, may be NULL if bufsize is 0
+ * @param bufsize the size of the buffer
+ * @return the size of the result in bytes, including the terminator
+ */
+static size_t ucs2_to_utf8(const unsigned char *unicstr, char *buf,
+			   size_t bufsize)
+{
+  const unsigned char *p = unicstr;
+  unsigned char *d = (unsigned char *) buf;
+  unsigned char *end = d + bufsize;
+  size_t n = 0;
+  u_int32_t c;
+  int used;
+
+  for (;;) {
+    /* Fast path for runs of plain ASCII, the vast majority of strings */
+    if (d < end) {
+      while (d < end && p[0] == 0x00 && p[1] - 1U < 0x7FU) {
+	*d++ = p[1];
+	p += 2;
+      }
+    } else {
+      while (p[0] == 0x00 && p[1] - 1U < 0x7FU) {
+	n++;
+	p += 2;
+      }
+    }
+    if ((p[0] | p[1]) == 0x00) {
+      break;
+    }
+    c = ucs2_decode(p, &used);
+    if (c < 0x80U) {
+      /* Plain ASCII that no longer fits */
+      n += 1;
+    } else if (c < 0x800U) {
+      if (end - d >= 2) {
+	d[0] = 0xC0 | (c >> 6);
+	d[1] = 0x80 | (c & 0x3F);
+	d += 2;
+	p += used;
+	continue;
+      }
+      n += 2;
+    } else if (c < 0x10000U) {
+      if (end - d >= 3) {
+	d[0] = 0xE0 | (c >> 12);
+	d[1] = 0x80 | ((c >> 6) & 0x3F);
+	d[2] = 0x80 | (c & 0x3F);
+	d += 3;
+	p += used;
+	continue;
+      }
+      n += 3;
+    } else {
+      if (end - d >= 4) {
+	d[0] = 0xF0 | (c >> 18);
+	d[1] = 0x80 | ((c >> 12) & 0x3F);
+	d[2] = 0x80 | ((c >> 6) & 0x3F);
+	d[3] = 0x80 | (c & 0x3F);
+	d += 4;
+	p += used;
+	continue;
+      }
+      n += 4;
+    }
+    /* Out of room: only measure the rest from here on */
+    p += used;
+    end = d;
+  }
+  if (d < end) {
+    *d = '\0';
+    return (size_t) (d - (unsigned char *) buf) + 1;
+  }
+  return (size_t) (d - (unsigned char *) buf) + n + 1;
+}
+
+/**
+ * This converts a UCS-2 string to ISO 8859-1, leaving out all
+ * characters above 0xff. Works like <code>ucs2_to_utf8()</code>.
+ */
+static size_t ucs2_to_latin1(const unsigned char *unicstr, char *buf,
+			     size_t bufsize)
+{
+  size_t n = 0;
   int i;
-  for(i=0; (unicstr[i] | unicstr[i+1]) != '\0'; i+=2) {
-    if (unicstr[i] == 0x00 && unicstr[i+1] < 0x80)
-      length++;
-    else if (unicstr[i] < 0x08)
-      length+=2;
-    else
-      length+=3;
+
+  for (i = 0; (unicstr[i] | unicstr[i+1]) != 0x00; i += 2) {
+    if (unicstr[i] == 0x00) {
+      if (n < bufsize) {
+	buf[n] = unicstr[i+1];
+      }
+      n++;
+    }
+  }
+  if (n < bufsize) {
+    buf[n] = '\0';
   }
-  return length;
+  return n + 1;
 }
 
-/** 
- * Create a new, allocated UCS-2 string that is a copy
- * of the parameter
+/**
+ * This converts a UTF-8 string to UCS-2, using surrogate pairs for
+ * characters outside the basic multilingual plane and skipping
+ * malformed bytes. Works like <code>ucs2_to_utf8()</code>.
+ */
+static size_t utf8_to_ucs2(const unsigned char *str, unsigned char *buf,
+			   size_t bufsize)
+{
+  size_t n = 0;
+  u_int32_t c;
+  int i = 0;
+  int used;
+
+  for (;;) {
+    /* Fast path for runs of plain ASCII */
+    while (str[i] - 1U < 0x7FU) {
+      if (n + 2 <= bufsize) {
+	buf[n] = 0x00;
+	buf[n+1] = str[i];
+      }
+      n += 2;
+      i++;
+    }
+    if (str[i] == '\0') {
+      break;
+    }
+    c = utf8_decode(&str[i], &used);
+    i += used;
+    if (c == UNICODE_INVALID) {
+      continue;
+    }
+    if (c >= 0x10000U) {
+      u_int32_t hi = 0xD800U + ((c - 0x10000U) >> 10);
+      u_int32_t lo = 0xDC00U + ((c - 0x10000U) & 0x3FFU);
+
+      if (n + 4 <= bufsize) {
+	buf[n] = hi >> 8;
+	buf[n+1] = hi & 0xFF;
+	buf[n+2] = lo >> 8;
+	buf[n+3] = lo & 0xFF;
+      }
+      n += 4;
+    } else {
+      if (n + 2 <= bufsize) {
+	buf[n] = c >> 8;
+	buf[n+1] = c & 0xFF;
+      }
+      n += 2;
+    }
+  }
+  if (n + 2 <= bufsize) {
+    buf[n] = 0x00;
+    buf[n+1] = 0x00;
+  }
+  return n + 2;
+}
+
+/**
+ * This converts an ISO 8859-1 string to UCS-2. Works like
+ * <code>ucs2_to_utf8()</code>.
+ */
+static size_t latin1_to_ucs2(const unsigned char *str, unsigned char *buf,
+			     size_t bufsize)
+{
+  size_t n = 0;
+  int i;
+
+  for (i = 0; str[i] != '\0'; i++) {
+    if (n + 2 <= bufsize) {
+      buf[n] = 0x00;
+      buf[n+1] = str[i];
+    }
+    n += 2;
+  }
+  if (n + 2 <= bufsize) {
+    buf[n] = 0x00;
+    buf[n+1] = 0x00;
+  }
+  return n + 2;
+}
+
+/**
+ * This converts an ISO 8859-1 string to UTF-8. Works like
+ * <code>ucs2_to_utf8()</code>.
+ */
+static size_t latin1_to_utf8(const unsigned char *str, char *buf,
+			     size_t bufsize)
+{
+  size_t n = 0;
+  int i;
+
+  for (i = 0; str[i] != '\0'; i++) {
+    if (str[i] < 0x80) {
+      if (n < bufsize) {
+	buf[n] = str[i];
+      }
+      n++;
+    } else {
+      if (n + 2 <= bufsize) {
+	buf[n] = 0xC0 | (str[i] >> 6);
+	buf[n+1] = 0x80 | (str[i] & 0x3F);
+      }
+      n += 2;
+    }
+  }
+  if (n < bufsize) {
+    buf[n] = '\0';
+  }
+  return n + 1;
+}
+
+/**
+ * This approximates an ISO 8859-1 string from a UTF-8 string,
+ * leaving out characters above 0xff and malformed bytes. Works like
+ * <code>ucs2_to_utf8()</code>.
  *
- * @param unicstr the UCS-2 string to copy
- * @return a newly allocated copy of the string
+ * @param nchars a pointer to a variable that will hold the number of
+ *               characters in the UTF-8 string
  */
-static unsigned char *ucs2strdup(const unsigned char *unicstr) {
-  int length = ucs2strlen(unicstr);
-  unsigned char *data;
-  
-  data = (unsigned char *) malloc(length*2+2);
-  if ( data == NULL ) {
-    return NULL;
+static size_t utf8_to_latin1(const unsigned char *str, char *buf,
+			     size_t bufsize, size_t *nchars)
+{
+  size_t n = 0;
+  u_int32_t c;
+  int i = 0;
+  int used;
+
+  *nchars = 0;
+  while (str[i] != '\0') {
+    c = utf8_decode(&str[i], &used);
+    i += used;
+    (*nchars)++;
+    if (c < 0x100U) {
+      if (n < bufsize) {
+	buf[n] = c;
+      }
+      n++;
+    }
+  }
+  if (n < bufsize) {
+    buf[n] = '\0';
+  }
+  return n + 1;
+}
+
+/**
+ * This releases a string returned by one of the <code>_buf</code>
+ * conversion functions, if it was allocated rather than written
+ * to the caller's buffer.
+ *
+ * @param str the converted string, may be NULL
+ * @param buf the buffer that was passed to the conversion
+ */
+void unicode_buf_free(void *str, const void *buf)
+{
+  if (str != NULL && str != buf) {
+    free(str);
   }
-  memcpy(data, unicstr, length*2+2);
-  return data;
 }
 
 /**
@@ -115,25 +434,53 @@ static unsigned char *ucs2strdup(const unsigned char *unicstr) {
  *         the same content. Should be freed after use.
  */
 char *strtoutf8(const unsigned char *str) {  
-  unsigned char buffer[MAX_STRING_LENGTH];
-  int l = 0;
-  int i;
+  char *data;
+  size_t size;
 
-  memset(buffer,0,MAX_STRING_LENGTH);
-  
-  for (i = 0; i < strlen((char *) str); i++) {
-    if (str[i]<0x80) {
-      buffer[l] = str[i];
-      l++;
-    } else {
-      buffer[l] = 0xC0 | (str[i]>>6 & 0x03);
-      buffer[l+1] = 0x80 | (str[i] & 0x3F);
-      l+=2;
+  size = latin1_to_utf8(str, NULL, 0);
+  data = (char *) malloc(size);
+  if (data == NULL) {
+    return NULL;
+  }
+  latin1_to_utf8(str, data, size);
+  return data;
+}
+
+/**
+ * This function approximates an ISO 8859-1 string from
+ * a UTF-8 string, leaving out untranslatable characters.
+ * The result is written to a buffer supplied by the caller
+ * if it fits there.
+ *
+ * @param str the UTF-8 string to use as indata
+ * @param buf the buffer to use, may be NULL
+ * @param bufsize the size of the buffer
+ * @return <code>buf</code> or a newly allocated ISO 8859-1 string
+ *         which is as close a possible to the UTF-8 string, to be
+ *         released with <code>unicode_buf_free()</code>. Returns NULL
+ *         if no character of a non-empty string could be translated,
+ *         or if out of memory.
+ */
+char *utf8tostr_buf(const unsigned char *str, char *buf, size_t bufsize) {
+  char *data = buf;
+  size_t size;
+  size_t nchars;
+
+  size = utf8_to_latin1(str, buf, bufsize, &nchars);
+  if (size > bufsize) {
+    data = (char *) malloc(size);
+    if (data == NULL) {
+      return NULL;
     }
-    buffer[l] = 0x00;
+    utf8_to_latin1(str, data, size, &nchars);
   }
-  /* The duplicate the string and return it */
-  return strdup((char *) buffer);
+
+  /* If there was nothing in this string, return NULL */
+  if (size == 1 && nchars > 0) {
+    unicode_buf_free(data, buf);
+    return NULL;
+  }
+  return data;
 }
 
 /**
@@ -145,193 +492,143 @@ char *strtoutf8(const unsigned char *str) {
  *         as close a possible to the UTF-8 string.
  */
 char *utf8tostr(const unsigned char *str) {
-  unsigned char buffer[MAX_STRING_LENGTH];
-  unsigned char *ucs2string;
-  int i = 0;
-  int l = 0;
+  char buf[UNICODE_BUF_SIZE];
+  char *data;
 
-  memset(buffer,0,MAX_STRING_LENGTH);
-
-  ucs2string = strtoucs2(str);
-
-  for(i=0; (ucs2string[i] | ucs2string[i+1])!='\0'; i+=2) {
-    if (ucs2string[i] == '\0') {
-      buffer[l] = ucs2string[i+1];
-      l++;
-    }
+  data = utf8tostr_buf(str, buf, sizeof(buf));
+  if (data == buf) {
+    data = strdup(buf);
   }
-  buffer[l] = '\0';
-
-  free(ucs2string);
-
-  /* If there was nothing in this string, return NULL */
-  if (l>0 || i == 0)
-    return strdup((char *) buffer);
-  else
-    return NULL;
+  return data;
 }
 
 /**
- * Converts a Unicode UCS-2 2-byte string to a common 
- * ISO 8859-1 string quick and dirty (japanese unicodes etc, 
- * that use all 16 bits will fail miserably)
+ * Converts a Unicode UCS-2 2-byte string to UTF-8 or to an
+ * ISO 8859-1 string (depending on library Unicode flag). In
+ * ISO 8859-1 mode, characters above 0xff are lost. The result
+ * is written to a buffer supplied by the caller if it fits there.
  *
  * @param unicstr the UCS-2 unicode string to convert
- * @return a newly allocated ISO 8859-1 string that tries
- *         to resemble the UCS-2 string
+ * @param buf the buffer to use, may be NULL
+ * @param bufsize the size of the buffer
+ * @return <code>buf</code> or a newly allocated string, to be
+ *         released with <code>unicode_buf_free()</code>. NULL if
+ *         out of memory.
  */
-char *ucs2tostr(const unsigned char *unicstr){
+char *ucs2tostr_buf(const unsigned char *unicstr, char *buf, size_t bufsize){
 
-	__dsub= "ucs2tostr";
+	__dsub= "ucs2tostr_buf";
 
-	char *data = NULL;
-	int i = 0;
-	int l = 0;
+	size_t (*convert)(const unsigned char *, char *, size_t);
+	char *data = buf;
+	size_t size;
 
 	__enter;
 
-
-	/* Real unicode support in UTF8 */
 	if (njb_unicode_flag == NJB_UC_UTF8) {
-	  int length8 = ucs2utf8len(unicstr);
-	  data= (char *) malloc(length8+1);
-	  if ( data == NULL ) {
-	    __leave;
-	    return NULL;
-	  }
-	  for(l=0;(unicstr[l] | unicstr[l+1])!='\0'; l+=2) {
-	    if (unicstr[l] == 0x00 && unicstr[l+1] < 0x80) {
-	      data[i]=unicstr[l+1];
-	      i++;
-	    } else if (unicstr[l] < 0x08) {
-	      data[i] = 0xc0 | (unicstr[l]<<2 & 0x1C) | (unicstr[l+1]>>6  & 0x03);
-	      data[i+1] = 0x80 | (unicstr[l+1] & 0x3F);
-	      i+=2;
-	    } else {
-	      data[i] = 0xe0 | (unicstr[l]>>4 & 0x0F);
-	      data[i+1] = 0x80 | (unicstr[l]<<2 & 0x3C) | (unicstr[l+1]>>6 & 0x03);
-	      data[i+2] = 0x80 | (unicstr[l+1] & 0x3F);
-	      i+=3;
-	    }
-	  }
-	  /* Terminate string */
-	  data[i]=0x00;	  
+	  convert = ucs2_to_utf8;
 	} else {
-	  /* If we're running in ISO 8859-1 mode, approximate
-	   * and concatenate, loosing any chars above 0xff */
-	  int length=ucs2strlen(unicstr);
-
-	  data = (char *) malloc(length+1);
+	  convert = ucs2_to_latin1;
+	}
+	/* Only measure first if the result does not fit */
+	size = convert(unicstr, buf, bufsize);
+	if (size > bufsize) {
+	  data = (char *) malloc(size);
 	  if ( data == NULL ) {
 	    __leave;
 	    return NULL;
 	  }
-
-	  l = 0;
-	  for(i=0;l<length*2;){
-	    if (unicstr[l] == 0x00) {
-	      data[i]=unicstr[l+1];
-	      i++;
-	    }
-	    l+=2;
-	  }
-	  /* Terminate string */
-	  data[i]=0x00;
+	  convert(unicstr, data, size);
 	}
 
-
 	__leave;
 	return data;
 }
 
+/**
+ * Converts a Unicode UCS-2 2-byte string to UTF-8 or to an
+ * ISO 8859-1 string (depending on library Unicode flag). In
+ * ISO 8859-1 mode, characters above 0xff are lost.
+ *
+ * @param unicstr the UCS-2 unicode string to convert
+ * @return a newly allocated string that tries
+ *         to resemble the UCS-2 string
+ */
+char *ucs2tostr(const unsigned char *unicstr){
+	char buf[UNICODE_BUF_SIZE];
+	char *data;
+
+	/* Converting on the stack first saves measuring the string */
+	data = ucs2tostr_buf(unicstr, buf, sizeof(buf));
+	if (data == buf) {
+	  data = strdup(buf);
+	}
+	return data;
+}
+
 /**
  * Convert a simple ISO 8859-1 or a Unicode
  * UTF8 string (depending on library Unicode flag) to a 
- * unicode UCS-2 string.
+ * unicode UCS-2 string. The result is written to a buffer
+ * supplied by the caller if it fits there.
  *
- * @param str the ISO 8859-1 or UTF-8 string to conver
- * @return a pointer to a newly allocated UCS-2 string
+ * @param str the ISO 8859-1 or UTF-8 string to convert
+ * @param buf the buffer to use, may be NULL
+ * @param bufsize the size of the buffer in bytes
+ * @return <code>buf</code> or a newly allocated UCS-2 string, to
+ *         be released with <code>unicode_buf_free()</code>. NULL if
+ *         out of memory.
  */
-unsigned char *strtoucs2(const unsigned char *str) {
+unsigned char *strtoucs2_buf(const unsigned char *str, unsigned char *buf,
+			     size_t bufsize) {
 
-	__dsub= "strtoucs2";
+	__dsub= "strtoucs2_buf";
 
-	unsigned char *data = NULL;
-	int i=0;
-	int l=0;
+	size_t (*convert)(const unsigned char *, unsigned char *, size_t);
+	unsigned char *data = buf;
+	size_t size;
 
 	__enter;
 
-	/* Real unicode support in UTF8 */
 	if (njb_unicode_flag == NJB_UC_UTF8) {
-	  unsigned char buffer[MAX_STRING_LENGTH*2];
-
-	  int length=0;
-	  int i;
-
-	  for(i=0; str[i] != '\0';) {
-	    if (str[i] < 0x80) {
-	      buffer[length] = 0x00;
-	      buffer[length+1] = str[i];
-	      length += 2;
-	      i++;
-	    } else {
-	      unsigned char numbytes = 0;
-	      unsigned char lenbyte = 0;
-	      
-	      /* Read the number of encoded bytes */
-	      lenbyte = str[i];
-	      while (lenbyte & 0x80) {
-		numbytes++;
-		lenbyte = lenbyte<<1;
-	      }
-	      /* UCS-2 can handle no more than 3 UTF-8 encoded bytes */
-	      if (numbytes <= 3) {
-		if (numbytes == 2 && str[i+1] >= 0x80) {
-		  /* This character can always be handled correctly */
-		  buffer[length] = (str[i]>>2 & 0x07);
-		  buffer[length+1] = (str[i]<<6 & 0xC0) | (str[i+1] & 0x3F);
-		  i += 2;
-		  length += 2;
-		} else if (numbytes == 3 && str[i+1] >= 0x80 && str[i+2] >= 0x80) {
-		  buffer[length] = (str[i]<<4 & 0xF0) | (str[i+1]>>2 & 0x0F);
-		  buffer[length+1]= (str[i+1]<<6 & 0xC0) | (str[i+2] & 0x3F);
-		  i += 3;
-		  length += 2;
-		} else {
-		  /* Abnormal string character, just skip */
-		  i += numbytes;
-		}
-	      } else {
-		/* Just skip that character */
-		i += numbytes;
-	      }
-	    }
-	  }
-	  /* Copy the buffer contents */
-	  buffer[length] = 0x00;
-	  buffer[length+1] = 0x00;
-	  data = ucs2strdup(buffer);
-	  if (data == NULL) {
-	    __leave;
-	    return NULL;
-	  }
+	  convert = utf8_to_ucs2;
 	} else {
-	  /* If we're running in ISO 8859-1 mode, approximate
-	   * and concatenate, loosing any chars above 0xff */
-	  data = (unsigned char *) malloc(2 * strlen((char *) str) + 2);
+	  convert = latin1_to_ucs2;
+	}
+	size = convert(str, buf, bufsize);
+	if (size > bufsize) {
+	  data = (unsigned char *) malloc(size);
 	  if ( data == NULL ) {
 	    __leave;
 	    return NULL;
 	  }
-	
-	  for(i = 0; i <= strlen((char *) str); i++){
-	    data[l] = 0x00;
-	    data[l+1] = str[i];
-	    l += 2;
-	  }
+	  convert(str, data, size);
 	}
 
 	__leave;
 	return data;
 }
+
+/**
+ * Convert a simple ISO 8859-1 or a Unicode
+ * UTF8 string (depending on library Unicode flag) to a
+ * unicode UCS-2 string.
+ *
+ * @param str the ISO 8859-1 or UTF-8 string to conver
+ * @return a pointer to a newly allocated UCS-2 string
+ */
+unsigned char *strtoucs2(const unsigned char *str) {
+	unsigned char buf[UNICODE_BUF_SIZE];
+	unsigned char *data;
+
+	data = strtoucs2_buf(str, buf, sizeof(buf));
+	if (data == buf) {
+	  size_t size = ucs2strlen(buf) * 2 + 2;
+
+	  data = (unsigned char *) malloc(size);
+	  if (data != NULL) {
+	    memcpy(data, buf, size);
+	  }
+	}
+	return data;
+}
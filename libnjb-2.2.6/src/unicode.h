@@ -1,11 +1,19 @@
 #ifndef __NJB__UNICODE__H
 #define __NJB__UNICODE__H
 
+/* A buffer size that fits the strings found in most frames */
+#define UNICODE_BUF_SIZE 256
+
 void njb_set_unicode (int flag);
 int ucs2strlen(const unsigned char *unicstr);
 char *strtoutf8(const unsigned char *str);
 char *utf8tostr(const unsigned char *str);
 char *ucs2tostr(const unsigned char *unicstr);
 unsigned char *strtoucs2(const unsigned char *str);
+char *utf8tostr_buf(const unsigned char *str, char *buf, size_t bufsize);
+char *ucs2tostr_buf(const unsigned char *unicstr, char *buf, size_t bufsize);
+unsigned char *strtoucs2_buf(const unsigned char *str, unsigned char *buf,
+			     size_t bufsize);
+void unicode_buf_free(void *str, const void *buf);
 
 #endif /* __NJB__UNICODE__H */
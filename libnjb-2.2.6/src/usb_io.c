@@ -12,8 +12,28 @@
 #include "ioutil.h"
 #include "usb_io.h"
 #include "njb_error.h"
+#include "defs.h"
+#include "njbtime.h"
+#include "xferstats.h"
+#include "usbrec.h"
 
-extern int __sub_depth;
+/** The number of times a failing bulk transfer is tried */
+#define USB_RETRANSMIT 10
+/** Bulk writes up to this size are commands, see bulk_code() */
+#define USB_COMMAND_MAX 64
+
+/**
+ * This picks out the command code of a bulk write for the transfer
+ * trace: the first two bytes of a short write, which is where the
+ * series 3 devices have their command. Longer writes carry file data.
+ */
+static u_int16_t bulk_code(const unsigned char *buf, size_t nbytes)
+{
+  if (nbytes < 2 || nbytes > USB_COMMAND_MAX) {
+    return 0;
+  }
+  return (u_int16_t) ((buf[0] << 8) | buf[1]);
+}
 
 /**
  * This function writes a number of bytes from a buffer 
@@ -27,26 +47,29 @@ extern int __sub_depth;
 ssize_t usb_pipe_write(njb_t *njb, void *buf, size_t nbytes)
 {
   ssize_t bwritten = -1;
+  u_int32_t started = njb_get_millis();
 
   /* Used for all libnjb enabled platforms. 
    * This section might be the source of timeout problems so
    * it is currently being tested. Also see pipe_read below. */
   
   int usb_timeout = 10 * nbytes; /* that's 5ms / byte */
-  int retransmit = 10; /* Try ten times! (That should do it...) */
+  int retransmit = USB_RETRANSMIT; /* Try ten times! (That should do it...) */
   
   /* Set a timeout floor */
   if (usb_timeout < USBTIMEOUT)
     usb_timeout = USBTIMEOUT;
   
   while (retransmit > 0) {
-    bwritten = usb_bulk_write(njb->dev, njb->usb_bulk_out_ep, buf, nbytes, 
-			     usb_timeout);
+    bwritten = usbrec_bulk_write(njb, buf, nbytes, usb_timeout);
     if ( bwritten < 0 )
       retransmit--;
     else
       break;
   }
+  xferstats_record(njb, NJB_XFER_BULK_OUT, bulk_code(buf, nbytes), nbytes,
+		   (retransmit == 0) ? -1 : bwritten, USB_RETRANSMIT - retransmit,
+		   started, njb_get_millis() - started);
   if (retransmit == 0) {
     njb_error_add_string (njb, "usb_bulk_write", usb_strerror());
     return -1;
@@ -76,20 +99,20 @@ ssize_t usb_pipe_write(njb_t *njb, void *buf, size_t nbytes)
 ssize_t usb_pipe_read (njb_t *njb, void *buf, size_t nbytes)
 {
   ssize_t bread = 0;
+  u_int32_t started = njb_get_millis();
   
   /* Used for all libnjb enabled platforms. 
    * This section might be the source of timeout problems so
    * it is currently being tested. Also see pipe_write above. */
   int usb_timeout = 10 * nbytes; /* that's 10ms / byte */
-  int retransmit = 10; /* Try ten times! (That should do it...) */
+  int retransmit = USB_RETRANSMIT; /* Try ten times! (That should do it...) */
   
   /* Set a timeout floor */
   if (usb_timeout < USBTIMEOUT)
     usb_timeout = USBTIMEOUT;
   
   while (retransmit > 0) {
-    bread = usb_bulk_read(njb->dev, njb->usb_bulk_in_ep, buf, nbytes, 
-			 usb_timeout);
+    bread = usbrec_bulk_read(njb, buf, nbytes, usb_timeout);
     /* This should be changed to (bread < nbytes) asap, but needs
      * an NJB3 to test it, it cancels out short reads if I set
      * it to that, so these must first be avoided in all NJB3
@@ -99,6 +122,9 @@ ssize_t usb_pipe_read (njb_t *njb, void *buf, size_t nbytes)
     else
       break;
   }
+  xferstats_record(njb, NJB_XFER_BULK_IN, 0, nbytes,
+		   (retransmit == 0) ? -1 : bread, USB_RETRANSMIT - retransmit,
+		   started, njb_get_millis() - started);
   if ( retransmit == 0 ) {
     njb_error_add_string (njb, "usb_bulk_read", usb_strerror());
     return -1;
@@ -124,7 +150,8 @@ int usb_setup (njb_t *njb, int type, int request, int value,
 	int index, int length, void *data)
 {
   u_int8_t setup[8];
-  usb_dev_handle *dev = njb->dev;
+  u_int32_t started;
+  int ret;
   
   if ( njb_debug(DD_USBCTL) ) {
     memset(setup, 0, 8);
@@ -149,8 +176,12 @@ int usb_setup (njb_t *njb, int type, int request, int value,
     data_dump(stderr, setup, 8);
   }
   
-  if ( usb_control_msg(dev, type, request, value, index, data, length,
-		       USBTIMEOUT) < 0 ) {
+  started = njb_get_millis();
+  ret = usbrec_control_msg(njb, type, request, value, index, data, length,
+			   USBTIMEOUT);
+  xferstats_record(njb, NJB_XFER_CONTROL, request, length,
+		   (ret < 0) ? -1 : ret, 0, started, njb_get_millis() - started);
+  if ( ret < 0 ) {
     njb_error_add_string (njb, "usb_control_msg", usb_strerror());
     return -1;
   }
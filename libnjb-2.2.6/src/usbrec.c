@@ -0,0 +1,483 @@
+/**
+ * \file usbrec.c
+ *
+ * This file contains the USB session recorder. When recording, every
+ * bulk and control transfer attempt made through usb_io.c is written
+ * to a log file with its parameters, result, duration and data. When
+ * replaying, the transfers are answered from the log instead of from
+ * a device, so a slow sync can be captured once and then run again
+ * as often as needed while the host side code is being tuned, with
+ * the original timing or faster.
+ *
+ * A replay only works for the same sequence of calls that was
+ * recorded: as soon as libnjb asks for a transfer that does not match
+ * the next one in the log, the replay has diverged and every further
+ * transfer fails.
+ *
+ * The log starts with a header of USBREC_HEADER_SIZE bytes:
+ * the magic USBREC_MAGIC, the device type (4 bytes), the flags
+ * (4 bytes), the USB config, interface, IN and OUT endpoints (1 byte
+ * each) and the transfer size (4 bytes). Then follows one record per
+ * transfer attempt: a header of USBREC_RECORD_SIZE bytes, with the
+ * transfer type (2 bytes), control request type (1 byte), control
+ * request (1 byte), control value and index (2 bytes each), bytes
+ * asked for, result, start time and duration in ms and data length
+ * (4 bytes each), followed by the data read or written. All numbers
+ * are big endian.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <usb.h>
+#include "libnjb.h"
+#include "njb_error.h"
+#include "defs.h"
+#include "base.h"
+#include "byteorder.h"
+#include "njbtime.h"
+#include "usb_io.h"
+#include "usbrec.h"
+
+/** Shortest run of printable characters hashed as an ASCII string */
+#define USBREC_ASCII_RUN 4
+/** Shortest run of printable characters hashed as a UCS-2 string */
+#define USBREC_UCS2_RUN 3
+
+/**
+ * This allocates the session state for a device.
+ */
+static njb_usbrec_t *usbrec_new(njb_t *njb, const char *path,
+				const char *mode)
+{
+  njb_usbrec_t *rec;
+
+  rec = (njb_usbrec_t *) malloc(sizeof(njb_usbrec_t));
+  if (rec == NULL) {
+    return NULL;
+  }
+  memset(rec, 0, sizeof(njb_usbrec_t));
+  rec->fp = fopen(path, mode);
+  if (rec->fp == NULL) {
+    free(rec);
+    return NULL;
+  }
+  rec->started = njb_get_millis();
+  return rec;
+}
+
+/**
+ * This starts recording the USB transfers of a device to a file.
+ *
+ * @param njb the device object, not yet opened
+ * @param path the file to record to, which is overwritten
+ * @param flags <code>NJB_REC_HASH_STRINGS</code> or 0
+ * @return 0 on success, -1 if the file could not be created
+ */
+int usbrec_record(njb_t *njb, const char *path, int flags)
+{
+  njb_usbrec_t *rec;
+
+  usbrec_stop(njb);
+  rec = usbrec_new(njb, path, "wb");
+  if (rec == NULL) {
+    return -1;
+  }
+  rec->flags = flags;
+  njb->usb_session = (void *) rec;
+  return 0;
+}
+
+/**
+ * This sets up a device object to be replayed from a file. The
+ * device type, config, interface, endpoints and transfer size are
+ * taken from the file header.
+ *
+ * @param njb the device object to fill in
+ * @param path the file to replay
+ * @param speedup the replay speed, see <code>NJB_Replay_Session()</code>
+ * @return 0 on success, -1 if the file could not be read or is not
+ *         a session log
+ */
+int usbrec_replay(njb_t *njb, const char *path, u_int32_t speedup)
+{
+  njb_usbrec_t *rec;
+  unsigned char hdr[USBREC_HEADER_SIZE];
+
+  rec = usbrec_new(njb, path, "rb");
+  if (rec == NULL) {
+    return -1;
+  }
+  if (fread(hdr, 1, USBREC_HEADER_SIZE, rec->fp) != USBREC_HEADER_SIZE ||
+      memcmp(hdr, USBREC_MAGIC, USBREC_MAGIC_SIZE)) {
+    fclose(rec->fp);
+    free(rec);
+    return -1;
+  }
+  rec->replaying = 1;
+  rec->speedup = speedup;
+  rec->flags = (int) njb3_bytes_to_32bit(&hdr[12]);
+
+  memset(njb, 0, sizeof(njb_t));
+  njb->device_type = (int) njb3_bytes_to_32bit(&hdr[8]);
+  njb->usb_config = hdr[16];
+  njb->usb_interface = hdr[17];
+  njb->usb_bulk_in_ep = hdr[18];
+  njb->usb_bulk_out_ep = hdr[19];
+  njb->xfersize = njb3_bytes_to_32bit(&hdr[20]);
+  njb->usb_session = (void *) rec;
+  return 0;
+}
+
+/**
+ * This stops recording or replaying and closes the session log.
+ *
+ * @param njb the device object
+ */
+void usbrec_stop(njb_t *njb)
+{
+  njb_usbrec_t *rec = (njb_usbrec_t *) njb->usb_session;
+
+  if (rec == NULL) {
+    return;
+  }
+  fclose(rec->fp);
+  free(rec);
+  njb->usb_session = NULL;
+}
+
+/**
+ * This tells if a device object is being replayed from a file
+ * rather than talking to a device.
+ *
+ * @param njb the device object
+ * @return 1 when replaying, else 0
+ */
+int usbrec_replaying(njb_t *njb)
+{
+  njb_usbrec_t *rec = (njb_usbrec_t *) njb->usb_session;
+
+  return (rec != NULL && rec->replaying) ? 1 : 0;
+}
+
+static int is_printable(unsigned char c)
+{
+  return (c >= 0x20 && c < 0x7f);
+}
+
+static int is_letter(unsigned char c)
+{
+  return ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'));
+}
+
+/**
+ * This replaces the letters of a string of printable characters,
+ * each <code>step</code> bytes apart, with letters derived from a
+ * hash of the string. Equal strings come out equal, and the length,
+ * case and all other characters are kept, so the protocol still
+ * parses.
+ */
+static void hash_run(unsigned char *p, size_t nchars, size_t step)
+{
+  u_int32_t h = 2166136261U;
+  size_t i;
+
+  for (i = 0; i < nchars; i++) {
+    h = (h ^ p[i * step]) * 16777619U;
+  }
+  for (i = 0; i < nchars; i++) {
+    unsigned char c = p[i * step];
+
+    h = (h ^ (u_int32_t) i) * 16777619U;
+    if (c >= 'a' && c <= 'z') {
+      p[i * step] = 'a' + (h >> 8) % 26;
+    } else if (c >= 'A' && c <= 'Z') {
+      p[i * step] = 'A' + (h >> 8) % 26;
+    }
+  }
+}
+
+/**
+ * This hashes the strings found in a block of recorded data: runs
+ * of printable big endian UCS-2 characters, as used by the series 3
+ * devices, and runs of printable ASCII. Runs without letters are left
+ * alone so that numbers and such stay readable.
+ */
+static void hash_strings(unsigned char *data, size_t len)
+{
+  size_t i = 0;
+
+  while (i < len) {
+    size_t n = 0;
+    int letters = 0;
+
+    /* UCS-2: a zero high byte and a printable low byte */
+    while (i + 2 * n + 1 < len && data[i + 2 * n] == 0x00 &&
+	   is_printable(data[i + 2 * n + 1])) {
+      letters |= is_letter(data[i + 2 * n + 1]);
+      n++;
+    }
+    if (n >= USBREC_UCS2_RUN) {
+      if (letters) {
+	hash_run(&data[i + 1], n, 2);
+      }
+      i += 2 * n;
+      continue;
+    }
+
+    n = 0;
+    letters = 0;
+    while (i + n < len && is_printable(data[i + n])) {
+      letters |= is_letter(data[i + n]);
+      n++;
+    }
+    if (n >= USBREC_ASCII_RUN) {
+      if (letters) {
+	hash_run(&data[i], n, 1);
+      }
+      i += n;
+      continue;
+    }
+    i += (n > 0) ? n : 1;
+  }
+}
+
+/**
+ * This gives up on the session log after a write failure or a
+ * diverged replay. The first failure is reported on the error
+ * stack, later transfers fail (when replaying) or go unrecorded.
+ */
+static void usbrec_fail(njb_t *njb, njb_usbrec_t *rec, const char *error)
+{
+  __dsub= "usbrec_fail";
+
+  if (rec->failed) {
+    return;
+  }
+  rec->failed = 1;
+  {
+    char msg[64];
+
+    snprintf(msg, sizeof(msg), "%s at transfer %u", error, rec->records);
+    njb_error_add_string(njb, subroutinename, msg);
+  }
+}
+
+/**
+ * This writes the file header, which is put off until the first
+ * transfer because the endpoints are not known before the device
+ * has been opened.
+ */
+static int write_header(njb_t *njb, njb_usbrec_t *rec)
+{
+  unsigned char hdr[USBREC_HEADER_SIZE];
+
+  memcpy(hdr, USBREC_MAGIC, USBREC_MAGIC_SIZE);
+  from_32bit_to_njb3_bytes((u_int32_t) njb->device_type, &hdr[8]);
+  from_32bit_to_njb3_bytes((u_int32_t) rec->flags, &hdr[12]);
+  hdr[16] = njb->usb_config;
+  hdr[17] = njb->usb_interface;
+  hdr[18] = njb->usb_bulk_in_ep;
+  hdr[19] = njb->usb_bulk_out_ep;
+  from_32bit_to_njb3_bytes(njb->xfersize, &hdr[20]);
+  if (fwrite(hdr, 1, USBREC_HEADER_SIZE, rec->fp) != USBREC_HEADER_SIZE) {
+    return -1;
+  }
+  rec->header_written = 1;
+  return 0;
+}
+
+/**
+ * This appends one transfer attempt to the session log.
+ */
+static void record_transfer(njb_t *njb, njb_usbrec_t *rec, int type,
+			    int reqtype, int request, int value, int index,
+			    u_int32_t requested, int32_t result,
+			    u_int32_t started, u_int32_t millis,
+			    const void *data, u_int32_t datalen)
+{
+  unsigned char hdr[USBREC_RECORD_SIZE];
+  unsigned char *copy = NULL;
+
+  if (rec->failed) {
+    return;
+  }
+  if (!rec->header_written && write_header(njb, rec) == -1) {
+    usbrec_fail(njb, rec, "could not write session log");
+    return;
+  }
+
+  from_16bit_to_njb3_bytes((u_int16_t) type, &hdr[0]);
+  hdr[2] = (unsigned char) reqtype;
+  hdr[3] = (unsigned char) request;
+  from_16bit_to_njb3_bytes((u_int16_t) value, &hdr[4]);
+  from_16bit_to_njb3_bytes((u_int16_t) index, &hdr[6]);
+  from_32bit_to_njb3_bytes(requested, &hdr[8]);
+  from_32bit_to_njb3_bytes((u_int32_t) result, &hdr[12]);
+  from_32bit_to_njb3_bytes(started - rec->started, &hdr[16]);
+  from_32bit_to_njb3_bytes(millis, &hdr[20]);
+  from_32bit_to_njb3_bytes(datalen, &hdr[24]);
+
+  /* Hash a copy, the caller's buffer holds the real thing */
+  if (datalen > 0 && (rec->flags & NJB_REC_HASH_STRINGS)) {
+    copy = (unsigned char *) malloc(datalen);
+    if (copy == NULL) {
+      usbrec_fail(njb, rec, "out of memory");
+      return;
+    }
+    memcpy(copy, data, datalen);
+    hash_strings(copy, datalen);
+    data = copy;
+  }
+
+  if (fwrite(hdr, 1, USBREC_RECORD_SIZE, rec->fp) != USBREC_RECORD_SIZE ||
+      (datalen > 0 && fwrite(data, 1, datalen, rec->fp) != datalen)) {
+    usbrec_fail(njb, rec, "could not write session log");
+  }
+  if (copy != NULL) {
+    free(copy);
+  }
+  rec->records++;
+}
+
+/**
+ * This answers a transfer from the session log. The next record
+ * must be of the same type, and for control transfers the same
+ * request, with the same number of bytes asked for. Data read in
+ * the recorded transfer is copied to <code>buf</code>, and the
+ * recorded duration is waited out, scaled by the replay speed.
+ *
+ * @return the recorded result, or -1 if the replay has diverged
+ */
+static int replay_transfer(njb_t *njb, njb_usbrec_t *rec, int type,
+			   int request, void *buf, int size, int into_buf)
+{
+  unsigned char hdr[USBREC_RECORD_SIZE];
+  u_int32_t requested, millis, datalen;
+  int32_t result;
+
+  if (rec->failed) {
+    return -1;
+  }
+  if (fread(hdr, 1, USBREC_RECORD_SIZE, rec->fp) != USBREC_RECORD_SIZE) {
+    usbrec_fail(njb, rec, "replay ran out of transfers");
+    return -1;
+  }
+  requested = njb3_bytes_to_32bit(&hdr[8]);
+  result = (int32_t) njb3_bytes_to_32bit(&hdr[12]);
+  millis = njb3_bytes_to_32bit(&hdr[20]);
+  datalen = njb3_bytes_to_32bit(&hdr[24]);
+
+  if (njb3_bytes_to_16bit(&hdr[0]) != type ||
+      (type == NJB_XFER_CONTROL && hdr[3] != (unsigned char) request) ||
+      requested != (u_int32_t) size ||
+      (into_buf && datalen > (u_int32_t) size)) {
+    usbrec_fail(njb, rec, "replay diverged");
+    return -1;
+  }
+  if (datalen > 0) {
+    if (into_buf) {
+      if (fread(buf, 1, datalen, rec->fp) != datalen) {
+	usbrec_fail(njb, rec, "replay ran out of transfers");
+	return -1;
+      }
+    } else if (fseek(rec->fp, (long) datalen, SEEK_CUR) != 0) {
+      usbrec_fail(njb, rec, "replay ran out of transfers");
+      return -1;
+    }
+  }
+  rec->records++;
+
+  if (rec->speedup > 0 && millis >= rec->speedup) {
+    njb_sleep_millis(millis / rec->speedup);
+  }
+  return result;
+}
+
+/**
+ * This does a bulk write to the OUT endpoint of a device, recording
+ * or replaying it when a session is active.
+ *
+ * @return as <code>usb_bulk_write()</code>
+ */
+int usbrec_bulk_write(njb_t *njb, void *buf, int size, int timeout)
+{
+  njb_usbrec_t *rec = (njb_usbrec_t *) njb->usb_session;
+  u_int32_t started;
+  int ret;
+
+  if (rec == NULL) {
+    return usb_bulk_write(njb->dev, njb->usb_bulk_out_ep, buf, size, timeout);
+  }
+  if (rec->replaying) {
+    return replay_transfer(njb, rec, NJB_XFER_BULK_OUT, 0, buf, size, 0);
+  }
+  started = njb_get_millis();
+  ret = usb_bulk_write(njb->dev, njb->usb_bulk_out_ep, buf, size, timeout);
+  record_transfer(njb, rec, NJB_XFER_BULK_OUT, 0, 0, 0, 0, size, ret,
+		  started, njb_get_millis() - started, buf,
+		  (ret > 0) ? ret : 0);
+  return ret;
+}
+
+/**
+ * This does a bulk read from the IN endpoint of a device, recording
+ * or replaying it when a session is active.
+ *
+ * @return as <code>usb_bulk_read()</code>
+ */
+int usbrec_bulk_read(njb_t *njb, void *buf, int size, int timeout)
+{
+  njb_usbrec_t *rec = (njb_usbrec_t *) njb->usb_session;
+  u_int32_t started;
+  int ret;
+
+  if (rec == NULL) {
+    return usb_bulk_read(njb->dev, njb->usb_bulk_in_ep, buf, size, timeout);
+  }
+  if (rec->replaying) {
+    return replay_transfer(njb, rec, NJB_XFER_BULK_IN, 0, buf, size, 1);
+  }
+  started = njb_get_millis();
+  ret = usb_bulk_read(njb->dev, njb->usb_bulk_in_ep, buf, size, timeout);
+  record_transfer(njb, rec, NJB_XFER_BULK_IN, 0, 0, 0, 0, size, ret,
+		  started, njb_get_millis() - started, buf,
+		  (ret > 0) ? ret : 0);
+  return ret;
+}
+
+/**
+ * This does a control transfer on endpoint 0 of a device, recording
+ * or replaying it when a session is active. The data read, or the
+ * data sent, is kept in the log.
+ *
+ * @return as <code>usb_control_msg()</code>
+ */
+int usbrec_control_msg(njb_t *njb, int reqtype, int request, int value,
+		       int index, void *data, int size, int timeout)
+{
+  njb_usbrec_t *rec = (njb_usbrec_t *) njb->usb_session;
+  int reading = ((reqtype & UT_READ) == UT_READ);
+  u_int32_t started, datalen;
+  int ret;
+
+  if (rec == NULL) {
+    return usb_control_msg(njb->dev, reqtype, request, value, index, data,
+			   size, timeout);
+  }
+  if (rec->replaying) {
+    return replay_transfer(njb, rec, NJB_XFER_CONTROL, request, data, size,
+			   reading);
+  }
+  started = njb_get_millis();
+  ret = usb_control_msg(njb->dev, reqtype, request, value, index, data,
+			size, timeout);
+  if (reading) {
+    datalen = (ret > 0) ? ret : 0;
+  } else {
+    datalen = (size > 0) ? size : 0;
+  }
+  record_transfer(njb, rec, NJB_XFER_CONTROL, reqtype, request, value, index,
+		  size, ret, started, njb_get_millis() - started, data,
+		  datalen);
+  return ret;
+}
@@ -0,0 +1,34 @@
+#ifndef __NJB__USBREC__H
+#define __NJB__USBREC__H
+
+#include <stdio.h>
+#include "libnjb.h"
+
+/* The first bytes of a session log, with the format version */
+#define USBREC_MAGIC "NJBUSB01"
+#define USBREC_MAGIC_SIZE 8
+/* Size of the file header and of the header of each record */
+#define USBREC_HEADER_SIZE 24
+#define USBREC_RECORD_SIZE 28
+
+typedef struct {
+  FILE *fp; /* The session log */
+  int replaying; /* Replaying the log rather than recording to it */
+  int flags; /* NJB_REC_* flags given when recording */
+  u_int32_t speedup; /* Replay this many times faster, 0 = no delays */
+  u_int32_t started; /* When the session started, in ms */
+  u_int32_t records; /* Records written or replayed so far */
+  int header_written; /* Whether the file header has been written */
+  int failed; /* Writing failed, or the replay diverged */
+} njb_usbrec_t;
+
+int usbrec_record(njb_t *njb, const char *path, int flags);
+int usbrec_replay(njb_t *njb, const char *path, u_int32_t speedup);
+void usbrec_stop(njb_t *njb);
+int usbrec_replaying(njb_t *njb);
+int usbrec_bulk_write(njb_t *njb, void *buf, int size, int timeout);
+int usbrec_bulk_read(njb_t *njb, void *buf, int size, int timeout);
+int usbrec_control_msg(njb_t *njb, int reqtype, int request, int value,
+		       int index, void *data, int size, int timeout);
+
+#endif
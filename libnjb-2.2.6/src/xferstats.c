@@ -0,0 +1,278 @@
+/**
+ * \file xferstats.c
+ *
+ * This file contains the transfer counters kept for each device.
+ * Every bulk and control transfer is counted and timed as it
+ * passes through usb_io.c, and a sample of the transfers can be
+ * kept in a ring buffer that is dumped after a slow session, which
+ * is a lot cheaper than running with the USB debug flags on.
+ *
+ * The counters belong to the device object and are only updated
+ * by the thread using it, so no locking is needed. A snapshot taken
+ * from another thread during a transfer may be slightly out of step,
+ * but every counter in it is one that has been written.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "libnjb.h"
+#include "njb_error.h"
+#include "defs.h"
+#include "base.h"
+#include "xferstats.h"
+
+/** A transfer taking longer than this (ms) counts as slow */
+#define XFER_SLOW_MS 1000U
+
+/**
+ * This allocates the transfer counters for a device.
+ *
+ * @param njb the device object
+ * @return 0 on success, -1 if out of memory
+ */
+int xferstats_init(njb_t *njb)
+{
+  njb_xferstats_t *xs;
+
+  xs = (njb_xferstats_t *) malloc(sizeof(njb_xferstats_t));
+  if (xs == NULL) {
+    njb->xfer_stats = NULL;
+    return -1;
+  }
+  memset(xs, 0, sizeof(njb_xferstats_t));
+  njb->xfer_stats = (void *) xs;
+  return 0;
+}
+
+/**
+ * This frees the transfer counters of a device.
+ *
+ * @param njb the device object
+ */
+void xferstats_destroy(njb_t *njb)
+{
+  if (njb->xfer_stats != NULL) {
+    free(njb->xfer_stats);
+    njb->xfer_stats = NULL;
+  }
+}
+
+/**
+ * This returns the latency histogram bucket for a transfer time:
+ * bucket 0 is under 1 ms, bucket n (n > 0) is from 2^(n-1) up to
+ * 2^n ms, and the last bucket holds everything longer.
+ */
+static int latency_bucket(u_int32_t millis)
+{
+  int bucket = 0;
+
+  while (millis != 0 && bucket < NJB_XFER_NBUCKETS - 1) {
+    millis >>= 1;
+    bucket++;
+  }
+  return bucket;
+}
+
+/**
+ * This records a finished transfer.
+ *
+ * @param njb the device object
+ * @param type the kind of transfer, <code>NJB_XFER_BULK_IN</code>,
+ *             <code>NJB_XFER_BULK_OUT</code> or <code>NJB_XFER_CONTROL</code>
+ * @param code the control request, or the command code of a bulk write
+ * @param requested the number of bytes asked for
+ * @param result the number of bytes transferred, or -1 on failure
+ * @param retries the number of attempts that failed before this one
+ * @param started when the transfer started, in ms
+ * @param millis how long the transfer took in ms
+ */
+void xferstats_record(njb_t *njb, int type, u_int16_t code, u_int32_t requested,
+		      int32_t result, int retries, u_int32_t started,
+		      u_int32_t millis)
+{
+  njb_xferstats_t *xs = (njb_xferstats_t *) njb->xfer_stats;
+  njb_xfer_stats_t *st;
+
+  if (xs == NULL) {
+    return;
+  }
+  st = &xs->stats;
+
+  switch (type) {
+  case NJB_XFER_BULK_IN:
+    st->bulk_reads++;
+    if (result >= 0) {
+      st->bytes_in += result;
+      if ((u_int32_t) result < requested) {
+	st->short_reads++;
+      }
+    }
+    break;
+  case NJB_XFER_BULK_OUT:
+    st->bulk_writes++;
+    if (result >= 0) {
+      st->bytes_out += result;
+    }
+    break;
+  default:
+    st->control_transfers++;
+    break;
+  }
+  st->retries += retries;
+  if (result < 0) {
+    st->errors++;
+  }
+  if (millis > XFER_SLOW_MS) {
+    st->slow_transfers++;
+  }
+  st->latency[type][latency_bucket(millis)]++;
+
+  if (xs->trace_every == 0) {
+    return;
+  }
+  /* Failures are always traced, other transfers are sampled */
+  if (result >= 0 && xs->trace_skip > 0) {
+    xs->trace_skip--;
+    return;
+  }
+  xs->trace_skip = xs->trace_every - 1;
+  {
+    xfer_trace_entry_t *e = &xs->trace[xs->trace_next];
+
+    e->when = started;
+    e->millis = millis;
+    e->requested = requested;
+    e->result = result;
+    e->code = code;
+    e->type = (u_int8_t) type;
+    e->retries = (retries > 255) ? 255 : (u_int8_t) retries;
+  }
+  xs->trace_next = (xs->trace_next + 1) % XFER_TRACE_SIZE;
+  if (xs->trace_used < XFER_TRACE_SIZE) {
+    xs->trace_used++;
+  }
+}
+
+/**
+ * This records that the device was not ready and had to be
+ * waited for.
+ *
+ * @param njb the device object
+ * @param waited the time waited in ms
+ */
+void xferstats_not_ready(njb_t *njb, u_int32_t waited)
+{
+  njb_xferstats_t *xs = (njb_xferstats_t *) njb->xfer_stats;
+
+  if (xs == NULL) {
+    return;
+  }
+  xs->stats.not_ready++;
+  xs->stats.not_ready_ms += waited;
+}
+
+/**
+ * This copies the counters of a device.
+ *
+ * @param njb the device object
+ * @param stats where to put the copy
+ * @return 0 on success, -1 if the device has not been opened
+ */
+int xferstats_get(njb_t *njb, njb_xfer_stats_t *stats)
+{
+  njb_xferstats_t *xs = (njb_xferstats_t *) njb->xfer_stats;
+
+  if (xs == NULL) {
+    return -1;
+  }
+  memcpy(stats, &xs->stats, sizeof(njb_xfer_stats_t));
+  return 0;
+}
+
+/**
+ * This zeroes the counters and empties the trace of a device.
+ *
+ * @param njb the device object
+ */
+void xferstats_reset(njb_t *njb)
+{
+  njb_xferstats_t *xs = (njb_xferstats_t *) njb->xfer_stats;
+
+  if (xs == NULL) {
+    return;
+  }
+  memset(&xs->stats, 0, sizeof(njb_xfer_stats_t));
+  xs->trace_skip = 0;
+  xs->trace_next = 0;
+  xs->trace_used = 0;
+}
+
+/**
+ * This sets how many transfers are traced.
+ *
+ * @param njb the device object
+ * @param every trace one transfer in this many, 1 traces all and
+ *              0 turns tracing off
+ */
+void xferstats_set_trace(njb_t *njb, u_int32_t every)
+{
+  njb_xferstats_t *xs = (njb_xferstats_t *) njb->xfer_stats;
+
+  if (xs == NULL) {
+    return;
+  }
+  xs->trace_every = every;
+  xs->trace_skip = 0;
+}
+
+/**
+ * This prints the counters and the traced transfers of a device,
+ * oldest first.
+ *
+ * @param njb the device object
+ * @param fp the file to print to
+ */
+void xferstats_dump(njb_t *njb, FILE *fp)
+{
+  static const char *typenames[NJB_XFER_NTYPES] = { "in", "out", "ctrl" };
+  njb_xferstats_t *xs = (njb_xferstats_t *) njb->xfer_stats;
+  njb_xfer_stats_t *st;
+  u_int32_t i, slot;
+  int t, b;
+
+  if (xs == NULL) {
+    return;
+  }
+  st = &xs->stats;
+
+  fprintf(fp, "Bytes in: %llu, bytes out: %llu\n",
+	  (unsigned long long) st->bytes_in, (unsigned long long) st->bytes_out);
+  fprintf(fp, "Bulk reads: %u, bulk writes: %u, control transfers: %u\n",
+	  st->bulk_reads, st->bulk_writes, st->control_transfers);
+  fprintf(fp, "Retries: %u, short reads: %u, slow transfers: %u, errors: %u\n",
+	  st->retries, st->short_reads, st->slow_transfers, st->errors);
+  fprintf(fp, "Not ready: %u times, %u ms\n", st->not_ready, st->not_ready_ms);
+  for (t = 0; t < NJB_XFER_NTYPES; t++) {
+    fprintf(fp, "Latency %-4s:", typenames[t]);
+    for (b = 0; b < NJB_XFER_NBUCKETS; b++) {
+      fprintf(fp, " %u", st->latency[t][b]);
+    }
+    fprintf(fp, "\n");
+  }
+
+  if (xs->trace_used == 0) {
+    return;
+  }
+  fprintf(fp, "Last %u traced transfers:\n", xs->trace_used);
+  fprintf(fp, "%10s %-4s %6s %8s %8s %7s %3s\n", "time", "type", "code",
+	  "asked", "result", "ms", "rty");
+  slot = (xs->trace_next + XFER_TRACE_SIZE - xs->trace_used) % XFER_TRACE_SIZE;
+  for (i = 0; i < xs->trace_used; i++) {
+    xfer_trace_entry_t *e = &xs->trace[slot];
+
+    fprintf(fp, "%10u %-4s 0x%04x %8u %8d %7u %3u\n", e->when,
+	    typenames[e->type], e->code, e->requested, e->result,
+	    e->millis, e->retries);
+    slot = (slot + 1) % XFER_TRACE_SIZE;
+  }
+}
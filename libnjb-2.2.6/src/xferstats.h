@@ -0,0 +1,40 @@
+#ifndef __NJB__XFERSTATS__H
+#define __NJB__XFERSTATS__H
+
+#include <stdio.h>
+#include "libnjb.h"
+
+/* Number of transfers kept in the trace ring */
+#define XFER_TRACE_SIZE 256
+
+typedef struct {
+  u_int32_t when; /* When the transfer started, in ms */
+  u_int32_t millis; /* How long it took */
+  u_int32_t requested; /* Number of bytes asked for */
+  int32_t result; /* Bytes transferred, or -1 on failure */
+  u_int16_t code; /* Control request, or command code of a bulk write */
+  u_int8_t type; /* NJB_XFER_BULK_IN, NJB_XFER_BULK_OUT or NJB_XFER_CONTROL */
+  u_int8_t retries; /* Attempts that failed before this one */
+} xfer_trace_entry_t;
+
+typedef struct {
+  njb_xfer_stats_t stats; /* The counters handed out to the application */
+  u_int32_t trace_every; /* Trace one in this many transfers, 0 = off */
+  u_int32_t trace_skip; /* Transfers left to skip until the next sample */
+  u_int32_t trace_next; /* The slot to write the next entry to */
+  u_int32_t trace_used; /* The number of slots in use */
+  xfer_trace_entry_t trace[XFER_TRACE_SIZE];
+} njb_xferstats_t;
+
+int xferstats_init(njb_t *njb);
+void xferstats_destroy(njb_t *njb);
+void xferstats_record(njb_t *njb, int type, u_int16_t code, u_int32_t requested,
+		      int32_t result, int retries, u_int32_t started,
+		      u_int32_t millis);
+void xferstats_not_ready(njb_t *njb, u_int32_t waited);
+int xferstats_get(njb_t *njb, njb_xfer_stats_t *stats);
+void xferstats_reset(njb_t *njb);
+void xferstats_set_trace(njb_t *njb, u_int32_t every);
+void xferstats_dump(njb_t *njb, FILE *fp);
+
+#endif
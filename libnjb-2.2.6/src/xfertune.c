@@ -0,0 +1,238 @@
+/**
+ * \file xfertune.c
+ *
+ * This file contains the transfer block size tuner for the series 3
+ * devices. The largest block size that a device accepts when files
+ * are sent to it differs between models and firmware revisions.
+ * Instead of a fixed size, the tuner measures the throughput of a few
+ * candidate sizes during the first transfers, backs off from sizes
+ * that cause short writes or stalls, and settles on the fastest
+ * stable one. The result can be kept in a small profile file, so that
+ * the next session can start at the settled size right away.
+ */
+
+#ifndef _MSC_VER
+#include <unistd.h>
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "libnjb.h"
+#include "njb_error.h"
+#include "defs.h"
+#include "base.h"
+#include "xfertune.h"
+
+/** The profile file format identifier */
+#define XFER_PROFILE_MAGIC "NJBXFER"
+/** The number of bytes to measure for each candidate */
+#define XFER_TUNE_PROBE_BYTES 0x100000U
+/** A block taking longer than this (ms) counts as a stall */
+#define XFER_TUNE_STALL_MS 1000U
+/** Stalls tolerated before a candidate is given up */
+#define XFER_TUNE_MAX_STALLS 2
+
+/**
+ * The candidate block sizes, smallest first. The largest is the
+ * size used by turbo mode, which works on most devices.
+ */
+static const u_int32_t candidates[XFER_TUNE_NCANDIDATES] = {
+  0x2000U, 0x4000U, 0x8000U, 0xC000U, 0xE000U
+};
+
+/**
+ * This resets a tuner so that it starts probing at the largest
+ * candidate block size.
+ *
+ * @param t the tuner to reset
+ */
+void xfer_tuner_init(xfer_tuner_t *t)
+{
+  memset(t, 0, sizeof(xfer_tuner_t));
+  t->phase = XFER_TUNE_PROBING;
+  t->current = XFER_TUNE_NCANDIDATES - 1;
+  t->ceiling = XFER_TUNE_NCANDIDATES - 1;
+  t->best = -1;
+}
+
+/**
+ * This returns the block size to use for the next transfer.
+ *
+ * @param t the tuner
+ * @return the block size in bytes
+ */
+u_int32_t xfer_tuner_block_size(xfer_tuner_t *t)
+{
+  return candidates[t->current];
+}
+
+/**
+ * This compares the throughput measured for two candidates.
+ *
+ * @return 1 if candidate a is faster than candidate b, else 0
+ */
+static int faster(xfer_tuner_t *t, int a, int b)
+{
+  /* bytes[a]/millis[a] > bytes[b]/millis[b], without dividing */
+  return (u_int64_t) t->bytes[a] * (u_int64_t) (t->millis[b] + 1) >
+    (u_int64_t) t->bytes[b] * (u_int64_t) (t->millis[a] + 1);
+}
+
+/**
+ * This reports the outcome of one block transfer to the tuner,
+ * which may then change the block size returned by
+ * <code>xfer_tuner_block_size()</code>.
+ *
+ * @param t the tuner
+ * @param requested the number of bytes that was sent
+ * @param written the number of bytes that the device accepted
+ * @param millis the time the transfer took in milliseconds
+ * @return 1 if the tuner has reached a new stable setting that
+ *         should be saved, else 0
+ */
+int xfer_tuner_report(xfer_tuner_t *t, u_int32_t requested, u_int32_t written,
+		      u_int32_t millis)
+{
+  int c = t->current;
+
+  /* The tail of a file is shorter than the block size and tells nothing */
+  if (requested != candidates[c]) {
+    return 0;
+  }
+
+  if (written < requested || millis > XFER_TUNE_STALL_MS) {
+    t->stalls[c]++;
+    if (t->stalls[c] < XFER_TUNE_MAX_STALLS || c == 0) {
+      return 0;
+    }
+    /* Back off: this size and everything above it is unstable */
+    t->ceiling = c - 1;
+    t->current = c - 1;
+    if (t->best > t->ceiling) {
+      t->best = -1;
+    }
+    /* A settled size that breaks down is replaced by the next one down */
+    return (t->phase == XFER_TUNE_SETTLED) ? 1 : 0;
+  }
+
+  t->bytes[c] += written;
+  t->millis[c] += millis;
+
+  if (t->phase == XFER_TUNE_SETTLED || t->bytes[c] < XFER_TUNE_PROBE_BYTES) {
+    return 0;
+  }
+
+  /*
+   * The candidates are probed from the top down, so that transfers
+   * start out at the size that is most likely to be the best one.
+   */
+  if (t->best == -1 || faster(t, c, t->best)) {
+    t->best = c;
+  }
+  if (c > 0) {
+    t->current = c - 1;
+    return 0;
+  }
+  t->current = t->best;
+  t->phase = XFER_TUNE_SETTLED;
+  return 1;
+}
+
+/**
+ * This loads a settled block size from a profile file.
+ *
+ * @param t the tuner to load into
+ * @param path the profile file
+ * @return 0 on success, -1 if there is no usable profile
+ */
+int xfer_tuner_load(xfer_tuner_t *t, const char *path)
+{
+  __dsub= "xfer_tuner_load";
+  FILE *fp;
+  char magic[16];
+  int version;
+  unsigned long blocksize;
+  int i;
+
+  __enter;
+
+  fp = fopen(path, "r");
+  if (fp == NULL) {
+    __leave;
+    return -1;
+  }
+  if (fscanf(fp, "%15s %d %lx", magic, &version, &blocksize) != 3 ||
+      strcmp(magic, XFER_PROFILE_MAGIC) || version != 1) {
+    fclose(fp);
+    __leave;
+    return -1;
+  }
+  fclose(fp);
+
+  for (i = 0; i < XFER_TUNE_NCANDIDATES; i++) {
+    if (candidates[i] == blocksize) {
+      xfer_tuner_init(t);
+      t->phase = XFER_TUNE_SETTLED;
+      t->current = i;
+      t->best = i;
+      t->ceiling = i;
+      __leave;
+      return 0;
+    }
+  }
+
+  __leave;
+  return -1;
+}
+
+/**
+ * This saves the current block size of a tuner to a profile file.
+ * The file is written under a temporary name and then renamed, so
+ * that a concurrent reader never sees half a profile.
+ *
+ * @param t the tuner to save
+ * @param path the profile file
+ * @return 0 on success, -1 on failure
+ */
+int xfer_tuner_save(xfer_tuner_t *t, const char *path)
+{
+  __dsub= "xfer_tuner_save";
+  char *tmppath;
+  FILE *fp;
+  int result = 0;
+
+  __enter;
+
+  tmppath = (char *) malloc(strlen(path) + 5);
+  if (tmppath == NULL) {
+    __leave;
+    return -1;
+  }
+  strcpy(tmppath, path);
+  strcat(tmppath, ".tmp");
+
+  fp = fopen(tmppath, "w");
+  if (fp == NULL) {
+    free(tmppath);
+    __leave;
+    return -1;
+  }
+  if (fprintf(fp, "%s 1 %x\n", XFER_PROFILE_MAGIC,
+	      (unsigned int) candidates[t->current]) < 0) {
+    result = -1;
+  }
+  if (fclose(fp) != 0) {
+    result = -1;
+  }
+  if (result == 0 && rename(tmppath, path) != 0) {
+    result = -1;
+  }
+  if (result == -1) {
+    unlink(tmppath);
+  }
+  free(tmppath);
+
+  __leave;
+  return result;
+}
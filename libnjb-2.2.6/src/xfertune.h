@@ -0,0 +1,29 @@
+#ifndef __NJB__XFERTUNE__H
+#define __NJB__XFERTUNE__H
+
+/* Number of candidate block sizes known to the tuner */
+#define XFER_TUNE_NCANDIDATES 5
+
+/* Tuner phases */
+#define XFER_TUNE_PROBING 0
+#define XFER_TUNE_SETTLED 1
+
+typedef struct {
+  int phase; /* XFER_TUNE_PROBING or XFER_TUNE_SETTLED */
+  int current; /* Index of the candidate in use */
+  int best; /* Index of the fastest candidate measured so far, or -1 */
+  int ceiling; /* Candidates above this index are known to be unstable */
+  int loaded; /* 1 if the profile has been looked for */
+  u_int32_t bytes[XFER_TUNE_NCANDIDATES]; /* Bytes sent with each candidate */
+  u_int32_t millis[XFER_TUNE_NCANDIDATES]; /* Time spent on those bytes */
+  u_int32_t stalls[XFER_TUNE_NCANDIDATES]; /* Short writes and slow blocks */
+} xfer_tuner_t;
+
+void xfer_tuner_init(xfer_tuner_t *t);
+u_int32_t xfer_tuner_block_size(xfer_tuner_t *t);
+int xfer_tuner_report(xfer_tuner_t *t, u_int32_t requested, u_int32_t written,
+		      u_int32_t millis);
+int xfer_tuner_load(xfer_tuner_t *t, const char *path);
+int xfer_tuner_save(xfer_tuner_t *t, const char *path);
+
+#endif
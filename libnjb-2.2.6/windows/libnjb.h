@@ -153,6 +153,27 @@ typedef unsigned __int64 u_int64_t;
  */
 #define NJB_TURBO_OFF   0 /**< turbo mode is off for series 3 devices */
 #define NJB_TURBO_ON    1 /**< turbo mode is on for series 3 devices */
+#define NJB_TURBO_TUNED 2 /**< turbo mode with the send block size tuned to the device */
+
+/**
+ * @defgroup xfertypes Transfer types
+ * @see NJB_Get_Transfer_Stats()
+ * @{
+ */
+#define NJB_XFER_BULK_IN	0 /**< bulk transfers from the device */
+#define NJB_XFER_BULK_OUT	1 /**< bulk transfers to the device */
+#define NJB_XFER_CONTROL	2 /**< control transfers */
+#define NJB_XFER_NTYPES		3 /**< the number of transfer types */
+#define NJB_XFER_NBUCKETS	12 /**< the number of latency histogram buckets */
+/** @} */
+
+/**
+ * @defgroup recflags Session recording flags
+ * @see NJB_Record_Session()
+ * @{
+ */
+#define NJB_REC_HASH_STRINGS	0x01 /**< replace the letters of strings with hashed ones */
+/** @} */
 
 /** The fixed length of the owner string */
 #define OWNER_STRING_LENGTH	128
@@ -166,8 +187,12 @@ typedef unsigned char owner_string[OWNER_STRING_LENGTH + 1];
 typedef struct njb_struct njb_t; /**< @see njb_struct */
 typedef struct njb_songid_frame_struct njb_songid_frame_t; /**< See struct definition */
 typedef struct njb_songid_struct njb_songid_t; /**< See struct definition */
+typedef struct njb_track_table_struct njb_track_table_t; /**< See struct definition */
+typedef struct njb_batch_track_struct njb_batch_track_t; /**< See struct definition */
+typedef struct njb_xfer_stats_struct njb_xfer_stats_t; /**< See struct definition */
 typedef struct njb_playlist_track_struct njb_playlist_track_t; /**< See struct definition */
 typedef struct njb_playlist_struct njb_playlist_t; /**< See struct definition */
+typedef struct njb_playlist_edit_struct njb_playlist_edit_t; /**< See struct definition */
 typedef struct njb_datafile_struct njb_datafile_t; /**< See struct definition */
 typedef struct njb_eax_struct njb_eax_t; /**< See struct definition */
 typedef struct njb_time_struct njb_time_t; /**< See struct definition */
@@ -189,6 +214,8 @@ struct njb_struct {
 	u_int32_t xfersize; /**< The transfer size for endpoints */
 	void *protocol_state; /**< dereferenced and maintained individually by protocol implementations */
 	void *error_stack; /**< Error stack, used inside libnjb */
+	void *xfer_stats; /**< Transfer counters, used inside libnjb */
+	void *usb_session; /**< USB session recording or replay, used inside libnjb */
 };
 
 /* Song/track tag definitions */
@@ -226,6 +253,76 @@ struct njb_songid_struct {
 	njb_songid_t *next; /**< Used internally on series 3 devices for spanning lists of song IDs only */
 };
 
+/**
+ * The track table holds the metadata of all tracks on a device in
+ * one single block of memory, with one array per metadata column,
+ * so that the whole table is freed with one call to
+ * <code>NJB_Track_Table_Destroy()</code>. String columns hold offsets
+ * into the <code>strings</code> pool, where each distinct string is
+ * stored only once; use <code>NJB_Track_Table_String()</code> to get
+ * the string. Missing strings have offset 0, which is the empty
+ * string, and missing numeric metadata is 0.
+ */
+struct njb_track_table_struct {
+	u_int32_t ntracks; /**< The number of tracks in the table */
+	u_int32_t *trid; /**< The track IDs as used on the device */
+	u_int32_t *size; /**< The file sizes in bytes */
+	u_int16_t *length; /**< The lengths in seconds */
+	u_int16_t *year; /**< The years */
+	u_int16_t *tracknum; /**< The track numbers */
+	u_int16_t *protect; /**< Non-zero for copy protected tracks */
+	u_int32_t *title; /**< The titles, as offsets into the string pool */
+	u_int32_t *artist; /**< The artists, as offsets into the string pool */
+	u_int32_t *album; /**< The albums, as offsets into the string pool */
+	u_int32_t *genre; /**< The genres, as offsets into the string pool */
+	u_int32_t *codec; /**< The codecs, as offsets into the string pool */
+	u_int32_t *filename; /**< The file names, as offsets into the string pool */
+	u_int32_t *folder; /**< The folders, as offsets into the string pool */
+	char *strings; /**< The string pool */
+	u_int32_t strings_size; /**< The size of the string pool in bytes */
+};
+
+/**
+ * One track in a batch sent with <code>NJB_Send_Tracks()</code>
+ */
+struct njb_batch_track_struct {
+	const char *path; /**< The file to send */
+	njb_songid_t *songid; /**< The tag of the track */
+	u_int32_t trackid; /**< Set to the new track ID when the track is sent */
+	int sent; /**< Set to 1 when the track has been sent */
+};
+
+/**
+ * The transfer counters of a device, see
+ * <code>NJB_Get_Transfer_Stats()</code>
+ */
+struct njb_xfer_stats_struct {
+	u_int64_t bytes_in; /**< Bytes read from the device in bulk reads */
+	u_int64_t bytes_out; /**< Bytes written to the device in bulk writes */
+	u_int32_t bulk_reads; /**< Number of bulk reads */
+	u_int32_t bulk_writes; /**< Number of bulk writes */
+	u_int32_t control_transfers; /**< Number of control transfers */
+	u_int32_t retries; /**< Bulk transfers repeated after failing */
+	u_int32_t short_reads; /**< Bulk reads returning less than asked for */
+	u_int32_t slow_transfers; /**< Transfers taking more than a second */
+	u_int32_t errors; /**< Transfers that failed for good */
+	u_int32_t not_ready; /**< Times the device was not ready (NJB1) */
+	u_int32_t not_ready_ms; /**< Milliseconds spent waiting for it */
+	/**
+	 * Latency histograms per transfer type: bucket 0 counts
+	 * transfers under 1 ms, bucket n from 2^(n-1) up to 2^n ms,
+	 * and the last bucket all longer ones.
+	 */
+	u_int32_t latency[NJB_XFER_NTYPES][NJB_XFER_NBUCKETS];
+};
+
+/**
+ * Gets a string from a string column of a track table, as in
+ * <code>NJB_Track_Table_String(table, artist, i)</code>.
+ */
+#define NJB_Track_Table_String(table, column, row) \
+	(&(table)->strings[(table)->column[row]])
+
 /* Playlist definitions */
 
 /**
@@ -256,6 +353,27 @@ struct njb_playlist_struct {
 	njb_playlist_track_t *cur; /**< A pointer to the current track in this playlist */
 	njb_playlist_t *nextpl; /**< Used internally for spanning lists of 
 				     playlists on series 3 devices only */
+	njb_playlist_edit_t *_edits; /**< The edits made since the playlist
+					  was last in sync with the device */
+	njb_playlist_edit_t *_lastedit; /**< The last of these edits */
+	int _edits_lost; /**< Set if an edit could not be recorded */
+};
+
+/**
+ * This struct records one edit made to a <code>njb_playlist_t</code>
+ * playlist since it was last read from or written to the device, so
+ * that <code>NJB_Update_Playlist()</code> can send just the changes.
+ */
+struct njb_playlist_edit_struct {
+	int op; /**< The kind of edit */
+#define NJB_PL_EDIT_APPEND	0 /**< A track was added last */
+#define NJB_PL_EDIT_INSERT	1 /**< A track was inserted */
+#define NJB_PL_EDIT_DELETE	2 /**< A track was removed */
+#define NJB_PL_EDIT_MOVE	3 /**< A track was moved */
+#define NJB_PL_EDIT_RENAME	4 /**< The playlist was renamed */
+	u_int32_t from; /**< The index (from 0) of the track concerned */
+	u_int32_t to; /**< The new index of a moved track */
+	njb_playlist_edit_t *next; /**< The next edit */
 };
 
 /**
@@ -429,6 +547,12 @@ extern "C" {
 /** The callback type */
 typedef int NJB_Xfer_Callback(u_int64_t sent, u_int64_t total,
 		const char* buf, unsigned len, void *data);
+/** The callback type for batches, see NJB_Send_Tracks() */
+typedef int NJB_Batch_Callback(u_int32_t track, u_int32_t ntracks,
+		u_int64_t sent, u_int64_t total,
+		u_int64_t batch_sent, u_int64_t batch_total, void *data);
+/** The reader type for streamed uploads, see NJB_Send_Track_Stream() */
+typedef int NJB_Read_Callback(void *buf, u_int32_t len, void *data);
 
 /**
  * @defgroup internals The libnjb configuration API
@@ -467,6 +591,14 @@ const char *NJB_Get_Device_Name(njb_t *njb, int type);
 int NJB_Get_Firmware_Revision(njb_t *njb, u_int8_t *major, u_int8_t *minor, u_int8_t *release);
 int NJB_Get_Hardware_Revision(njb_t *njb, u_int8_t *major, u_int8_t *minor, u_int8_t *release);
 int NJB_Set_Turbo_Mode(njb_t *njb, u_int8_t mode);
+int NJB_Set_Transfer_Profile_Dir(njb_t *njb, const char *dir);
+int NJB_Get_Transfer_Stats(njb_t *njb, njb_xfer_stats_t *stats);
+void NJB_Reset_Transfer_Stats(njb_t *njb);
+void NJB_Set_Transfer_Trace(njb_t *njb, u_int32_t every);
+void NJB_Dump_Transfer_Trace(njb_t *njb, FILE *fp);
+int NJB_Record_Session(njb_t *njb, const char *path, int flags);
+int NJB_Replay_Session(njb_t *njb, const char *path, u_int32_t speedup);
+void NJB_Stop_Session(njb_t *njb);
 /**
  * @}
  * @defgroup tagapi The track and tag (song ID metadata) manipulation API
@@ -501,15 +633,33 @@ njb_songid_frame_t *NJB_Songid_Frame_New_Codec(const char *value);
 #define NJB_Songid_Frame_New_Folder(a) NJB_Songid_Frame_New_String(FR_FOLDER, a)
 void NJB_Songid_Frame_Destroy (njb_songid_frame_t *frame);
 void NJB_Get_Extended_Tags (njb_t *njb, int extended);
+void NJB_Stream_Track_Tags (njb_t *njb, int stream);
+int NJB_Get_Track_Scan_Time (njb_t *njb, u_int32_t *first_ms, u_int32_t *total_ms);
+int NJB_Get_Transfer_Stalls (njb_t *njb, u_int32_t *stalls, u_int32_t *stall_ms);
 void NJB_Reset_Get_Track_Tag (njb_t *njb);
 njb_songid_t *NJB_Get_Track_Tag (njb_t *njb);
+njb_track_table_t *NJB_Get_Track_Table (njb_t *njb);
+njb_track_table_t *NJB_Get_Track_Table_Cached (njb_t *njb, const char *cachedir);
+void NJB_Track_Table_Destroy (njb_track_table_t *table);
 int NJB_Replace_Track_Tag(njb_t *njb, u_int32_t trackid, njb_songid_t *songid);
 int NJB_Get_Track (njb_t *njb, u_int32_t trackid, u_int32_t size,
 	const char *path, NJB_Xfer_Callback *callback, void *data);
 int NJB_Get_Track_fd (njb_t *njb, u_int32_t trackid, u_int32_t size,
 	int fd, NJB_Xfer_Callback *callback, void *data);
+int NJB_Get_Track_Range (njb_t *njb, u_int32_t trackid, u_int32_t size,
+	u_int32_t offset, u_int32_t length, int fd,
+	NJB_Xfer_Callback *callback, void *data);
+int NJB_Get_Track_Resume (njb_t *njb, u_int32_t trackid, u_int32_t size,
+	const char *path, NJB_Xfer_Callback *callback, void *data);
+int NJB_Get_Track_Buffer (njb_t *njb, u_int32_t trackid, u_int32_t size,
+	void *buf, NJB_Xfer_Callback *callback, void *data);
 int NJB_Send_Track (njb_t *njb, const char *path, njb_songid_t *songid,
 	NJB_Xfer_Callback *callback, void *data, u_int32_t *trackid);
+int NJB_Send_Track_Stream (njb_t *njb, NJB_Read_Callback *reader,
+	void *readdata, u_int64_t size, njb_songid_t *songid,
+	NJB_Xfer_Callback *callback, void *data, u_int32_t *trackid);
+int NJB_Send_Tracks (njb_t *njb, njb_batch_track_t *tracks, u_int32_t ntracks,
+	NJB_Batch_Callback *callback, void *data);
 int NJB_Delete_Track (njb_t *njb, u_int32_t trackid);
 /**
  * @}
@@ -531,6 +681,8 @@ njb_playlist_track_t *NJB_Playlist_Gettrack(njb_playlist_t *pl);
 int NJB_Playlist_Set_Name(njb_playlist_t *pl, const char *name);
 void NJB_Playlist_Deltrack(njb_playlist_t *pl, unsigned int pos);
 void NJB_Playlist_Deltrack_TrackID(njb_playlist_t *pl, u_int32_t trackid);
+void NJB_Playlist_Movetrack(njb_playlist_t *pl, unsigned int from,
+	unsigned int to);
 njb_playlist_track_t *NJB_Playlist_Track_New(u_int32_t trackid);
 void NJB_Playlist_Track_Destroy(njb_playlist_track_t *track);
 /**
@@ -543,6 +695,9 @@ njb_datafile_t *NJB_Get_Datafile_Tag (njb_t *njb);
 void NJB_Datafile_Destroy(njb_datafile_t *df);
 #define NJB_Get_File NJB_Get_Track
 #define NJB_Get_File_fd NJB_Get_Track_fd
+#define NJB_Get_File_Range NJB_Get_Track_Range
+#define NJB_Get_File_Resume NJB_Get_Track_Resume
+#define NJB_Get_File_Buffer NJB_Get_Track_Buffer
 int NJB_Send_File (njb_t *njb, const char *path, const char *name, const char *folder,
 	NJB_Xfer_Callback *callback, void *data, u_int32_t *fileid);
 int NJB_Delete_Datafile (njb_t *njb, u_int32_t fileid);
@@ -12,9 +12,9 @@
 #include "usb.h"
 #include "error.h"
 
-char usb_error_str[1024] = "";
-int usb_error_errno = 0;
-usb_error_type_t usb_error_type = USB_ERROR_TYPE_NONE;
+USB_THREAD_LOCAL char usb_error_str[1024] = "";
+USB_THREAD_LOCAL int usb_error_errno = 0;
+USB_THREAD_LOCAL usb_error_type_t usb_error_type = USB_ERROR_TYPE_NONE;
 
 char *usb_strerror(void)
 {
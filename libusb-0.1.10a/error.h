@@ -7,9 +7,19 @@ typedef enum {
   USB_ERROR_TYPE_ERRNO,
 } usb_error_type_t;
 
-extern char usb_error_str[1024];
-extern int usb_error_errno;
-extern usb_error_type_t usb_error_type;
+/*
+ * The last error is kept per thread, so that threads working on
+ * different devices don't overwrite each other's errors.
+ */
+#if defined(__clang__) || (defined(__GNUC__) && !defined(__APPLE__))
+#define USB_THREAD_LOCAL __thread
+#else
+#define USB_THREAD_LOCAL
+#endif
+
+extern USB_THREAD_LOCAL char usb_error_str[1024];
+extern USB_THREAD_LOCAL int usb_error_errno;
+extern USB_THREAD_LOCAL usb_error_type_t usb_error_type;
 
 #define USB_ERROR(x) \
 	do { \
@@ -19,6 +19,7 @@
 #include "usbi.h"
 
 static char usb_path[PATH_MAX + 1] = "";
+static char usb_sysfs_path[PATH_MAX + 1] = "";
 
 static int device_open(struct usb_device *dev)
 {
@@ -167,10 +168,14 @@ static int usb_urb_transfer(usb_dev_handle *dev, int ep, int urbtype,
   int ret, waiting;
 
   /*
+   * Completed URBs are queued per file descriptor, so callers working
+   * on different device handles never see each other's completions
+   * and may run at the same time from different threads.
+   *
    * FIXME: The use of the URB interface is incorrect here if there are
-   * multiple callers at the same time. We assume we're the only caller
-   * and if we get completions from another caller, this code will fail
-   * in interesting ways.
+   * multiple callers on the same handle at the same time. We assume
+   * we're the only caller on this handle and if we get completions from
+   * another caller, this code will fail in interesting ways.
    */
 
   /*
@@ -349,151 +354,332 @@ int usb_os_find_busses(struct usb_bus **busses)
   return 0;
 }
 
-int usb_os_find_devices(struct usb_bus *bus, struct usb_device **devices)
+/*
+ * Reads the descriptors of the device node dirpath/name and adds the
+ * device to the front of the *fdev list. A node that can't be opened
+ * is skipped. Returns 0, or < 0 if we run out of memory.
+ */
+static int device_scan(struct usb_bus *bus, const char *dirpath,
+	const char *name, struct usb_device **fdev)
 {
-  struct usb_device *fdev = NULL;
-  DIR *dir;
-  struct dirent *entry;
-  char dirpath[PATH_MAX + 1];
+  char filename[PATH_MAX + 1];
+  struct usb_device *dev;
+  struct usb_connectinfo connectinfo;
+  int i, fd, ret;
 
-  snprintf(dirpath, PATH_MAX, "%s/%s", usb_path, bus->dirname);
+  dev = malloc(sizeof(*dev));
+  if (!dev)
+    USB_ERROR(-ENOMEM);
 
-  dir = opendir(dirpath);
-  if (!dir)
-    USB_ERROR_STR(-errno, "couldn't opendir(%s): %s", dirpath,
-	strerror(errno));
+  memset((void *)dev, 0, sizeof(*dev));
 
-  while ((entry = readdir(dir)) != NULL) {
-    char filename[PATH_MAX + 1];
-    struct usb_device *dev;
-    struct usb_connectinfo connectinfo;
-    int i, fd, ret;
+  dev->bus = bus;
 
-    /* Skip anything starting with a . */
-    if (entry->d_name[0] == '.')
-      continue;
+  strncpy(dev->filename, name, sizeof(dev->filename) - 1);
+  dev->filename[sizeof(dev->filename) - 1] = 0;
 
-    dev = malloc(sizeof(*dev));
-    if (!dev)
-      USB_ERROR(-ENOMEM);
+  snprintf(filename, sizeof(filename) - 1, "%s/%s", dirpath, name);
+  fd = open(filename, O_RDWR);
+  if (fd < 0) {
+    fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+      if (usb_debug >= 2)
+        fprintf(stderr, "usb_os_find_devices: Couldn't open %s\n",
+                filename);
+
+      free(dev);
+      return 0;
+    }
+  }
 
-    memset((void *)dev, 0, sizeof(*dev));
+  /* Get the device number */
+  ret = ioctl(fd, IOCTL_USB_CONNECTINFO, &connectinfo);
+  if (ret < 0) {
+    if (usb_debug)
+      fprintf(stderr, "usb_os_find_devices: couldn't get connect info\n");
+  } else
+    dev->devnum = connectinfo.devnum;
 
-    dev->bus = bus;
+  ret = read(fd, (void *)&dev->descriptor, sizeof(dev->descriptor));
+  if (ret < 0) {
+    if (usb_debug)
+      fprintf(stderr, "usb_os_find_devices: Couldn't read descriptor\n");
 
-    strncpy(dev->filename, entry->d_name, sizeof(dev->filename) - 1);
-    dev->filename[sizeof(dev->filename) - 1] = 0;
+    free(dev);
 
-    snprintf(filename, sizeof(filename) - 1, "%s/%s", dirpath, entry->d_name);
-    fd = open(filename, O_RDWR);
-    if (fd < 0) {
-      fd = open(filename, O_RDONLY);
-      if (fd < 0) {
-        if (usb_debug >= 2)
-          fprintf(stderr, "usb_os_find_devices: Couldn't open %s\n",
-                  filename);
+    goto err;
+  }
 
-        free(dev);
-        continue;
+  LIST_ADD(*fdev, dev);
+
+  if (usb_debug >= 2)
+    fprintf(stderr, "usb_os_find_devices: Found %s on %s\n",
+	dev->filename, bus->dirname);
+
+  /* Now try to fetch the rest of the descriptors */
+  if (dev->descriptor.bNumConfigurations > USB_MAXCONFIG)
+    /* Silent since we'll try again later */
+    goto err;
+
+  if (dev->descriptor.bNumConfigurations < 1)
+    /* Silent since we'll try again later */
+    goto err;
+
+  dev->config = (struct usb_config_descriptor *)malloc(dev->descriptor.bNumConfigurations * sizeof(struct usb_config_descriptor));
+  if (!dev->config)
+    /* Silent since we'll try again later */
+    goto err;
+
+  memset(dev->config, 0, dev->descriptor.bNumConfigurations *
+        sizeof(struct usb_config_descriptor));
+
+  for (i = 0; i < dev->descriptor.bNumConfigurations; i++) {
+    char buffer[8], *bigbuffer;
+    struct usb_config_descriptor *desc = (struct usb_config_descriptor *)buffer;
+
+    /* Get the first 8 bytes so we can figure out what the total length is */
+    ret = read(fd, (void *)buffer, 8);
+    if (ret < 8) {
+      if (usb_debug >= 1) {
+        if (ret < 0)
+          fprintf(stderr, "Unable to get descriptor (%d)\n", ret);
+        else
+          fprintf(stderr, "Config descriptor too short (expected %d, got %d)\n", 8, ret);
       }
+
+      goto err;
     }
 
-    /* Get the device number */
-    ret = ioctl(fd, IOCTL_USB_CONNECTINFO, &connectinfo);
-    if (ret < 0) {
-      if (usb_debug)
-        fprintf(stderr, "usb_os_find_devices: couldn't get connect info\n");
-    } else
-      dev->devnum = connectinfo.devnum;
+    USB_LE16_TO_CPU(desc->wTotalLength);
 
-    ret = read(fd, (void *)&dev->descriptor, sizeof(dev->descriptor));
-    if (ret < 0) {
-      if (usb_debug)
-        fprintf(stderr, "usb_os_find_devices: Couldn't read descriptor\n");
+    bigbuffer = malloc(desc->wTotalLength);
+    if (!bigbuffer) {
+      if (usb_debug >= 1)
+        fprintf(stderr, "Unable to allocate memory for descriptors\n");
+      goto err;
+    }
 
-      free(dev);
+    /* Copy over the first 8 bytes we read */
+    memcpy(bigbuffer, buffer, 8);
 
+    ret = read(fd, (void *)(bigbuffer + 8), desc->wTotalLength - 8);
+    if (ret < desc->wTotalLength - 8) {
+      if (usb_debug >= 1) {
+        if (ret < 0)
+          fprintf(stderr, "Unable to get descriptor (%d)\n", ret);
+        else
+          fprintf(stderr, "Config descriptor too short (expected %d, got %d)\n", desc->wTotalLength, ret);
+      }
+
+      free(bigbuffer);
       goto err;
     }
 
-    LIST_ADD(fdev, dev);
+    ret = usb_parse_configuration(&dev->config[i], bigbuffer);
+    if (usb_debug >= 2) {
+      if (ret > 0)
+        fprintf(stderr, "Descriptor data still left\n");
+      else if (ret < 0)
+        fprintf(stderr, "Unable to parse descriptors\n");
+    }
 
-    if (usb_debug >= 2)
-      fprintf(stderr, "usb_os_find_devices: Found %s on %s\n",
-		dev->filename, bus->dirname);
+    free(bigbuffer);
+  }
 
-    /* Now try to fetch the rest of the descriptors */
-    if (dev->descriptor.bNumConfigurations > USB_MAXCONFIG)
-      /* Silent since we'll try again later */
-      goto err;
+err:
+  close(fd);
 
-    if (dev->descriptor.bNumConfigurations < 1)
-      /* Silent since we'll try again later */
-      goto err;
+  return 0;
+}
 
-    dev->config = (struct usb_config_descriptor *)malloc(dev->descriptor.bNumConfigurations * sizeof(struct usb_config_descriptor));
-    if (!dev->config)
-      /* Silent since we'll try again later */
-      goto err;
+/*
+ * Reads the bus number, device number and IDs of a device from its
+ * uevent file in sysfs. Returns 0, or -1 if any of them are missing,
+ * which is the case with kernels older than 2.6.22.
+ */
+static int sysfs_read_uevent(const char *path, int *busnum, int *devnum,
+	unsigned int *vendor, unsigned int *product)
+{
+  char buf[1024], *line;
+  unsigned int bcd;
+  int fd, len, have_ids = 0;
+
+  *busnum = *devnum = -1;
+
+  fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return -1;
+
+  len = read(fd, buf, sizeof(buf) - 1);
+  close(fd);
+  if (len <= 0)
+    return -1;
+  buf[len] = 0;
+
+  line = buf;
+  while (line && *line) {
+    if (!strncmp(line, "PRODUCT=", 8))
+      have_ids = (sscanf(line + 8, "%x/%x/%x", vendor, product, &bcd) >= 2);
+    else if (!strncmp(line, "BUSNUM=", 7))
+      *busnum = atoi(line + 7);
+    else if (!strncmp(line, "DEVNUM=", 7))
+      *devnum = atoi(line + 7);
+
+    line = strchr(line, '\n');
+    if (line)
+      line++;
+  }
 
-    memset(dev->config, 0, dev->descriptor.bNumConfigurations *
-          sizeof(struct usb_config_descriptor));
+  if (!have_ids || *busnum < 0 || *devnum < 0)
+    return -1;
 
-    for (i = 0; i < dev->descriptor.bNumConfigurations; i++) {
-      char buffer[8], *bigbuffer;
-      struct usb_config_descriptor *desc = (struct usb_config_descriptor *)buffer;
+  return 0;
+}
 
-      /* Get the first 8 bytes so we can figure out what the total length is */
-      ret = read(fd, (void *)buffer, 8);
-      if (ret < 8) {
-        if (usb_debug >= 1) {
-          if (ret < 0)
-            fprintf(stderr, "Unable to get descriptor (%d)\n", ret);
-          else
-            fprintf(stderr, "Config descriptor too short (expected %d, got %d)\n", 8, ret);
-        }
+/*
+ * Lists the devices on a bus from sysfs, which doesn't involve opening
+ * the devices themselves. Returns 0, or -1 if sysfs can't be used and
+ * the device nodes have to be scanned instead.
+ */
+static int sysfs_scan_bus(int busnum, struct usb_sysfs_device *devs)
+{
+  DIR *dir;
+  struct dirent *entry;
+  char prefix[16], root[16];
+  int found = 0;
 
-        goto err;
-      }
+  if (!usb_sysfs_path[0] || busnum <= 0)
+    return -1;
+
+  dir = opendir(usb_sysfs_path);
+  if (!dir)
+    return -1;
 
-      USB_LE16_TO_CPU(desc->wTotalLength);
+  memset(devs, 0, USB_MAXDEVNUM * sizeof(*devs));
 
-      bigbuffer = malloc(desc->wTotalLength);
-      if (!bigbuffer) {
-        if (usb_debug >= 1)
-          fprintf(stderr, "Unable to allocate memory for descriptors\n");
-        goto err;
-      }
+  /* Devices on bus 1 are named usb1 (the root hub) and 1-port.port... */
+  snprintf(prefix, sizeof(prefix), "%d-", busnum);
+  snprintf(root, sizeof(root), "usb%d", busnum);
 
-      /* Copy over the first 8 bytes we read */
-      memcpy(bigbuffer, buffer, 8);
+  while ((entry = readdir(dir)) != NULL) {
+    char path[PATH_MAX + 1];
+    unsigned int vendor, product;
+    int bnum, dnum;
 
-      ret = read(fd, (void *)(bigbuffer + 8), desc->wTotalLength - 8);
-      if (ret < desc->wTotalLength - 8) {
-        if (usb_debug >= 1) {
-          if (ret < 0)
-            fprintf(stderr, "Unable to get descriptor (%d)\n", ret);
-          else
-            fprintf(stderr, "Config descriptor too short (expected %d, got %d)\n", desc->wTotalLength, ret);
-        }
+    if (strncmp(entry->d_name, prefix, strlen(prefix)) &&
+        strcmp(entry->d_name, root))
+      continue;
 
-        free(bigbuffer);
-        goto err;
-      }
+    /* Interfaces are named like the device, followed by :config.ifnum */
+    if (strchr(entry->d_name, ':'))
+      continue;
+
+    snprintf(path, sizeof(path) - 1, "%s/%s/uevent", usb_sysfs_path,
+	entry->d_name);
+    if (sysfs_read_uevent(path, &bnum, &dnum, &vendor, &product) < 0 ||
+        bnum != busnum || dnum <= 0 || dnum >= USB_MAXDEVNUM) {
+      if (usb_debug >= 2)
+        fprintf(stderr, "usb_os_find_devices: Can't use %s\n", path);
+
+      closedir(dir);
+      return -1;
+    }
+
+    devs[dnum].present = 1;
+    devs[dnum].idVendor = vendor;
+    devs[dnum].idProduct = product;
+    found++;
+  }
+
+  closedir(dir);
+
+  /* There is always a root hub, so no devices means something is wrong */
+  return found ? 0 : -1;
+}
+
+int usb_os_find_devices(struct usb_bus *bus, struct usb_device **devices)
+{
+  struct usb_device *fdev = NULL;
+  struct usb_sysfs_device sysdevs[USB_MAXDEVNUM];
+  DIR *dir;
+  struct dirent *entry;
+  char dirpath[PATH_MAX + 1];
+  int i, ret;
+
+  snprintf(dirpath, PATH_MAX, "%s/%s", usb_path, bus->dirname);
+
+  /*
+   * With sysfs we can tell which devices are there and what they are
+   * without opening them. Devices we already know about are passed
+   * back without reading their descriptors again, and devices the
+   * application isn't interested in aren't opened at all.
+   */
+  if (sysfs_scan_bus(atoi(bus->dirname), sysdevs) == 0) {
+    for (i = 1; i < USB_MAXDEVNUM; i++) {
+      struct usb_device *dev;
+      char name[PATH_MAX + 1];
+
+      if (!sysdevs[i].present)
+        continue;
 
-      ret = usb_parse_configuration(&dev->config[i], bigbuffer);
-      if (usb_debug >= 2) {
-        if (ret > 0)
-          fprintf(stderr, "Descriptor data still left\n");
-        else if (ret < 0)
-          fprintf(stderr, "Unable to parse descriptors\n");
+      snprintf(name, sizeof(name), "%03d", i);
+
+      for (dev = bus->devices; dev; dev = dev->next)
+        if (!strcmp(dev->filename, name) &&
+            dev->descriptor.idVendor == sysdevs[i].idVendor &&
+            dev->descriptor.idProduct == sysdevs[i].idProduct)
+          break;
+
+      if (dev) {
+        /* usb_find_devices() only compares the names, and frees this copy */
+        struct usb_device *copy = malloc(sizeof(*copy));
+
+        if (!copy)
+          USB_ERROR(-ENOMEM);
+
+        memset((void *)copy, 0, sizeof(*copy));
+        copy->bus = bus;
+        strcpy(copy->filename, dev->filename);
+        copy->devnum = dev->devnum;
+        copy->descriptor = dev->descriptor;
+        LIST_ADD(fdev, copy);
+        continue;
       }
 
-      free(bigbuffer);
+      if (usb_find_filter &&
+          !usb_find_filter(sysdevs[i].idVendor, sysdevs[i].idProduct))
+        continue;
+
+      dev = fdev;
+      ret = device_scan(bus, dirpath, name, &fdev);
+      if (ret < 0)
+        return ret;
+
+      /* Fill in the device number if the connect info ioctl failed */
+      if (fdev != dev && !fdev->devnum)
+        fdev->devnum = i;
     }
 
-err:
-    close(fd);
+    *devices = fdev;
+
+    return 0;
+  }
+
+  dir = opendir(dirpath);
+  if (!dir)
+    USB_ERROR_STR(-errno, "couldn't opendir(%s): %s", dirpath,
+	strerror(errno));
+
+  while ((entry = readdir(dir)) != NULL) {
+    /* Skip anything starting with a . */
+    if (entry->d_name[0] == '.')
+      continue;
+
+    ret = device_scan(bus, dirpath, entry->d_name, &fdev);
+    if (ret < 0) {
+      closedir(dir);
+      return ret;
+    }
   }
 
   closedir(dir);
@@ -520,6 +706,10 @@ int usb_os_determine_children(struct usb_bus *bus)
     struct usb_hub_portinfo portinfo;
     int fd;
 
+    /* Only hubs have children, no need to open anything else */
+    if (dev->descriptor.bDeviceClass != USB_CLASS_HUB)
+      continue;
+
     fd = device_open(dev);
     if (fd < 0)
       continue;
@@ -542,6 +732,9 @@ int usb_os_determine_children(struct usb_bus *bus)
       continue;
     }
 
+    if (dev->children)
+      free(dev->children);
+    dev->children = NULL;
     dev->num_children = 0;
     for (i = 0; i < portinfo.numports; i++)
       if (portinfo.port[i])
@@ -632,6 +825,16 @@ void usb_os_init(void)
       usb_path[0] = 0;	/* No path, no USB support */
   }
 
+  /* sysfs lets us list the devices without opening them */
+  if (getenv("USB_SYSFS_PATH")) {
+    strncpy(usb_sysfs_path, getenv("USB_SYSFS_PATH"), sizeof(usb_sysfs_path) - 1);
+    usb_sysfs_path[sizeof(usb_sysfs_path) - 1] = 0;
+  } else if (check_usb_vfs("/sys/bus/usb/devices")) {
+    strncpy(usb_sysfs_path, "/sys/bus/usb/devices", sizeof(usb_sysfs_path) - 1);
+    usb_sysfs_path[sizeof(usb_sysfs_path) - 1] = 0;
+  } else
+    usb_sysfs_path[0] = 0;
+
   if (usb_debug) {
     if (usb_path[0])
       fprintf(stderr, "usb_os_init: Found USB VFS at %s\n", usb_path);
@@ -78,6 +78,16 @@ struct usb_connectinfo {
 	unsigned char slow;
 };
 
+/* Device numbers on a bus are 1 to 127 */
+#define USB_MAXDEVNUM	128
+
+/* What sysfs tells us about a device, see sysfs_scan_bus() */
+struct usb_sysfs_device {
+	int present;
+	u_int16_t idVendor;
+	u_int16_t idProduct;
+};
+
 struct usb_ioctl {
 	int ifno;	/* interface 0..N ; negative numbers reserved */
 	int ioctl_code;	/* MUST encode size + direction of data so the
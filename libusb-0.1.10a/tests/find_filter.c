@@ -0,0 +1,201 @@
+/*
+ * find_filter.c
+ *
+ *  Test suite program for usb_set_find_filter_np() on Linux. It builds
+ *  a fake usbfs and sysfs tree, where the nodes of the devices that
+ *  should never be opened are FIFOs: opening and reading one of those
+ *  blocks, and the alarm below then fails the test.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <usb.h>
+
+#define NJB_VENDOR	0x041e
+#define NJB_PRODUCT	0x4108
+#define OTHER_DEVICES	40
+#define POLLS		1000
+
+static char root[64];
+
+static int njb_filter(u_int16_t idVendor, u_int16_t idProduct)
+{
+  return idVendor == NJB_VENDOR;
+}
+
+static void make_sysfs(const char *name, int devnum, int vendor, int product)
+{
+  char path[256];
+  FILE *fp;
+
+  snprintf(path, sizeof(path), "%s/sys/%s", root, name);
+  mkdir(path, 0755);
+  snprintf(path, sizeof(path), "%s/sys/%s/uevent", root, name);
+  fp = fopen(path, "w");
+  if (!fp) {
+    perror(path);
+    exit(1);
+  }
+  if (devnum > 0)
+    fprintf(fp, "MAJOR=189\nDEVTYPE=usb_device\nPRODUCT=%x/%x/100\n"
+	    "BUSNUM=001\nDEVNUM=%03d\n", vendor, product, devnum);
+  else
+    fprintf(fp, "DEVTYPE=usb_interface\nINTERFACE=255/0/0\n");
+  fclose(fp);
+}
+
+static void remove_sysfs(const char *name)
+{
+  char path[256];
+
+  snprintf(path, sizeof(path), "%s/sys/%s/uevent", root, name);
+  unlink(path);
+  snprintf(path, sizeof(path), "%s/sys/%s", root, name);
+  rmdir(path);
+}
+
+/* A device node with a device descriptor and one config descriptor */
+static void make_node(int devnum, int vendor, int product, int class)
+{
+  unsigned char desc[36] = {
+    18, 1, 0x00, 0x02, 0, 0, 0, 64, 0, 0, 0, 0, 0x00, 0x01, 0, 0, 0, 1,
+    9, 2, 18, 0, 1, 1, 0, 0x80, 50,
+    9, 4, 0, 0, 0, 0xff, 0, 0, 0
+  };
+  char path[256];
+  int fd;
+
+  desc[4] = class;
+  desc[8] = vendor & 0xff;
+  desc[9] = vendor >> 8;
+  desc[10] = product & 0xff;
+  desc[11] = product >> 8;
+
+  snprintf(path, sizeof(path), "%s/usbfs/001/%03d", root, devnum);
+  unlink(path);
+  fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0 || write(fd, desc, sizeof(desc)) != sizeof(desc)) {
+    perror(path);
+    exit(1);
+  }
+  close(fd);
+}
+
+/* A device node that hangs whoever reads it */
+static void make_trap(int devnum)
+{
+  char path[256];
+
+  snprintf(path, sizeof(path), "%s/usbfs/001/%03d", root, devnum);
+  unlink(path);
+  if (mkfifo(path, 0644) < 0) {
+    perror(path);
+    exit(1);
+  }
+}
+
+static struct usb_device *only_device(void)
+{
+  struct usb_bus *bus = usb_get_busses();
+
+  if (!bus || bus->next)
+    return NULL;
+  if (!bus->devices || bus->devices->next)
+    return NULL;
+  return bus->devices;
+}
+
+static int check(int ok, const char *what)
+{
+  printf("%s: %s\n", ok ? "ok" : "FAILED", what);
+  return ok ? 0 : 1;
+}
+
+int main(void)
+{
+  struct usb_device *dev;
+  struct timeval start, end;
+  char path[256], name[32];
+  int i, changes, failed = 0;
+
+  strcpy(root, "/tmp/find_filter.XXXXXX");
+  if (!mkdtemp(root)) {
+    perror("mkdtemp");
+    return 1;
+  }
+  snprintf(path, sizeof(path), "%s/usbfs", root);
+  mkdir(path, 0755);
+  snprintf(path, sizeof(path), "%s/usbfs/001", root);
+  mkdir(path, 0755);
+  snprintf(path, sizeof(path), "%s/sys", root);
+  mkdir(path, 0755);
+
+  /* A root hub, lots of other devices and one jukebox at 1-1, device 2 */
+  make_sysfs("usb1", 1, 0x1d6b, 0x0002);
+  make_trap(1);
+  make_sysfs("1-1", 2, NJB_VENDOR, NJB_PRODUCT);
+  make_sysfs("1-1:1.0", 0, 0, 0);
+  make_node(2, NJB_VENDOR, NJB_PRODUCT, 0);
+  for (i = 0; i < OTHER_DEVICES; i++) {
+    snprintf(name, sizeof(name), "1-2.%d", i + 1);
+    make_sysfs(name, i + 3, 0x046d, 0xc000 + i);
+    make_trap(i + 3);
+  }
+
+  snprintf(path, sizeof(path), "%s/usbfs", root);
+  setenv("USB_DEVFS_PATH", path, 1);
+  snprintf(path, sizeof(path), "%s/sys", root);
+  setenv("USB_SYSFS_PATH", path, 1);
+
+  /* Opening any of the other devices hangs, so fail instead */
+  alarm(10);
+
+  usb_init();
+  usb_set_find_filter_np(njb_filter);
+  usb_find_busses();
+  changes = usb_find_devices();
+  dev = only_device();
+  failed += check(changes == 1 && dev != NULL, "only the jukebox is found");
+  failed += check(dev && dev->descriptor.idProduct == NJB_PRODUCT &&
+		  dev->devnum == 2 && dev->config != NULL &&
+		  dev->config->bNumInterfaces == 1,
+		  "its descriptors are read");
+
+  /* Now the jukebox must not be opened again either */
+  make_trap(2);
+  gettimeofday(&start, NULL);
+  for (i = 0; i < POLLS; i++)
+    changes = usb_find_devices();
+  gettimeofday(&end, NULL);
+  failed += check(changes == 0 && only_device() == dev,
+		  "a known device is kept without opening it");
+  printf("poll with %d other devices: %ld us\n", OTHER_DEVICES + 1,
+	 ((end.tv_sec - start.tv_sec) * 1000000L +
+	  (end.tv_usec - start.tv_usec)) / POLLS);
+
+  /* Unplugged */
+  remove_sysfs("1-1:1.0");
+  remove_sysfs("1-1");
+  changes = usb_find_devices();
+  failed += check(changes == 1 && usb_get_busses()->devices == NULL,
+		  "an unplugged device is removed");
+
+  /* And plugged in again, with a new device number */
+  make_sysfs("1-1", 60, NJB_VENDOR, NJB_PRODUCT);
+  make_node(60, NJB_VENDOR, NJB_PRODUCT, 0);
+  changes = usb_find_devices();
+  dev = only_device();
+  failed += check(changes == 1 && dev && dev->devnum == 60 &&
+		  !strcmp(dev->filename, "060"),
+		  "a plugged in device is found");
+
+  snprintf(path, sizeof(path), "rm -rf %s", root);
+  system(path);
+
+  return failed ? 1 : 0;
+}
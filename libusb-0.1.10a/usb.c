@@ -15,6 +15,7 @@
 
 int usb_debug = 0;
 struct usb_bus *usb_busses = NULL;
+usb_find_filter_np_t usb_find_filter = NULL;
 
 int usb_find_busses(void)
 {
@@ -93,6 +94,7 @@ int usb_find_devices(void)
 
   for (bus = usb_busses; bus; bus = bus->next) {
     struct usb_device *devices, *dev;
+    int bus_changes = changes;
 
     /* Find all of the devices and put them into a temporary list */
     ret = usb_os_find_devices(bus, &devices);
@@ -150,6 +152,14 @@ int usb_find_devices(void)
        */
       LIST_DEL(devices, dev);
 
+      /* Drop the devices the application isn't interested in */
+      if (usb_find_filter &&
+          !usb_find_filter(dev->descriptor.idVendor, dev->descriptor.idProduct)) {
+        usb_free_dev(dev);
+        dev = tdev;
+        continue;
+      }
+
       LIST_ADD(bus->devices, dev);
 
       /*
@@ -172,12 +182,19 @@ int usb_find_devices(void)
       dev = tdev;
     }
 
-    usb_os_determine_children(bus);
+    /* The children found last time are still right if nothing changed */
+    if (changes != bus_changes)
+      usb_os_determine_children(bus);
   }
 
   return changes;
 }
 
+void usb_set_find_filter_np(usb_find_filter_np_t filter)
+{
+  usb_find_filter = filter;
+}
+
 void usb_set_debug(int level)
 {
   if (usb_debug || level)
@@ -291,6 +308,8 @@ struct usb_device *usb_device(usb_dev_handle *dev)
 void usb_free_dev(struct usb_device *dev)
 {
   usb_destroy_configuration(dev);
+  if (dev->children)
+    free(dev->children);
   free(dev);
 }
 
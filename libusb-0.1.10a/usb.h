@@ -327,6 +327,17 @@ void usb_init(void);
 void usb_set_debug(int level);
 int usb_find_busses(void);
 int usb_find_devices(void);
+
+/*
+ * Non-portable: only devices the filter returns non-zero for are
+ * listed by usb_find_devices(). On Linux, devices that don't match
+ * are not even opened when sysfs is available. The filter applies to
+ * every caller of usb_find_devices() in the process, so it should
+ * only be set by the application itself, not by a library.
+ */
+#define LIBUSB_HAS_FIND_FILTER_NP 1
+typedef int (*usb_find_filter_np_t)(u_int16_t idVendor, u_int16_t idProduct);
+void usb_set_find_filter_np(usb_find_filter_np_t filter);
 struct usb_device *usb_device(usb_dev_handle *dev);
 struct usb_bus *usb_get_busses(void);
 
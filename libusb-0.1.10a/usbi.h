@@ -6,6 +6,7 @@
 #include "error.h"
 
 extern int usb_debug;
+extern usb_find_filter_np_t usb_find_filter;
 
 /* Some quick and generic macros for the simple kind of lists we use */
 #define LIST_ADD(begin, ent) \
@@ -24,11 +24,7 @@
 #include <tstring.h>
 #include <fileref.h>
 #include <tag.h>
-#include <mpegfile.h>
-#include <id3v2tag.h>
-//#include <id3v2frame.h>
-//#include <id3v2header.h>
-#include <attachedpictureframe.h>
+#include <trackinfo.h>
 
 using namespace std;
 using namespace TagLib;
@@ -105,41 +101,29 @@ using namespace TagLib;
 	
   if ([track fileType] == LIBMTP_FILETYPE_MP3)
 	{
+    // one open and one parse gives the tags, the picture and the length
     TagLib::FileRef file([filename UTF8String]);
-    if (!file.isNull() && file.tag())
+    TrackInfo info(file.file());
+    if (!info.isNull())
     {
-      TagLib::Tag *tag = file.tag();
-      
       // todo: check unicode formatting
-      [track setTitle:[self trimTagString:[NSString stringWithUTF8String:tag->title().toCString(true)]]];
-      [track setArtist:[self trimTagString:[NSString stringWithUTF8String:tag->artist().toCString(true)]]];
-      [track setAlbum:[self trimTagString:[NSString stringWithUTF8String:tag->album().toCString(true)]]];
-      [track setGenre:[self trimTagString:[NSString stringWithUTF8String:tag->genre().toCString(true)]]];
-      [track setTrackNumber:tag->track()];
-      [track setYear:tag->year()];
-      
-      TagLib::AudioProperties *properties = file.audioProperties();
-      
-      [track setLength:properties->length()];
-      
-      // now do image - have to assume is MPEG here
-      MPEG::File mpegFile([filename UTF8String]);
-      
-      ID3v2::Tag *id3v2Tag = mpegFile.ID3v2Tag(false);
+      [track setTitle:[self trimTagString:[NSString stringWithUTF8String:info.title().toCString(true)]]];
+      [track setArtist:[self trimTagString:[NSString stringWithUTF8String:info.artist().toCString(true)]]];
+      [track setAlbum:[self trimTagString:[NSString stringWithUTF8String:info.album().toCString(true)]]];
+      [track setGenre:[self trimTagString:[NSString stringWithUTF8String:info.genre().toCString(true)]]];
+      [track setTrackNumber:info.track()];
+      [track setYear:info.year()];
       
-      if (id3v2Tag)
+      ByteVector picture = info.picture();
+      if (!picture.isEmpty())
       {
-        TagLib::ID3v2::FrameList frameList = id3v2Tag->frameListMap()["APIC"];
-        if (!frameList.isEmpty())
-        {
-          TagLib::ID3v2::AttachedPictureFrame *p = static_cast<TagLib::ID3v2::AttachedPictureFrame *>(frameList.front());
-          
-          NSData *data = [NSData dataWithBytes:p->picture().data() length:p->picture().size()];
-          NSBitmapImageRep *image = [[NSBitmapImageRep alloc] initWithData:data];
-          [track setImage:image];
-          [image release];
-        }
+        NSData *data = [NSData dataWithBytes:picture.data() length:picture.size()];
+        NSBitmapImageRep *image = [[NSBitmapImageRep alloc] initWithData:data];
+        [track setImage:image];
+        [image release];
       }
+      
+      [track setLength:info.length()];
     }
 	}
 	else if ([track fileType] == LIBMTP_FILETYPE_WAV)
@@ -147,6 +131,8 @@ using namespace TagLib;
 		// use filename as title, but strip extension
 		NSString *title = [[filename lastPathComponent] stringByDeletingPathExtension];
 		[track setTitle:title];
+		// TagLib doesn't work out the length of WAV files, and would round
+		// it down; the header is enough for a length rounded up
 		[track setLength:[self wavFileLength:filename]];
 	}
 	
@@ -178,61 +164,20 @@ using namespace TagLib;
 	
 	[tag release];	*/
   
-  TagLib::FileRef file([[track fullPath] UTF8String]);
-  if (!file.isNull() && file.tag())
+  // TrackInfo keeps the total number of tracks and the other fields it
+  // read, and saves the file once, only if something changed
+  TagLib::FileRef file([[track fullPath] UTF8String], false);
+  TrackInfo info(file.file());
+  if (!info.isNull())
   {
-    TagLib::Tag *tag = file.tag();
-   
-    String strTitle = String([[track title] UTF8String], String::UTF8);
-    tag->setTitle(strTitle);
-    String strArtist = String([[track artist] UTF8String], String::UTF8);
-    tag->setArtist(strArtist);
-    String strAlbum = String([[track album] UTF8String], String::UTF8);
-    tag->setAlbum(strAlbum);
-    String strGenre = String([[track genre] UTF8String], String::UTF8);
-    tag->setGenre(strGenre);
-
-    tag->setYear([track year]);
+    info.setTitle(String([[track title] UTF8String], String::UTF8));
+    info.setArtist(String([[track artist] UTF8String], String::UTF8));
+    info.setAlbum(String([[track album] UTF8String], String::UTF8));
+    info.setGenre(String([[track genre] UTF8String], String::UTF8));
+    info.setYear([track year]);
+    info.setTrack([track trackNumber]);
     
-    file.save();
-    
-    // now for track - need to preserve total number of tracks
-    MPEG::File mpegFile([[track fullPath] UTF8String]);
-      
-    ID3v2::Tag *id3v2Tag = mpegFile.ID3v2Tag(false);
-      
-    if (id3v2Tag)
-    {
-      TagLib::ID3v2::FrameList frameList = id3v2Tag->frameListMap()["TRCK"];
-      if (!frameList.isEmpty())
-      {
-        TagLib::ID3v2::Frame *frame = static_cast<TagLib::ID3v2::Frame *>(frameList.front());
-        
-        NSString *trackString = [NSString stringWithUTF8String:frame->toString().toCString()];
-        NSArray *components = [trackString componentsSeparatedByString:@"/"];
-        if ([components count] == 2)
-        {
-          NSString *total = [components objectAtIndex:1];
-          trackString = [NSString stringWithFormat:@"%u/%@", [track trackNumber], total];
-          
-          frame->setText([trackString UTF8String]);
-        }
-        else
-        {
-          id3v2Tag->setTrack([track trackNumber]);
-        }
-      }
-      else
-      {
-        id3v2Tag->setTrack([track trackNumber]);
-      }
-      mpegFile.save();
-    }
-    else
-    {
-      tag->setTrack([track trackNumber]);
-      file.save();
-    }
+    info.save(file.file());
   }
 }
 
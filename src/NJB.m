@@ -48,6 +48,7 @@ StatusDisplayer *statusDisplayerGlobal;
 - (NSString *)njbErrorString;
 - (NSString *)rateString:(double) rate;
 - (NSString *)uniqueFilename:(NSString *)path;
+- (NSString *)snapshotDirectory;
 - (LIBMTP_track_t *)libmtpTrack_tFromTrack:(Track *)track;
 - (void)libmtpFolder_tToDir:(LIBMTP_folder_t *)folders withDir:(Directory *)baseDir;
 // we make this private so that the user never changes the setting directly
@@ -482,112 +483,44 @@ io_iterator_t deviceAddedIter;
 	cachedTrackList = [[NSMutableArray alloc] init];
 	if (!mtpDevice)
 	{
-		NJB_Reset_Get_Track_Tag(njb);	
-		njb_songid_t *songtag;
-		njb_songid_frame_t *frame;
-		while ((songtag = NJB_Get_Track_Tag(njb))) {
+		// reuses the track list from the last connection if the device has not changed
+		njb_track_table_t *table = NJB_Get_Track_Table_Cached(njb, [[self snapshotDirectory] fileSystemRepresentation]);
+		unsigned i;
+		for (i = 0; table != NULL && i < table->ntracks; i++) {
 			Track *track = [[Track alloc] init];
 			
-			frame = NJB_Songid_Findframe(songtag, FR_TITLE);
-			if (frame != NULL && frame->data.strval != NULL)
-				[track setTitle:[NSString stringWithUTF8String:frame->data.strval]];
-			
-			frame = NJB_Songid_Findframe(songtag, FR_ALBUM);
-			if (frame != NULL && frame->data.strval != NULL)
-				[track setAlbum:[NSString stringWithUTF8String:frame->data.strval]];
-			
-			frame = NJB_Songid_Findframe(songtag, FR_ARTIST);
-			if (frame != NULL && frame->data.strval != NULL)
-				[track setArtist:[NSString stringWithUTF8String:frame->data.strval]];
-			
-			frame = NJB_Songid_Findframe(songtag, FR_GENRE);
-			if (frame != NULL && frame->data.strval != NULL)
-				[track setGenre:[NSString stringWithUTF8String:frame->data.strval]];
-			
+			[track setTitle:[NSString stringWithUTF8String:NJB_Track_Table_String(table, title, i)]];
+			[track setAlbum:[NSString stringWithUTF8String:NJB_Track_Table_String(table, album, i)]];
+			[track setArtist:[NSString stringWithUTF8String:NJB_Track_Table_String(table, artist, i)]];
+			[track setGenre:[NSString stringWithUTF8String:NJB_Track_Table_String(table, genre, i)]];
 			// this is not used: we don't get extended track info from njb3
 			// njb1 gets it but ignored
-			frame = NJB_Songid_Findframe(songtag, FR_FNAME);
-			if (frame != NULL && frame->data.strval != NULL)
-				[track setFilename:[NSString stringWithUTF8String:frame->data.strval]];
-			
-			frame = NJB_Songid_Findframe(songtag, FR_SIZE);
-			if (frame != NULL)
-			{
-				if (frame->type == NJB_TYPE_UINT16)
-					[track setFilesize:frame->data.u_int16_val];
-				else
-					[track setFilesize:frame->data.u_int32_val];
-			}
-			frame = NJB_Songid_Findframe(songtag, FR_LENGTH);
-			if (frame != NULL)
-			{
-				if (frame->type == NJB_TYPE_UINT16)
-					[track setLength:frame->data.u_int16_val];
-				else
-					[track setLength:frame->data.u_int32_val];
-			}
-			frame = NJB_Songid_Findframe(songtag, FR_TRACK);
-			if (frame != NULL)
-			{
-				if (frame->type == NJB_TYPE_UINT16)
-					[track setTrackNumber:frame->data.u_int16_val];
-				else if (frame->type == NJB_TYPE_UINT32)
-					[track setTrackNumber:frame->data.u_int32_val];
-				// in case it's a string
-				else if (frame->type == NJB_TYPE_STRING && frame->data.strval != NULL)
-				{
-					NSString *trackNumber = [NSString stringWithUTF8String:frame->data.strval];
-					[track setTrackNumber:(unsigned)[trackNumber intValue]];
-				}
-				else
-					NSLog(@"type not expected for FR_TRACK field %d", frame->type);
-			}
-			frame = NJB_Songid_Findframe(songtag, FR_CODEC);
-			if (frame != NULL)
-			{
-				if (frame->data.strval == NULL)
-					[track setFileType:LIBMTP_FILETYPE_UNDEF_AUDIO];
-				else
-				{
-					if (strcmp(frame->data.strval, NJB_CODEC_MP3) == 0)
-						[track setFileType:LIBMTP_FILETYPE_MP3];
-					else if (strcmp(frame->data.strval, NJB_CODEC_WMA) == 0)
-						[track setFileType:LIBMTP_FILETYPE_WMA];
-					else if (strcmp(frame->data.strval, NJB_CODEC_WAV) == 0)
-						[track setFileType:LIBMTP_FILETYPE_WAV];
-					else if (strcmp(frame->data.strval, NJB_CODEC_AA) == 0)
-						[track setFileType:LIBMTP_FILETYPE_AUDIBLE];
-					else
-						[track setFileType:LIBMTP_FILETYPE_UNDEF_AUDIO];
-				}
-			}
+			if (table->filename[i] != 0)
+				[track setFilename:[NSString stringWithUTF8String:NJB_Track_Table_String(table, filename, i)]];
+			[track setFilesize:table->size[i]];
+			[track setLength:table->length[i]];
+			[track setTrackNumber:table->tracknum[i]];
 			
-			[track setItemID:songtag->trid];
-
-			frame = NJB_Songid_Findframe(songtag, FR_YEAR);
-			if (frame != NULL)
-			{
-				if (frame->type == NJB_TYPE_UINT16)
-					[track setYear:frame->data.u_int16_val];
-				else if (frame->type == NJB_TYPE_UINT32)
-					[track setYear:frame->data.u_int32_val];
-				// strings on NJB1
-				else if (frame->type == NJB_TYPE_STRING && frame->data.strval != NULL)
-				{
-					NSString *year = [NSString stringWithUTF8String:frame->data.strval];
-					[track setYear:(unsigned)[year intValue]];
-				}
-				else
-					NSLog(@"type not expected for FR_YEAR field %d", frame->type);
-			}
+			const char *codec = NJB_Track_Table_String(table, codec, i);
+			if (strcmp(codec, NJB_CODEC_MP3) == 0)
+				[track setFileType:LIBMTP_FILETYPE_MP3];
+			else if (strcmp(codec, NJB_CODEC_WMA) == 0)
+				[track setFileType:LIBMTP_FILETYPE_WMA];
+			else if (strcmp(codec, NJB_CODEC_WAV) == 0)
+				[track setFileType:LIBMTP_FILETYPE_WAV];
+			else if (strcmp(codec, NJB_CODEC_AA) == 0)
+				[track setFileType:LIBMTP_FILETYPE_AUDIBLE];
 			else
-				[track setYear:0];
+				[track setFileType:LIBMTP_FILETYPE_UNDEF_AUDIO];
+			
+			[track setItemID:table->trid[i]];
+			[track setYear:table->year[i]];
 			
 			[cachedTrackList addObject:track];
 			[track release];
-			
-			NJB_Songid_Destroy(songtag);
 		}
+		if (table != NULL)
+			NJB_Track_Table_Destroy(table);
 	}
 	else
 	{		
@@ -982,6 +915,15 @@ io_iterator_t deviceAddedIter;
 																					 resultString:[NSString stringWithFormat:NSLocalizedString(@"Speed %@ Mbps", nil), [self rateString:rate]]] autorelease];
 }
 
+- (NSString *)snapshotDirectory
+{
+	NSArray *paths = NSSearchPathForDirectoriesInDomains(NSCachesDirectory, NSUserDomainMask, YES);
+	NSString *dir = [[paths objectAtIndex:0] stringByAppendingPathComponent:@"XNJB"];
+	// create the directory, will fail if already made, don't worry
+	[[NSFileManager defaultManager] createDirectoryAtPath:dir attributes:nil];
+	return dir;
+}
+
 - (NSString *)uniqueFilename:(NSString *)path
 {
 	struct stat sb;
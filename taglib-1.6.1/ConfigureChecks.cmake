@@ -20,6 +20,19 @@ ELSE(ZLIB_FOUND)
 	SET(HAVE_ZLIB 0)
 ENDIF(ZLIB_FOUND)
 
+FIND_PACKAGE(Threads)
+
+# io_uring with the open, statx and read operations (Linux 5.6) is used by
+# FileScanner when it is there; otherwise it falls back to threads.  The C
+# library has to know struct statx (glibc 2.28) as well as the kernel headers.
+CHECK_CXX_SOURCE_COMPILES("
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+int main() { struct statx stx; stx.stx_size = 0; return IORING_OP_OPENAT + IORING_OP_STATX + IORING_OP_READ + __NR_io_uring_setup + STATX_SIZE + int(stx.stx_size); }
+" HAVE_IO_URING)
+
 SET(CMAKE_MODULE_PATH ${CMAKE_CURRENT_SOURCE_DIR}/cmake/modules)
 FIND_PACKAGE(CppUnit)
 IF (NOT CppUnit_FOUND AND BUILD_TESTS)
@@ -6,6 +6,9 @@
 /* Define if you have libz */
 #cmakedefine   HAVE_ZLIB 1
 
+/* Define if io_uring can be used to prefetch files */
+#cmakedefine   HAVE_IO_URING 1
+
 #cmakedefine   NO_ITUNES_HACKS 1
 #cmakedefine   WITH_ASF 1
 #cmakedefine   WITH_MP4 1
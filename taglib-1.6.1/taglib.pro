@@ -46,6 +46,9 @@ INCLUDEPATH += . \
 HEADERS += config.h \
            taglib/audioproperties.h \
            taglib/fileref.h \
+           taglib/filescanner.h \
+           taglib/audiohash.h \
+           taglib/trackinfo.h \
            taglib/tag.h \
            taglib/taglib_export.h \
            taglib/tagunion.h \
@@ -69,8 +72,14 @@ HEADERS += config.h \
            taglib/toolkit/taglib.h \
            taglib/toolkit/tbytevector.h \
            taglib/toolkit/tbytevectorlist.h \
+           taglib/toolkit/tbytevectorreader.h \
+           taglib/toolkit/tbytevectorwriter.h \
            taglib/toolkit/tdebug.h \
            taglib/toolkit/tfile.h \
+           taglib/toolkit/tfilestream.h \
+           taglib/toolkit/tsplicedstream.h \
+           taglib/toolkit/tstreamhash.h \
+           taglib/toolkit/tiostream.h \
            taglib/toolkit/tlist.h \
            taglib/toolkit/tmap.h \
            taglib/toolkit/tstring.h \
@@ -112,6 +121,9 @@ SOURCES += examples/framelist.cpp \
            examples/tagwriter.cpp \
            taglib/audioproperties.cpp \
            taglib/fileref.cpp \
+           taglib/filescanner.cpp \
+           taglib/audiohash.cpp \
+           taglib/trackinfo.cpp \
            taglib/tag.cpp \
            taglib/tagunion.cpp \
            tests/main.cpp \
@@ -143,8 +155,14 @@ SOURCES += examples/framelist.cpp \
            taglib/ogg/xiphcomment.cpp \
            taglib/toolkit/tbytevector.cpp \
            taglib/toolkit/tbytevectorlist.cpp \
+           taglib/toolkit/tbytevectorreader.cpp \
+           taglib/toolkit/tbytevectorwriter.cpp \
            taglib/toolkit/tdebug.cpp \
            taglib/toolkit/tfile.cpp \
+           taglib/toolkit/tfilestream.cpp \
+           taglib/toolkit/tsplicedstream.cpp \
+           taglib/toolkit/tstreamhash.cpp \
+           taglib/toolkit/tiostream.cpp \
            taglib/toolkit/tstring.cpp \
            taglib/toolkit/tstringlist.cpp \
            taglib/toolkit/unicode.cpp \
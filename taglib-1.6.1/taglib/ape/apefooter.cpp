@@ -28,6 +28,7 @@
 #include <bitset>
 
 #include <tstring.h>
+#include <tbytevectorreader.h>
 #include <tdebug.h>
 
 #include "apefooter.h"
@@ -175,21 +176,23 @@ void Footer::parse(const ByteVector &data)
 
   // The first eight bytes, data[0..7], are the File Identifier, "APETAGEX".
 
+  ByteVectorReader reader(data, 8);
+
   // Read the version number
 
-  d->version = data.mid(8, 4).toUInt(false);
+  d->version = reader.readUInt32(false);
 
   // Read the tag size
 
-  d->tagSize = data.mid(12, 4).toUInt(false);
+  d->tagSize = reader.readUInt32(false);
 
   // Read the item count
 
-  d->itemCount = data.mid(16, 4).toUInt(false);
+  d->itemCount = reader.readUInt32(false);
 
   // Read the flags
 
-  std::bitset<32> flags(data.mid(20, 4).toUInt(false));
+  std::bitset<32> flags(reader.readUInt32(false));
 
   d->headerPresent = flags[31];
   d->footerPresent = !flags[30];
@@ -24,6 +24,8 @@
  ***************************************************************************/
 
 #include <tbytevectorlist.h>
+#include <tbytevectorreader.h>
+#include <tbytevectorwriter.h>
 #include <tdebug.h>
 
 #include "apeitem.h"
@@ -183,8 +185,9 @@ void APE::Item::parse(const ByteVector &data)
     return;
   }
 
-  uint valueLength  = data.mid(0, 4).toUInt(false);
-  uint flags        = data.mid(4, 4).toUInt(false);
+  ByteVectorReader reader(data);
+  uint valueLength  = reader.readUInt32(false);
+  uint flags        = reader.readUInt32(false);
 
   d->key = String(data.mid(8), String::UTF8);
 
@@ -199,32 +202,26 @@ void APE::Item::parse(const ByteVector &data)
 
 ByteVector APE::Item::render() const
 {
-  ByteVector data;
   TagLib::uint flags = ((d->readOnly) ? 1 : 0) | (d->type << 1);
-  ByteVector value;
 
   if(isEmpty())
-    return data;
+    return ByteVector();
 
   if(d->type == Text) {
-    StringList::ConstIterator it = d->text.begin();
-
-    value.append(it->data(String::UTF8));
-    it++;
-    for(; it != d->text.end(); ++it) {
-      value.append('\0');
-      value.append(it->data(String::UTF8));
-    }
-    d->value = value;
+    ByteVectorList values;
+    for(StringList::ConstIterator it = d->text.begin(); it != d->text.end(); ++it)
+      values.append(it->data(String::UTF8));
+    d->value = values.toByteVector('\0');
   }
-  else
-    value.append(d->value);
 
-  data.append(ByteVector::fromUInt(value.size(), false));
-  data.append(ByteVector::fromUInt(flags, false));
-  data.append(d->key.data(String::UTF8));
-  data.append(ByteVector('\0'));
-  data.append(value);
+  const ByteVector key = d->key.data(String::UTF8);
+
+  ByteVectorWriter writer(8 + key.size() + 1 + d->value.size());
+  writer.writeUInt32(d->value.size(), false);
+  writer.writeUInt32(flags, false);
+  writer.writeBlock(key);
+  writer.writeByte(0);
+  writer.writeBlock(d->value);
 
-  return data;
+  return writer.data();
 }
@@ -34,6 +34,8 @@
 #include <tfile.h>
 #include <tstring.h>
 #include <tmap.h>
+#include <tbytevectorlist.h>
+#include <tbytevectorwriter.h>
 
 #include "apetag.h"
 #include "apefooter.h"
@@ -187,17 +189,33 @@ const APE::ItemListMap& APE::Tag::itemListMap() const
 void APE::Tag::removeItem(const String &key)
 {
   Map<const String, Item>::Iterator it = d->itemListMap.find(key.upper());
-  if(it != d->itemListMap.end())
+  if(it != d->itemListMap.end()) {
     d->itemListMap.erase(it);
+    setModified();
+  }
 }
 
 void APE::Tag::addValue(const String &key, const String &value, bool replace)
 {
+  if(replace && !value.isEmpty()) {
+
+    // Leave the tag alone if the item already holds just this value.
+
+    Map<const String, Item>::ConstIterator it = d->itemListMap.find(key.upper());
+    if(it != d->itemListMap.end() && it->second.type() == Item::Text &&
+       it->second.values() == StringList(value))
+    {
+      return;
+    }
+  }
+
   if(replace)
     removeItem(key);
   if(!value.isEmpty()) {
-    if(d->itemListMap.contains(key) || !replace)
+    if(d->itemListMap.contains(key) || !replace) {
       d->itemListMap[key.upper()].appendValue(value);
+      setModified();
+    }
     else
       setItem(key, Item(key, value));
   }
@@ -206,6 +224,7 @@ void APE::Tag::addValue(const String &key, const String &value, bool replace)
 void APE::Tag::setItem(const String &key, const Item &item)
 {
   d->itemListMap.insert(key.upper(), item);
+  setModified();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -226,27 +245,38 @@ void APE::Tag::read()
     d->file->seek(d->footerLocation + Footer::size() - d->footer.tagSize());
     parse(d->file->readBlock(d->footer.tagSize() - Footer::size()));
   }
+
+  setModified(false);
 }
 
 ByteVector APE::Tag::render() const
 {
-  ByteVector data;
-  uint itemCount = 0;
+  // The items are rendered first so that the tag can be put together in a
+  // single buffer.
+
+  ByteVectorList items;
+  uint itemsSize = 0;
 
   {
     for(Map<const String, Item>::ConstIterator it = d->itemListMap.begin();
         it != d->itemListMap.end(); ++it)
     {
-      data.append(it->second.render());
-      itemCount++;
+      items.append(it->second.render());
+      itemsSize += items.back().size();
     }
   }
 
-  d->footer.setItemCount(itemCount);
-  d->footer.setTagSize(data.size() + Footer::size());
+  d->footer.setItemCount(items.size());
+  d->footer.setTagSize(itemsSize + Footer::size());
   d->footer.setHeaderPresent(true);
 
-  return d->footer.renderHeader() + data + d->footer.renderFooter();
+  ByteVectorWriter writer(Footer::size() + itemsSize + Footer::size());
+  writer.writeBlock(d->footer.renderHeader());
+  for(ByteVectorList::ConstIterator it = items.begin(); it != items.end(); ++it)
+    writer.writeBlock(*it);
+  writer.writeBlock(d->footer.renderFooter());
+
+  return writer.data();
 }
 
 void APE::Tag::parse(const ByteVector &data)
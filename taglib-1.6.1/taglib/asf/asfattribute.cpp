@@ -30,6 +30,8 @@
 #ifdef WITH_ASF
 
 #include <taglib.h>
+#include <tbytevectorreader.h>
+#include <tbytevectorwriter.h>
 #include "asfattribute.h"
 #include "asffile.h"
 
@@ -171,61 +173,61 @@ ASF::Attribute::toULongLong() const
 }
 
 String
-ASF::Attribute::parse(ASF::File &f, int kind)
+ASF::Attribute::parse(ByteVectorReader &reader, int kind)
 {
   int size, nameLength;
   String name;
 
   // extended content descriptor
   if(kind == 0) {
-    nameLength = f.readWORD();
-    name = f.readString(nameLength);
-    d->type = ASF::Attribute::AttributeTypes(f.readWORD());
-    size = f.readWORD();
+    nameLength = reader.readUInt16(false);
+    name = File::readString(reader, nameLength);
+    d->type = ASF::Attribute::AttributeTypes(reader.readUInt16(false));
+    size = reader.readUInt16(false);
   }
   // metadata & metadata library
   else {
-    int temp = f.readWORD();
+    int temp = reader.readUInt16(false);
     // metadata library
     if(kind == 2) {
       d->language = temp;
     }
-    d->stream = f.readWORD();
-    nameLength = f.readWORD();
-    d->type = ASF::Attribute::AttributeTypes(f.readWORD());
-    size = f.readDWORD();
-    name = f.readString(nameLength);
+    d->stream = reader.readUInt16(false);
+    nameLength = reader.readUInt16(false);
+    d->type = ASF::Attribute::AttributeTypes(reader.readUInt16(false));
+    size = reader.readUInt32(false);
+    name = File::readString(reader, nameLength);
   }
 
   switch(d->type) {
   case WordType:
-    d->shortValue = f.readWORD();
+    d->shortValue = reader.readUInt16(false);
     break;
 
   case BoolType:
     if(kind == 0) {
-      d->boolValue = f.readDWORD() == 1;
+      d->boolValue = reader.readUInt32(false) == 1;
     }
     else {
-      d->boolValue = f.readWORD() == 1;
+      d->boolValue = reader.readUInt16(false) == 1;
     }
     break;
 
   case DWordType:
-    d->intValue = f.readDWORD();
+    d->intValue = reader.readUInt32(false);
     break;
 
   case QWordType:
-    d->longLongValue = f.readQWORD();
+    d->longLongValue = reader.readUInt64(false);
     break;
 
   case UnicodeType:
-    d->stringValue = f.readString(size);
+    d->stringValue = File::readString(reader, size);
     break;
 
   case BytesType:
   case GuidType:
-    d->byteVectorValue = f.readBlock(size);
+    d->byteVectorValue = reader.readBlock(size);
     break;
   }
 
@@ -239,54 +241,58 @@ ASF::Attribute::render(const String &name, int kind) const
 
   switch (d->type) {
   case WordType:
-    data.append(ByteVector::fromShort(d->shortValue, false));
+    data = ByteVector::fromShort(d->shortValue, false);
     break;
 
   case BoolType:
     if(kind == 0) {
-      data.append(ByteVector::fromUInt(d->boolValue ? 1 : 0, false));
+      data = ByteVector::fromUInt(d->boolValue ? 1 : 0, false);
     }
     else {
-      data.append(ByteVector::fromShort(d->boolValue ? 1 : 0, false));
+      data = ByteVector::fromShort(d->boolValue ? 1 : 0, false);
     }
     break;
 
   case DWordType:
-    data.append(ByteVector::fromUInt(d->intValue, false));
+    data = ByteVector::fromUInt(d->intValue, false);
     break;
 
   case QWordType:
-    data.append(ByteVector::fromLongLong(d->longLongValue, false));
+    data = ByteVector::fromLongLong(d->longLongValue, false);
     break;
 
   case UnicodeType:
-    data.append(File::renderString(d->stringValue));
+    data = File::renderString(d->stringValue);
     break;
 
   case BytesType:
   case GuidType:
-    data.append(d->byteVectorValue);
+    data = d->byteVectorValue;
     break;
   }
 
+  ByteVector nameData = File::renderString(name);
+
   if(kind == 0) {
-    data = File::renderString(name, true) +
-           ByteVector::fromShort((int)d->type, false) +
-           ByteVector::fromShort(data.size(), false) +
-           data;
+    ByteVectorWriter writer(2 + nameData.size() + 4 + data.size());
+    writer.writeUInt16(nameData.size(), false);
+    writer.writeBlock(nameData);
+    writer.writeUInt16(d->type, false);
+    writer.writeUInt16(data.size(), false);
+    writer.writeBlock(data);
+    return writer.data();
   }
   else {
-    ByteVector nameData = File::renderString(name);
-    data = ByteVector::fromShort(kind == 2 ? d->language : 0, false) +
-           ByteVector::fromShort(d->stream, false) +
-           ByteVector::fromShort(nameData.size(), false) +
-           ByteVector::fromShort((int)d->type, false) +
-           ByteVector::fromUInt(data.size(), false) +
-           nameData +
-           data;
+    ByteVectorWriter writer(12 + nameData.size() + data.size());
+    writer.writeUInt16(kind == 2 ? d->language : 0, false);
+    writer.writeUInt16(d->stream, false);
+    writer.writeUInt16(nameData.size(), false);
+    writer.writeUInt16(d->type, false);
+    writer.writeUInt32(data.size(), false);
+    writer.writeBlock(nameData);
+    writer.writeBlock(data);
+    return writer.data();
   }
-
-  return data;
 }
 
 int
@@ -33,6 +33,8 @@
 namespace TagLib
 {
 
+  class ByteVectorReader;
+
   namespace ASF
   {
 
@@ -162,7 +164,7 @@ namespace TagLib
 
 #ifndef DO_NOT_DOCUMENT
       /* THIS IS PRIVATE, DON'T TOUCH IT! */
-      String parse(ASF::File &file, int kind = 0);
+      String parse(ByteVectorReader &reader, int kind = 0);
 #endif
 
     private:
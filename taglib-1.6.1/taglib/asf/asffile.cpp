@@ -31,6 +31,8 @@
 
 #include <tdebug.h>
 #include <tbytevectorlist.h>
+#include <tbytevectorreader.h>
+#include <tbytevectorwriter.h>
 #include <tstring.h>
 #include "asffile.h"
 #include "asftag.h"
@@ -62,6 +64,7 @@ public:
 };
 
 static ByteVector headerGuid("\x30\x26\xB2\x75\x8E\x66\xCF\x11\xA6\xD9\x00\xAA\x00\x62\xCE\x6C", 16);
+static ByteVector dataGuid("\x36\x26\xB2\x75\x8E\x66\xCF\x11\xA6\xD9\x00\xAA\x00\x62\xCE\x6C", 16);
 static ByteVector filePropertiesGuid("\xA1\xDC\xAB\x8C\x47\xA9\xCF\x11\x8E\xE4\x00\xC0\x0C\x20\x53\x65", 16);
 static ByteVector streamPropertiesGuid("\x91\x07\xDC\xB7\xB7\xA9\xCF\x11\x8E\xE6\x00\xC0\x0C\x20\x53\x65", 16);
 static ByteVector contentDescriptionGuid("\x33\x26\xB2\x75\x8E\x66\xCF\x11\xA6\xD9\x00\xAA\x00\x62\xCE\x6C", 16);
@@ -70,6 +73,25 @@ static ByteVector headerExtensionGuid("\xb5\x03\xbf_.\xa9\xcf\x11\x8e\xe3\x00\xc
 static ByteVector metadataGuid("\xEA\xCB\xF8\xC5\xAF[wH\204g\xAA\214D\xFAL\xCA", 16);
 static ByteVector metadataLibraryGuid("\224\034#D\230\224\321I\241A\x1d\x13NEpT", 16);
 
+// The objects that hold attributes are the GUID and size, the number of
+// attributes and then the attributes themselves.
+
+static ByteVector renderAttributeObject(const ByteVector &guid, const ByteVectorList &attributeData)
+{
+  uint size = 24 + 2;
+  for(ByteVectorList::ConstIterator it = attributeData.begin(); it != attributeData.end(); ++it) {
+    size += it->size();
+  }
+  ByteVectorWriter writer(size);
+  writer.writeBlock(guid);
+  writer.writeUInt64(size, false);
+  writer.writeUInt16(attributeData.size(), false);
+  for(ByteVectorList::ConstIterator it = attributeData.begin(); it != attributeData.end(); ++it) {
+    writer.writeBlock(*it);
+  }
+  return writer.data();
+}
+
 class ASF::File::BaseObject
 {
 public:
@@ -155,7 +177,11 @@ ASF::File::BaseObject::parse(ASF::File *file, unsigned int size)
 ByteVector
 ASF::File::BaseObject::render(ASF::File * /*file*/)
 {
-  return guid() + ByteVector::fromLongLong(data.size() + 24, false) + data;
+  ByteVectorWriter writer(data.size() + 24);
+  writer.writeBlock(guid());
+  writer.writeUInt64(data.size() + 24, false);
+  writer.writeBlock(data);
+  return writer.data();
 }
 
 ASF::File::UnknownObject::UnknownObject(const ByteVector &guid) : myGuid(guid)
@@ -178,7 +204,11 @@ void
 ASF::File::FilePropertiesObject::parse(ASF::File *file, uint size)
 {
   BaseObject::parse(file, size);
-  file->d->properties->setLength((int)(data.mid(40, 8).toLongLong(false) / 10000000L - data.mid(56, 8).toLongLong(false) / 1000L));
+  ByteVectorReader reader(data, 40);
+  long long duration = reader.readUInt64(false);
+  reader.skip(8);
+  long long preroll = reader.readUInt64(false);
+  file->d->properties->setLength((int)(duration / 10000000L - preroll / 1000L));
 }
 
 ByteVector
@@ -191,9 +221,10 @@ void
 ASF::File::StreamPropertiesObject::parse(ASF::File *file, uint size)
 {
   BaseObject::parse(file, size);
-  file->d->properties->setChannels(data.mid(56, 2).toShort(false));
-  file->d->properties->setSampleRate(data.mid(58, 4).toUInt(false));
-  file->d->properties->setBitrate(data.mid(62, 4).toUInt(false) * 8 / 1000);
+  ByteVectorReader reader(data, 56);
+  file->d->properties->setChannels(reader.readUInt16(false));
+  file->d->properties->setSampleRate(reader.readUInt32(false));
+  file->d->properties->setBitrate(reader.readUInt32(false) * 8 / 1000);
 }
 
 ByteVector
@@ -203,19 +234,20 @@ ASF::File::ContentDescriptionObject::guid()
 }
 
 void
-ASF::File::ContentDescriptionObject::parse(ASF::File *file, uint /*size*/)
+ASF::File::ContentDescriptionObject::parse(ASF::File *file, uint size)
 {
   file->d->contentDescriptionObject = this;
-  int titleLength = file->readWORD();
-  int artistLength = file->readWORD();
-  int copyrightLength = file->readWORD();
-  int commentLength = file->readWORD();
-  int ratingLength = file->readWORD();
-  file->d->tag->setTitle(file->readString(titleLength));
-  file->d->tag->setArtist(file->readString(artistLength));
-  file->d->tag->setCopyright(file->readString(copyrightLength));
-  file->d->tag->setComment(file->readString(commentLength));
-  file->d->tag->setRating(file->readString(ratingLength));
+  ByteVectorReader reader(file->readBlock(size - 24));
+  int titleLength = reader.readUInt16(false);
+  int artistLength = reader.readUInt16(false);
+  int copyrightLength = reader.readUInt16(false);
+  int commentLength = reader.readUInt16(false);
+  int ratingLength = reader.readUInt16(false);
+  file->d->tag->setTitle(readString(reader, titleLength));
+  file->d->tag->setArtist(readString(reader, artistLength));
+  file->d->tag->setCopyright(readString(reader, copyrightLength));
+  file->d->tag->setComment(readString(reader, commentLength));
+  file->d->tag->setRating(readString(reader, ratingLength));
 }
 
 ByteVector
@@ -247,24 +279,22 @@ ASF::File::ExtendedContentDescriptionObject::guid()
 }
 
 void
-ASF::File::ExtendedContentDescriptionObject::parse(ASF::File *file, uint /*size*/)
+ASF::File::ExtendedContentDescriptionObject::parse(ASF::File *file, uint size)
 {
   file->d->extendedContentDescriptionObject = this;
-  int count = file->readWORD();
+  ByteVectorReader reader(file->readBlock(size - 24));
+  int count = reader.readUInt16(false);
   while(count--) {
     ASF::Attribute attribute;
-    String name = attribute.parse(*file);
+    String name = attribute.parse(reader);
     file->d->tag->addAttribute(name, attribute);
   }
 }
 
 ByteVector
-ASF::File::ExtendedContentDescriptionObject::render(ASF::File *file)
+ASF::File::ExtendedContentDescriptionObject::render(ASF::File * /*file*/)
 {
-  data.clear();
-  data.append(ByteVector::fromShort(attributeData.size(), false));
-  data.append(attributeData.toByteVector(ByteVector::null));
-  return BaseObject::render(file);
+  return renderAttributeObject(guid(), attributeData);
 }
 
 ByteVector
@@ -274,24 +304,22 @@ ASF::File::MetadataObject::guid()
 }
 
 void
-ASF::File::MetadataObject::parse(ASF::File *file, uint /*size*/)
+ASF::File::MetadataObject::parse(ASF::File *file, uint size)
 {
   file->d->metadataObject = this;
-  int count = file->readWORD();
+  ByteVectorReader reader(file->readBlock(size - 24));
+  int count = reader.readUInt16(false);
   while(count--) {
     ASF::Attribute attribute;
-    String name = attribute.parse(*file, 1);
+    String name = attribute.parse(reader, 1);
     file->d->tag->addAttribute(name, attribute);
   }
 }
 
 ByteVector
-ASF::File::MetadataObject::render(ASF::File *file)
+ASF::File::MetadataObject::render(ASF::File * /*file*/)
 {
-  data.clear();
-  data.append(ByteVector::fromShort(attributeData.size(), false));
-  data.append(attributeData.toByteVector(ByteVector::null));
-  return BaseObject::render(file);
+  return renderAttributeObject(guid(), attributeData);
 }
 
 ByteVector
@@ -301,24 +329,22 @@ ASF::File::MetadataLibraryObject::guid()
 }
 
 void
-ASF::File::MetadataLibraryObject::parse(ASF::File *file, uint /*size*/)
+ASF::File::MetadataLibraryObject::parse(ASF::File *file, uint size)
 {
   file->d->metadataLibraryObject = this;
-  int count = file->readWORD();
+  ByteVectorReader reader(file->readBlock(size - 24));
+  int count = reader.readUInt16(false);
   while(count--) {
     ASF::Attribute attribute;
-    String name = attribute.parse(*file, 2);
+    String name = attribute.parse(reader, 2);
     file->d->tag->addAttribute(name, attribute);
   }
 }
 
 ByteVector
-ASF::File::MetadataLibraryObject::render(ASF::File *file)
+ASF::File::MetadataLibraryObject::render(ASF::File * /*file*/)
 {
-  data.clear();
-  data.append(ByteVector::fromShort(attributeData.size(), false));
-  data.append(attributeData.toByteVector(ByteVector::null));
-  return BaseObject::render(file);
+  return renderAttributeObject(guid(), attributeData);
 }
 
 ByteVector
@@ -332,11 +358,16 @@ ASF::File::HeaderExtensionObject::parse(ASF::File *file, uint /*size*/)
 {
   file->d->headerExtensionObject = this;
   file->seek(18, File::Current);
-  long long dataSize = file->readDWORD();
+  long long dataSize = ByteVectorReader(file->readBlock(4)).readUInt32(false);
   long long dataPos = 0;
   while(dataPos < dataSize) {
-    ByteVector guid = file->readBlock(16);
-    long long size = file->readQWORD();
+    ByteVectorReader header(file->readBlock(24));
+    ByteVector guid = header.readBlock(16);
+    long long size = header.readUInt64(false);
+    if(!header.isValid() || size < 24) {
+      debug("ASF::File::HeaderExtensionObject::parse() -- Invalid object size.");
+      break;
+    }
     BaseObject *obj;
     if(guid == metadataGuid) {
       obj = new MetadataObject();
@@ -356,12 +387,26 @@ ASF::File::HeaderExtensionObject::parse(ASF::File *file, uint /*size*/)
 ByteVector
 ASF::File::HeaderExtensionObject::render(ASF::File *file)
 {
-  data.clear();
+  ByteVectorList children;
+  uint childrenSize = 0;
   for(unsigned int i = 0; i < objects.size(); i++) {
-    data.append(objects[i]->render(file));
+    children.append(objects[i]->render(file));
+    childrenSize += children.back().size();
   }
-  data = ByteVector("\x11\xD2\xD3\xAB\xBA\xA9\xcf\x11\x8E\xE6\x00\xC0\x0C\x20\x53\x65\x06\x00", 18) + ByteVector::fromUInt(data.size(), false) + data;
-  return BaseObject::render(file);
+
+  // The GUID and size are followed by a reserved GUID and field, and the size
+  // of the objects inside.
+
+  const uint size = 24 + 18 + 4 + childrenSize;
+  ByteVectorWriter writer(size);
+  writer.writeBlock(guid());
+  writer.writeUInt64(size, false);
+  writer.writeBlock("\x11\xD2\xD3\xAB\xBA\xA9\xcf\x11\x8E\xE6\x00\xC0\x0C\x20\x53\x65\x06\x00", 18);
+  writer.writeUInt32(childrenSize, false);
+  for(ByteVectorList::ConstIterator it = children.begin(); it != children.end(); ++it) {
+    writer.writeBlock(*it);
+  }
+  return writer.data();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -375,6 +420,13 @@ ASF::File::File(FileName file, bool readProperties, Properties::ReadStyle proper
   read(readProperties, propertiesStyle);
 }
 
+ASF::File::File(IOStream *stream, bool readProperties, Properties::ReadStyle propertiesStyle) 
+  : TagLib::File(stream)
+{
+  d = new FilePrivate;
+  read(readProperties, propertiesStyle);
+}
+
 ASF::File::~File()
 {
   for(unsigned int i = 0; i < d->objects.size(); i++) {
@@ -404,8 +456,8 @@ void ASF::File::read(bool /*readProperties*/, Properties::ReadStyle /*properties
   if(!isValid())
     return;
 
-  ByteVector guid = readBlock(16);
-  if(guid != headerGuid) {
+  ByteVectorReader header(readBlock(30));
+  if(header.readBlock(16) != headerGuid) {
     debug("ASF: Not an ASF file.");
     return;
   }
@@ -413,13 +465,17 @@ void ASF::File::read(bool /*readProperties*/, Properties::ReadStyle /*properties
   d->tag = new ASF::Tag();
   d->properties = new ASF::Properties();
 
-  d->size = readQWORD();
-  int numObjects = readDWORD();
-  seek(2, Current);
+  d->size = header.readUInt64(false);
+  int numObjects = header.readUInt32(false);
 
   for(int i = 0; i < numObjects; i++) {
-    ByteVector guid = readBlock(16);
-    long size = (long)readQWORD();
+    ByteVectorReader objectHeader(readBlock(24));
+    ByteVector guid = objectHeader.readBlock(16);
+    long size = (long)objectHeader.readUInt64(false);
+    if(!objectHeader.isValid() || size < 24) {
+      debug("ASF::File::read() -- Invalid object size.");
+      break;
+    }
     BaseObject *obj;
     if(guid == filePropertiesGuid) {
       obj = new FilePropertiesObject();
@@ -442,6 +498,8 @@ void ASF::File::read(bool /*readProperties*/, Properties::ReadStyle /*properties
     obj->parse(this, size);
     d->objects.append(obj);
   }
+
+  d->tag->setModified(false);
 }
 
 bool ASF::File::save()
@@ -451,6 +509,9 @@ bool ASF::File::save()
     return false;
   }
 
+  if(!d->tag->isModified())
+    return true;
+
   if(!d->contentDescriptionObject) {
     d->contentDescriptionObject = new ContentDescriptionObject();
     d->objects.append(d->contentDescriptionObject);
@@ -494,48 +555,61 @@ bool ASF::File::save()
     }
   }
 
-  ByteVector data;
+  ByteVectorList objects;
+  uint size = 30;
   for(unsigned int i = 0; i < d->objects.size(); i++) {
-    data.append(d->objects[i]->render(this));
+    objects.append(d->objects[i]->render(this));
+    size += objects.back().size();
   }
-  data = headerGuid + ByteVector::fromLongLong(data.size() + 30, false) + ByteVector::fromUInt(d->objects.size(), false) + ByteVector("\x01\x02", 2) + data;
+
+  ByteVectorWriter writer(size);
+  writer.writeBlock(headerGuid);
+  writer.writeUInt64(size, false);
+  writer.writeUInt32(d->objects.size(), false);
+  writer.writeBlock("\x01\x02", 2);
+  for(ByteVectorList::ConstIterator it = objects.begin(); it != objects.end(); ++it) {
+    writer.writeBlock(*it);
+  }
+  ByteVector data = writer.data();
   insert(data, 0, d->size);
 
+  d->size = data.size();
+  d->tag->setModified(false);
   return true;
 }
 
-////////////////////////////////////////////////////////////////////////////////
-// protected members
-////////////////////////////////////////////////////////////////////////////////
-
-int ASF::File::readBYTE()
+bool ASF::File::audioRange(long &offset, long &length)
 {
-  ByteVector v = readBlock(1);
-  return v[0];
-}
+  if(!isValid() || !d->tag)
+    return false;
 
-int ASF::File::readWORD()
-{
-  ByteVector v = readBlock(2);
-  return v.toShort(false);
-}
+  // The data object is the GUID, the size, the file ID, the packet count and
+  // two reserved bytes, followed by the packets.
 
-unsigned int ASF::File::readDWORD()
-{
-  ByteVector v = readBlock(4);
-  return v.toUInt(false);
-}
+  seek(long(d->size));
+  ByteVectorReader header(readBlock(24));
+  if(header.readBlock(16) != dataGuid) {
+    debug("ASF::File::audioRange() -- No data object after the header.");
+    return false;
+  }
 
-long long ASF::File::readQWORD()
-{
-  ByteVector v = readBlock(8);
-  return v.toLongLong(false);
+  long size = long(header.readUInt64(false));
+
+  offset = long(d->size) + 50;
+  length = File::length() - offset;
+  if(size >= 50 && size - 50 < length)
+    length = size - 50;
+  return length >= 0;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// protected members
+////////////////////////////////////////////////////////////////////////////////
+
 String
-ASF::File::readString(int length)
+ASF::File::readString(ByteVectorReader &reader, int length)
 {
-  ByteVector data = readBlock(length);
+  ByteVector data = reader.readBlock(length);
   unsigned int size = data.size();
   while (size >= 2) {
     if(data[size - 1] != '\0' || data[size - 2] != '\0') {
@@ -552,11 +626,16 @@ ASF::File::readString(int length)
 ByteVector
 ASF::File::renderString(const String &str, bool includeLength)
 {
-  ByteVector data = str.data(String::UTF16LE) + ByteVector::fromShort(0, false);
+  const uint size = 2 * str.size() + 2;
+  ByteVectorWriter writer((includeLength ? 2 : 0) + size);
   if(includeLength) {
-    data = ByteVector::fromShort(data.size(), false) + data;
+    writer.writeUInt16(size, false);
+  }
+  for(String::ConstIterator it = str.begin(); it != str.end(); ++it) {
+    writer.writeUInt16(*it, false);
   }
-  return data;
+  writer.writeUInt16(0, false);
+  return writer.data();
 }
 
 #endif
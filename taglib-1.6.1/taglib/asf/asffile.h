@@ -34,6 +34,8 @@
 
 namespace TagLib {
 
+  class ByteVectorReader;
+
   //! An implementation of ASF (WMA) metadata
   namespace ASF {
 
@@ -57,6 +59,16 @@ namespace TagLib {
        */
       File(FileName file, bool readProperties = true, Properties::ReadStyle propertiesStyle = Properties::Average);
 
+      /*!
+       * Contructs an ASF file from \a stream.  If \a readProperties is true the
+       * file's audio properties will also be read using \a propertiesStyle.  If
+       * false, \a propertiesStyle is ignored.
+       *
+       * \note TagLib will *not* take ownership of the stream, the caller is
+       * responsible for deleting it after the File object.
+       */
+      File(IOStream *stream, bool readProperties = true, Properties::ReadStyle propertiesStyle = Properties::Average);
+
       /*!
        * Destroys this instance of the File.
        */
@@ -86,14 +98,18 @@ namespace TagLib {
        */
       virtual bool save();
 
+      /*!
+       * Sets \a offset and \a length to the data packets of the data object
+       * that follows the header.
+       *
+       * \see TagLib::File::audioRange()
+       */
+      virtual bool audioRange(long &offset, long &length);
+
     private:
 
-      int readBYTE();
-      int readWORD();
-      unsigned int readDWORD();
-      long long readQWORD();
       static ByteVector renderString(const String &str, bool includeLength = false);
-      String readString(int len);
+      static String readString(ByteVectorReader &reader, int length);
       void read(bool readProperties, Properties::ReadStyle propertiesStyle);
 
       friend class Attribute;
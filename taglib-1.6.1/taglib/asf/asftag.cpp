@@ -123,59 +123,82 @@ ASF::Tag::genre() const
 void
 ASF::Tag::setTitle(const String &value)
 {
-  d->title = value;
+  if(d->title != value) {
+    d->title = value;
+    setModified();
+  }
 }
 
 void
 ASF::Tag::setArtist(const String &value)
 {
-  d->artist = value;
+  if(d->artist != value) {
+    d->artist = value;
+    setModified();
+  }
 }
 
 void
 ASF::Tag::setCopyright(const String &value)
 {
-  d->copyright = value;
+  if(d->copyright != value) {
+    d->copyright = value;
+    setModified();
+  }
 }
 
 void
 ASF::Tag::setComment(const String &value)
 {
-  d->comment = value;
+  if(d->comment != value) {
+    d->comment = value;
+    setModified();
+  }
 }
 
 void
 ASF::Tag::setRating(const String &value)
 {
-  d->rating = value;
+  if(d->rating != value) {
+    d->rating = value;
+    setModified();
+  }
 }
 
 void
 ASF::Tag::setAlbum(const String &value)
 {
-  setAttribute("WM/AlbumTitle", value);
+  setTextAttribute("WM/AlbumTitle", value);
 }
 
 void
 ASF::Tag::setGenre(const String &value)
 {
-  setAttribute("WM/Genre", value);
+  setTextAttribute("WM/Genre", value);
 }
 
 void
 ASF::Tag::setYear(uint value)
 {
-  setAttribute("WM/Year", String::number(value));
+  setTextAttribute("WM/Year", String::number(value));
 }
 
 void
 ASF::Tag::setTrack(uint value)
 {
-  setAttribute("WM/TrackNumber", String::number(value));
+  setTextAttribute("WM/TrackNumber", String::number(value));
 }
 
 ASF::AttributeListMap&
 ASF::Tag::attributeListMap()
+{
+  // The attributes may be changed through the returned reference.
+  setModified();
+  return d->attributeListMap;
+}
+
+const ASF::AttributeListMap &
+ASF::Tag::attributeListMap() const
 {
   return d->attributeListMap;
 }
@@ -183,8 +206,10 @@ ASF::Tag::attributeListMap()
 void ASF::Tag::removeItem(const String &key)
 {
   AttributeListMap::Iterator it = d->attributeListMap.find(key);
-  if(it != d->attributeListMap.end())
+  if(it != d->attributeListMap.end()) {
     d->attributeListMap.erase(it);
+    setModified();
+  }
 }
 
 void ASF::Tag::setAttribute(const String &name, const Attribute &attribute)
@@ -192,18 +217,30 @@ void ASF::Tag::setAttribute(const String &name, const Attribute &attribute)
   AttributeList value;
   value.append(attribute);
   d->attributeListMap.insert(name, value);
+  setModified();
 }
 
 void ASF::Tag::addAttribute(const String &name, const Attribute &attribute)
 {
   if(d->attributeListMap.contains(name)) {
     d->attributeListMap[name].append(attribute);
+    setModified();
   }
   else {
     setAttribute(name, attribute);
   }
 }
 
+void ASF::Tag::setTextAttribute(const String &name, const String &value)
+{
+  if(d->attributeListMap.contains(name) && d->attributeListMap[name].size() == 1) {
+    const Attribute &current = d->attributeListMap[name][0];
+    if(current.type() == Attribute::UnicodeType && current.toString() == value)
+      return;
+  }
+  setAttribute(name, value);
+}
+
 bool ASF::Tag::isEmpty() const {
   return TagLib::Tag::isEmpty() &&
          copyright().isEmpty() &&
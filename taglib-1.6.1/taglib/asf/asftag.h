@@ -156,9 +156,16 @@ namespace TagLib {
        * all of the items in the tag.
        *
        * This is the most powerfull structure for accessing the items of the tag.
+       * Since the items can be changed through it, this marks the tag as
+       * modified.
        */
       AttributeListMap &attributeListMap();
 
+      /*!
+       * Returns the item list map without marking the tag as modified.
+       */
+      const AttributeListMap &attributeListMap() const;
+
       /*!
        * Removes the \a key attribute from the tag
        */
@@ -177,6 +184,7 @@ namespace TagLib {
       void addAttribute(const String &name, const Attribute &attribute);
 
     private:
+      void setTextAttribute(const String &name, const String &value);
 
       class TagPrivate;
       TagPrivate *d;
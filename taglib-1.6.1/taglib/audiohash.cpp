@@ -0,0 +1,115 @@
+/***************************************************************************
+ *   This library is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Lesser General Public License version   *
+ *   2.1 as published by the Free Software Foundation.                     *
+ *                                                                         *
+ *   This library is distributed in the hope that it will be useful, but   *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU     *
+ *   Lesser General Public License for more details.                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU Lesser General Public      *
+ *   License along with this library; if not, write to the Free Software   *
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  *
+ *   USA                                                                   *
+ *                                                                         *
+ *   Alternatively, this file is available under the Mozilla Public        *
+ *   License Version 1.1.  You may obtain a copy of the License at         *
+ *   http://www.mozilla.org/MPL/                                           *
+ ***************************************************************************/
+
+#include <tstreamhash.h>
+
+#include "audiohash.h"
+
+using namespace TagLib;
+
+namespace
+{
+  // The size of the blocks that all of the audio is read in.
+  const long readSize = 256 * 1024;
+}
+
+class AudioHash::AudioHashPrivate
+{
+public:
+  AudioHashPrivate() :
+    windows(0),
+    windowSize(16384),
+    bytesRead(0) {}
+
+  uint windows;
+  uint windowSize;
+  ulong bytesRead;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// public members
+////////////////////////////////////////////////////////////////////////////////
+
+AudioHash::AudioHash()
+{
+  d = new AudioHashPrivate;
+}
+
+AudioHash::~AudioHash()
+{
+  delete d;
+}
+
+void AudioHash::setSampled(uint windows, uint windowSize)
+{
+  d->windows = windowSize > 0 ? windows : 0;
+  d->windowSize = windowSize;
+}
+
+TagLib::uint AudioHash::windows() const
+{
+  return d->windows;
+}
+
+TagLib::uint AudioHash::windowSize() const
+{
+  return d->windowSize;
+}
+
+ByteVector AudioHash::hash(File *file)
+{
+  d->bytesRead = 0;
+
+  long offset, length;
+  if(!file || !file->audioRange(offset, length))
+    return ByteVector::null;
+
+  // Seeding with the length tells apart audio whose windows happen to match.
+
+  StreamHash h(length);
+
+  if(d->windows == 0 || length <= long(d->windows) * long(d->windowSize)) {
+    file->seek(offset);
+    for(long left = length; left > 0; left -= readSize) {
+      ByteVector block = file->readBlock(left < readSize ? left : readSize);
+      if(block.isEmpty())
+        break;
+      h.update(block);
+    }
+  }
+  else {
+    long last = length - d->windowSize;
+    for(uint i = 0; i < d->windows; i++) {
+      long position = d->windows > 1
+        ? long((long long)(last) * i / (d->windows - 1))
+        : last / 2;
+      file->seek(offset + position);
+      h.update(file->readBlock(d->windowSize));
+    }
+  }
+
+  d->bytesRead = ulong(h.length());
+  return ByteVector::fromLongLong(h.digest());
+}
+
+TagLib::ulong AudioHash::bytesRead() const
+{
+  return d->bytesRead;
+}
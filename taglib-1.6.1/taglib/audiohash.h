@@ -0,0 +1,113 @@
+/***************************************************************************
+ *   This library is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Lesser General Public License version   *
+ *   2.1 as published by the Free Software Foundation.                     *
+ *                                                                         *
+ *   This library is distributed in the hope that it will be useful, but   *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU     *
+ *   Lesser General Public License for more details.                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU Lesser General Public      *
+ *   License along with this library; if not, write to the Free Software   *
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  *
+ *   USA                                                                   *
+ *                                                                         *
+ *   Alternatively, this file is available under the Mozilla Public        *
+ *   License Version 1.1.  You may obtain a copy of the License at         *
+ *   http://www.mozilla.org/MPL/                                           *
+ ***************************************************************************/
+
+#ifndef TAGLIB_AUDIOHASH_H
+#define TAGLIB_AUDIOHASH_H
+
+#include "tfile.h"
+#include "tbytevector.h"
+
+#include "taglib_export.h"
+
+namespace TagLib {
+
+  //! Hashes the audio of a file, leaving out its tags
+
+  /*!
+   * Two copies of the same rip that have been tagged differently have
+   * different bytes, but the same audio.  AudioHash hashes only the range
+   * that File::audioRange() gives, so such copies hash the same and can be
+   * found without comparing their tags at all.
+   *
+   * By default all of the audio is read.  With setSampled() only a few
+   * windows spread evenly over it are, which turns the hash into one small,
+   * bounded amount of I/O per file whatever its size; the length of the audio
+   * is part of the hash either way.
+   *
+   * \code
+   *
+   * TagLib::AudioHash hasher;
+   * hasher.setSampled(8);
+   * TagLib::FileRef ref("song.mp3");
+   * TagLib::ByteVector h = hasher.hash(ref.file());
+   *
+   * \endcode
+   *
+   * \see StreamHash
+   */
+
+  class TAGLIB_EXPORT AudioHash
+  {
+  public:
+    /*!
+     * Constructs a hasher that reads all of the audio.
+     */
+    AudioHash();
+
+    /*!
+     * Destroys this AudioHash instance.
+     */
+    ~AudioHash();
+
+    /*!
+     * Makes hash() read only \a windows windows of \a windowSize bytes each,
+     * spread evenly from the start to the end of the audio.  Audio that is
+     * no longer than that is read whole.  A \a windows of 0 reads all of the
+     * audio, which is the default.
+     *
+     * Sampled hashes are only comparable with ones made with the same
+     * settings.
+     */
+    void setSampled(uint windows, uint windowSize = 16384);
+
+    /*!
+     * Returns the number of windows read by hash(), or 0 if it reads all of
+     * the audio.
+     */
+    uint windows() const;
+
+    /*!
+     * Returns the size of the windows read by hash().
+     */
+    uint windowSize() const;
+
+    /*!
+     * Returns the 8 byte hash of the audio of \a file, or an empty vector if
+     * \a file is null or File::audioRange() can't find its audio.  This
+     * moves the read position of the file.
+     */
+    ByteVector hash(File *file);
+
+    /*!
+     * Returns the number of bytes that the last call to hash() read.
+     */
+    ulong bytesRead() const;
+
+  private:
+    AudioHash(const AudioHash &);
+    AudioHash &operator=(const AudioHash &);
+
+    class AudioHashPrivate;
+    AudioHashPrivate *d;
+  };
+
+} // namespace TagLib
+
+#endif
@@ -44,21 +44,95 @@
 #include "trueaudiofile.h"
 #include "aifffile.h"
 #include "wavfile.h"
+#include "id3v2framefactory.h"
 
 using namespace TagLib;
 
 class FileRef::FileRefPrivate : public RefCounter
 {
 public:
-  FileRefPrivate(File *f) : RefCounter(), file(f) {}
+  FileRefPrivate(File *f) : RefCounter(), file(f), stream(0) {}
   ~FileRefPrivate() {
     delete file;
+    delete stream;
   }
 
   File *file;
+  IOStream *stream;
   static List<const FileTypeResolver *> fileTypeResolvers;
 };
 
+namespace
+{
+  // Both the file name and the stream based constructors of the concrete file
+  // types are picked by extension in the same way, so this works with either.
+
+  template <class Source>
+  File *createByExtension(Source source, FileName fileName, bool readAudioProperties,
+                          AudioProperties::ReadStyle audioPropertiesStyle)
+  {
+    // Ok, this is really dumb for now, but it works for testing.
+
+    String s;
+
+#ifdef _WIN32
+    s = (wcslen((const wchar_t *) fileName) > 0) ? String((const wchar_t *) fileName) : String((const char *) fileName);
+#else
+    s = fileName;
+#endif
+
+    // If this list is updated, the method defaultFileExtensions() should also be
+    // updated.  However at some point that list should be created at the same time
+    // that a default file type resolver is created.
+
+    int pos = s.rfind(".");
+    if(pos != -1) {
+      String ext = s.substr(pos + 1).upper();
+      if(ext == "MP3")
+        return new MPEG::File(source, ID3v2::FrameFactory::instance(),
+                              readAudioProperties, audioPropertiesStyle);
+      if(ext == "OGG")
+        return new Ogg::Vorbis::File(source, readAudioProperties, audioPropertiesStyle);
+      if(ext == "OGA") {
+        /* .oga can be any audio in the Ogg container. First try FLAC, then Vorbis. */
+        File *file = new Ogg::FLAC::File(source, readAudioProperties, audioPropertiesStyle);
+        if (file->isValid())
+          return file;
+        delete file;
+        return new Ogg::Vorbis::File(source, readAudioProperties, audioPropertiesStyle);
+      }
+      if(ext == "FLAC")
+        return new FLAC::File(source, ID3v2::FrameFactory::instance(),
+                              readAudioProperties, audioPropertiesStyle);
+      if(ext == "MPC")
+        return new MPC::File(source, readAudioProperties, audioPropertiesStyle);
+      if(ext == "WV")
+        return new WavPack::File(source, readAudioProperties, audioPropertiesStyle);
+      if(ext == "SPX")
+        return new Ogg::Speex::File(source, readAudioProperties, audioPropertiesStyle);
+      if(ext == "TTA")
+        return new TrueAudio::File(source, ID3v2::FrameFactory::instance(),
+                                   readAudioProperties, audioPropertiesStyle);
+#ifdef TAGLIB_WITH_MP4
+      if(ext == "M4A" || ext == "M4B" || ext == "M4P" || ext == "MP4" || ext == "3G2")
+        return new MP4::File(source, readAudioProperties, audioPropertiesStyle);
+#endif
+#ifdef TAGLIB_WITH_ASF
+      if(ext == "WMA" || ext == "ASF")
+        return new ASF::File(source, readAudioProperties, audioPropertiesStyle);
+#endif
+      if(ext == "AIF")
+        return new RIFF::AIFF::File(source, readAudioProperties, audioPropertiesStyle);
+      if(ext == "WAV")
+        return new RIFF::WAV::File(source, readAudioProperties, audioPropertiesStyle);
+      if(ext == "AIFF")
+        return new RIFF::AIFF::File(source, readAudioProperties, audioPropertiesStyle);
+    }
+
+    return 0;
+  }
+}
+
 List<const FileRef::FileTypeResolver *> FileRef::FileRefPrivate::fileTypeResolvers;
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -76,6 +150,13 @@ FileRef::FileRef(FileName fileName, bool readAudioProperties,
   d = new FileRefPrivate(create(fileName, readAudioProperties, audioPropertiesStyle));
 }
 
+FileRef::FileRef(IOStream *stream, bool readAudioProperties,
+                 AudioProperties::ReadStyle audioPropertiesStyle)
+{
+  d = new FileRefPrivate(createByExtension(stream, stream->name(),
+                                           readAudioProperties, audioPropertiesStyle));
+}
+
 FileRef::FileRef(File *file)
 {
   d = new FileRefPrivate(file);
@@ -201,59 +282,14 @@ File *FileRef::create(FileName fileName, bool readAudioProperties,
       return file;
   }
 
-  // Ok, this is really dumb for now, but it works for testing.
-
-  String s;
-
-#ifdef _WIN32
-  s = (wcslen((const wchar_t *) fileName) > 0) ? String((const wchar_t *) fileName) : String((const char *) fileName);
-#else
-  s = fileName;
-#endif
+  return createByExtension(fileName, fileName, readAudioProperties, audioPropertiesStyle);
+}
 
-  // If this list is updated, the method defaultFileExtensions() should also be
-  // updated.  However at some point that list should be created at the same time
-  // that a default file type resolver is created.
-
-  int pos = s.rfind(".");
-  if(pos != -1) {
-    String ext = s.substr(pos + 1).upper();
-    if(ext == "MP3")
-      return new MPEG::File(fileName, readAudioProperties, audioPropertiesStyle);
-    if(ext == "OGG")
-      return new Ogg::Vorbis::File(fileName, readAudioProperties, audioPropertiesStyle);
-    if(ext == "OGA") {
-      /* .oga can be any audio in the Ogg container. First try FLAC, then Vorbis. */
-      File *file = new Ogg::FLAC::File(fileName, readAudioProperties, audioPropertiesStyle);
-      if (file->isValid())
-        return file;
-      return new Ogg::Vorbis::File(fileName, readAudioProperties, audioPropertiesStyle);
-    }
-    if(ext == "FLAC")
-      return new FLAC::File(fileName, readAudioProperties, audioPropertiesStyle);
-    if(ext == "MPC")
-      return new MPC::File(fileName, readAudioProperties, audioPropertiesStyle);
-    if(ext == "WV")
-      return new WavPack::File(fileName, readAudioProperties, audioPropertiesStyle);
-    if(ext == "SPX")
-      return new Ogg::Speex::File(fileName, readAudioProperties, audioPropertiesStyle);
-    if(ext == "TTA")
-      return new TrueAudio::File(fileName, readAudioProperties, audioPropertiesStyle);
-#ifdef TAGLIB_WITH_MP4
-    if(ext == "M4A" || ext == "M4B" || ext == "M4P" || ext == "MP4" || ext == "3G2")
-      return new MP4::File(fileName, readAudioProperties, audioPropertiesStyle);
-#endif
-#ifdef TAGLIB_WITH_ASF
-    if(ext == "WMA" || ext == "ASF")
-      return new ASF::File(fileName, readAudioProperties, audioPropertiesStyle);
-#endif
-    if(ext == "AIF")
-      return new RIFF::AIFF::File(fileName, readAudioProperties, audioPropertiesStyle);
-    if(ext == "WAV")
-      return new RIFF::WAV::File(fileName, readAudioProperties, audioPropertiesStyle);
-    if(ext == "AIFF")
-      return new RIFF::AIFF::File(fileName, readAudioProperties, audioPropertiesStyle);
-  }
+////////////////////////////////////////////////////////////////////////////////
+// private members
+////////////////////////////////////////////////////////////////////////////////
 
-  return 0;
+void FileRef::adoptStream(IOStream *stream)
+{
+  d->stream = stream;
 }
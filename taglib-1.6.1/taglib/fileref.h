@@ -127,6 +127,19 @@ namespace TagLib {
                      AudioProperties::ReadStyle
                      audioPropertiesStyle = AudioProperties::Average);
 
+    /*!
+     * Create a FileRef from \a stream.  The file type is guessed from the
+     * extension of the stream's name() in the same way as for a file name;
+     * file type resolvers are not consulted since they work on file names.
+     *
+     * \note TagLib will *not* take ownership of the stream, the caller is
+     * responsible for deleting it after this FileRef and all of its copies.
+     */
+    explicit FileRef(IOStream *stream,
+                     bool readAudioProperties = true,
+                     AudioProperties::ReadStyle
+                     audioPropertiesStyle = AudioProperties::Average);
+
     /*!
      * Contruct a FileRef using \a file.  The FileRef now takes ownership of the
      * pointer and will delete the File when it passes out of scope.
@@ -251,6 +264,14 @@ namespace TagLib {
 
 
   private:
+    friend class FileScanner;
+
+    /*!
+     * Makes this FileRef and its copies delete \a stream, which the file was
+     * read from, after the file.
+     */
+    void adoptStream(IOStream *stream);
+
     class FileRefPrivate;
     FileRefPrivate *d;
   };
@@ -0,0 +1,886 @@
+/***************************************************************************
+ *   This library is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Lesser General Public License version   *
+ *   2.1 as published by the Free Software Foundation.                     *
+ *                                                                         *
+ *   This library is distributed in the hope that it will be useful, but   *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU     *
+ *   Lesser General Public License for more details.                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU Lesser General Public      *
+ *   License along with this library; if not, write to the Free Software   *
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  *
+ *   USA                                                                   *
+ *                                                                         *
+ *   Alternatively, this file is available under the Mozilla Public        *
+ *   License Version 1.1.  You may obtain a copy of the License at         *
+ *   http://www.mozilla.org/MPL/                                           *
+ ***************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <tiostream.h>
+#include <tdebug.h>
+
+#include "filescanner.h"
+
+#ifndef _WIN32
+
+#include <id3v2header.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <list>
+#include <vector>
+
+#ifdef HAVE_IO_URING
+# include <linux/io_uring.h>
+# include <sys/mman.h>
+# include <sys/syscall.h>
+# include <stdlib.h>
+# include <string.h>
+#endif
+
+#endif
+
+using namespace TagLib;
+
+class FileScanner::FileScannerPrivate
+{
+public:
+  FileScannerPrivate(bool readProperties, AudioProperties::ReadStyle style) :
+    readAudioProperties(readProperties),
+    audioPropertiesStyle(style),
+    backend(Automatic),
+    maxInFlight(64),
+    headSize(64 * 1024),
+    tailSize(16 * 1024),
+    extraReads(0) {}
+
+  bool readAudioProperties;
+  AudioProperties::ReadStyle audioPropertiesStyle;
+  Backend backend;
+  uint maxInFlight;
+  uint headSize;
+  uint tailSize;
+  ulong extraReads;
+};
+
+#ifndef _WIN32
+
+namespace
+{
+  // ID3v2 tags bigger than this are left to be read through the stream.
+  const uint maxPrefetchedTagSize = 16 * 1024 * 1024;
+
+  // Enough of the audio after an ID3v2 tag to find the first MPEG frame and
+  // its Xing header.
+  const uint firstFrameSize = 4096;
+
+  //! What has been read of one file
+
+  struct Prefetch
+  {
+    Prefetch(const String &p) : path(p), name(p.to8Bit(true)), fd(-1), size(0), tailOffset(0) {}
+
+    String path;
+    std::string name;
+    int fd;
+    long size;
+    ByteVector head;
+    long tailOffset;
+    ByteVector tail;
+  };
+
+  uint headLength(long size, uint headSize)
+  {
+    return size < long(headSize) ? uint(size) : headSize;
+  }
+
+  // The tail starts after the head so that the two don't overlap.
+
+  long tailOffset(long size, uint headLength, uint tailSize)
+  {
+    return size - long(headLength) > long(tailSize) ? size - tailSize : long(headLength);
+  }
+
+  // Returns how much of the file the head should cover now that its first
+  // bytes are known: all of an ID3v2 tag that is bigger than the head.
+
+  uint completeHeadLength(const ByteVector &head, long size)
+  {
+    if(head.size() < ID3v2::Header::size() ||
+       !head.startsWith(ID3v2::Header::fileIdentifier()))
+      return head.size();
+
+    ID3v2::Header header(head.mid(0, ID3v2::Header::size()));
+    const uint length = header.completeTagSize() + firstFrameSize;
+    if(length <= head.size() || header.completeTagSize() > maxPrefetchedTagSize)
+      return head.size();
+
+    return size < long(length) ? uint(size) : length;
+  }
+
+  ByteVector readAt(int fd, long offset, uint length)
+  {
+    ByteVector v(length, 0);
+    uint count = 0;
+
+    while(count < length) {
+      ssize_t n = pread(fd, v.data() + count, length - count, offset + count);
+      if(n < 0 && errno == EINTR)
+        continue;
+      if(n <= 0)
+        break;
+      count += n;
+    }
+
+    v.resize(count);
+    return v;
+  }
+
+  //! A read only stream that serves reads from the prefetched head and tail
+
+  /*!
+   * Reads that fall outside of the prefetched data (or straddle its edges)
+   * go to the file.  Seeking follows fseek(): seeking before the start fails
+   * and leaves the position alone, seeking past the end is allowed.
+   */
+
+  class PrefetchedStream : public IOStream
+  {
+  public:
+    PrefetchedStream(Prefetch *p) :
+      m_name(p->name),
+      m_fd(p->fd),
+      m_size(p->size),
+      m_head(p->head),
+      m_tailOffset(p->tailOffset),
+      m_tail(p->tail),
+      m_position(0),
+      m_extraReads(0)
+    {
+      p->fd = -1;
+    }
+
+    virtual ~PrefetchedStream()
+    {
+      if(m_fd >= 0)
+        close(m_fd);
+    }
+
+    virtual FileName name() const { return m_name.c_str(); }
+
+    virtual ByteVector readBlock(ulong length)
+    {
+      if(m_fd < 0) {
+        debug("PrefetchedStream::readBlock() -- Invalid File");
+        return ByteVector::null;
+      }
+
+      if(length == 0)
+        return ByteVector::null;
+
+      if(m_position >= m_size)
+        return ByteVector();
+
+      if(length > ulong(m_size - m_position))
+        length = m_size - m_position;
+
+      const long end = m_position + long(length);
+      ByteVector v;
+
+      if(end <= long(m_head.size()))
+        v = m_head.mid(m_position, length);
+      else if(m_position >= m_tailOffset && end <= m_tailOffset + long(m_tail.size()))
+        v = m_tail.mid(m_position - m_tailOffset, length);
+      else {
+        v = readAt(m_fd, m_position, length);
+        m_extraReads++;
+      }
+
+      m_position += v.size();
+      return v;
+    }
+
+    virtual void writeBlock(const ByteVector &)
+    {
+      debug("PrefetchedStream::writeBlock() -- attempted to write to a file that is not writable");
+    }
+
+    virtual void insert(const ByteVector &, ulong, ulong)
+    {
+      debug("PrefetchedStream::insert() -- attempted to write to a file that is not writable");
+    }
+
+    virtual void removeBlock(ulong, ulong)
+    {
+      debug("PrefetchedStream::removeBlock() -- attempted to write to a file that is not writable");
+    }
+
+    virtual bool readOnly() const { return true; }
+
+    virtual bool isOpen() const { return m_fd >= 0; }
+
+    virtual void seek(long offset, Position p)
+    {
+      long position = offset;
+
+      if(p == Current)
+        position += m_position;
+      else if(p == End)
+        position += m_size;
+
+      if(position >= 0)
+        m_position = position;
+    }
+
+    virtual long tell() const { return m_position; }
+
+    virtual long length() { return m_size; }
+
+    virtual void truncate(long)
+    {
+      debug("PrefetchedStream::truncate() -- attempted to write to a file that is not writable");
+    }
+
+    ulong extraReads() const { return m_extraReads; }
+
+  private:
+    std::string m_name;
+    int m_fd;
+    long m_size;
+    ByteVector m_head;
+    long m_tailOffset;
+    ByteVector m_tail;
+    long m_position;
+    ulong m_extraReads;
+  };
+
+  //! Does the blocking reads for one file
+
+  void prefetch(Prefetch *p, uint headSize, uint tailSize)
+  {
+    p->fd = open(p->name.c_str(), O_RDONLY);
+    if(p->fd < 0)
+      return;
+
+    struct stat st;
+    if(fstat(p->fd, &st) != 0) {
+      close(p->fd);
+      p->fd = -1;
+      return;
+    }
+
+    p->size = st.st_size;
+    p->head = readAt(p->fd, 0, headLength(p->size, headSize));
+    p->tailOffset = tailOffset(p->size, p->head.size(), tailSize);
+
+    const uint length = completeHeadLength(p->head, p->size);
+    if(length > p->head.size())
+      p->head.append(readAt(p->fd, p->head.size(), length - p->head.size()));
+
+    if(p->tailOffset < p->size)
+      p->tail = readAt(p->fd, p->tailOffset, uint(p->size - p->tailOffset));
+  }
+
+  //! The work shared by the reader threads and the scanning thread
+
+  struct ReaderPool
+  {
+    pthread_mutex_t mutex;
+    pthread_cond_t changed;
+
+    const StringList *paths;
+    StringList::ConstIterator next;
+    uint inFlight;
+    uint maxInFlight;
+    uint headSize;
+    uint tailSize;
+    std::list<Prefetch *> done;
+  };
+
+  void *readFiles(void *data)
+  {
+    ReaderPool *pool = static_cast<ReaderPool *>(data);
+
+    pthread_mutex_lock(&pool->mutex);
+
+    for(;;) {
+      while(pool->next != pool->paths->end() && pool->inFlight >= pool->maxInFlight)
+        pthread_cond_wait(&pool->changed, &pool->mutex);
+
+      if(pool->next == pool->paths->end())
+        break;
+
+      Prefetch *p = new Prefetch(*pool->next);
+      ++pool->next;
+      pool->inFlight++;
+
+      pthread_mutex_unlock(&pool->mutex);
+      prefetch(p, pool->headSize, pool->tailSize);
+      pthread_mutex_lock(&pool->mutex);
+
+      pool->done.push_back(p);
+      pthread_cond_broadcast(&pool->changed);
+    }
+
+    pthread_mutex_unlock(&pool->mutex);
+    return 0;
+  }
+
+#ifdef HAVE_IO_URING
+
+  //! A minimal io_uring, set up and driven with the raw system calls
+
+  class Ring
+  {
+  public:
+    Ring() : m_fd(-1), m_sqRing(MAP_FAILED), m_cqRing(MAP_FAILED), m_sqes(MAP_FAILED), m_queued(0) {}
+
+    ~Ring()
+    {
+      if(m_sqes != MAP_FAILED)
+        munmap(m_sqes, m_sqesSize);
+      if(m_cqRing != MAP_FAILED && m_cqRing != m_sqRing)
+        munmap(m_cqRing, m_cqRingSize);
+      if(m_sqRing != MAP_FAILED)
+        munmap(m_sqRing, m_sqRingSize);
+      if(m_fd >= 0)
+        close(m_fd);
+    }
+
+    bool setup(uint entries)
+    {
+      struct io_uring_params params;
+      memset(&params, 0, sizeof(params));
+
+      m_fd = syscall(__NR_io_uring_setup, entries, &params);
+      if(m_fd < 0 || !supports(IORING_OP_OPENAT) || !supports(IORING_OP_STATX) ||
+         !supports(IORING_OP_READ))
+      {
+        return false;
+      }
+
+      m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+      m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+      if(params.features & IORING_FEAT_SINGLE_MMAP) {
+        if(m_cqRingSize > m_sqRingSize)
+          m_sqRingSize = m_cqRingSize;
+        m_cqRingSize = m_sqRingSize;
+      }
+
+      m_sqRing = mmap(0, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                      m_fd, IORING_OFF_SQ_RING);
+      if(m_sqRing == MAP_FAILED)
+        return false;
+
+      if(params.features & IORING_FEAT_SINGLE_MMAP)
+        m_cqRing = m_sqRing;
+      else {
+        m_cqRing = mmap(0, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                        m_fd, IORING_OFF_CQ_RING);
+        if(m_cqRing == MAP_FAILED)
+          return false;
+      }
+
+      m_sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+      m_sqes = mmap(0, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                    m_fd, IORING_OFF_SQES);
+      if(m_sqes == MAP_FAILED)
+        return false;
+
+      char *sq = static_cast<char *>(m_sqRing);
+      m_sqTail = reinterpret_cast<unsigned *>(sq + params.sq_off.tail);
+      m_sqMask = *reinterpret_cast<unsigned *>(sq + params.sq_off.ring_mask);
+      m_sqArray = reinterpret_cast<unsigned *>(sq + params.sq_off.array);
+
+      char *cq = static_cast<char *>(m_cqRing);
+      m_cqHead = reinterpret_cast<unsigned *>(cq + params.cq_off.head);
+      m_cqTail = reinterpret_cast<unsigned *>(cq + params.cq_off.tail);
+      m_cqMask = *reinterpret_cast<unsigned *>(cq + params.cq_off.ring_mask);
+      m_cqes = reinterpret_cast<struct io_uring_cqe *>(cq + params.cq_off.cqes);
+
+      return true;
+    }
+
+    // The caller never has more requests outstanding than the ring has
+    // entries, so there is always room for another one.
+
+    struct io_uring_sqe *queue(int opcode, int fd, unsigned long long userData)
+    {
+      const unsigned tail = *m_sqTail + m_queued;
+      const unsigned index = tail & m_sqMask;
+      struct io_uring_sqe *sqe = static_cast<struct io_uring_sqe *>(m_sqes) + index;
+
+      memset(sqe, 0, sizeof(*sqe));
+      sqe->opcode = opcode;
+      sqe->fd = fd;
+      sqe->user_data = userData;
+
+      m_sqArray[index] = index;
+      m_queued++;
+
+      return sqe;
+    }
+
+    // Submits what has been queued and waits for at least one completion.
+
+    bool submitAndWait()
+    {
+      __atomic_store_n(m_sqTail, *m_sqTail + m_queued, __ATOMIC_RELEASE);
+      uint toSubmit = m_queued;
+      m_queued = 0;
+
+      for(;;) {
+        const long n = syscall(__NR_io_uring_enter, m_fd, toSubmit, 1,
+                               IORING_ENTER_GETEVENTS, 0, 0);
+        if(n >= 0)
+          return true;
+        if(errno != EINTR)
+          return false;
+        // The submissions were consumed before the wait was interrupted.
+        toSubmit = 0;
+      }
+    }
+
+    bool next(unsigned long long *userData, int *result)
+    {
+      const unsigned head = *m_cqHead;
+      if(head == __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE))
+        return false;
+
+      const struct io_uring_cqe &cqe = m_cqes[head & m_cqMask];
+      *userData = cqe.user_data;
+      *result = cqe.res;
+
+      __atomic_store_n(m_cqHead, head + 1, __ATOMIC_RELEASE);
+      return true;
+    }
+
+  private:
+    bool supports(int opcode)
+    {
+      const size_t size = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+      struct io_uring_probe *probe = static_cast<struct io_uring_probe *>(calloc(1, size));
+      bool supported =
+        syscall(__NR_io_uring_register, m_fd, IORING_REGISTER_PROBE, probe, 256) == 0 &&
+        opcode <= probe->last_op &&
+        (probe->ops[opcode].flags & IO_URING_OP_SUPPORTED);
+      free(probe);
+      return supported;
+    }
+
+    int m_fd;
+    void *m_sqRing;
+    void *m_cqRing;
+    void *m_sqes;
+    size_t m_sqRingSize;
+    size_t m_cqRingSize;
+    size_t m_sqesSize;
+    unsigned *m_sqTail;
+    unsigned m_sqMask;
+    unsigned *m_sqArray;
+    unsigned *m_cqHead;
+    unsigned *m_cqTail;
+    unsigned m_cqMask;
+    struct io_uring_cqe *m_cqes;
+    uint m_queued;
+  };
+
+  //! One file being read through the ring
+
+  /*!
+   * The file is opened and its size found at the same time, then its head
+   * and tail are read at the same time, and then, if it has an ID3v2 tag
+   * bigger than the head, the rest of the tag is read.
+   */
+
+  struct Slot
+  {
+    enum Stage { Opening, Reading, Extending };
+    enum Request { Open, Stat, Head, Tail };
+
+    Slot() : file(0), stage(Opening), pending(0), failed(false) {}
+
+    Prefetch *file;
+    struct statx stx;
+    ByteVector extension;
+    Stage stage;
+    uint pending;
+    bool failed;
+  };
+
+  unsigned long long userData(uint slot, Slot::Request request)
+  {
+    return (unsigned long long)(slot) << 2 | request;
+  }
+
+  void readRange(Ring &ring, uint slot, Slot::Request request, int fd, ByteVector &buffer, long offset)
+  {
+    struct io_uring_sqe *sqe = ring.queue(IORING_OP_READ, fd, userData(slot, request));
+    sqe->addr = (unsigned long long)(buffer.data());
+    sqe->len = buffer.size();
+    sqe->off = offset;
+  }
+
+  // Moves the slot on to its next stage once its requests are in.  Returns
+  // true once the file has been read.
+
+  bool advance(Ring &ring, Slot &s, uint slot, uint headSize, uint tailSize)
+  {
+    Prefetch *p = s.file;
+
+    if(s.failed) {
+      if(p->fd >= 0)
+        close(p->fd);
+      p->fd = -1;
+      return true;
+    }
+
+    if(s.stage == Slot::Opening) {
+      p->size = s.stx.stx_size;
+      p->head.resize(headLength(p->size, headSize));
+      p->tailOffset = tailOffset(p->size, p->head.size(), tailSize);
+      p->tail.resize(p->tailOffset < p->size ? uint(p->size - p->tailOffset) : 0);
+      s.stage = Slot::Reading;
+
+      if(!p->head.isEmpty()) {
+        readRange(ring, slot, Slot::Head, p->fd, p->head, 0);
+        s.pending++;
+      }
+      if(!p->tail.isEmpty()) {
+        readRange(ring, slot, Slot::Tail, p->fd, p->tail, p->tailOffset);
+        s.pending++;
+      }
+      return s.pending == 0;
+    }
+
+    if(s.stage == Slot::Reading) {
+      const uint length = completeHeadLength(p->head, p->size);
+      if(length > p->head.size()) {
+        s.stage = Slot::Extending;
+        s.extension.resize(length - p->head.size());
+        readRange(ring, slot, Slot::Head, p->fd, s.extension, p->head.size());
+        s.pending++;
+        return false;
+      }
+    }
+
+    return true;
+  }
+
+  void complete(Slot &s, Slot::Request request, int result)
+  {
+    s.pending--;
+
+    // A failed read just leaves less prefetched; the stream reads the rest.
+
+    switch(request) {
+    case Slot::Open:
+      if(result >= 0)
+        s.file->fd = result;
+      else
+        s.failed = true;
+      break;
+    case Slot::Stat:
+      if(result < 0)
+        s.failed = true;
+      break;
+    case Slot::Head:
+      if(s.stage == Slot::Extending) {
+        s.extension.resize(result > 0 ? result : 0);
+        s.file->head.append(s.extension);
+        s.extension.clear();
+      }
+      else
+        s.file->head.resize(result > 0 ? result : 0);
+      break;
+    case Slot::Tail:
+      s.file->tail.resize(result > 0 ? result : 0);
+      break;
+    }
+  }
+
+#endif // HAVE_IO_URING
+
+}
+
+#endif // _WIN32
+
+////////////////////////////////////////////////////////////////////////////////
+// public members
+////////////////////////////////////////////////////////////////////////////////
+
+FileScanner::FileScanner(bool readAudioProperties,
+                         AudioProperties::ReadStyle audioPropertiesStyle)
+{
+  d = new FileScannerPrivate(readAudioProperties, audioPropertiesStyle);
+}
+
+FileScanner::~FileScanner()
+{
+  delete d;
+}
+
+void FileScanner::setBackend(Backend backend)
+{
+  d->backend = backend;
+}
+
+FileScanner::Backend FileScanner::backend() const
+{
+  return d->backend;
+}
+
+void FileScanner::setMaxInFlight(uint files)
+{
+  d->maxInFlight = files > 0 ? files : 1;
+}
+
+void FileScanner::setPrefetchSize(uint head, uint tail)
+{
+  d->headSize = head;
+  d->tailSize = tail;
+}
+
+ulong FileScanner::extraReads() const
+{
+  return d->extraReads;
+}
+
+#ifdef _WIN32
+
+uint FileScanner::scan(const StringList &paths, Handler *handler)
+{
+  // Without the POSIX calls the files are simply opened one after the other.
+
+  uint count = 0;
+  d->extraReads = 0;
+  d->backend = Threads;
+
+  for(StringList::ConstIterator it = paths.begin(); it != paths.end(); ++it) {
+    FileRef ref(FileName(it->toWString().c_str()), d->readAudioProperties, d->audioPropertiesStyle);
+    if(!ref.isNull())
+      count++;
+    handler->scanned(*it, ref);
+  }
+
+  return count;
+}
+
+#else
+
+uint FileScanner::scan(const StringList &paths, Handler *handler)
+{
+  d->extraReads = 0;
+
+  // The tags are always read here, on the calling thread; only the reading
+  // of the prefetched data is spread out.
+
+  class Deliver
+  {
+  public:
+    Deliver(FileScannerPrivate *d, Handler *handler) : m_d(d), m_handler(handler), m_count(0) {}
+
+    void operator()(Prefetch *p)
+    {
+      if(p->fd < 0) {
+        m_handler->scanned(p->path, FileRef());
+        delete p;
+        return;
+      }
+
+      PrefetchedStream *stream = new PrefetchedStream(p);
+      FileRef ref(stream, m_d->readAudioProperties, m_d->audioPropertiesStyle);
+      ref.adoptStream(stream);
+      if(!ref.isNull())
+        m_count++;
+
+      m_handler->scanned(p->path, ref);
+      m_d->extraReads += stream->extraReads();
+      delete p;
+    }
+
+    uint count() const { return m_count; }
+
+  private:
+    FileScannerPrivate *m_d;
+    Handler *m_handler;
+    uint m_count;
+  } deliver(d, handler);
+
+#ifdef HAVE_IO_URING
+
+  if(d->backend != Threads) {
+    Ring ring;
+
+    if(ring.setup(d->maxInFlight * 2)) {
+      d->backend = IOUring;
+
+      // The slots hold the buffers the kernel reads into.
+
+      std::vector<Slot> *slots = new std::vector<Slot>(d->maxInFlight);
+      std::vector<uint> idle;
+      std::vector<uint> finished;
+      StringList::ConstIterator next = paths.begin();
+      uint active = 0;
+
+      for(uint i = d->maxInFlight; i > 0; i--)
+        idle.push_back(i - 1);
+
+      while(next != paths.end() || active > 0) {
+
+        while(next != paths.end() && !idle.empty()) {
+          const uint slot = idle.back();
+          idle.pop_back();
+
+          Slot &s = (*slots)[slot];
+          s = Slot();
+          s.file = new Prefetch(*next);
+          ++next;
+
+          struct io_uring_sqe *sqe = ring.queue(IORING_OP_OPENAT, AT_FDCWD, userData(slot, Slot::Open));
+          sqe->addr = (unsigned long long)(s.file->name.c_str());
+          sqe->open_flags = O_RDONLY | O_CLOEXEC;
+
+          sqe = ring.queue(IORING_OP_STATX, AT_FDCWD, userData(slot, Slot::Stat));
+          sqe->addr = (unsigned long long)(s.file->name.c_str());
+          sqe->len = STATX_SIZE;
+          sqe->off = (unsigned long long)(&s.stx);
+
+          s.pending = 2;
+          active++;
+        }
+
+        if(!ring.submitAndWait()) {
+          debug("FileScanner::scan() -- io_uring_enter() failed");
+          break;
+        }
+
+        unsigned long long data;
+        int result;
+
+        while(ring.next(&data, &result)) {
+          const uint slot = uint(data >> 2);
+          Slot &s = (*slots)[slot];
+
+          complete(s, Slot::Request(data & 3), result);
+
+          if(s.pending == 0 && advance(ring, s, slot, d->headSize, d->tailSize))
+            finished.push_back(slot);
+        }
+
+        for(std::vector<uint>::const_iterator it = finished.begin(); it != finished.end(); ++it) {
+          deliver((*slots)[*it].file);
+          (*slots)[*it].file = 0;
+          idle.push_back(*it);
+          active--;
+        }
+        finished.clear();
+      }
+
+      if(active == 0)
+        delete slots;
+      else {
+        // The ring broke down with reads still in flight, which may yet write
+        // into the slots, so they are left alone rather than freed.  The files
+        // are still handed over, as unreadable.
+
+        for(std::vector<Slot>::const_iterator it = slots->begin(); it != slots->end(); ++it) {
+          if(it->file)
+            deliver(new Prefetch(it->file->path));
+        }
+        for(; next != paths.end(); ++next)
+          deliver(new Prefetch(*next));
+      }
+
+      return deliver.count();
+    }
+
+    if(d->backend == IOUring) {
+      debug("FileScanner::scan() -- io_uring is not available");
+      return 0;
+    }
+  }
+
+#else
+
+  if(d->backend == IOUring) {
+    debug("FileScanner::scan() -- io_uring is not available");
+    return 0;
+  }
+
+#endif
+
+  d->backend = Threads;
+
+  ReaderPool pool;
+  pthread_mutex_init(&pool.mutex, 0);
+  pthread_cond_init(&pool.changed, 0);
+  pool.paths = &paths;
+  pool.next = paths.begin();
+  pool.inFlight = 0;
+  pool.maxInFlight = d->maxInFlight;
+  pool.headSize = d->headSize;
+  pool.tailSize = d->tailSize;
+
+  // Each reader blocks on one file at a time, so there's a thread for every
+  // file in flight, up to a point.
+
+  const uint threadCount = d->maxInFlight < 16 ? d->maxInFlight : 16;
+  std::vector<pthread_t> threads;
+
+  for(uint i = 0; i < threadCount; i++) {
+    pthread_t thread;
+    if(pthread_create(&thread, 0, readFiles, &pool) == 0)
+      threads.push_back(thread);
+  }
+
+  if(threads.empty()) {
+    // Nothing else would take the files off the done list, so each one is
+    // read and handed over in turn here.
+
+    debug("FileScanner::scan() -- could not start the reader threads");
+
+    for(StringList::ConstIterator it = paths.begin(); it != paths.end(); ++it) {
+      Prefetch *p = new Prefetch(*it);
+      prefetch(p, d->headSize, d->tailSize);
+      deliver(p);
+    }
+  }
+
+  for(uint remaining = threads.empty() ? 0 : paths.size(); remaining > 0; remaining--) {
+    pthread_mutex_lock(&pool.mutex);
+    while(pool.done.empty())
+      pthread_cond_wait(&pool.changed, &pool.mutex);
+    Prefetch *p = pool.done.front();
+    pool.done.pop_front();
+    pthread_mutex_unlock(&pool.mutex);
+
+    deliver(p);
+
+    pthread_mutex_lock(&pool.mutex);
+    pool.inFlight--;
+    pthread_cond_broadcast(&pool.changed);
+    pthread_mutex_unlock(&pool.mutex);
+  }
+
+  for(std::vector<pthread_t>::const_iterator it = threads.begin(); it != threads.end(); ++it)
+    pthread_join(*it, 0);
+
+  pthread_cond_destroy(&pool.changed);
+  pthread_mutex_destroy(&pool.mutex);
+
+  return deliver.count();
+}
+
+#endif
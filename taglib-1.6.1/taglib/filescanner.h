@@ -0,0 +1,159 @@
+/***************************************************************************
+ *   This library is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Lesser General Public License version   *
+ *   2.1 as published by the Free Software Foundation.                     *
+ *                                                                         *
+ *   This library is distributed in the hope that it will be useful, but   *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU     *
+ *   Lesser General Public License for more details.                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU Lesser General Public      *
+ *   License along with this library; if not, write to the Free Software   *
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  *
+ *   USA                                                                   *
+ *                                                                         *
+ *   Alternatively, this file is available under the Mozilla Public        *
+ *   License Version 1.1.  You may obtain a copy of the License at         *
+ *   http://www.mozilla.org/MPL/                                           *
+ ***************************************************************************/
+
+#ifndef TAGLIB_FILESCANNER_H
+#define TAGLIB_FILESCANNER_H
+
+#include "fileref.h"
+#include "tstringlist.h"
+
+#include "taglib_export.h"
+#include "audioproperties.h"
+
+namespace TagLib {
+
+  //! Reads the tags of many files with their I/O overlapped
+
+  /*!
+   * Opening files one at a time with FileRef spends most of its time waiting:
+   * each file is opened, its head is read for the tag header and then its
+   * tail for ID3v1, APE or the last MPEG frame, and every one of those is a
+   * round trip to the disk.  FileScanner keeps many files in flight at once
+   * instead.  It opens them, finds their size and reads their head and tail
+   * in batches, and then reads the tags from those buffers, so only the files
+   * whose tags need more than that do any further I/O.
+   *
+   * On Linux the reads are queued with io_uring where the kernel supports it;
+   * elsewhere (or if io_uring can't be set up) a pool of threads does them.
+   *
+   * \code
+   *
+   * class Printer : public TagLib::FileScanner::Handler
+   * {
+   *   void scanned(const TagLib::String &path, const TagLib::FileRef &ref)
+   *   {
+   *     if(!ref.isNull())
+   *       std::cout << path << ": " << ref.tag()->title() << std::endl;
+   *   }
+   * };
+   *
+   * Printer printer;
+   * TagLib::FileScanner().scan(paths, &printer);
+   *
+   * \endcode
+   *
+   * \note The files are opened read only, so the FileRefs handed out can't be
+   * saved; open the file by name to change its tags.
+   */
+
+  class TAGLIB_EXPORT FileScanner
+  {
+  public:
+
+    /*!
+     * The way the files are read.
+     */
+    enum Backend {
+      //! io_uring if the kernel supports it, otherwise threads
+      Automatic,
+      //! Only io_uring; scan() reads nothing if it isn't available
+      IOUring,
+      //! A pool of threads doing blocking reads
+      Threads
+    };
+
+    //! Receives the files as they are scanned
+
+    class TAGLIB_EXPORT Handler
+    {
+      TAGLIB_IGNORE_MISSING_DESTRUCTOR
+    public:
+      /*!
+       * Called once for each file given to scan(), in the order in which their
+       * reads complete rather than the order they were given in.  \a ref is
+       * null if the file could not be opened or its type was not recognized.
+       *
+       * This is always called on the thread that called scan().
+       */
+      virtual void scanned(const String &path, const FileRef &ref) = 0;
+    };
+
+    /*!
+     * Creates a scanner.  If \a readAudioProperties is true the audio
+     * properties of each file will be read using \a audioPropertiesStyle,
+     * as with FileRef.
+     */
+    FileScanner(bool readAudioProperties = true,
+                AudioProperties::ReadStyle
+                audioPropertiesStyle = AudioProperties::Average);
+
+    /*!
+     * Destroys this FileScanner instance.
+     */
+    ~FileScanner();
+
+    /*!
+     * Sets the way the files are read to \a backend.  The default is
+     * Automatic.
+     */
+    void setBackend(Backend backend);
+
+    /*!
+     * Returns the way the files were read by the last call to scan(), or the
+     * requested backend if scan() has not been called yet.
+     */
+    Backend backend() const;
+
+    /*!
+     * Sets the number of files that are opened and read at the same time.
+     * The default is 64.
+     */
+    void setMaxInFlight(uint files);
+
+    /*!
+     * Sets the number of bytes read from the start and the end of each file.
+     * The defaults are 64 KiB and 16 KiB.  An ID3v2 tag that is bigger than
+     * the head is read whole, as long as it is under 16 MiB.
+     */
+    void setPrefetchSize(uint head, uint tail);
+
+    /*!
+     * Reads the tags of the files in \a paths, calling \a handler for each of
+     * them.  Returns the number of files that could be read.
+     */
+    uint scan(const StringList &paths, Handler *handler);
+
+    /*!
+     * Returns the number of reads during the last scan() that the prefetched
+     * buffers could not satisfy, and so went to the file.
+     */
+    ulong extraReads() const;
+
+  private:
+    FileScanner(const FileScanner &);
+    FileScanner &operator=(const FileScanner &);
+
+    class FileScannerPrivate;
+    FileScannerPrivate *d;
+  };
+
+} // namespace TagLib
+
+#endif
@@ -24,6 +24,7 @@
  ***************************************************************************/
 
 #include <tbytevector.h>
+#include <tbytevectorreader.h>
 #include <tstring.h>
 #include <tlist.h>
 #include <tdebug.h>
@@ -110,6 +111,15 @@ FLAC::File::File(FileName file, ID3v2::FrameFactory *frameFactory,
   read(readProperties, propertiesStyle);
 }
 
+FLAC::File::File(IOStream *stream, ID3v2::FrameFactory *frameFactory,
+                 bool readProperties, Properties::ReadStyle propertiesStyle) :
+  TagLib::File(stream)
+{
+  d = new FilePrivate;
+  d->ID3v2FrameFactory = frameFactory;
+  read(readProperties, propertiesStyle);
+}
+
 FLAC::File::~File()
 {
   delete d;
@@ -137,6 +147,16 @@ bool FLAC::File::save()
 
   Tag::duplicate(&d->tag, xiphComment(true), true);
 
+  // Nothing needs to be written if the tags are all in the file already and
+  // none of them have been changed.
+
+  if(d->hasXiphComment && !xiphComment()->isModified() &&
+     (!ID3v2Tag() || (d->hasID3v2 && !ID3v2Tag()->isModified())) &&
+     (!ID3v1Tag() || (d->hasID3v1 && !ID3v1Tag()->isModified())))
+  {
+    return true;
+  }
+
   d->xiphCommentData = xiphComment()->render(false);
 
   // A Xiph comment portion of the data stream starts with a 4-byte descriptor.
@@ -165,7 +185,7 @@ bool FLAC::File::save()
       ByteVector header = readBlock(4);
       char blockType = header[0] & 0x7f;
       isLastBlock = (header[0] & 0x80) != 0;
-      uint blockLength = header.mid(1, 3).toUInt();
+      uint blockLength = ByteVectorReader(header, 1).readUInt24();
 
       if(blockType == VorbisComment) {
 
@@ -223,7 +243,7 @@ bool FLAC::File::save()
 
     ByteVector header = readBlock(4);
     bool isLastBlock = (header[0] & 0x80) != 0;
-    uint blockLength = header.mid(1, 3).toUInt();
+    uint blockLength = ByteVectorReader(header, 1).readUInt24();
 
     if(isLastBlock) {
 
@@ -241,9 +261,11 @@ bool FLAC::File::save()
     d->hasXiphComment = true;
   }
 
+  xiphComment()->setModified(false);
+
   // Update ID3 tags
 
-  if(ID3v2Tag()) {
+  if(ID3v2Tag() && (!d->hasID3v2 || ID3v2Tag()->isModified())) {
     if(d->hasID3v2) {
       if(d->ID3v2Location < d->flacStart)
         debug("FLAC::File::save() -- This can't be right -- an ID3v2 tag after the "
@@ -253,11 +275,13 @@ bool FLAC::File::save()
     }
     else
       insert(ID3v2Tag()->render(), 0, 0);
+    ID3v2Tag()->setModified(false);
   }
 
-  if(ID3v1Tag()) {
+  if(ID3v1Tag() && (!d->hasID3v1 || ID3v1Tag()->isModified())) {
     seek(-128, End);
     writeBlock(ID3v1Tag()->render());
+    ID3v1Tag()->setModified(false);
   }
 
   return true;
@@ -350,6 +374,16 @@ long FLAC::File::streamLength()
   return d->streamLength;
 }
 
+bool FLAC::File::audioRange(long &offset, long &length)
+{
+  if(!isValid() || !d->scanned)
+    return false;
+
+  offset = d->streamStart;
+  length = d->streamLength;
+  return true;
+}
+
 void FLAC::File::scan()
 {
   // Scan the metadata pages
@@ -392,7 +426,7 @@ void FLAC::File::scan()
 
   char blockType = header[0] & 0x7f;
   bool isLastBlock = (header[0] & 0x80) != 0;
-  uint length = header.mid(1, 3).toUInt();
+  uint length = ByteVectorReader(header, 1).readUInt24();
 
   // First block should be the stream_info metadata
 
@@ -412,7 +446,7 @@ void FLAC::File::scan()
     header = readBlock(4);
     blockType = header[0] & 0x7f;
     isLastBlock = (header[0] & 0x80) != 0;
-    length = header.mid(1, 3).toUInt();
+    length = ByteVectorReader(header, 1).readUInt24();
 
     // Found the vorbis-comment
     if(blockType == VorbisComment) {
@@ -480,7 +514,7 @@ long FLAC::File::findPaddingBreak(long nextBlockOffset, long targetOffset, bool
     ByteVector header = readBlock(4);
     char blockType = header[0] & 0x7f;
     bool isLastBlock = header[0] & 0x80;
-    uint length = header.mid(1, 3).toUInt();
+    uint length = ByteVectorReader(header, 1).readUInt24();
 
     if(blockType != Padding)
       break;
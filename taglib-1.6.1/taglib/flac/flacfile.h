@@ -88,6 +88,21 @@ namespace TagLib {
            bool readProperties = true,
            Properties::ReadStyle propertiesStyle = Properties::Average);
 
+      /*!
+       * Contructs a FLAC file from \a stream.  If \a readProperties is true the
+       * file's audio properties will also be read using \a propertiesStyle.  If
+       * false, \a propertiesStyle is ignored.
+       *
+       * If this file contains and ID3v2 tag the frames will be created using
+       * \a frameFactory.
+       *
+       * \note TagLib will *not* take ownership of the stream, the caller is
+       * responsible for deleting it after the File object.
+       */
+      File(IOStream *stream, ID3v2::FrameFactory *frameFactory,
+           bool readProperties = true,
+           Properties::ReadStyle propertiesStyle = Properties::Average);
+
       /*!
        * Destroys this instance of the File.
        */
@@ -118,6 +133,14 @@ namespace TagLib {
        */
       virtual bool save();
 
+      /*!
+       * Sets \a offset and \a length to the FLAC frames after the metadata
+       * blocks, up to the ID3v1 tag if there is one.
+       *
+       * \see TagLib::File::audioRange()
+       */
+      virtual bool audioRange(long &offset, long &length);
+
       /*!
        * Returns a pointer to the ID3v2 tag of the file.
        *
@@ -24,6 +24,7 @@
  ***************************************************************************/
 
 #include <tstring.h>
+#include <tbytevectorreader.h>
 #include <tdebug.h>
 
 #include "flacproperties.h"
@@ -111,21 +112,21 @@ void FLAC::Properties::read()
     return;
   }
 
-  int pos = 0;
+  ByteVectorReader reader(d->data);
 
   // Minimum block size (in samples)
-  pos += 2;
+  reader.skip(2);
 
   // Maximum block size (in samples)
-  pos += 2;
+  reader.skip(2);
 
   // Minimum frame size (in bytes)
-  pos += 3;
+  reader.skip(3);
 
   // Maximum frame size (in bytes)
-  pos += 3;
+  reader.skip(3);
 
-  uint flags = d->data.mid(pos, 4).toUInt(true);
+  uint flags = reader.readUInt32();
   d->sampleRate = flags >> 12;
   d->channels = ((flags >> 9) & 7) + 1;
   d->sampleWidth = ((flags >> 4) & 31) + 1;
@@ -134,11 +135,9 @@ void FLAC::Properties::read()
   // stream length in samples. (Audio files measured in days)
 
   uint highLength =d->sampleRate > 0 ? (((flags & 0xf) << 28) / d->sampleRate) << 4 : 0;
-  pos += 4;
 
   d->length = d->sampleRate > 0 ?
-      (d->data.mid(pos, 4).toUInt(true)) / d->sampleRate + highLength : 0;
-  pos += 4;
+      reader.readUInt32() / d->sampleRate + highLength : 0;
 
   // Uncompressed bitrate:
 
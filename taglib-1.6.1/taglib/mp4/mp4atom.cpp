@@ -31,6 +31,7 @@
 
 #include <tdebug.h>
 #include <tstring.h>
+#include <tbytevectorreader.h>
 #include "mp4atom.h"
 
 using namespace TagLib;
@@ -53,7 +54,7 @@ MP4::Atom::Atom(File *file)
     return;
   }
 
-  length = header.mid(0, 4).toUInt();
+  length = ByteVectorReader(header).readUInt32();
 
   if (length == 1) {
     long long longLength = file->readBlock(8).toLongLong();
@@ -72,6 +72,13 @@ MP4::File::File(FileName file, bool readProperties, AudioProperties::ReadStyle a
   read(readProperties, audioPropertiesStyle);
 }
 
+MP4::File::File(IOStream *stream, bool readProperties, AudioProperties::ReadStyle audioPropertiesStyle)
+    : TagLib::File(stream)
+{
+  d = new FilePrivate;
+  read(readProperties, audioPropertiesStyle);
+}
+
 MP4::File::~File()
 {
   delete d;
@@ -128,4 +135,24 @@ MP4::File::save()
   return d->tag->save();
 }
 
+bool
+MP4::File::audioRange(long &offset, long &length)
+{
+  if(!isValid())
+    return false;
+
+  MP4::Atom *mdat = d->atoms->find("mdat");
+  if(!mdat)
+    return false;
+
+  // Skip the atom header, which has a 64-bit size if the 32-bit one is 1.
+
+  seek(mdat->offset);
+  long headerSize = readBlock(4).toUInt() == 1 ? 16 : 8;
+
+  offset = mdat->offset + headerSize;
+  length = mdat->length - headerSize;
+  return true;
+}
+
 #endif
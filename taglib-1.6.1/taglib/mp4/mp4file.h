@@ -58,6 +58,16 @@ namespace TagLib {
        */
       File(FileName file, bool readProperties = true, Properties::ReadStyle audioPropertiesStyle = Properties::Average);
 
+      /*!
+       * Contructs a MP4 file from \a stream.  If \a readProperties is true the
+       * file's audio properties will also be read using \a propertiesStyle.  If
+       * false, \a propertiesStyle is ignored.
+       *
+       * \note TagLib will *not* take ownership of the stream, the caller is
+       * responsible for deleting it after the File object.
+       */
+      File(IOStream *stream, bool readProperties = true, Properties::ReadStyle audioPropertiesStyle = Properties::Average);
+
       /*!
        * Destroys this instance of the File.
        */
@@ -87,6 +97,13 @@ namespace TagLib {
        */
       bool save();
 
+      /*!
+       * Sets \a offset and \a length to the contents of the mdat atom.
+       *
+       * \see TagLib::File::audioRange()
+       */
+      virtual bool audioRange(long &offset, long &length);
+
     private:
 
       void read(bool readProperties, Properties::ReadStyle audioPropertiesStyle);
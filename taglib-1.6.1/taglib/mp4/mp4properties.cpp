@@ -31,6 +31,7 @@
 
 #include <tdebug.h>
 #include <tstring.h>
+#include <tbytevectorreader.h>
 #include "mp4file.h"
 #include "mp4atom.h"
 #include "mp4properties.h"
@@ -92,13 +93,15 @@ MP4::Properties::Properties(File *file, MP4::Atoms *atoms, ReadStyle style)
   file->seek(mdhd->offset);
   data = file->readBlock(mdhd->length);
   if(data[8] == 0) {
-    unsigned int unit = data.mid(20, 4).toUInt();
-    unsigned int length = data.mid(24, 4).toUInt();
+    ByteVectorReader reader(data, 20);
+    unsigned int unit = reader.readUInt32();
+    unsigned int length = reader.readUInt32();
     d->length = length / unit;
   }
   else {
-    long long unit = data.mid(28, 8).toLongLong();
-    long long length = data.mid(36, 8).toLongLong();
+    ByteVectorReader reader(data, 28);
+    long long unit = reader.readUInt64();
+    long long length = reader.readUInt64();
     d->length = int(length / unit);
   }
 
@@ -109,23 +112,25 @@ MP4::Properties::Properties(File *file, MP4::Atoms *atoms, ReadStyle style)
 
   file->seek(atom->offset);
   data = file->readBlock(atom->length);
-  if(data.mid(20, 4) == "mp4a") {
-    d->channels = data.mid(40, 2).toShort();
-    d->bitsPerSample = data.mid(42, 2).toShort();
-    d->sampleRate = data.mid(46, 4).toUInt();
-    if(data.mid(56, 4) == "esds" && data[64] == 0x03) {
+  if(data.containsAt("mp4a", 20)) {
+    ByteVectorReader reader(data, 40);
+    d->channels = reader.readUInt16();
+    d->bitsPerSample = reader.readUInt16();
+    reader.skip(2);
+    d->sampleRate = reader.readUInt32();
+    if(data.containsAt("esds", 56) && data[64] == 0x03) {
       long pos = 65;
-      if(data.mid(pos, 3) == "\x80\x80\x80") {
+      if(data.containsAt("\x80\x80\x80", pos)) {
         pos += 3;
       }
       pos += 4;
       if(data[pos] == 0x04) {
         pos += 1;
-        if(data.mid(pos, 3) == "\x80\x80\x80") {
+        if(data.containsAt("\x80\x80\x80", pos)) {
           pos += 3;
         }
         pos += 10;
-        d->bitrate = (data.mid(pos, 4).toUInt() + 500) / 1000;
+        d->bitrate = (ByteVectorReader(data, pos).readUInt32() + 500) / 1000;
       }
     }
   }
@@ -31,6 +31,8 @@
 
 #include <tdebug.h>
 #include <tstring.h>
+#include <tbytevectorreader.h>
+#include <tbytevectorwriter.h>
 #include "mp4atom.h"
 #include "mp4tag.h"
 #include "id3v1genres.h"
@@ -47,6 +49,21 @@ public:
   ItemListMap items;
 };
 
+namespace
+{
+  // A "data" atom is its size and name, the type flags, four reserved bytes
+  // and then the value, so it takes 16 bytes more than the value.
+
+  void writeDataAtom(ByteVectorWriter &writer, uint flags, const ByteVector &value)
+  {
+    writer.writeUInt32(16 + value.size());
+    writer.writeBlock("data");
+    writer.writeUInt32(flags);
+    writer.writeUInt32(0);
+    writer.writeBlock(value);
+  }
+}
+
 MP4::Tag::Tag(File *file, MP4::Atoms *atoms)
 {
   d = new TagPrivate;
@@ -99,9 +116,10 @@ MP4::Tag::parseData(MP4::Atom *atom, TagLib::File *file, int expectedFlags, bool
   int i = 0;
   unsigned int pos = 0;
   while(pos < data.size()) {
-    int length = data.mid(pos, 4).toUInt();
-    ByteVector name = data.mid(pos + 4, 4);
-    int flags = data.mid(pos + 8, 4).toUInt();
+    ByteVectorReader reader(data, pos);
+    int length = reader.readUInt32();
+    ByteVector name = reader.readBlock(4);
+    int flags = reader.readUInt32();
     if(freeForm && i < 2) {
       if(i == 0 && name != "mean") {
         debug("MP4: Unexpected atom \"" + name + "\", expecting \"mean\"");
@@ -154,8 +172,9 @@ MP4::Tag::parseIntPair(MP4::Atom *atom, TagLib::File *file)
 {
   ByteVectorList data = parseData(atom, file);
   if(data.size()) {
-    int a = data[0].mid(2, 2).toShort();
-    int b = data[0].mid(4, 2).toShort();
+    ByteVectorReader reader(data[0], 2);
+    int a = reader.readUInt16();
+    int b = reader.readUInt16();
     d->items.insert(atom->name, MP4::Item(a, b));
   }
 }
@@ -204,9 +223,10 @@ MP4::Tag::parseCovr(MP4::Atom *atom, TagLib::File *file)
   ByteVector data = file->readBlock(atom->length - 8);
   unsigned int pos = 0;
   while(pos < data.size()) {
-    int length = data.mid(pos, 4).toUInt();
-    ByteVector name = data.mid(pos + 4, 4);
-    int flags = data.mid(pos + 8, 4).toUInt();
+    ByteVectorReader reader(data, pos);
+    int length = reader.readUInt32();
+    ByteVector name = reader.readBlock(4);
+    int flags = reader.readUInt32();
     if(name != "data") {
       debug("MP4: Unexpected atom \"" + name + "\", expecting \"data\"");
       return;
@@ -233,17 +253,27 @@ MP4::Tag::padIlst(const ByteVector &data, int length)
 ByteVector
 MP4::Tag::renderAtom(const ByteVector &name, const ByteVector &data)
 {
-  return ByteVector::fromUInt(data.size() + 8) + name + data;
+  ByteVectorWriter writer(data.size() + 8);
+  writer.writeUInt32(data.size() + 8);
+  writer.writeBlock(name);
+  writer.writeBlock(data);
+  return writer.data();
 }
 
 ByteVector
 MP4::Tag::renderData(const ByteVector &name, int flags, const ByteVectorList &data)
 {
-  ByteVector result;
+  uint size = 8;
   for(unsigned int i = 0; i < data.size(); i++) {
-    result.append(renderAtom("data", ByteVector::fromUInt(flags) + ByteVector(4, '\0') + data[i]));
+    size += 16 + data[i].size();
   }
-  return renderAtom(name, result);
+  ByteVectorWriter writer(size);
+  writer.writeUInt32(size);
+  writer.writeBlock(name);
+  for(unsigned int i = 0; i < data.size(); i++) {
+    writeDataAtom(writer, flags, data[i]);
+  }
+  return writer.data();
 }
 
 ByteVector
@@ -297,13 +327,18 @@ MP4::Tag::renderText(const ByteVector &name, MP4::Item &item, int flags)
 ByteVector
 MP4::Tag::renderCovr(const ByteVector &name, MP4::Item &item)
 {
-  ByteVector data;
   MP4::CoverArtList value = item.toCoverArtList();
+  uint size = 8;
+  for(unsigned int i = 0; i < value.size(); i++) {
+    size += 16 + value[i].data().size();
+  }
+  ByteVectorWriter writer(size);
+  writer.writeUInt32(size);
+  writer.writeBlock(name);
   for(unsigned int i = 0; i < value.size(); i++) {
-    data.append(renderAtom("data", ByteVector::fromUInt(value[i].format()) +
-                                   ByteVector(4, '\0') + value[i].data()));
+    writeDataAtom(writer, value[i].format(), value[i].data());
   }
-  return renderAtom(name, data);
+  return writer.data();
 }
 
 ByteVector
@@ -314,48 +349,86 @@ MP4::Tag::renderFreeForm(const String &name, MP4::Item &item)
     debug("MP4: Invalid free-form item name \"" + name + "\"");
     return ByteVector::null;
   }
-  ByteVector data;
-  data.append(renderAtom("mean", ByteVector::fromUInt(0) + header[1].data(String::UTF8)));
-  data.append(renderAtom("name", ByteVector::fromUInt(0) + header[2].data(String::UTF8)));
+  ByteVector mean = header[1].data(String::UTF8);
+  ByteVector key = header[2].data(String::UTF8);
+  ByteVectorList data;
   StringList value = item.toStringList();
+  uint size = 8 + 12 + mean.size() + 12 + key.size();
   for(unsigned int i = 0; i < value.size(); i++) {
-    data.append(renderAtom("data", ByteVector::fromUInt(1) + ByteVector(4, '\0') + value[i].data(String::UTF8)));
+    data.append(value[i].data(String::UTF8));
+    size += 16 + data.back().size();
   }
-  return renderAtom("----", data);
+  ByteVectorWriter writer(size);
+  writer.writeUInt32(size);
+  writer.writeBlock("----");
+  writer.writeUInt32(12 + mean.size());
+  writer.writeBlock("mean");
+  writer.writeUInt32(0);
+  writer.writeBlock(mean);
+  writer.writeUInt32(12 + key.size());
+  writer.writeBlock("name");
+  writer.writeUInt32(0);
+  writer.writeBlock(key);
+  for(ByteVectorList::ConstIterator it = data.begin(); it != data.end(); ++it) {
+    writeDataAtom(writer, 1, *it);
+  }
+  return writer.data();
 }
 
 bool
 MP4::Tag::save()
 {
-  ByteVector data;
+  if(!isModified())
+    return true;
+
+  ByteVectorList items;
   for(MP4::ItemListMap::Iterator i = d->items.begin(); i != d->items.end(); i++) {
     const String name = i->first;
     if(name.startsWith("----")) {
-      data.append(renderFreeForm(name, i->second));
+      items.append(renderFreeForm(name, i->second));
     }
     else if(name == "trkn") {
-      data.append(renderIntPair(name.data(String::Latin1), i->second));
+      items.append(renderIntPair(name.data(String::Latin1), i->second));
     }
     else if(name == "disk") {
-      data.append(renderIntPairNoTrailing(name.data(String::Latin1), i->second));
+      items.append(renderIntPairNoTrailing(name.data(String::Latin1), i->second));
     }
     else if(name == "cpil" || name == "pgap" || name == "pcst") {
-      data.append(renderBool(name.data(String::Latin1), i->second));
+      items.append(renderBool(name.data(String::Latin1), i->second));
     }
     else if(name == "tmpo") {
-      data.append(renderInt(name.data(String::Latin1), i->second));
+      items.append(renderInt(name.data(String::Latin1), i->second));
     }
     else if(name == "covr") {
-      data.append(renderCovr(name.data(String::Latin1), i->second));
+      items.append(renderCovr(name.data(String::Latin1), i->second));
     }
     else if(name.size() == 4){
-      data.append(renderText(name.data(String::Latin1), i->second));
+      items.append(renderText(name.data(String::Latin1), i->second));
     }
     else {
       debug("MP4: Unknown item name \"" + name + "\"");
     }
   }
-  data = renderAtom("ilst", data);
+
+  uint size = 8;
+  for(ByteVectorList::ConstIterator it = items.begin(); it != items.end(); ++it) {
+    size += it->size();
+  }
+
+  // Leave room for the padding that saveNew() or saveExisting() appends, so
+  // that doesn't copy the whole 'ilst' atom again.  The writer goes out of
+  // scope first so that the vector isn't shared when it is appended to.
+
+  ByteVector data;
+  {
+    ByteVectorWriter writer(size + 2048);
+    writer.writeUInt32(size);
+    writer.writeBlock("ilst");
+    for(ByteVectorList::ConstIterator it = items.begin(); it != items.end(); ++it) {
+      writer.writeBlock(*it);
+    }
+    data = writer.data();
+  }
 
   AtomList path = d->atoms->path("moov", "udta", "meta", "ilst");
   if(path.size() == 4) {
@@ -365,6 +438,7 @@ MP4::Tag::save()
     saveNew(data);
   }
 
+  setModified(false);
   return true;
 }
 
@@ -403,16 +477,18 @@ MP4::Tag::updateOffsets(long delta, long offset)
       }
       d->file->seek(atom->offset + 12);
       ByteVector data = d->file->readBlock(atom->length - 12);
-      unsigned int count = data.mid(0, 4).toUInt();
+      ByteVectorReader reader(data);
+      unsigned int count = reader.readUInt32();
       d->file->seek(atom->offset + 16);
-      int pos = 4;
       while(count--) {
-        long o = data.mid(pos, 4).toUInt();
+        long o = reader.readUInt32();
+        if(!reader.isValid()) {
+          break;
+        }
         if(o > offset) {
           o += delta;
         }
         d->file->writeBlock(ByteVector::fromUInt(o));
-        pos += 4;
       }
     }
 
@@ -424,16 +500,18 @@ MP4::Tag::updateOffsets(long delta, long offset)
       }
       d->file->seek(atom->offset + 12);
       ByteVector data = d->file->readBlock(atom->length - 12);
-      unsigned int count = data.mid(0, 4).toUInt();
+      ByteVectorReader reader(data);
+      unsigned int count = reader.readUInt32();
       d->file->seek(atom->offset + 16);
-      int pos = 4;
       while(count--) {
-        long long o = data.mid(pos, 8).toLongLong();
+        long long o = reader.readUInt64();
+        if(!reader.isValid()) {
+          break;
+        }
         if(o > offset) {
           o += delta;
         }
         d->file->writeBlock(ByteVector::fromLongLong(o));
-        pos += 8;
       }
     }
   }
@@ -447,10 +525,11 @@ MP4::Tag::updateOffsets(long delta, long offset)
         atom->offset += delta;
       }
       d->file->seek(atom->offset + 9);
-      ByteVector data = d->file->readBlock(atom->offset - 9);
-      unsigned int flags = (ByteVector(1, '\0') + data.mid(0, 3)).toUInt();
+      ByteVectorReader reader(d->file->readBlock(atom->length - 9));
+      unsigned int flags = reader.readUInt24();
       if(flags & 1) {
-        long long o = data.mid(7, 8).toLongLong();
+        reader.skip(4);
+        long long o = reader.readUInt64();
         if(o > offset) {
           o += delta;
         }
@@ -464,16 +543,35 @@ MP4::Tag::updateOffsets(long delta, long offset)
 void
 MP4::Tag::saveNew(ByteVector &data)
 {
-  data = renderAtom("meta", TagLib::ByteVector(4, '\0') +
-                    renderAtom("hdlr", TagLib::ByteVector(8, '\0') + TagLib::ByteVector("mdirappl") + TagLib::ByteVector(9, '\0')) +
-                    data + padIlst(data));
-
   AtomList path = d->atoms->path("moov", "udta");
-  if(path.size() != 2) {
+  const bool udta = path.size() != 2;
+  if(udta) {
     path = d->atoms->path("moov");
-    data = renderAtom("udta", data);
   }
 
+  // 'meta' holds its version and flags, an 'hdlr' atom, 'ilst' and padding,
+  // and is wrapped in a new 'udta' atom if there isn't one already.
+
+  const ByteVector padding = padIlst(data);
+  const uint metaSize = 8 + 4 + 33 + data.size() + padding.size();
+
+  ByteVectorWriter writer((udta ? 8 : 0) + metaSize);
+  if(udta) {
+    writer.writeUInt32(8 + metaSize);
+    writer.writeBlock("udta");
+  }
+  writer.writeUInt32(metaSize);
+  writer.writeBlock("meta");
+  writer.writeUInt32(0);
+  writer.writeUInt32(33);
+  writer.writeBlock("hdlr");
+  writer.fill(8);
+  writer.writeBlock("mdirappl");
+  writer.fill(9);
+  writer.writeBlock(data);
+  writer.writeBlock(padding);
+  data = writer.data();
+
   long offset = path[path.size() - 1]->offset + 8;
   d->file->insert(data, offset, 0);
 
@@ -588,49 +686,71 @@ MP4::Tag::track() const
 void
 MP4::Tag::setTitle(const String &value)
 {
-  d->items["\251nam"] = StringList(value);
+  setTextItem("\251nam", StringList(value));
 }
 
 void
 MP4::Tag::setArtist(const String &value)
 {
-  d->items["\251ART"] = StringList(value);
+  setTextItem("\251ART", StringList(value));
 }
 
 void
 MP4::Tag::setAlbum(const String &value)
 {
-  d->items["\251alb"] = StringList(value);
+  setTextItem("\251alb", StringList(value));
 }
 
 void
 MP4::Tag::setComment(const String &value)
 {
-  d->items["\251cmt"] = StringList(value);
+  setTextItem("\251cmt", StringList(value));
 }
 
 void
 MP4::Tag::setGenre(const String &value)
 {
-  d->items["\251gen"] = StringList(value);
+  setTextItem("\251gen", StringList(value));
 }
 
 void
 MP4::Tag::setYear(uint value)
 {
-  d->items["\251day"] = StringList(String::number(value));
+  setTextItem("\251day", StringList(String::number(value)));
 }
 
 void
 MP4::Tag::setTrack(uint value)
 {
-  d->items["trkn"] = MP4::Item(value, 0);
+  if(!d->items.contains("trkn") || d->items["trkn"].toIntPair().first != int(value) ||
+     d->items["trkn"].toIntPair().second != 0)
+  {
+    d->items["trkn"] = MP4::Item(value, 0);
+    setModified();
+  }
 }
 
 MP4::ItemListMap &
 MP4::Tag::itemListMap()
+{
+  // The items may be changed through the returned reference.
+  setModified();
+  return d->items;
+}
+
+const MP4::ItemListMap &
+MP4::Tag::itemListMap() const
 {
   return d->items;
 }
 
+void
+MP4::Tag::setTextItem(const String &name, const StringList &value)
+{
+  if(!d->items.contains(name) || d->items[name].toStringList() != value) {
+    d->items[name] = value;
+    setModified();
+  }
+}
+
 #endif
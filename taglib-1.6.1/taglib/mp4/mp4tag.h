@@ -64,9 +64,20 @@ namespace TagLib {
         void setYear(uint value);
         void setTrack(uint value);
 
+        /*!
+         * Returns the items of the tag.  Since they can be changed through
+         * the returned reference, this marks the tag as modified.
+         */
         ItemListMap &itemListMap();
 
+        /*!
+         * Returns the items of the tag without marking it as modified.
+         */
+        const ItemListMap &itemListMap() const;
+
     private:
+        void setTextItem(const String &name, const StringList &value);
+
         TagLib::ByteVectorList parseData(Atom *atom, TagLib::File *file, int expectedFlags = -1, bool freeForm = false);
         void parseText(Atom *atom, TagLib::File *file, int expectedFlags = 1);
         void parseFreeForm(Atom *atom, TagLib::File *file);
@@ -96,6 +96,13 @@ MPC::File::File(FileName file, bool readProperties,
   read(readProperties, propertiesStyle);
 }
 
+MPC::File::File(IOStream *stream, bool readProperties,
+                Properties::ReadStyle propertiesStyle) : TagLib::File(stream)
+{
+  d = new FilePrivate;
+  read(readProperties, propertiesStyle);
+}
+
 MPC::File::~File()
 {
   delete d;
@@ -133,8 +140,10 @@ bool MPC::File::save()
 
   if(ID3v1Tag()) {
     if(d->hasID3v1) {
-      seek(d->ID3v1Location);
-      writeBlock(ID3v1Tag()->render());
+      if(ID3v1Tag()->isModified()) {
+        seek(d->ID3v1Location);
+        writeBlock(ID3v1Tag()->render());
+      }
     }
     else {
       seek(0, End);
@@ -142,6 +151,7 @@ bool MPC::File::save()
       writeBlock(ID3v1Tag()->render());
       d->hasID3v1 = true;
     }
+    ID3v1Tag()->setModified(false);
   } else
     if(d->hasID3v1) {
       removeBlock(d->ID3v1Location, 128);
@@ -155,8 +165,15 @@ bool MPC::File::save()
   // Update APE tag
 
   if(APETag()) {
-    if(d->hasAPE)
-      insert(APETag()->render(), d->APELocation, d->APESize);
+    if(d->hasAPE) {
+      if(APETag()->isModified()) {
+        const long oldSize = d->APESize;
+        insert(APETag()->render(), d->APELocation, d->APESize);
+        d->APESize = APETag()->footer()->completeTagSize();
+        if(d->hasID3v1 && d->ID3v1Location > d->APELocation)
+          d->ID3v1Location += long(d->APESize) - oldSize;
+      }
+    }
     else {
       if(d->hasID3v1)  {
         insert(APETag()->render(), d->ID3v1Location, 0);
@@ -173,6 +190,7 @@ bool MPC::File::save()
         d->hasAPE = true;
       }
     }
+    APETag()->setModified(false);
   }
   else
     if(d->hasAPE) {
@@ -223,6 +241,24 @@ void MPC::File::remove(int tags)
 }
 
 
+bool MPC::File::audioRange(long &offset, long &length)
+{
+  if(!isValid())
+    return false;
+
+  long start = d->hasID3v2 ? d->ID3v2Location + long(d->ID3v2Size) : 0;
+  long end = File::length();
+
+  if(d->hasAPE && d->APELocation >= start && d->APELocation < end)
+    end = d->APELocation;
+  if(d->hasID3v1 && d->ID3v1Location >= start && d->ID3v1Location < end)
+    end = d->ID3v1Location;
+
+  offset = start;
+  length = end > start ? end - start : 0;
+  return true;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // private members
 ////////////////////////////////////////////////////////////////////////////////
@@ -88,6 +88,17 @@ namespace TagLib {
       File(FileName file, bool readProperties = true,
            Properties::ReadStyle propertiesStyle = Properties::Average);
 
+      /*!
+       * Contructs an MPC file from \a stream.  If \a readProperties is true the
+       * file's audio properties will also be read using \a propertiesStyle.  If
+       * false, \a propertiesStyle is ignored.
+       *
+       * \note TagLib will *not* take ownership of the stream, the caller is
+       * responsible for deleting it after the File object.
+       */
+      File(IOStream *stream, bool readProperties = true,
+           Properties::ReadStyle propertiesStyle = Properties::Average);
+
       /*!
        * Destroys this instance of the File.
        */
@@ -110,6 +121,14 @@ namespace TagLib {
        */
       virtual bool save();
 
+      /*!
+       * Sets \a offset and \a length to the Musepack stream between the
+       * ID3v2 tag and the APE or ID3v1 tag at the end of the file.
+       *
+       * \see TagLib::File::audioRange()
+       */
+      virtual bool audioRange(long &offset, long &length);
+
       /*!
        * Returns a pointer to the ID3v1 tag of the file.
        *
@@ -24,6 +24,7 @@
  ***************************************************************************/
 
 #include <tstring.h>
+#include <tbytevectorreader.h>
 #include <tdebug.h>
 #include <bitset>
 
@@ -109,16 +110,18 @@ void MPC::Properties::read()
   d->version = d->data[3] & 15;
 
   unsigned int frames;
+  ByteVectorReader reader(d->data);
 
   if(d->version >= 7) {
-    frames = d->data.mid(4, 4).toUInt(false);
+    reader.seek(4);
+    frames = reader.readUInt32(false);
 
-    std::bitset<32> flags = d->data.mid(8, 4).toUInt(false);
+    std::bitset<32> flags = reader.readUInt32(false);
     d->sampleRate = sftable[flags[17] * 2 + flags[16]];
     d->channels = 2;
   }
   else {
-    uint headerData = d->data.mid(0, 4).toUInt(false);
+    uint headerData = reader.readUInt32(false);
 
     d->bitrate = (headerData >> 23) & 0x01ff;
     d->version = (headerData >> 11) & 0x03ff;
@@ -126,9 +129,11 @@ void MPC::Properties::read()
     d->channels = 2;
 
     if(d->version >= 5)
-      frames = d->data.mid(4, 4).toUInt(false);
-    else
-      frames = d->data.mid(6, 2).toUInt(false);
+      frames = reader.readUInt32(false);
+    else {
+      reader.skip(2);
+      frames = reader.readUInt16(false);
+    }
   }
 
   uint samples = frames * 1152 - 576;
@@ -154,37 +154,61 @@ TagLib::uint ID3v1::Tag::track() const
 
 void ID3v1::Tag::setTitle(const String &s)
 {
-  d->title = s;
+  if(d->title != s) {
+    d->title = s;
+    setModified();
+  }
 }
 
 void ID3v1::Tag::setArtist(const String &s)
 {
-  d->artist = s;
+  if(d->artist != s) {
+    d->artist = s;
+    setModified();
+  }
 }
 
 void ID3v1::Tag::setAlbum(const String &s)
 {
-  d->album = s;
+  if(d->album != s) {
+    d->album = s;
+    setModified();
+  }
 }
 
 void ID3v1::Tag::setComment(const String &s)
 {
-  d->comment = s;
+  if(d->comment != s) {
+    d->comment = s;
+    setModified();
+  }
 }
 
 void ID3v1::Tag::setGenre(const String &s)
 {
-  d->genre = ID3v1::genreIndex(s);
+  const uchar genre = ID3v1::genreIndex(s);
+  if(d->genre != genre) {
+    d->genre = genre;
+    setModified();
+  }
 }
 
 void ID3v1::Tag::setYear(uint i)
 {
-  d->year = i > 0 ? String::number(i) : String::null;
+  const String year = i > 0 ? String::number(i) : String::null;
+  if(d->year != year) {
+    d->year = year;
+    setModified();
+  }
 }
 
 void ID3v1::Tag::setTrack(uint i)
 {
-  d->track = i < 256 ? i : 0;
+  const uchar track = i < 256 ? i : 0;
+  if(d->track != track) {
+    d->track = track;
+    setModified();
+  }
 }
 
 void ID3v1::Tag::setStringHandler(const StringHandler *handler)
@@ -26,6 +26,7 @@
 #include "attachedpictureframe.h"
 
 #include <tstringlist.h>
+#include <tbytevectorwriter.h>
 #include <tdebug.h>
 
 using namespace TagLib;
@@ -77,7 +78,10 @@ String::Type AttachedPictureFrame::textEncoding() const
 
 void AttachedPictureFrame::setTextEncoding(String::Type t)
 {
-  d->textEncoding = t;
+  if(d->textEncoding != t) {
+    d->textEncoding = t;
+    setModified();
+  }
 }
 
 String AttachedPictureFrame::mimeType() const
@@ -87,7 +91,10 @@ String AttachedPictureFrame::mimeType() const
 
 void AttachedPictureFrame::setMimeType(const String &m)
 {
-  d->mimeType = m;
+  if(d->mimeType != m) {
+    d->mimeType = m;
+    setModified();
+  }
 }
 
 AttachedPictureFrame::Type AttachedPictureFrame::type() const
@@ -97,7 +104,10 @@ AttachedPictureFrame::Type AttachedPictureFrame::type() const
 
 void AttachedPictureFrame::setType(Type t)
 {
-  d->type = t;
+  if(d->type != t) {
+    d->type = t;
+    setModified();
+  }
 }
 
 String AttachedPictureFrame::description() const
@@ -107,7 +117,10 @@ String AttachedPictureFrame::description() const
 
 void AttachedPictureFrame::setDescription(const String &desc)
 {
-  d->description = desc;
+  if(d->description != desc) {
+    d->description = desc;
+    setModified();
+  }
 }
 
 ByteVector AttachedPictureFrame::picture() const
@@ -117,7 +130,10 @@ ByteVector AttachedPictureFrame::picture() const
 
 void AttachedPictureFrame::setPicture(const ByteVector &p)
 {
-  d->data = p;
+  if(d->data != p) {
+    d->data = p;
+    setModified();
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -150,19 +166,30 @@ void AttachedPictureFrame::parseFields(const ByteVector &data)
 
 ByteVector AttachedPictureFrame::renderFields() const
 {
-  ByteVector data;
+  ByteVectorWriter writer(fieldsSize());
+  writeFields(writer);
+  return writer.data();
+}
 
+TagLib::uint AttachedPictureFrame::fieldsSize() const
+{
   String::Type encoding = checkEncoding(d->description, d->textEncoding);
 
-  data.append(char(encoding));
-  data.append(d->mimeType.data(String::Latin1));
-  data.append(textDelimiter(String::Latin1));
-  data.append(char(d->type));
-  data.append(d->description.data(encoding));
-  data.append(textDelimiter(encoding));
-  data.append(d->data);
+  return 1 + d->mimeType.size() + 1 + 1 + textSize(d->description, encoding) +
+    textDelimiter(encoding).size() + d->data.size();
+}
+
+void AttachedPictureFrame::writeFields(ByteVectorWriter &writer) const
+{
+  String::Type encoding = checkEncoding(d->description, d->textEncoding);
 
-  return data;
+  writer.writeByte(uchar(encoding));
+  writer.writeBlock(d->mimeType.data(String::Latin1));
+  writer.writeBlock(textDelimiter(String::Latin1));
+  writer.writeByte(uchar(d->type));
+  writer.writeBlock(d->description.data(encoding));
+  writer.writeBlock(textDelimiter(encoding));
+  writer.writeBlock(d->data);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
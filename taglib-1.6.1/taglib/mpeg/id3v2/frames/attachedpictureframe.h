@@ -205,6 +205,8 @@ namespace TagLib {
     protected:
       virtual void parseFields(const ByteVector &data);
       virtual ByteVector renderFields() const;
+      virtual uint fieldsSize() const;
+      virtual void writeFields(ByteVectorWriter &writer) const;
       class AttachedPictureFramePrivate;
       AttachedPictureFramePrivate *d;
 
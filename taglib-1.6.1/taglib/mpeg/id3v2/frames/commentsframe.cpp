@@ -24,6 +24,7 @@
  ***************************************************************************/
 
 #include <tbytevectorlist.h>
+#include <tbytevectorwriter.h>
 #include <id3v2tag.h>
 #include <tdebug.h>
 #include <tstringlist.h>
@@ -86,17 +87,26 @@ String CommentsFrame::text() const
 
 void CommentsFrame::setLanguage(const ByteVector &languageEncoding)
 {
-  d->language = languageEncoding.mid(0, 3);
+  if(d->language != languageEncoding.mid(0, 3)) {
+    d->language = languageEncoding.mid(0, 3);
+    setModified();
+  }
 }
 
 void CommentsFrame::setDescription(const String &s)
 {
-  d->description = s;
+  if(d->description != s) {
+    d->description = s;
+    setModified();
+  }
 }
 
 void CommentsFrame::setText(const String &s)
 {
-  d->text = s;
+  if(d->text != s) {
+    d->text = s;
+    setModified();
+  }
 }
 
 String::Type CommentsFrame::textEncoding() const
@@ -106,7 +116,10 @@ String::Type CommentsFrame::textEncoding() const
 
 void CommentsFrame::setTextEncoding(String::Type encoding)
 {
-  d->textEncoding = encoding;
+  if(d->textEncoding != encoding) {
+    d->textEncoding = encoding;
+    setModified();
+  }
 }
 
 CommentsFrame *CommentsFrame::findByDescription(const ID3v2::Tag *tag, const String &d) // static
@@ -151,20 +164,34 @@ void CommentsFrame::parseFields(const ByteVector &data)
 
 ByteVector CommentsFrame::renderFields() const
 {
-  ByteVector v;
+  ByteVectorWriter writer(fieldsSize());
+  writeFields(writer);
+  return writer.data();
+}
 
+TagLib::uint CommentsFrame::fieldsSize() const
+{
   String::Type encoding = d->textEncoding;
 
   encoding = checkEncoding(d->description, encoding);
   encoding = checkEncoding(d->text, encoding);
 
-  v.append(char(encoding));
-  v.append(d->language.size() == 3 ? d->language : "XXX");
-  v.append(d->description.data(encoding));
-  v.append(textDelimiter(encoding));
-  v.append(d->text.data(encoding));
+  return 1 + 3 + textSize(d->description, encoding) +
+    textDelimiter(encoding).size() + textSize(d->text, encoding);
+}
+
+void CommentsFrame::writeFields(ByteVectorWriter &writer) const
+{
+  String::Type encoding = d->textEncoding;
+
+  encoding = checkEncoding(d->description, encoding);
+  encoding = checkEncoding(d->text, encoding);
 
-  return v;
+  writer.writeByte(uchar(encoding));
+  writer.writeBlock(d->language.size() == 3 ? d->language : "XXX");
+  writer.writeBlock(d->description.data(encoding));
+  writer.writeBlock(textDelimiter(encoding));
+  writer.writeBlock(d->text.data(encoding));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
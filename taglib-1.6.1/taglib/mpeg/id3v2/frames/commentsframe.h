@@ -150,6 +150,8 @@ namespace TagLib {
 
       virtual void parseFields(const ByteVector &data);
       virtual ByteVector renderFields() const;
+      virtual uint fieldsSize() const;
+      virtual void writeFields(ByteVectorWriter &writer) const;
 
     private:
       /*!
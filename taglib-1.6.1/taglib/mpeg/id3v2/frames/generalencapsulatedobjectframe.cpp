@@ -26,6 +26,7 @@
  ***************************************************************************/
 
 #include <tdebug.h>
+#include <tbytevectorwriter.h>
 
 #include "generalencapsulatedobjectframe.h"
 
@@ -84,7 +85,10 @@ String::Type GeneralEncapsulatedObjectFrame::textEncoding() const
 
 void GeneralEncapsulatedObjectFrame::setTextEncoding(String::Type encoding)
 {
-  d->textEncoding = encoding;
+  if(d->textEncoding != encoding) {
+    d->textEncoding = encoding;
+    setModified();
+  }
 }
 
 String GeneralEncapsulatedObjectFrame::mimeType() const
@@ -94,7 +98,10 @@ String GeneralEncapsulatedObjectFrame::mimeType() const
 
 void GeneralEncapsulatedObjectFrame::setMimeType(const String &type)
 {
-  d->mimeType = type;
+  if(d->mimeType != type) {
+    d->mimeType = type;
+    setModified();
+  }
 }
 
 String GeneralEncapsulatedObjectFrame::fileName() const
@@ -104,7 +111,10 @@ String GeneralEncapsulatedObjectFrame::fileName() const
 
 void GeneralEncapsulatedObjectFrame::setFileName(const String &name)
 {
-  d->fileName = name;
+  if(d->fileName != name) {
+    d->fileName = name;
+    setModified();
+  }
 }
 
 String GeneralEncapsulatedObjectFrame::description() const
@@ -114,7 +124,10 @@ String GeneralEncapsulatedObjectFrame::description() const
 
 void GeneralEncapsulatedObjectFrame::setDescription(const String &desc)
 {
-  d->description = desc;
+  if(d->description != desc) {
+    d->description = desc;
+    setModified();
+  }
 }
 
 ByteVector GeneralEncapsulatedObjectFrame::object() const
@@ -124,7 +137,10 @@ ByteVector GeneralEncapsulatedObjectFrame::object() const
 
 void GeneralEncapsulatedObjectFrame::setObject(const ByteVector &data)
 {
-  d->data = data;
+  if(d->data != data) {
+    d->data = data;
+    setModified();
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -151,18 +167,31 @@ void GeneralEncapsulatedObjectFrame::parseFields(const ByteVector &data)
 
 ByteVector GeneralEncapsulatedObjectFrame::renderFields() const
 {
-  ByteVector data;
+  ByteVectorWriter writer(fieldsSize());
+  writeFields(writer);
+  return writer.data();
+}
 
-  data.append(char(d->textEncoding));
-  data.append(d->mimeType.data(String::Latin1));
-  data.append(textDelimiter(String::Latin1));
-  data.append(d->fileName.data(d->textEncoding));
-  data.append(textDelimiter(d->textEncoding));
-  data.append(d->description.data(d->textEncoding));
-  data.append(textDelimiter(d->textEncoding));
-  data.append(d->data);
+TagLib::uint GeneralEncapsulatedObjectFrame::fieldsSize() const
+{
+  const uint delimiterSize = textDelimiter(d->textEncoding).size();
 
-  return data;
+  return 1 + d->mimeType.size() + 1 +
+    textSize(d->fileName, d->textEncoding) + delimiterSize +
+    textSize(d->description, d->textEncoding) + delimiterSize +
+    d->data.size();
+}
+
+void GeneralEncapsulatedObjectFrame::writeFields(ByteVectorWriter &writer) const
+{
+  writer.writeByte(uchar(d->textEncoding));
+  writer.writeBlock(d->mimeType.data(String::Latin1));
+  writer.writeBlock(textDelimiter(String::Latin1));
+  writer.writeBlock(d->fileName.data(d->textEncoding));
+  writer.writeBlock(textDelimiter(d->textEncoding));
+  writer.writeBlock(d->description.data(d->textEncoding));
+  writer.writeBlock(textDelimiter(d->textEncoding));
+  writer.writeBlock(d->data);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -163,6 +163,8 @@ namespace TagLib {
     protected:
       virtual void parseFields(const ByteVector &data);
       virtual ByteVector renderFields() const;
+      virtual uint fieldsSize() const;
+      virtual void writeFields(ByteVectorWriter &writer) const;
 
     private:
       GeneralEncapsulatedObjectFrame(const ByteVector &data, Header *h);
@@ -24,6 +24,7 @@
  ***************************************************************************/
 
 #include <tdebug.h>
+#include <tbytevectorreader.h>
 
 #include "popularimeterframe.h"
 
@@ -71,7 +72,10 @@ String PopularimeterFrame::email() const
 
 void PopularimeterFrame::setEmail(const String &s)
 {
-  d->email = s;
+  if(d->email != s) {
+    d->email = s;
+    setModified();
+  }
 }
 
 int PopularimeterFrame::rating() const
@@ -81,7 +85,10 @@ int PopularimeterFrame::rating() const
 
 void PopularimeterFrame::setRating(int s)
 {
-  d->rating = s;
+  if(d->rating != s) {
+    d->rating = s;
+    setModified();
+  }
 }
 
 TagLib::uint PopularimeterFrame::counter() const
@@ -91,7 +98,10 @@ TagLib::uint PopularimeterFrame::counter() const
 
 void PopularimeterFrame::setCounter(TagLib::uint s)
 {
-  d->counter = s;
+  if(d->counter != s) {
+    d->counter = s;
+    setModified();
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -109,7 +119,7 @@ void PopularimeterFrame::parseFields(const ByteVector &data)
   if(pos < size) {
     d->rating = (unsigned char)(data[pos++]);
     if(pos < size) {
-      d->counter = data.mid(pos, 4).toUInt();
+      d->counter = ByteVectorReader(data, pos).readUInt32();
     }
   }
 }
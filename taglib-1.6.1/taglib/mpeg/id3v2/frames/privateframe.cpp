@@ -25,6 +25,7 @@
  ***************************************************************************/
 
 #include <tbytevectorlist.h>
+#include <tbytevectorwriter.h>
 #include <id3v2tag.h>
 #include <tdebug.h>
 
@@ -78,12 +79,18 @@ ByteVector PrivateFrame::data() const
 
 void PrivateFrame::setOwner(const String &s)
 {
-  d->owner = s;
+  if(d->owner != s) {
+    d->owner = s;
+    setModified();
+  }
 }
 
 void PrivateFrame::setData(const ByteVector & data)
 {
-  d->data = data;
+  if(d->data != data) {
+    d->data = data;
+    setModified();
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -108,13 +115,21 @@ void PrivateFrame::parseFields(const ByteVector &data)
 
 ByteVector PrivateFrame::renderFields() const
 {
-  ByteVector v;
+  ByteVectorWriter writer(fieldsSize());
+  writeFields(writer);
+  return writer.data();
+}
 
-  v.append(d->owner.data(String::Latin1));
-  v.append(textDelimiter(String::Latin1));
-  v.append(d->data);
+TagLib::uint PrivateFrame::fieldsSize() const
+{
+  return d->owner.size() + 1 + d->data.size();
+}
 
-  return v;
+void PrivateFrame::writeFields(ByteVectorWriter &writer) const
+{
+  writer.writeBlock(d->owner.data(String::Latin1));
+  writer.writeBlock(textDelimiter(String::Latin1));
+  writer.writeBlock(d->data);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -24,6 +24,7 @@
  ***************************************************************************/
 
 #include <tdebug.h>
+#include <tbytevectorreader.h>
 #include <tmap.h>
 
 #include "relativevolumeframe.h"
@@ -115,6 +116,7 @@ short RelativeVolumeFrame::volumeAdjustmentIndex() const
 void RelativeVolumeFrame::setVolumeAdjustmentIndex(short index, ChannelType type)
 {
   d->channels[type].volumeAdjustment = index;
+  setModified();
 }
 
 void RelativeVolumeFrame::setVolumeAdjustmentIndex(short index)
@@ -135,6 +137,7 @@ float RelativeVolumeFrame::volumeAdjustment() const
 void RelativeVolumeFrame::setVolumeAdjustment(float adjustment, ChannelType type)
 {
   d->channels[type].volumeAdjustment = short(adjustment * float(512));
+  setModified();
 }
 
 void RelativeVolumeFrame::setVolumeAdjustment(float adjustment)
@@ -155,6 +158,7 @@ RelativeVolumeFrame::PeakVolume RelativeVolumeFrame::peakVolume() const
 void RelativeVolumeFrame::setPeakVolume(const PeakVolume &peak, ChannelType type)
 {
   d->channels[type].peakVolume = peak;
+  setModified();
 }
 
 void RelativeVolumeFrame::setPeakVolume(const PeakVolume &peak)
@@ -169,7 +173,10 @@ String RelativeVolumeFrame::identification() const
 
 void RelativeVolumeFrame::setIdentification(const String &s)
 {
-  d->identification = s;
+  if(d->identification != s) {
+    d->identification = s;
+    setModified();
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -181,25 +188,22 @@ void RelativeVolumeFrame::parseFields(const ByteVector &data)
   int pos = 0;
   d->identification = readStringField(data, String::Latin1, &pos);
 
-  // Each channel is at least 4 bytes.
+  ByteVectorReader reader(data, pos);
 
-  while(pos <= (int)data.size() - 4) {
+  // Each channel is at least 4 bytes.
 
+  while(reader.remaining() >= 4) {
 
-    ChannelType type = ChannelType(data[pos]);
-    pos += 1;
+    ChannelType type = ChannelType(reader.readByte());
 
     ChannelData &channel = d->channels[type];
 
-    channel.volumeAdjustment = data.mid(pos, 2).toShort();
-    pos += 2;
+    channel.volumeAdjustment = short(reader.readUInt16());
 
-    channel.peakVolume.bitsRepresentingPeak = data[pos];
-    pos += 1;
+    channel.peakVolume.bitsRepresentingPeak = reader.readByte();
 
     int bytes = bitsToBytes(channel.peakVolume.bitsRepresentingPeak);
-    channel.peakVolume.peakVolume = data.mid(pos, bytes);
-    pos += bytes;
+    channel.peakVolume.peakVolume = reader.readBlock(bytes);
   }
 }
 
@@ -24,6 +24,7 @@
  ***************************************************************************/
 
 #include <tbytevectorlist.h>
+#include <tbytevectorwriter.h>
 #include <id3v2tag.h>
 
 #include "textidentificationframe.h"
@@ -64,12 +65,19 @@ TextIdentificationFrame::~TextIdentificationFrame()
 
 void TextIdentificationFrame::setText(const StringList &l)
 {
-  d->fieldList = l;
+  if(d->fieldList != l) {
+    d->fieldList = l;
+    setModified();
+  }
 }
 
 void TextIdentificationFrame::setText(const String &s)
 {
-  d->fieldList = s;
+  const StringList l(s);
+  if(d->fieldList != l) {
+    d->fieldList = l;
+    setModified();
+  }
 }
 
 String TextIdentificationFrame::toString() const
@@ -89,7 +97,10 @@ String::Type TextIdentificationFrame::textEncoding() const
 
 void TextIdentificationFrame::setTextEncoding(String::Type encoding)
 {
-  d->textEncoding = encoding;
+  if(d->textEncoding != encoding) {
+    d->textEncoding = encoding;
+    setModified();
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -138,12 +149,32 @@ void TextIdentificationFrame::parseFields(const ByteVector &data)
 }
 
 ByteVector TextIdentificationFrame::renderFields() const
+{
+  ByteVectorWriter writer(fieldsSize());
+  writeFields(writer);
+  return writer.data();
+}
+
+TagLib::uint TextIdentificationFrame::fieldsSize() const
 {
   String::Type encoding = checkEncoding(d->fieldList, d->textEncoding);
 
-  ByteVector v;
+  uint size = 1;
 
-  v.append(char(encoding));
+  for(StringList::ConstIterator it = d->fieldList.begin(); it != d->fieldList.end(); it++) {
+    if(it != d->fieldList.begin())
+      size += textDelimiter(encoding).size();
+    size += textSize(*it, encoding);
+  }
+
+  return size;
+}
+
+void TextIdentificationFrame::writeFields(ByteVectorWriter &writer) const
+{
+  String::Type encoding = checkEncoding(d->fieldList, d->textEncoding);
+
+  writer.writeByte(uchar(encoding));
 
   for(StringList::ConstIterator it = d->fieldList.begin(); it != d->fieldList.end(); it++) {
 
@@ -152,12 +183,10 @@ ByteVector TextIdentificationFrame::renderFields() const
     // encoding.
 
     if(it != d->fieldList.begin())
-      v.append(textDelimiter(encoding));
+      writer.writeBlock(textDelimiter(encoding));
 
-    v.append((*it).data(encoding));
+    writer.writeBlock((*it).data(encoding));
   }
-
-  return v;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -178,6 +178,8 @@ namespace TagLib {
 
       virtual void parseFields(const ByteVector &data);
       virtual ByteVector renderFields() const;
+      virtual uint fieldsSize() const;
+      virtual void writeFields(ByteVectorWriter &writer) const;
 
       /*!
        * The constructor used by the FrameFactory.
@@ -74,12 +74,18 @@ ByteVector UniqueFileIdentifierFrame::identifier() const
 
 void UniqueFileIdentifierFrame::setOwner(const String &s)
 {
-  d->owner = s;
+  if(d->owner != s) {
+    d->owner = s;
+    setModified();
+  }
 }
 
 void UniqueFileIdentifierFrame::setIdentifier(const ByteVector &v)
 {
-  d->identifier = v;
+  if(d->identifier != v) {
+    d->identifier = v;
+    setModified();
+  }
 }
 
 String UniqueFileIdentifierFrame::toString() const
@@ -23,6 +23,8 @@
  *   http://www.mozilla.org/MPL/                                           *
  ***************************************************************************/
 
+#include <tbytevectorwriter.h>
+
 #include "unknownframe.h"
 
 using namespace TagLib;
@@ -73,6 +75,16 @@ ByteVector UnknownFrame::renderFields() const
   return d->fieldData;
 }
 
+TagLib::uint UnknownFrame::fieldsSize() const
+{
+  return d->fieldData.size();
+}
+
+void UnknownFrame::writeFields(ByteVectorWriter &writer) const
+{
+  writer.writeBlock(d->fieldData);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // private members
 ////////////////////////////////////////////////////////////////////////////////
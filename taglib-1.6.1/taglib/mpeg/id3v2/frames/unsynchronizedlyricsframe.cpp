@@ -27,6 +27,7 @@
 
 #include "unsynchronizedlyricsframe.h"
 #include <tbytevectorlist.h>
+#include <tbytevectorwriter.h>
 #include <tdebug.h>
 
 using namespace TagLib;
@@ -87,17 +88,26 @@ String UnsynchronizedLyricsFrame::text() const
 
 void UnsynchronizedLyricsFrame::setLanguage(const ByteVector &languageEncoding)
 {
-  d->language = languageEncoding.mid(0, 3);
+  if(d->language != languageEncoding.mid(0, 3)) {
+    d->language = languageEncoding.mid(0, 3);
+    setModified();
+  }
 }
 
 void UnsynchronizedLyricsFrame::setDescription(const String &s)
 {
-  d->description = s;
+  if(d->description != s) {
+    d->description = s;
+    setModified();
+  }
 }
 
 void UnsynchronizedLyricsFrame::setText(const String &s)
 {
-  d->text = s;
+  if(d->text != s) {
+    d->text = s;
+    setModified();
+  }
 }
 
 
@@ -108,7 +118,10 @@ String::Type UnsynchronizedLyricsFrame::textEncoding() const
 
 void UnsynchronizedLyricsFrame::setTextEncoding(String::Type encoding)
 {
-  d->textEncoding = encoding;
+  if(d->textEncoding != encoding) {
+    d->textEncoding = encoding;
+    setModified();
+  }
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -139,15 +152,24 @@ void UnsynchronizedLyricsFrame::parseFields(const ByteVector &data)
 
 ByteVector UnsynchronizedLyricsFrame::renderFields() const
 {
-  ByteVector v;
+  ByteVectorWriter writer(fieldsSize());
+  writeFields(writer);
+  return writer.data();
+}
 
-  v.append(char(d->textEncoding));
-  v.append(d->language.size() == 3 ? d->language : "XXX");
-  v.append(d->description.data(d->textEncoding));
-  v.append(textDelimiter(d->textEncoding));
-  v.append(d->text.data(d->textEncoding));
+TagLib::uint UnsynchronizedLyricsFrame::fieldsSize() const
+{
+  return 1 + 3 + textSize(d->description, d->textEncoding) +
+    textDelimiter(d->textEncoding).size() + textSize(d->text, d->textEncoding);
+}
 
-  return v;
+void UnsynchronizedLyricsFrame::writeFields(ByteVectorWriter &writer) const
+{
+  writer.writeByte(uchar(d->textEncoding));
+  writer.writeBlock(d->language.size() == 3 ? d->language : "XXX");
+  writer.writeBlock(d->description.data(d->textEncoding));
+  writer.writeBlock(textDelimiter(d->textEncoding));
+  writer.writeBlock(d->text.data(d->textEncoding));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -60,7 +60,10 @@ UrlLinkFrame::~UrlLinkFrame()
 
 void UrlLinkFrame::setUrl(const String &s)
 {
-  d->url = s;
+  if(d->url != s) {
+    d->url = s;
+    setModified();
+  }
 }
 
 String UrlLinkFrame::url() const
@@ -126,7 +129,10 @@ String::Type UserUrlLinkFrame::textEncoding() const
 
 void UserUrlLinkFrame::setTextEncoding(String::Type encoding)
 {
-  d->textEncoding = encoding;
+  if(d->textEncoding != encoding) {
+    d->textEncoding = encoding;
+    setModified();
+  }
 }
 
 String UserUrlLinkFrame::description() const
@@ -136,7 +142,10 @@ String UserUrlLinkFrame::description() const
 
 void UserUrlLinkFrame::setDescription(const String &s)
 {
-  d->description = s;
+  if(d->description != s) {
+    d->description = s;
+    setModified();
+  }
 }
 
 void UserUrlLinkFrame::parseFields(const ByteVector &data)
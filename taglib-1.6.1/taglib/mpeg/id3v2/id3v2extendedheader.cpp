@@ -23,8 +23,9 @@
  *   http://www.mozilla.org/MPL/                                           *
  ***************************************************************************/
 
+#include <tbytevectorreader.h>
+
 #include "id3v2extendedheader.h"
-#include "id3v2synchdata.h"
 
 using namespace TagLib;
 using namespace ID3v2;
@@ -67,5 +68,5 @@ void ExtendedHeader::setData(const ByteVector &data)
 
 void ExtendedHeader::parse(const ByteVector &data)
 {
-  d->size = SynchData::toUInt(data.mid(0, 4)); // (structure 3.2 "Extended header size")
+  d->size = ByteVectorReader(data).readSynchSafeUInt32(); // (structure 3.2 "Extended header size")
 }
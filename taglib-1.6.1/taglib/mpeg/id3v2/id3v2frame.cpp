@@ -35,6 +35,8 @@
 
 #include <tdebug.h>
 #include <tstringlist.h>
+#include <tbytevectorreader.h>
+#include <tbytevectorwriter.h>
 
 #include "id3v2frame.h"
 #include "id3v2synchdata.h"
@@ -46,7 +48,9 @@ class Frame::FramePrivate
 {
 public:
   FramePrivate() :
-    header(0)
+    header(0),
+    modified(false),
+    tagDataOffset(-1)
     {}
 
   ~FramePrivate()
@@ -55,6 +59,8 @@ public:
   }
 
   Frame::Header *header;
+  bool modified;
+  int tagDataOffset;
 };
 
 namespace
@@ -123,6 +129,7 @@ TagLib::uint Frame::size() const
 void Frame::setData(const ByteVector &data)
 {
   parse(data);
+  setModified();
 }
 
 void Frame::setText(const String &)
@@ -139,10 +146,62 @@ ByteVector Frame::render() const
   return headerData + fieldData;
 }
 
+TagLib::uint Frame::renderedSize() const
+{
+  return headerSize(4) + fieldsSize();
+}
+
+void Frame::render(ByteVectorWriter &writer) const
+{
+  // The header is filled in once the fields have been written, from their
+  // actual size; fieldsSize() is only used to make room for them.
+
+  const uint headerOffset = writer.offset();
+  writer.fill(headerSize(4));
+  writeFields(writer);
+
+  const uint end = writer.offset();
+  d->header->setFrameSize(end - headerOffset - headerSize(4));
+
+  writer.seek(headerOffset);
+  writer.writeBlock(d->header->render());
+  writer.seek(end);
+}
+
+bool Frame::isModified() const
+{
+  return d->modified;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // protected members
 ////////////////////////////////////////////////////////////////////////////////
 
+TagLib::uint Frame::fieldsSize() const
+{
+  return renderFields().size();
+}
+
+void Frame::writeFields(ByteVectorWriter &writer) const
+{
+  writer.writeBlock(renderFields());
+}
+
+TagLib::uint Frame::textSize(const String &s, String::Type t)
+{
+  switch(t) {
+  case String::Latin1:
+    return s.size();
+  case String::UTF16:
+    return 2 + 2 * s.size();
+  case String::UTF16BE:
+  case String::UTF16LE:
+    return 2 * s.size();
+  default:
+    return s.data(t).size();
+  }
+}
+
 Frame::Frame(const ByteVector &data)
 {
   d = new FramePrivate;
@@ -166,6 +225,17 @@ void Frame::setHeader(Header *h, bool deleteCurrent)
     delete d->header;
 
   d->header = h;
+  setModified();
+}
+
+void Frame::setModified(bool modified)
+{
+  // Once changed, the frame no longer matches the bytes it was read from,
+  // even after it has been saved.
+
+  d->modified = modified;
+  if(modified)
+    d->tagDataOffset = -1;
 }
 
 void Frame::parse(const ByteVector &data)
@@ -186,7 +256,7 @@ ByteVector Frame::fieldData(const ByteVector &frameData) const
   uint frameDataLength = size();
 
   if(d->header->compression() || d->header->dataLengthIndicator()) {
-    frameDataLength = SynchData::toUInt(frameData.mid(headerSize, 4));
+    frameDataLength = ByteVectorReader(frameData, headerSize).readSynchSafeUInt32();
     frameDataOffset += 4;
   }
 
@@ -243,6 +313,20 @@ String::Type Frame::checkEncoding(const StringList &fields, String::Type encodin
   return String::Latin1;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+// private members
+////////////////////////////////////////////////////////////////////////////////
+
+int Frame::tagDataOffset() const
+{
+  return d->tagDataOffset;
+}
+
+void Frame::setTagDataOffset(int offset)
+{
+  d->tagDataOffset = offset;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // Frame::Header class
 ////////////////////////////////////////////////////////////////////////////////
@@ -356,7 +440,7 @@ void Frame::Header::setData(const ByteVector &data, uint version)
       return;
     }
 
-    d->frameSize = data.mid(3, 3).toUInt();
+    d->frameSize = ByteVectorReader(data, 3).readUInt24();
 
     break;
   }
@@ -384,7 +468,7 @@ void Frame::Header::setData(const ByteVector &data, uint version)
     // Set the size -- the frame size is the four bytes starting at byte four in
     // the frame header (structure 4)
 
-    d->frameSize = data.mid(4, 4).toUInt();
+    d->frameSize = ByteVectorReader(data, 4).readUInt32();
 
     { // read the first byte of flags
       std::bitset<8> flags(data[8]);
@@ -426,12 +510,12 @@ void Frame::Header::setData(const ByteVector &data, uint version)
     // Set the size -- the frame size is the four bytes starting at byte four in
     // the frame header (structure 4)
 
-    d->frameSize = SynchData::toUInt(data.mid(4, 4));
+    d->frameSize = ByteVectorReader(data, 4).readSynchSafeUInt32();
 #ifndef NO_ITUNES_HACKS
     // iTunes writes v2.4 tags with v2.3-like frame sizes
     if(d->frameSize > 127) {
       if(!isValidFrameID(data.mid(d->frameSize + 10, 4))) {
-        unsigned int uintSize = data.mid(4, 4).toUInt();
+        unsigned int uintSize = ByteVectorReader(data, 4).readUInt32();
         if(isValidFrameID(data.mid(uintSize + 10, 4))) {
           d->frameSize = uintSize;
         }
@@ -33,6 +33,7 @@
 namespace TagLib {
 
   class StringList;
+  class ByteVectorWriter;
 
   namespace ID3v2 {
 
@@ -120,6 +121,25 @@ namespace TagLib {
        */
       ByteVector render() const;
 
+      /*!
+       * Returns the number of bytes that render() gives, header included.
+       */
+      uint renderedSize() const;
+
+      /*!
+       * Renders the frame, header included, at the current position of
+       * \a writer.  Together with renderedSize() this lets a tag be rendered
+       * into a single buffer.
+       */
+      void render(ByteVectorWriter &writer) const;
+
+      /*!
+       * Returns true if the frame has been changed since it was read or last
+       * saved.  A frame that has never been changed is written back from the
+       * bytes it was read from rather than rendered again.
+       */
+      bool isModified() const;
+
       /*!
        * Returns the text delimiter that is used between fields for the string
        * type \a t.
@@ -160,6 +180,13 @@ namespace TagLib {
        */
       void setHeader(Header *h, bool deleteCurrent = true);
 
+      /*!
+       * Sets whether the frame counts as changed since it was read or last
+       * saved.  This must be called by the setters of the subclasses whenever
+       * they change the frame.
+       */
+      void setModified(bool modified = true);
+
       /*!
        * Called by setData() to parse the frame data.  It makes this information
        * available through the public API.
@@ -179,6 +206,26 @@ namespace TagLib {
        */
       virtual ByteVector renderFields() const = 0;
 
+      /*!
+       * Returns the size of the data that renderFields() gives.  The default
+       * renders the fields to measure them.  Frames that can work the size out
+       * without rendering, and in particular the ones that hold large binary
+       * data, should reimplement this along with writeFields().
+       */
+      virtual uint fieldsSize() const;
+
+      /*!
+       * Writes the field data to \a writer.  The default writes the result of
+       * renderFields().
+       */
+      virtual void writeFields(ByteVectorWriter &writer) const;
+
+      /*!
+       * Returns the number of bytes that \a s takes up in the encoding \a t,
+       * as rendered by String::data().
+       */
+      static uint textSize(const String &s, String::Type t);
+
       /*!
        * Returns a ByteVector containing the field data given the frame data.
        * This correctly adjusts for the header size plus any additional frame
@@ -206,6 +253,13 @@ namespace TagLib {
       Frame(const Frame &);
       Frame &operator=(const Frame &);
 
+      /*!
+       * Where the frame starts in the data of the tag it was read from, or -1
+       * if it wasn't read from a tag.  This is set and used by Tag.
+       */
+      int tagDataOffset() const;
+      void setTagDataOffset(int offset);
+
       class FramePrivate;
       friend class FramePrivate;
       FramePrivate *d;
@@ -28,6 +28,7 @@
 #endif
 
 #include <tdebug.h>
+#include <tmap.h>
 
 #include "id3v2framefactory.h"
 #include "id3v2synchdata.h"
@@ -57,6 +58,7 @@ public:
 
   String::Type defaultEncoding;
   bool useDefaultEncoding;
+  Map<uint, FrameCreator> creators;
 
   template <class T> void setTextEncoding(T *frame)
   {
@@ -67,6 +69,126 @@ public:
 
 FrameFactory *FrameFactory::factory = 0;
 
+// Frame IDs are packed into an integer, one character per byte, so that
+// they can be looked up with a switch rather than by comparing strings.
+
+#define FRAME_ID3(a, b, c) ((uint(a) << 16) | (uint(b) << 8) | uint(c))
+#define FRAME_ID4(a, b, c, d) ((uint(a) << 24) | FRAME_ID3(b, c, d))
+
+namespace {
+
+  // Packs \a frameID into \a id and returns false if it has characters that
+  // are not allowed in a frame ID.
+
+  bool packFrameID(const ByteVector &frameID, uint &id)
+  {
+    bool valid = true;
+    id = 0;
+    for(ByteVector::ConstIterator it = frameID.begin(); it != frameID.end(); it++) {
+      if( (*it < 'A' || *it > 'Z') && (*it < '1' || *it > '9') )
+        valid = false;
+      id = (id << 8) | uchar(*it);
+    }
+    return valid;
+  }
+
+  // These return the ID3v2.4 frame ID for an older one, an empty string if
+  // ID3v2.4 has no such frame and it has to be discarded, or null if the
+  // frame ID is kept.
+
+  const char *upgradeFrameIDV22(uint id)
+  {
+    switch(id) {
+    case FRAME_ID3('C','R','M'):
+    case FRAME_ID3('E','Q','U'):
+    case FRAME_ID3('L','N','K'):
+    case FRAME_ID3('R','V','A'):
+    case FRAME_ID3('T','I','M'):
+    case FRAME_ID3('T','S','I'):
+      return "";
+
+    // ID3v2.2 only used 3 bytes for the frame ID, so we need to convert all of
+    // the frames to their 4 byte ID3v2.4 equivalent.
+
+    case FRAME_ID3('B','U','F'): return "RBUF";
+    case FRAME_ID3('C','N','T'): return "PCNT";
+    case FRAME_ID3('C','O','M'): return "COMM";
+    case FRAME_ID3('C','R','A'): return "AENC";
+    case FRAME_ID3('E','T','C'): return "ETCO";
+    case FRAME_ID3('G','E','O'): return "GEOB";
+    case FRAME_ID3('I','P','L'): return "TIPL";
+    case FRAME_ID3('M','C','I'): return "MCDI";
+    case FRAME_ID3('M','L','L'): return "MLLT";
+    case FRAME_ID3('P','O','P'): return "POPM";
+    case FRAME_ID3('R','E','V'): return "RVRB";
+    case FRAME_ID3('S','L','T'): return "SYLT";
+    case FRAME_ID3('S','T','C'): return "SYTC";
+    case FRAME_ID3('T','A','L'): return "TALB";
+    case FRAME_ID3('T','B','P'): return "TBPM";
+    case FRAME_ID3('T','C','M'): return "TCOM";
+    case FRAME_ID3('T','C','O'): return "TCON";
+    case FRAME_ID3('T','C','R'): return "TCOP";
+    case FRAME_ID3('T','D','A'): return "TDRC";
+    case FRAME_ID3('T','D','Y'): return "TDLY";
+    case FRAME_ID3('T','E','N'): return "TENC";
+    case FRAME_ID3('T','F','T'): return "TFLT";
+    case FRAME_ID3('T','K','E'): return "TKEY";
+    case FRAME_ID3('T','L','A'): return "TLAN";
+    case FRAME_ID3('T','L','E'): return "TLEN";
+    case FRAME_ID3('T','M','T'): return "TMED";
+    case FRAME_ID3('T','O','A'): return "TOAL";
+    case FRAME_ID3('T','O','F'): return "TOFN";
+    case FRAME_ID3('T','O','L'): return "TOLY";
+    case FRAME_ID3('T','O','R'): return "TDOR";
+    case FRAME_ID3('T','O','T'): return "TOAL";
+    case FRAME_ID3('T','P','1'): return "TPE1";
+    case FRAME_ID3('T','P','2'): return "TPE2";
+    case FRAME_ID3('T','P','3'): return "TPE3";
+    case FRAME_ID3('T','P','4'): return "TPE4";
+    case FRAME_ID3('T','P','A'): return "TPOS";
+    case FRAME_ID3('T','P','B'): return "TPUB";
+    case FRAME_ID3('T','R','C'): return "TSRC";
+    case FRAME_ID3('T','R','D'): return "TDRC";
+    case FRAME_ID3('T','R','K'): return "TRCK";
+    case FRAME_ID3('T','S','S'): return "TSSE";
+    case FRAME_ID3('T','T','1'): return "TIT1";
+    case FRAME_ID3('T','T','2'): return "TIT2";
+    case FRAME_ID3('T','T','3'): return "TIT3";
+    case FRAME_ID3('T','X','T'): return "TOLY";
+    case FRAME_ID3('T','X','X'): return "TXXX";
+    case FRAME_ID3('T','Y','E'): return "TDRC";
+    case FRAME_ID3('U','F','I'): return "UFID";
+    case FRAME_ID3('U','L','T'): return "USLT";
+    case FRAME_ID3('W','A','F'): return "WOAF";
+    case FRAME_ID3('W','A','R'): return "WOAR";
+    case FRAME_ID3('W','A','S'): return "WOAS";
+    case FRAME_ID3('W','C','M'): return "WCOM";
+    case FRAME_ID3('W','C','P'): return "WCOP";
+    case FRAME_ID3('W','P','B'): return "WPUB";
+    case FRAME_ID3('W','X','X'): return "WXXX";
+    default:
+      return 0;
+    }
+  }
+
+  const char *upgradeFrameIDV23(uint id)
+  {
+    switch(id) {
+    case FRAME_ID4('E','Q','U','A'):
+    case FRAME_ID4('R','V','A','D'):
+    case FRAME_ID4('T','I','M','E'):
+    case FRAME_ID4('T','R','D','A'):
+    case FRAME_ID4('T','S','I','Z'):
+    case FRAME_ID4('T','D','A','T'):
+      return "";
+    case FRAME_ID4('T','O','R','Y'): return "TDOR";
+    case FRAME_ID4('T','Y','E','R'): return "TDRC";
+    default:
+      return 0;
+    }
+  }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // public members
 ////////////////////////////////////////////////////////////////////////////////
@@ -95,12 +217,12 @@ Frame *FrameFactory::createFrame(const ByteVector &origData, Header *tagHeader)
   ByteVector data = origData;
   uint version = tagHeader->majorVersion();
   Frame::Header *header = new Frame::Header(data, version);
-  ByteVector frameID = header->frameID();
+  uint id;
 
   // A quick sanity check -- make sure that the frameID is 4 uppercase Latin1
   // characters.  Also make sure that there is data in the frame.
 
-  if(!frameID.size() == (version < 3 ? 3 : 4) ||
+  if(!packFrameID(header->frameID(), id) ||
      header->frameSize() <= uint(header->dataLengthIndicator() ? 4 : 0) ||
      header->frameSize() > data.size())
   {
@@ -108,13 +230,6 @@ Frame *FrameFactory::createFrame(const ByteVector &origData, Header *tagHeader)
     return 0;
   }
 
-  for(ByteVector::ConstIterator it = frameID.begin(); it != frameID.end(); it++) {
-    if( (*it < 'A' || *it > 'Z') && (*it < '1' || *it > '9') ) {
-      delete header;
-      return 0;
-    }
-  }
-
   if(version > 3 && (tagHeader->unsynchronisation() || header->unsynchronisation())) {
     // Data lengths are not part of the encoded data, but since they are synch-safe
     // integers they will be never actually encoded.
@@ -144,32 +259,42 @@ Frame *FrameFactory::createFrame(const ByteVector &origData, Header *tagHeader)
 
   // updateFrame() might have updated the frame ID.
 
-  frameID = header->frameID();
+  const ByteVector frameID = header->frameID();
+  packFrameID(frameID, id);
 
-  // This is where things get necissarily nasty.  Here we determine which
-  // Frame subclass (or if none is found simply an Frame) based
-  // on the frame ID.  Since there are a lot of possibilities, that means
-  // a lot of if blocks.
+  // Frame types registered by the application come first.
 
-  // Text Identification (frames 4.2)
+  if(!d->creators.isEmpty()) {
+    Map<uint, FrameCreator>::ConstIterator it = d->creators.find(id);
+    if(it != d->creators.end())
+      return it->second(data, header);
+  }
+
+  // Here we determine which Frame subclass (or if none is found simply an
+  // UnknownFrame) based on the frame ID.
 
-  if(frameID.startsWith("T")) {
+  switch(id) {
 
-    TextIdentificationFrame *f = frameID != "TXXX"
-      ? new TextIdentificationFrame(data, header)
-      : new UserTextIdentificationFrame(data, header);
+  // User defined text information (frames 4.2.6)
 
+  case FRAME_ID4('T','X','X','X'): {
+    UserTextIdentificationFrame *f = new UserTextIdentificationFrame(data, header);
     d->setTextEncoding(f);
+    return f;
+  }
 
-    if(frameID == "TCON")
-      updateGenre(f);
+  // Content type (frames 4.2.3)
 
+  case FRAME_ID4('T','C','O','N'): {
+    TextIdentificationFrame *f = new TextIdentificationFrame(data, header);
+    d->setTextEncoding(f);
+    updateGenre(f);
     return f;
   }
 
   // Comments (frames 4.10)
 
-  if(frameID == "COMM") {
+  case FRAME_ID4('C','O','M','M'): {
     CommentsFrame *f = new CommentsFrame(data, header);
     d->setTextEncoding(f);
     return f;
@@ -177,7 +302,7 @@ Frame *FrameFactory::createFrame(const ByteVector &origData, Header *tagHeader)
 
   // Attached Picture (frames 4.14)
 
-  if(frameID == "APIC") {
+  case FRAME_ID4('A','P','I','C'): {
     AttachedPictureFrame *f = new AttachedPictureFrame(data, header);
     d->setTextEncoding(f);
     return f;
@@ -185,46 +310,41 @@ Frame *FrameFactory::createFrame(const ByteVector &origData, Header *tagHeader)
 
   // ID3v2.2 Attached Picture
 
-	if(frameID == "PIC") {
+  case FRAME_ID3('P','I','C'): {
     AttachedPictureFrame *f = new AttachedPictureFrameV22(data, header);
     d->setTextEncoding(f);
     return f;
   }
 
-	// Relative Volume Adjustment (frames 4.11)
+  // Relative Volume Adjustment (frames 4.11)
 
-  if(frameID == "RVA2")
+  case FRAME_ID4('R','V','A','2'):
     return new RelativeVolumeFrame(data, header);
 
   // Unique File Identifier (frames 4.1)
 
-  if(frameID == "UFID")
+  case FRAME_ID4('U','F','I','D'):
     return new UniqueFileIdentifierFrame(data, header);
 
   // General Encapsulated Object (frames 4.15)
 
-  if(frameID == "GEOB") {
+  case FRAME_ID4('G','E','O','B'): {
     GeneralEncapsulatedObjectFrame *f = new GeneralEncapsulatedObjectFrame(data, header);
     d->setTextEncoding(f);
     return f;
   }
 
-  // URL link (frames 4.3)
+  // User defined URL link (frames 4.3.2)
 
-  if(frameID.startsWith("W")) {
-    if(frameID != "WXXX") {
-      return new UrlLinkFrame(data, header);
-    }
-    else {
-      UserUrlLinkFrame *f = new UserUrlLinkFrame(data, header);
-      d->setTextEncoding(f);
-      return f;
-    }
+  case FRAME_ID4('W','X','X','X'): {
+    UserUrlLinkFrame *f = new UserUrlLinkFrame(data, header);
+    d->setTextEncoding(f);
+    return f;
   }
 
   // Unsynchronized lyric/text transcription (frames 4.8)
 
-  if(frameID == "USLT") {
+  case FRAME_ID4('U','S','L','T'): {
     UnsynchronizedLyricsFrame *f = new UnsynchronizedLyricsFrame(data, header);
     if(d->useDefaultEncoding)
       f->setTextEncoding(d->defaultEncoding);
@@ -233,13 +353,27 @@ Frame *FrameFactory::createFrame(const ByteVector &origData, Header *tagHeader)
 
   // Popularimeter (frames 4.17)
 
-  if(frameID == "POPM")
+  case FRAME_ID4('P','O','P','M'):
     return new PopularimeterFrame(data, header);
 
   // Private (frames 4.27)
 
-  if(frameID == "PRIV")
+  case FRAME_ID4('P','R','I','V'):
     return new PrivateFrame(data, header);
+  }
+
+  // Text Identification (frames 4.2)
+
+  if(!frameID.isEmpty() && frameID[0] == 'T') {
+    TextIdentificationFrame *f = new TextIdentificationFrame(data, header);
+    d->setTextEncoding(f);
+    return f;
+  }
+
+  // URL link (frames 4.3)
+
+  if(!frameID.isEmpty() && frameID[0] == 'W')
+    return new UrlLinkFrame(data, header);
 
   return new UnknownFrame(data, header);
 }
@@ -255,6 +389,16 @@ void FrameFactory::setDefaultTextEncoding(String::Type encoding)
   d->defaultEncoding = encoding;
 }
 
+void FrameFactory::registerFrameCreator(const ByteVector &frameID, FrameCreator creator)
+{
+  uint id;
+  packFrameID(frameID, id);
+  if(creator)
+    d->creators.insert(id, creator);
+  else
+    d->creators.erase(id);
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // protected members
 ////////////////////////////////////////////////////////////////////////////////
@@ -271,116 +415,43 @@ FrameFactory::~FrameFactory()
 
 bool FrameFactory::updateFrame(Frame::Header *header) const
 {
-  TagLib::ByteVector frameID = header->frameID();
+  uint id;
+  packFrameID(header->frameID(), id);
+
+  const char *newID;
 
   switch(header->version()) {
 
   case 2: // ID3v2.2
-  {
-    if(frameID == "CRM" ||
-       frameID == "EQU" ||
-       frameID == "LNK" ||
-       frameID == "RVA" ||
-       frameID == "TIM" ||
-       frameID == "TSI")
-    {
-      debug("ID3v2.4 no longer supports the frame type " + String(frameID) +
-            ".  It will be discarded from the tag.");
-      return false;
-    }
-
-    // ID3v2.2 only used 3 bytes for the frame ID, so we need to convert all of
-    // the frames to their 4 byte ID3v2.4 equivalent.
-
-    convertFrame("BUF", "RBUF", header);
-    convertFrame("CNT", "PCNT", header);
-    convertFrame("COM", "COMM", header);
-    convertFrame("CRA", "AENC", header);
-    convertFrame("ETC", "ETCO", header);
-    convertFrame("GEO", "GEOB", header);
-    convertFrame("IPL", "TIPL", header);
-    convertFrame("MCI", "MCDI", header);
-    convertFrame("MLL", "MLLT", header);
-    convertFrame("POP", "POPM", header);
-    convertFrame("REV", "RVRB", header);
-    convertFrame("SLT", "SYLT", header);
-    convertFrame("STC", "SYTC", header);
-    convertFrame("TAL", "TALB", header);
-    convertFrame("TBP", "TBPM", header);
-    convertFrame("TCM", "TCOM", header);
-    convertFrame("TCO", "TCON", header);
-    convertFrame("TCR", "TCOP", header);
-    convertFrame("TDA", "TDRC", header);
-    convertFrame("TDY", "TDLY", header);
-    convertFrame("TEN", "TENC", header);
-    convertFrame("TFT", "TFLT", header);
-    convertFrame("TKE", "TKEY", header);
-    convertFrame("TLA", "TLAN", header);
-    convertFrame("TLE", "TLEN", header);
-    convertFrame("TMT", "TMED", header);
-    convertFrame("TOA", "TOAL", header);
-    convertFrame("TOF", "TOFN", header);
-    convertFrame("TOL", "TOLY", header);
-    convertFrame("TOR", "TDOR", header);
-    convertFrame("TOT", "TOAL", header);
-    convertFrame("TP1", "TPE1", header);
-    convertFrame("TP2", "TPE2", header);
-    convertFrame("TP3", "TPE3", header);
-    convertFrame("TP4", "TPE4", header);
-    convertFrame("TPA", "TPOS", header);
-    convertFrame("TPB", "TPUB", header);
-    convertFrame("TRC", "TSRC", header);
-    convertFrame("TRD", "TDRC", header);
-    convertFrame("TRK", "TRCK", header);
-    convertFrame("TSS", "TSSE", header);
-    convertFrame("TT1", "TIT1", header);
-    convertFrame("TT2", "TIT2", header);
-    convertFrame("TT3", "TIT3", header);
-    convertFrame("TXT", "TOLY", header);
-    convertFrame("TXX", "TXXX", header);
-    convertFrame("TYE", "TDRC", header);
-    convertFrame("UFI", "UFID", header);
-    convertFrame("ULT", "USLT", header);
-    convertFrame("WAF", "WOAF", header);
-    convertFrame("WAR", "WOAR", header);
-    convertFrame("WAS", "WOAS", header);
-    convertFrame("WCM", "WCOM", header);
-    convertFrame("WCP", "WCOP", header);
-    convertFrame("WPB", "WPUB", header);
-    convertFrame("WXX", "WXXX", header);
-
+    newID = upgradeFrameIDV22(id);
     break;
-  }
 
   case 3: // ID3v2.3
-  {
-    if(frameID == "EQUA" ||
-       frameID == "RVAD" ||
-       frameID == "TIME" ||
-       frameID == "TRDA" ||
-       frameID == "TSIZ" ||
-       frameID == "TDAT")
-    {
-      debug("ID3v2.4 no longer supports the frame type " + String(frameID) +
-            ".  It will be discarded from the tag.");
-      return false;
-    }
-
-    convertFrame("TORY", "TDOR", header);
-    convertFrame("TYER", "TDRC", header);
-
+    newID = upgradeFrameIDV23(id);
     break;
-  }
 
   default:
 
     // This should catch a typo that existed in TagLib up to and including
     // version 1.1 where TRDC was used for the year rather than TDRC.
 
-    convertFrame("TRDC", "TDRC", header);
+    newID = id == FRAME_ID4('T','R','D','C') ? "TDRC" : 0;
     break;
   }
 
+  if(!newID)
+    return true;
+
+  if(!*newID) {
+    debug("ID3v2.4 no longer supports the frame type " + String(header->frameID()) +
+          ".  It will be discarded from the tag.");
+    return false;
+  }
+
+  // debug("ID3v2.4 no longer supports the frame type " + String(header->frameID()) +
+  //       "  It has been converted to the type " + String(newID) + ".");
+
+  header->setFrameID(newID);
   return true;
 }
 
@@ -388,18 +459,6 @@ bool FrameFactory::updateFrame(Frame::Header *header) const
 // private members
 ////////////////////////////////////////////////////////////////////////////////
 
-void FrameFactory::convertFrame(const char *from, const char *to,
-                                Frame::Header *header) const
-{
-  if(header->frameID() != from)
-    return;
-
-  // debug("ID3v2.4 no longer supports the frame type " + String(from) + "  It has" +
-  //       "been converted to the type " + String(to) + ".");
-
-  header->setFrameID(to);
-}
-
 void FrameFactory::updateGenre(TextIdentificationFrame *frame) const
 {
   StringList fields = frame->fieldList();
@@ -115,6 +115,27 @@ namespace TagLib {
        */
       void setDefaultTextEncoding(String::Type encoding);
 
+      /*!
+       * A function that creates a frame from \a data, which holds the whole
+       * frame, and its already parsed \a header.  The new frame takes
+       * ownership of the header.  Because Frame::Header is protected this is
+       * usually a static member of the ID3v2::Frame subclass it creates.
+       */
+      typedef Frame *(*FrameCreator)(const ByteVector &data, Frame::Header *header);
+
+      /*!
+       * Makes createFrame() use \a creator for frames with the ID \a frameID,
+       * in place of the frame class it would pick otherwise.  \a frameID is
+       * the ID after any conversion of frames from older versions of the
+       * standard, see updateFrame().  A null \a creator removes the frame
+       * ID again.
+       *
+       * This is a cheaper way than subclassing the factory to add support
+       * for frame types not handled by TagLib.  Creators should be registered
+       * before tags are read, as the factory is not locked.
+       */
+      void registerFrameCreator(const ByteVector &frameID, FrameCreator creator);
+
     protected:
       /*!
        * Constructs a frame factory.  Because this is a singleton this method is
@@ -145,14 +166,6 @@ namespace TagLib {
       FrameFactory(const FrameFactory &);
       FrameFactory &operator=(const FrameFactory &);
 
-      /*!
-       * This method is used internally to convert a frame from ID \a from to ID
-       * \a to.  If the frame matches the \a from pattern and converts the frame
-       * ID in the \a header or simply does nothing if the frame ID does not match.
-       */
-      void convertFrame(const char *from, const char *to,
-                        Frame::Header *header) const;
-
       void updateGenre(TextIdentificationFrame *frame) const;
 
       static FrameFactory *factory;
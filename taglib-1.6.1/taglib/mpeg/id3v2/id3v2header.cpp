@@ -27,6 +27,7 @@
 #include <bitset>
 
 #include <tstring.h>
+#include <tbytevectorreader.h>
 #include <tdebug.h>
 
 #include "id3v2header.h"
@@ -207,16 +208,14 @@ void Header::parse(const ByteVector &data)
   // note that we're doing things a little out of order here -- the size is
   // later in the bytestream than the version
 
-  ByteVector sizeData = data.mid(6, 4);
-
-  if(sizeData.size() != 4) {
+  if(data.size() < 10) {
     d->tagSize = 0;
     debug("TagLib::ID3v2::Header::parse() - The tag size as read was 0 bytes!");
     return;
   }
 
-  for(ByteVector::Iterator it = sizeData.begin(); it != sizeData.end(); it++) {
-    if(uchar(*it) >= 128) {
+  for(uint i = 6; i < 10; i++) {
+    if(uchar(data[i]) >= 128) {
       d->tagSize = 0;
       debug("TagLib::ID3v2::Header::parse() - One of the size bytes in the id3v2 header was greater than the allowed 128.");
       return;
@@ -239,5 +238,5 @@ void Header::parse(const ByteVector &data)
 
   // Get the size from the remaining four bytes (read above)
 
-  d->tagSize = SynchData::toUInt(sizeData); // (structure 3.1 "size")
+  d->tagSize = ByteVectorReader(data, 6).readSynchSafeUInt32(); // (structure 3.1 "size")
 }
@@ -25,6 +25,8 @@
 
 #include <tfile.h>
 #include <tdebug.h>
+#include <tbytevectorreader.h>
+#include <tbytevectorwriter.h>
 
 #include "id3v2tag.h"
 #include "id3v2header.h"
@@ -43,7 +45,7 @@ using namespace ID3v2;
 class ID3v2::Tag::TagPrivate
 {
 public:
-  TagPrivate() : file(0), tagOffset(-1), extendedHeader(0), footer(0), paddingSize(0)
+  TagPrivate() : file(0), tagOffset(-1), extendedHeader(0), footer(0), paddingSize(0), modified(false)
   {
     frameList.setAutoDelete(true);
   }
@@ -65,6 +67,18 @@ public:
 
   FrameListMap frameListMap;
   FrameList frameList;
+
+  /*!
+   * Whether frames have been added or removed since the tag was read or
+   * last saved; changes to the frames themselves are tracked by the frames.
+   */
+  bool modified;
+
+  /*!
+   * The tag data as it was read, kept for ID3v2.4 tags so that frames that
+   * have not been changed can be written back without rendering them again.
+   */
+  ByteVector data;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -280,6 +294,28 @@ bool ID3v2::Tag::isEmpty() const
   return d->frameList.isEmpty();
 }
 
+bool ID3v2::Tag::isModified() const
+{
+  if(d->modified)
+    return true;
+
+  for(FrameList::ConstIterator it = d->frameList.begin(); it != d->frameList.end(); it++) {
+    if((*it)->isModified())
+      return true;
+  }
+  return false;
+}
+
+void ID3v2::Tag::setModified(bool modified)
+{
+  d->modified = modified;
+
+  if(!modified) {
+    for(FrameList::Iterator it = d->frameList.begin(); it != d->frameList.end(); it++)
+      (*it)->setModified(false);
+  }
+}
+
 Header *ID3v2::Tag::header() const
 {
   return &(d->header);
@@ -314,6 +350,7 @@ void ID3v2::Tag::addFrame(Frame *frame)
 {
   d->frameList.append(frame);
   d->frameListMap[frame->frameID()].append(frame);
+  setModified();
 }
 
 void ID3v2::Tag::removeFrame(Frame *frame, bool del)
@@ -326,6 +363,8 @@ void ID3v2::Tag::removeFrame(Frame *frame, bool del)
   it = d->frameListMap[frame->frameID()].find(frame);
   d->frameListMap[frame->frameID()].erase(it);
 
+  setModified();
+
   // ...and delete as desired
   if(del)
     delete frame;
@@ -340,44 +379,72 @@ void ID3v2::Tag::removeFrames(const ByteVector &id)
 
 ByteVector ID3v2::Tag::render() const
 {
-  // We need to render the "tag data" first so that we have to correct size to
-  // render in the tag's header.  The "tag data" -- everything that is included
+  // The frames' sizes are added up first so that the whole tag can be
+  // rendered into one buffer.  The "tag data" -- everything that is included
   // in ID3v2::Header::tagSize() -- includes the extended header, frames and
   // padding, but does not include the tag's header or footer.
 
-  ByteVector tagData;
-
   // TODO: Render the extended header.
 
-  // Loop through the frames rendering them and adding them to the tagData.
+  uint frameDataSize = 0;
+
+  for(FrameList::ConstIterator it = d->frameList.begin(); it != d->frameList.end(); it++) {
+    if((*it)->header()->frameID().size() != 4 || (*it)->header()->tagAlterPreservation())
+      continue;
+    const uint originalSize = originalFrameSize(*it);
+    frameDataSize += originalSize > 0 ? originalSize : (*it)->renderedSize();
+  }
+
+  const uint expectedSize = frameDataSize < d->header.tagSize() ?
+    d->header.tagSize() : frameDataSize + 1024;
+  ByteVectorWriter writer(Header::size() + expectedSize);
+
+  // The header goes in once the size of the tag data is known.
+
+  writer.fill(Header::size());
 
-  for(FrameList::Iterator it = d->frameList.begin(); it != d->frameList.end(); it++) {
+  for(FrameList::ConstIterator it = d->frameList.begin(); it != d->frameList.end(); it++) {
     if ((*it)->header()->frameID().size() != 4) {
       debug("A frame of unsupported or unknown type \'"
           + String((*it)->header()->frameID()) + "\' has been discarded");
       continue;
     }
-    if(!(*it)->header()->tagAlterPreservation())
-      tagData.append((*it)->render());
+    if((*it)->header()->tagAlterPreservation())
+      continue;
+
+    // Frames that haven't changed since they were read are copied from the
+    // original tag data rather than rendered again.
+
+    const uint originalSize = originalFrameSize(*it);
+    if(originalSize > 0) {
+      const ByteVector &original = d->data;
+      writer.writeBlock(original.data() + (*it)->tagDataOffset(), originalSize);
+    }
+    else
+      (*it)->render(writer);
   }
 
-  // Compute the amount of padding, and append that to tagData.
+  // Compute the amount of padding, and add that to the tag data.
 
+  const uint tagDataSize = writer.offset() - Header::size();
   uint paddingSize = 0;
   uint originalSize = d->header.tagSize();
 
-  if(tagData.size() < originalSize)
-    paddingSize = originalSize - tagData.size();
+  if(tagDataSize < originalSize)
+    paddingSize = originalSize - tagDataSize;
   else
     paddingSize = 1024;
 
-  tagData.append(ByteVector(paddingSize, char(0)));
+  writer.fill(paddingSize);
 
   // Set the tag size.
-  d->header.setTagSize(tagData.size());
+  d->header.setTagSize(tagDataSize + paddingSize);
 
   // TODO: This should eventually include d->footer->render().
-  return d->header.render() + tagData;
+  writer.seek(0);
+  writer.writeBlock(d->header.render());
+
+  return writer.data();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -399,6 +466,12 @@ void ID3v2::Tag::read()
 
     parse(d->file->readBlock(d->header.tagSize()));
   }
+
+  // Adding the frames counts as a change to the tag; that's cleared here.
+  // Frames that the factory changed while reading them, e.g. to its default
+  // text encoding, stay changed so that saving writes them as changed.
+
+  d->modified = false;
 }
 
 void ID3v2::Tag::parse(const ByteVector &origData)
@@ -408,6 +481,12 @@ void ID3v2::Tag::parse(const ByteVector &origData)
   if(d->header.unsynchronisation() && d->header.majorVersion() <= 3)
     data = SynchData::decode(data);
 
+  // Only ID3v2.4 frames are written back as they are; older ones are
+  // converted when they are read and so have to be rendered again anyway.
+
+  if(d->header.majorVersion() == 4)
+    d->data = data;
+
   uint frameDataPosition = 0;
   uint frameDataLength = data.size();
 
@@ -448,7 +527,21 @@ void ID3v2::Tag::parse(const ByteVector &origData)
       return;
     }
 
-    Frame *frame = d->factory->createFrame(data.mid(frameDataPosition),
+    // Hand the factory only this frame's bytes rather than the rest of the
+    // tag, which would make reading a tag quadratic in its number of frames.
+    // The frame header may peek at the ID after the frame to work out how an
+    // ID3v2.4 size was written, so allow for the larger reading of the size
+    // and 4 more bytes.
+
+    const uint version = d->header.majorVersion();
+    const uint frameHeaderSize = Frame::headerSize(version);
+    ByteVectorReader sizeReader(data, frameDataPosition + (version < 3 ? 3 : 4));
+    const uint maxFrameSize = version < 3 ? sizeReader.readUInt24() : sizeReader.readUInt32();
+    const uint available = data.size() - frameDataPosition - frameHeaderSize;
+    const uint frameLength = frameHeaderSize +
+      (available > 4 && maxFrameSize < available - 4 ? maxFrameSize + 4 : available);
+
+    Frame *frame = d->factory->createFrame(data.mid(frameDataPosition, frameLength),
                                            &d->header);
 
     if(!frame)
@@ -461,6 +554,9 @@ void ID3v2::Tag::parse(const ByteVector &origData)
       return;
     }
 
+    if(!d->data.isEmpty() && !frame->isModified())
+      frame->setTagDataOffset(frameDataPosition);
+
     frameDataPosition += frame->size() + Frame::headerSize(d->header.majorVersion());
     addFrame(frame);
   }
@@ -482,3 +578,29 @@ void ID3v2::Tag::setTextFrame(const ByteVector &id, const String &value)
     f->setText(value);
   }
 }
+
+////////////////////////////////////////////////////////////////////////////////
+// private members
+////////////////////////////////////////////////////////////////////////////////
+
+TagLib::uint ID3v2::Tag::originalFrameSize(const Frame *frame) const
+{
+  const int offset = frame->tagDataOffset();
+
+  if(frame->isModified() || offset < 0 || d->data.isEmpty())
+    return 0;
+
+  // The header is rendered again to be sure that it still matches; the
+  // frame factory may have changed it while the frame was being read.
+
+  const uint headerSize = Frame::headerSize(4);
+  const ByteVector header = frame->header()->render();
+
+  if(offset + headerSize + frame->size() > d->data.size() ||
+     !d->data.containsAt(header, offset))
+  {
+    return 0;
+  }
+
+  return headerSize + frame->size();
+}
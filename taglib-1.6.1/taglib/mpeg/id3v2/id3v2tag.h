@@ -152,6 +152,20 @@ namespace TagLib {
 
       virtual bool isEmpty() const;
 
+      /*!
+       * Returns true if the tag or any of its frames has been changed since it
+       * was read or last saved.
+       *
+       * \see Frame::isModified()
+       */
+      virtual bool isModified() const;
+
+      /*!
+       * Marks the tag as changed, or if \a modified is false, marks it and all
+       * of its frames as unchanged.
+       */
+      virtual void setModified(bool modified = true);
+
       /*!
        * Returns a pointer to the tag's header.
        */
@@ -290,6 +304,13 @@ namespace TagLib {
       Tag(const Tag &);
       Tag &operator=(const Tag &);
 
+      /*!
+       * Returns the size of \a frame, header included, as it was read if it
+       * hasn't been changed since and so can be copied from the bytes it was
+       * read from, or 0 otherwise.
+       */
+      uint originalFrameSize(const Frame *frame) const;
+
       class TagPrivate;
       TagPrivate *d;
     };
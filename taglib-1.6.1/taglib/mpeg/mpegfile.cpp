@@ -30,8 +30,11 @@
 #include <apefooter.h>
 #include <apetag.h>
 #include <tdebug.h>
+#include <tsplicedstream.h>
 
+#include <algorithm>
 #include <bitset>
+#include <vector>
 
 #include "mpegfile.h"
 #include "mpegheader.h"
@@ -113,6 +116,16 @@ MPEG::File::File(FileName file, ID3v2::FrameFactory *frameFactory,
     read(readProperties, propertiesStyle);
 }
 
+MPEG::File::File(IOStream *stream, ID3v2::FrameFactory *frameFactory,
+                 bool readProperties, Properties::ReadStyle propertiesStyle) :
+  TagLib::File(stream)
+{
+  d = new FilePrivate(frameFactory);
+
+  if(isOpen())
+    read(readProperties, propertiesStyle);
+}
+
 MPEG::File::~File()
 {
   delete d;
@@ -167,26 +180,35 @@ bool MPEG::File::save(int tags, bool stripOthers)
 
   bool success = true;
 
+  // Tags that are already in the file and haven't been changed are left as
+  // they are.
+
   if(ID3v2 & tags) {
 
     if(ID3v2Tag() && !ID3v2Tag()->isEmpty()) {
 
-      if(!d->hasID3v2)
-        d->ID3v2Location = 0;
+      if(!d->hasID3v2 || ID3v2Tag()->isModified()) {
 
-      insert(ID3v2Tag()->render(), d->ID3v2Location, d->ID3v2OriginalSize);
+        if(!d->hasID3v2)
+          d->ID3v2Location = 0;
 
-      d->hasID3v2 = true;
+        const ByteVector data = ID3v2Tag()->render();
+        insert(data, d->ID3v2Location, d->ID3v2OriginalSize);
 
-      // v1 tag location has changed, update if it exists
+        d->hasID3v2 = true;
+        d->ID3v2OriginalSize = data.size();
+        ID3v2Tag()->setModified(false);
 
-      if(ID3v1Tag())
-        d->ID3v1Location = findID3v1();
+        // v1 tag location has changed, update if it exists
 
-      // APE tag location has changed, update if it exists
+        if(ID3v1Tag())
+          d->ID3v1Location = findID3v1();
 
-      if(APETag())
-	findAPE();
+        // APE tag location has changed, update if it exists
+
+        if(APETag())
+          findAPE();
+      }
     }
     else if(stripOthers)
       success = strip(ID3v2, false) && success;
@@ -196,11 +218,14 @@ bool MPEG::File::save(int tags, bool stripOthers)
 
   if(ID3v1 & tags) {
     if(ID3v1Tag() && !ID3v1Tag()->isEmpty()) {
-      int offset = d->hasID3v1 ? -128 : 0;
-      seek(offset, End);
-      writeBlock(ID3v1Tag()->render());
-      d->hasID3v1 = true;
-      d->ID3v1Location = findID3v1();
+      if(!d->hasID3v1 || ID3v1Tag()->isModified()) {
+        int offset = d->hasID3v1 ? -128 : 0;
+        seek(offset, End);
+        writeBlock(ID3v1Tag()->render());
+        d->hasID3v1 = true;
+        d->ID3v1Location = findID3v1();
+        ID3v1Tag()->setModified(false);
+      }
     }
     else if(stripOthers)
       success = strip(ID3v1) && success;
@@ -211,8 +236,12 @@ bool MPEG::File::save(int tags, bool stripOthers)
   // Dont save an APE-tag unless one has been created
 
   if((APE & tags) && APETag()) {
-    if(d->hasAPE)
-      insert(APETag()->render(), d->APELocation, d->APEOriginalSize);
+    if(d->hasAPE) {
+      if(APETag()->isModified()) {
+        insert(APETag()->render(), d->APELocation, d->APEOriginalSize);
+        d->APEOriginalSize = APETag()->footer()->completeTagSize();
+      }
+    }
     else {
       if(d->hasID3v1) {
         insert(APETag()->render(), d->ID3v1Location, 0);
@@ -232,6 +261,7 @@ bool MPEG::File::save(int tags, bool stripOthers)
         d->hasAPE = true;
       }
     }
+    APETag()->setModified(false);
   }
   else if(d->hasAPE && stripOthers)
     success = strip(APE, false) && success;
@@ -254,6 +284,66 @@ APE::Tag *MPEG::File::APETag(bool create)
   return d->tag.access<APE::Tag>(APEIndex, create);
 }
 
+SplicedStream *MPEG::File::splicedStream(int tags)
+{
+  if(!isValid())
+    return 0;
+
+  // Work out which parts of the file are tags; everything else is audio.
+
+  std::vector<std::pair<long, long> > tagRanges;
+
+  if(d->hasID3v2)
+    tagRanges.push_back(std::make_pair(d->ID3v2Location, long(d->ID3v2OriginalSize)));
+  if(d->hasAPE)
+    tagRanges.push_back(std::make_pair(d->APELocation, long(d->APEOriginalSize)));
+  if(d->hasID3v1)
+    tagRanges.push_back(std::make_pair(d->ID3v1Location, 128L));
+
+  std::sort(tagRanges.begin(), tagRanges.end());
+
+  SplicedStream *s = new SplicedStream;
+
+  if((tags & ID3v2) && ID3v2Tag() && !ID3v2Tag()->isEmpty())
+    s->appendData(ID3v2Tag()->render());
+
+  long position = 0;
+  for(std::vector<std::pair<long, long> >::const_iterator it = tagRanges.begin();
+      it != tagRanges.end(); ++it)
+  {
+    if(it->first > position)
+      s->appendRange(stream(), position, it->first - position);
+    position = std::max(position, it->first + it->second);
+  }
+  s->appendRange(stream(), position, length() - position);
+
+  if((tags & APE) && APETag() && !APETag()->isEmpty())
+    s->appendData(APETag()->render());
+
+  if((tags & ID3v1) && ID3v1Tag() && !ID3v1Tag()->isEmpty())
+    s->appendData(ID3v1Tag()->render());
+
+  return s;
+}
+
+bool MPEG::File::audioRange(long &offset, long &length)
+{
+  if(!isValid())
+    return false;
+
+  long start = d->hasID3v2 ? d->ID3v2Location + long(d->ID3v2OriginalSize) : 0;
+  long end = File::length();
+
+  if(d->hasAPE && d->APELocation >= start)
+    end = std::min(end, d->APELocation);
+  if(d->hasID3v1 && d->ID3v1Location >= start)
+    end = std::min(end, d->ID3v1Location);
+
+  offset = start;
+  length = std::max(end - start, 0L);
+  return true;
+}
+
 bool MPEG::File::strip(int tags)
 {
   return strip(tags, true);
@@ -33,6 +33,8 @@
 
 namespace TagLib {
 
+  class SplicedStream;
+
   namespace ID3v2 { class Tag; class FrameFactory; }
   namespace ID3v1 { class Tag; }
   namespace APE { class Tag; }
@@ -91,6 +93,19 @@ namespace TagLib {
            bool readProperties = true,
            Properties::ReadStyle propertiesStyle = Properties::Average);
 
+      /*!
+       * Contructs an MPEG file from \a stream.  If \a readProperties is true the
+       * file's audio properties will also be read using \a propertiesStyle.  If
+       * false, \a propertiesStyle is ignored.  The frames will be created using
+       * \a frameFactory.
+       *
+       * \note TagLib will *not* take ownership of the stream, the caller is
+       * responsible for deleting it after the File object.
+       */
+      File(IOStream *stream, ID3v2::FrameFactory *frameFactory,
+           bool readProperties = true,
+           Properties::ReadStyle propertiesStyle = Properties::Average);
+
       /*!
        * Destroys this instance of the File.
        */
@@ -161,6 +176,31 @@ namespace TagLib {
       // BIC: combine with the above method
       bool save(int tags, bool stripOthers);
 
+      /*!
+       * Returns a read only stream of the file as save(\a tags, true) would
+       * leave it, without writing anything.  The tags in \a tags that exist
+       * and aren't empty are rendered into the stream; the audio is read from
+       * this file as the stream is read.  The length of the stream is known
+       * as soon as it is returned.
+       *
+       * Unlike save(), this doesn't create missing tags from the others.
+       *
+       * The stream is owned by the caller.  It reads from this file, which
+       * must outlive it and shouldn't be saved while it is in use.  Returns a
+       * null pointer if the file isn't valid.
+       *
+       * \see SplicedStream
+       */
+      SplicedStream *splicedStream(int tags = AllTags);
+
+      /*!
+       * Sets \a offset and \a length to the MPEG frames between the ID3v2
+       * tag and the APE or ID3v1 tag at the end of the file.
+       *
+       * \see TagLib::File::audioRange()
+       */
+      virtual bool audioRange(long &offset, long &length);
+
       /*!
        * Returns a pointer to the ID3v2 tag of the file.
        *
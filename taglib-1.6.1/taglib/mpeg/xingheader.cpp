@@ -24,6 +24,7 @@
  ***************************************************************************/
 
 #include <tbytevector.h>
+#include <tbytevectorreader.h>
 #include <tstring.h>
 #include <tdebug.h>
 
@@ -108,8 +109,9 @@ void MPEG::XingHeader::parse(const ByteVector &data)
     return;
   }
 
-  d->frames = data.mid(8, 4).toUInt();
-  d->size = data.mid(12, 4).toUInt();
+  ByteVectorReader reader(data, 8);
+  d->frames = reader.readUInt32();
+  d->size = reader.readUInt32();
 
   d->valid = true;
 }
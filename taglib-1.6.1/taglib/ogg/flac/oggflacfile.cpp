@@ -24,6 +24,7 @@
  ***************************************************************************/
 
 #include <tbytevector.h>
+#include <tbytevectorreader.h>
 #include <tstring.h>
 #include <tdebug.h>
 
@@ -43,7 +44,8 @@ public:
     streamLength(0),
     scanned(false),
     hasXiphComment(false),
-    commentPacket(0) {}
+    commentPacket(0),
+    audioPacket(0) {}
 
   ~FilePrivate()
   {
@@ -62,6 +64,7 @@ public:
 
   bool hasXiphComment;
   int commentPacket;
+  int audioPacket;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -75,6 +78,13 @@ Ogg::FLAC::File::File(FileName file, bool readProperties,
   read(readProperties, propertiesStyle);
 }
 
+Ogg::FLAC::File::File(IOStream *stream, bool readProperties,
+                      Properties::ReadStyle propertiesStyle) : Ogg::File(stream)
+{
+  d = new FilePrivate;
+  read(readProperties, propertiesStyle);
+}
+
 Ogg::FLAC::File::~File()
 {
   delete d;
@@ -93,6 +103,9 @@ Properties *Ogg::FLAC::File::audioProperties() const
 
 bool Ogg::FLAC::File::save()
 {
+  if(!d->comment->isModified())
+    return true;
+
   d->xiphCommentData = d->comment->render(false);
 
   // Create FLAC metadata-block:
@@ -114,7 +127,11 @@ bool Ogg::FLAC::File::save()
 
   setPacket(d->commentPacket, v);
 
-  return Ogg::File::save();
+  if(!Ogg::File::save())
+    return false;
+
+  d->comment->setModified(false);
+  return true;
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -172,6 +189,12 @@ long Ogg::FLAC::File::streamLength()
   return d->streamLength;
 }
 
+bool Ogg::FLAC::File::audioRange(long &offset, long &length)
+{
+  scan();
+  return d->scanned && streamRange(d->audioPacket, offset, length);
+}
+
 void Ogg::FLAC::File::scan()
 {
   // Scan the metadata pages
@@ -221,7 +244,7 @@ void Ogg::FLAC::File::scan()
 
   char blockType = header[0] & 0x7f;
   bool lastBlock = (header[0] & 0x80) != 0;
-  uint length = header.mid(1, 3).toUInt();
+  uint length = ByteVectorReader(header, 1).readUInt24();
   overhead += length;
 
   // Sanity: First block should be the stream_info metadata
@@ -244,7 +267,7 @@ void Ogg::FLAC::File::scan()
     header = metadataHeader.mid(0, 4);
     blockType = header[0] & 0x7f;
     lastBlock = (header[0] & 0x80) != 0;
-    length = header.mid(1, 3).toUInt();
+    length = ByteVectorReader(header, 1).readUInt24();
     overhead += length;
 
     if(blockType == 1) {
@@ -262,6 +285,7 @@ void Ogg::FLAC::File::scan()
   }
 
   // End of metadata, now comes the datastream
+  d->audioPacket = ipacket + 1;
   d->streamStart = overhead;
   d->streamLength = File::length() - d->streamStart;
 
@@ -213,6 +213,23 @@ Ogg::File::File(FileName file) : TagLib::File(file)
   d = new FilePrivate;
 }
 
+Ogg::File::File(IOStream *stream) : TagLib::File(stream)
+{
+  d = new FilePrivate;
+}
+
+bool Ogg::File::streamRange(uint i, long &offset, long &length)
+{
+  while(d->packetToPageMap.size() <= i) {
+    if(!nextPage())
+      return false;
+  }
+
+  offset = d->pages[d->packetToPageMap[i].front()]->fileOffset();
+  length = File::length() - offset;
+  return true;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // private members
 ////////////////////////////////////////////////////////////////////////////////
@@ -92,6 +92,26 @@ namespace TagLib {
        */
       File(FileName file);
 
+      /*!
+       * Contructs an Ogg file from \a stream.
+       *
+       * \note This constructor is protected since Ogg::File shouldn't be
+       * instantiated directly but rather should be used through the codec
+       * specific subclasses.
+       *
+       * \note TagLib will *not* take ownership of the stream, the caller is
+       * responsible for deleting it after the File object.
+       */
+      File(IOStream *stream);
+
+      /*!
+       * Sets \a offset and \a length to the pages from the one on which packet
+       * \a i starts to the end of the file and returns true, or returns false
+       * if there is no such packet.  The codecs use this to find their audio,
+       * which starts on a fresh page after the header packets.
+       */
+      bool streamRange(uint i, long &offset, long &length);
+
     private:
       File(const File &);
       File &operator=(const File &);
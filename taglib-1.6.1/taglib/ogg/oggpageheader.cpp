@@ -28,6 +28,7 @@
 #include <bitset>
 
 #include <tstring.h>
+#include <tbytevectorreader.h>
 #include <tdebug.h>
 #include <taglib.h>
 
@@ -255,9 +256,10 @@ void Ogg::PageHeader::read()
   d->firstPageOfStream = flags.test(1);
   d->lastPageOfStream = flags.test(2);
 
-  d->absoluteGranularPosition = data.mid(6, 8).toLongLong(false);
-  d->streamSerialNumber = data.mid(14, 4).toUInt(false);
-  d->pageSequenceNumber = data.mid(18, 4).toUInt(false);
+  ByteVectorReader reader(data, 6);
+  d->absoluteGranularPosition = reader.readUInt64(false);
+  d->streamSerialNumber = reader.readUInt32(false);
+  d->pageSequenceNumber = reader.readUInt32(false);
 
   // Byte number 27 is the number of page segments, which is the only variable
   // length portion of the page header.  After reading the number of page
@@ -31,6 +31,7 @@
 
 #include <tstring.h>
 #include <tdebug.h>
+#include <tbytevectorreader.h>
 
 #include "speexfile.h"
 
@@ -65,6 +66,13 @@ Speex::File::File(FileName file, bool readProperties,
   read(readProperties, propertiesStyle);
 }
 
+Speex::File::File(IOStream *stream, bool readProperties,
+                   Properties::ReadStyle propertiesStyle) : Ogg::File(stream)
+{
+  d = new FilePrivate;
+  read(readProperties, propertiesStyle);
+}
+
 Speex::File::~File()
 {
   delete d;
@@ -84,10 +92,27 @@ bool Speex::File::save()
 {
   if(!d->comment)
     d->comment = new Ogg::XiphComment;
+  else if(!d->comment->isModified())
+    return true;
 
   setPacket(1, d->comment->render());
 
-  return Ogg::File::save();
+  if(!Ogg::File::save())
+    return false;
+
+  d->comment->setModified(false);
+  return true;
+}
+
+bool Speex::File::audioRange(long &offset, long &length)
+{
+  if(!isValid())
+    return false;
+
+  // The number of extra header packets is at byte 68 of the Speex header.
+
+  uint extraHeaders = ByteVectorReader(packet(0), 68).readUInt32(false);
+  return streamRange(2 + extraHeaders, offset, length);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -28,6 +28,7 @@
  ***************************************************************************/
 
 #include <tstring.h>
+#include <tbytevectorreader.h>
 #include <tdebug.h>
 
 #include <oggpageheader.h>
@@ -113,44 +114,38 @@ void Speex::Properties::read()
 
   ByteVector data = d->file->packet(0);
 
-  int pos = 28;
+  ByteVectorReader reader(data, 28);
 
   // speex_version_id;       /**< Version for Speex (for checking compatibility) */
-  d->speexVersion = data.mid(pos, 4).toUInt(false);
-  pos += 4;
+  d->speexVersion = reader.readUInt32(false);
 
   // header_size;            /**< Total size of the header ( sizeof(SpeexHeader) ) */
-  pos += 4;
+  reader.skip(4);
 
   // rate;                   /**< Sampling rate used */
-  d->sampleRate = data.mid(pos, 4).toUInt(false);
-  pos += 4;
+  d->sampleRate = reader.readUInt32(false);
 
   // mode;                   /**< Mode used (0 for narrowband, 1 for wideband) */
-  d->mode = data.mid(pos, 4).toUInt(false);
-  pos += 4;
+  d->mode = reader.readUInt32(false);
 
   // mode_bitstream_version; /**< Version ID of the bit-stream */
-  pos += 4;
+  reader.skip(4);
 
   // nb_channels;            /**< Number of channels encoded */
-  d->channels = data.mid(pos, 4).toUInt(false);
-  pos += 4;
+  d->channels = reader.readUInt32(false);
 
   // bitrate;                /**< Bit-rate used */
-  d->bitrate = data.mid(pos, 4).toUInt(false);
-  pos += 4;
+  d->bitrate = reader.readUInt32(false);
 
   // frame_size;             /**< Size of frames */
-  // unsigned int frameSize = data.mid(pos, 4).toUInt(false);
-  pos += 4;
+  // unsigned int frameSize = reader.readUInt32(false);
+  reader.skip(4);
 
   // vbr;                    /**< 1 for a VBR encoding, 0 otherwise */
-  d->vbr = data.mid(pos, 4).toUInt(false) == 1;
-  pos += 4;
+  d->vbr = reader.readUInt32(false) == 1;
 
   // frames_per_packet;      /**< Number of frames stored per Ogg packet */
-  // unsigned int framesPerPacket = data.mid(pos, 4).toUInt(false);
+  // unsigned int framesPerPacket = reader.readUInt32(false);
 
   const Ogg::PageHeader *first = d->file->firstPageHeader();
   const Ogg::PageHeader *last = d->file->lastPageHeader();
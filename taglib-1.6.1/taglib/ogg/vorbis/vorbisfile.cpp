@@ -68,6 +68,13 @@ Vorbis::File::File(FileName file, bool readProperties,
   read(readProperties, propertiesStyle);
 }
 
+Vorbis::File::File(IOStream *stream, bool readProperties,
+                   Properties::ReadStyle propertiesStyle) : Ogg::File(stream)
+{
+  d = new FilePrivate;
+  read(readProperties, propertiesStyle);
+}
+
 Vorbis::File::~File()
 {
   delete d;
@@ -89,11 +96,22 @@ bool Vorbis::File::save()
 
   if(!d->comment)
     d->comment = new Ogg::XiphComment;
+  else if(!d->comment->isModified())
+    return true;
   v.append(d->comment->render());
 
   setPacket(1, v);
 
-  return Ogg::File::save();
+  if(!Ogg::File::save())
+    return false;
+
+  d->comment->setModified(false);
+  return true;
+}
+
+bool Vorbis::File::audioRange(long &offset, long &length)
+{
+  return isValid() && streamRange(3, offset, length);
 }
 
 ////////////////////////////////////////////////////////////////////////////////
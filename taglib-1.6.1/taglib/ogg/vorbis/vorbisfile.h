@@ -70,6 +70,17 @@ namespace TagLib {
       File(FileName file, bool readProperties = true,
            Properties::ReadStyle propertiesStyle = Properties::Average);
 
+      /*!
+       * Contructs a Vorbis file from \a stream.  If \a readProperties is true the
+       * file's audio properties will also be read using \a propertiesStyle.  If
+       * false, \a propertiesStyle is ignored.
+       *
+       * \note TagLib will *not* take ownership of the stream, the caller is
+       * responsible for deleting it after the File object.
+       */
+      File(IOStream *stream, bool readProperties = true,
+           Properties::ReadStyle propertiesStyle = Properties::Average);
+
       /*!
        * Destroys this instance of the File.
        */
@@ -90,6 +101,17 @@ namespace TagLib {
 
       virtual bool save();
 
+      /*!
+       * Sets \a offset and \a length to the audio pages after the three
+       * header packets.
+       *
+       * \note The pages carry sequence numbers, so if retagging changes the
+       * number of header pages the bytes of the audio pages change too.
+       *
+       * \see TagLib::File::audioRange()
+       */
+      virtual bool audioRange(long &offset, long &length);
+
     private:
       File(const File &);
       File &operator=(const File &);
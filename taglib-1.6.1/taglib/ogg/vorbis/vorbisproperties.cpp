@@ -24,6 +24,7 @@
  ***************************************************************************/
 
 #include <tstring.h>
+#include <tbytevectorreader.h>
 #include <tdebug.h>
 
 #include <oggpageheader.h>
@@ -133,31 +134,19 @@ void Vorbis::Properties::read()
 
   ByteVector data = d->file->packet(0);
 
-  int pos = 0;
-
-  if(data.mid(pos, 7) != vorbisSetupHeaderID) {
+  if(!data.startsWith(vorbisSetupHeaderID)) {
     debug("Vorbis::Properties::read() -- invalid Vorbis identification header");
     return;
   }
 
-  pos += 7;
-
-  d->vorbisVersion = data.mid(pos, 4).toUInt(false);
-  pos += 4;
-
-  d->channels = uchar(data[pos]);
-  pos += 1;
-
-  d->sampleRate = data.mid(pos, 4).toUInt(false);
-  pos += 4;
-
-  d->bitrateMaximum = data.mid(pos, 4).toUInt(false);
-  pos += 4;
-
-  d->bitrateNominal = data.mid(pos, 4).toUInt(false);
-  pos += 4;
+  ByteVectorReader reader(data, 7);
 
-  d->bitrateMinimum = data.mid(pos, 4).toUInt(false);
+  d->vorbisVersion = reader.readUInt32(false);
+  d->channels = reader.readByte();
+  d->sampleRate = reader.readUInt32(false);
+  d->bitrateMaximum = reader.readUInt32(false);
+  d->bitrateNominal = reader.readUInt32(false);
+  d->bitrateMinimum = reader.readUInt32(false);
 
   // TODO: Later this should be only the "fast" mode.
   d->bitrate = d->bitrateNominal;
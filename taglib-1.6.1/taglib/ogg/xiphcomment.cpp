@@ -24,6 +24,9 @@
  ***************************************************************************/
 
 #include <tbytevector.h>
+#include <tbytevectorlist.h>
+#include <tbytevectorreader.h>
+#include <tbytevectorwriter.h>
 #include <tdebug.h>
 
 #include <xiphcomment.h>
@@ -195,11 +198,21 @@ String Ogg::XiphComment::vendorID() const
 
 void Ogg::XiphComment::addField(const String &key, const String &value, bool replace)
 {
+  // Leave the comment alone if the field already holds just this value.
+
+  if(replace && !value.isEmpty() && d->fieldListMap.contains(key.upper()) &&
+     d->fieldListMap[key.upper()] == StringList(value))
+  {
+    return;
+  }
+
   if(replace)
     removeField(key.upper());
 
-  if(!key.isEmpty() && !value.isEmpty())
+  if(!key.isEmpty() && !value.isEmpty()) {
     d->fieldListMap[key.upper()].append(value);
+    setModified();
+  }
 }
 
 void Ogg::XiphComment::removeField(const String &key, const String &value)
@@ -207,14 +220,18 @@ void Ogg::XiphComment::removeField(const String &key, const String &value)
   if(!value.isNull()) {
     StringList::Iterator it = d->fieldListMap[key].begin();
     while(it != d->fieldListMap[key].end()) {
-      if(value == *it)
+      if(value == *it) {
         it = d->fieldListMap[key].erase(it);
+        setModified();
+      }
       else
         it++;
     }
   }
-  else
+  else if(d->fieldListMap.contains(key)) {
     d->fieldListMap.erase(key);
+    setModified();
+  }
 }
 
 bool Ogg::XiphComment::contains(const String &key) const
@@ -229,51 +246,65 @@ ByteVector Ogg::XiphComment::render() const
 
 ByteVector Ogg::XiphComment::render(bool addFramingBit) const
 {
-  ByteVector data;
+  // The vendor ID and the fields are converted to UTF8 first, so that the
+  // size of the comment is known and it can be written into a single buffer.
+  // It's important to use the length of the data(String::UTF8) rather than
+  // the length of the the string since this is UTF8 text and there may be
+  // more characters in the data than in the UTF16 string.
 
-  // Add the vendor ID length and the vendor ID.  It's important to use the
-  // length of the data(String::UTF8) rather than the length of the the string
-  // since this is UTF8 text and there may be more characters in the data than
-  // in the UTF16 string.
+  const ByteVector vendorData = d->vendorID.data(String::UTF8);
 
-  ByteVector vendorData = d->vendorID.data(String::UTF8);
-
-  data.append(ByteVector::fromUInt(vendorData.size(), false));
-  data.append(vendorData);
-
-  // Add the number of fields.
-
-  data.append(ByteVector::fromUInt(fieldCount(), false));
+  uint size = 4 + vendorData.size() + 4 + (addFramingBit ? 1 : 0);
 
   // Iterate over the the field lists.  Our iterator returns a
   // std::pair<String, StringList> where the first String is the field name and
-  // the StringList is the values associated with that field.
+  // the StringList is the values associated with that field.  The name and
+  // value of each field are kept one after the other in fieldData.
+
+  ByteVectorList fieldData;
 
   FieldListMap::ConstIterator it = d->fieldListMap.begin();
   for(; it != d->fieldListMap.end(); ++it) {
 
-    // And now iterate over the values of the current list.
-
-    String fieldName = (*it).first;
-    StringList values = (*it).second;
+    const ByteVector name = (*it).first.data(String::UTF8);
+    const StringList &values = (*it).second;
 
     StringList::ConstIterator valuesIt = values.begin();
     for(; valuesIt != values.end(); ++valuesIt) {
-      ByteVector fieldData = fieldName.data(String::UTF8);
-      fieldData.append('=');
-      fieldData.append((*valuesIt).data(String::UTF8));
-
-      data.append(ByteVector::fromUInt(fieldData.size(), false));
-      data.append(fieldData);
+      const ByteVector value = (*valuesIt).data(String::UTF8);
+      fieldData.append(name);
+      fieldData.append(value);
+      size += 4 + name.size() + 1 + value.size();
     }
   }
 
+  ByteVectorWriter writer(size);
+
+  // Add the vendor ID length and the vendor ID.
+
+  writer.writeUInt32(vendorData.size(), false);
+  writer.writeBlock(vendorData);
+
+  // Add the number of fields.
+
+  writer.writeUInt32(fieldCount(), false);
+
+  for(ByteVectorList::ConstIterator fieldIt = fieldData.begin(); fieldIt != fieldData.end(); ++fieldIt) {
+    const ByteVector &name = *fieldIt;
+    const ByteVector &value = *++fieldIt;
+
+    writer.writeUInt32(name.size() + 1 + value.size(), false);
+    writer.writeBlock(name);
+    writer.writeByte('=');
+    writer.writeBlock(value);
+  }
+
   // Append the "framing bit".
 
   if(addFramingBit)
-    data.append(char(1));
+    writer.writeByte(1);
 
-  return data;
+  return writer.data();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -285,29 +316,23 @@ void Ogg::XiphComment::parse(const ByteVector &data)
   // The first thing in the comment data is the vendor ID length, followed by a
   // UTF8 string with the vendor ID.
 
-  int pos = 0;
-
-  int vendorLength = data.mid(0, 4).toUInt(false);
-  pos += 4;
+  ByteVectorReader reader(data);
 
-  d->vendorID = String(data.mid(pos, vendorLength), String::UTF8);
-  pos += vendorLength;
+  d->vendorID = reader.readLengthPrefixedString(String::UTF8, 4, false);
 
   // Next the number of fields in the comment vector.
 
-  int commentFields = data.mid(pos, 4).toUInt(false);
-  pos += 4;
+  uint commentFields = reader.readUInt32(false);
 
-  for(int i = 0; i < commentFields; i++) {
+  for(uint i = 0; i < commentFields; i++) {
 
     // Each comment field is in the format "KEY=value" in a UTF8 string and has
     // 4 bytes before the text starts that gives the length.
 
-    int commentLength = data.mid(pos, 4).toUInt(false);
-    pos += 4;
+    String comment = reader.readLengthPrefixedString(String::UTF8, 4, false);
 
-    String comment = String(data.mid(pos, commentLength), String::UTF8);
-    pos += commentLength;
+    if(!reader.isValid())
+      break;
 
     int commentSeparatorPosition = comment.find("=");
 
@@ -316,4 +341,6 @@ void Ogg::XiphComment::parse(const ByteVector &data)
 
     addField(key, value, false);
   }
+
+  setModified(false);
 }
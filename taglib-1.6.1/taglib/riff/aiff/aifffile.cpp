@@ -63,6 +63,14 @@ RIFF::AIFF::File::File(FileName file, bool readProperties,
     read(readProperties, propertiesStyle);
 }
 
+RIFF::AIFF::File::File(IOStream *stream, bool readProperties,
+                       Properties::ReadStyle propertiesStyle) : RIFF::File(stream, BigEndian)
+{
+  d = new FilePrivate;
+  if(isOpen())
+    read(readProperties, propertiesStyle);
+}
+
 RIFF::AIFF::File::~File()
 {
   delete d;
@@ -85,11 +93,32 @@ bool RIFF::AIFF::File::save()
     return false;
   }
 
+  if(!d->tag->isModified())
+    return true;
+
   setChunkData("ID3 ", d->tag->render());
+  d->tag->setModified(false);
 
   return true;
 }
 
+bool RIFF::AIFF::File::audioRange(long &offset, long &length)
+{
+  if(!isValid())
+    return false;
+
+  for(uint i = 0; i < chunkCount(); i++) {
+    if(chunkName(i) == "SSND") {
+      // The samples follow the offset and block size fields.
+
+      offset = chunkOffset(i) + 8;
+      length = long(chunkDataSize(i)) - 8;
+      return length >= 0;
+    }
+  }
+  return false;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // private members
 ////////////////////////////////////////////////////////////////////////////////
@@ -65,6 +65,17 @@ namespace TagLib {
         File(FileName file, bool readProperties = true,
              Properties::ReadStyle propertiesStyle = Properties::Average);
 
+        /*!
+         * Contructs an AIFF file from \a stream.  If \a readProperties is true the
+         * file's audio properties will also be read using \a propertiesStyle.  If
+         * false, \a propertiesStyle is ignored.
+         *
+         * \note TagLib will *not* take ownership of the stream, the caller is
+         * responsible for deleting it after the File object.
+         */
+        File(IOStream *stream, bool readProperties = true,
+             Properties::ReadStyle propertiesStyle = Properties::Average);
+
         /*!
          * Destroys this instance of the File.
          */
@@ -86,6 +97,13 @@ namespace TagLib {
          */
         virtual bool save();
 
+        /*!
+         * Sets \a offset and \a length to the samples in the SSND chunk.
+         *
+         * \see TagLib::File::audioRange()
+         */
+        virtual bool audioRange(long &offset, long &length);
+
       private:
         File(const File &);
         File &operator=(const File &);
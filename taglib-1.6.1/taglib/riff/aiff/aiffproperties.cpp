@@ -24,6 +24,7 @@
  ***************************************************************************/
 
 #include <tstring.h>
+#include <tbytevectorreader.h>
 #include <tdebug.h>
 #include <cmath>
 // ldexp is a c99 function, which might not be defined in <cmath>
@@ -136,9 +137,10 @@ int RIFF::AIFF::Properties::channels() const
 
 void RIFF::AIFF::Properties::read(const ByteVector &data)
 {
-  d->channels       = data.mid(0, 2).toShort();
-  uint sampleFrames = data.mid(2, 4).toUInt();
-  short sampleSize  = data.mid(6, 2).toShort();
+  ByteVectorReader reader(data);
+  d->channels       = reader.readUInt16();
+  uint sampleFrames = reader.readUInt32();
+  short sampleSize  = reader.readUInt16();
   double sampleRate = ConvertFromIeeeExtended(reinterpret_cast<unsigned char *>(data.mid(8, 10).data()));
   d->sampleRate     = sampleRate;
   d->bitrate        = (sampleRate * sampleSize * d->channels) / 1024.0;
@@ -74,6 +74,15 @@ RIFF::File::File(FileName file, Endianness endianness) : TagLib::File(file)
     read();
 }
 
+RIFF::File::File(IOStream *stream, Endianness endianness) : TagLib::File(stream)
+{
+  d = new FilePrivate;
+  d->endianness = endianness;
+
+  if(isOpen())
+    read();
+}
+
 TagLib::uint RIFF::File::chunkCount() const
 {
   return d->chunkNames.size();
@@ -84,6 +93,11 @@ TagLib::uint RIFF::File::chunkOffset(uint i) const
   return d->chunkOffsets[i];
 }
 
+TagLib::uint RIFF::File::chunkDataSize(uint i) const
+{
+  return d->chunkSizes[i];
+}
+
 ByteVector RIFF::File::chunkName(uint i) const
 {
   if(i >= chunkCount())
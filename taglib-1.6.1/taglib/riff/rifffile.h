@@ -56,6 +56,7 @@ namespace TagLib {
       enum Endianness { BigEndian, LittleEndian };
 
       File(FileName file, Endianness endianness);
+      File(IOStream *stream, Endianness endianness);
 
       /*!
        * \return The number of chunks in the file.
@@ -67,6 +68,12 @@ namespace TagLib {
        */
       uint chunkOffset(uint i) const;
 
+      /*!
+       * \return The size of the data of the selected chunk, without its header
+       * or padding.
+       */
+      uint chunkDataSize(uint i) const;
+
       /*!
        * \return The name of the specified chunk, for instance, "COMM" or "ID3 "
        */
@@ -63,6 +63,14 @@ RIFF::WAV::File::File(FileName file, bool readProperties,
     read(readProperties, propertiesStyle);
 }
 
+RIFF::WAV::File::File(IOStream *stream, bool readProperties,
+                       Properties::ReadStyle propertiesStyle) : RIFF::File(stream, LittleEndian)
+{
+  d = new FilePrivate;
+  if(isOpen())
+    read(readProperties, propertiesStyle);
+}
+
 RIFF::WAV::File::~File()
 {
   delete d;
@@ -85,11 +93,30 @@ bool RIFF::WAV::File::save()
     return false;
   }
 
+  if(!d->tag->isModified())
+    return true;
+
   setChunkData("ID3 ", d->tag->render());
+  d->tag->setModified(false);
 
   return true;
 }
 
+bool RIFF::WAV::File::audioRange(long &offset, long &length)
+{
+  if(!isValid())
+    return false;
+
+  for(uint i = 0; i < chunkCount(); i++) {
+    if(chunkName(i) == "data") {
+      offset = chunkOffset(i);
+      length = chunkDataSize(i);
+      return true;
+    }
+  }
+  return false;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // private members
 ////////////////////////////////////////////////////////////////////////////////
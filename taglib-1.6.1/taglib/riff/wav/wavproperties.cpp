@@ -26,6 +26,7 @@
 #include "wavproperties.h"
 
 #include <tstring.h>
+#include <tbytevectorreader.h>
 #include <tdebug.h>
 #include <cmath>
 #include <math.h>
@@ -93,10 +94,11 @@ int RIFF::WAV::Properties::channels() const
 
 void RIFF::WAV::Properties::read(const ByteVector &data)
 {
-  d->format     = data.mid(0, 2).toShort(false);
-  d->channels   = data.mid(2, 2).toShort(false);
-  d->sampleRate = data.mid(4, 4).toUInt(false);
-  d->bitrate    = data.mid(8, 4).toUInt(false) * 8 / 1024;
+  ByteVectorReader reader(data);
+  d->format     = reader.readUInt16(false);
+  d->channels   = reader.readUInt16(false);
+  d->sampleRate = reader.readUInt32(false);
+  d->bitrate    = reader.readUInt32(false) * 8 / 1024;
 
   // short bitsPerSample = data.mid(10, 2).toShort();
   // d->bitrate    = (sampleRate * sampleSize * d->channels) / 1024.0;
@@ -29,17 +29,20 @@ using namespace TagLib;
 
 class Tag::TagPrivate
 {
+public:
+  TagPrivate() : modified(false) {}
 
+  bool modified;
 };
 
 Tag::Tag()
 {
-
+  d = new TagPrivate;
 }
 
 Tag::~Tag()
 {
-
+  delete d;
 }
 
 bool Tag::isEmpty() const
@@ -53,6 +56,16 @@ bool Tag::isEmpty() const
           track() == 0);
 }
 
+bool Tag::isModified() const
+{
+  return d->modified;
+}
+
+void Tag::setModified(bool modified)
+{
+  d->modified = modified;
+}
+
 void Tag::duplicate(const Tag *source, Tag *target, bool overwrite) // static
 {
   if(overwrite) {
@@ -141,6 +141,22 @@ namespace TagLib {
      */
     virtual bool isEmpty() const;
 
+    /*!
+     * Returns true if the tag has been changed since it was read or last
+     * saved.  The setters only count as a change if they change the value.
+     * A tag that has just been created is not modified until something is set
+     * in it, since writing it would be the same as not writing it.
+     *
+     * The File classes use this to skip saving tags that haven't changed.
+     */
+    virtual bool isModified() const;
+
+    /*!
+     * Sets whether the tag counts as changed since it was read.  The File
+     * classes clear this once the tag has been written.
+     */
+    virtual void setModified(bool modified = true);
+
     /*!
      * Copies the generic data from one tag to another.
      *
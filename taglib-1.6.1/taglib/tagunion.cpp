@@ -183,3 +183,20 @@ bool TagUnion::isEmpty() const
   return true;
 }
 
+bool TagUnion::isModified() const
+{
+  if(d->tags[0] && d->tags[0]->isModified())
+    return true;
+  if(d->tags[1] && d->tags[1]->isModified())
+    return true;
+  if(d->tags[2] && d->tags[2]->isModified())
+    return true;
+
+  return false;
+}
+
+void TagUnion::setModified(bool modified)
+{
+  setUnion(Modified, modified);
+}
+
@@ -72,6 +72,8 @@ namespace TagLib {
     virtual void setYear(uint i);
     virtual void setTrack(uint i);
     virtual bool isEmpty() const;
+    virtual bool isModified() const;
+    virtual void setModified(bool modified = true);
 
     template <class T> T *access(int index, bool create)
     {
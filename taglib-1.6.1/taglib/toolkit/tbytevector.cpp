@@ -478,11 +478,31 @@ ByteVector &ByteVector::append(const ByteVector &v)
   if(v.d->size == 0)
     return *this; // Simply return if appending nothing.
 
-  detach();
+  // The size is taken first as v may be this vector.
+
+  const uint originalSize = d->size;
+  const uint appendSize = v.d->size;
+
+  if(d->count() > 1) {
+
+    // Rather than detaching and then growing the copy, copy straight into a
+    // vector of the new size.
+
+    ByteVectorPrivate *copy = new ByteVectorPrivate;
+    copy->data.reserve(originalSize + appendSize);
+    copy->data.insert(copy->data.end(), d->data.begin(), d->data.end());
+    copy->data.insert(copy->data.end(), v.d->data.begin(), v.d->data.end());
+    copy->size = originalSize + appendSize;
 
-  uint originalSize = d->size;
-  resize(d->size + v.d->size);
-  ::memcpy(DATA(d) + originalSize, DATA(v.d), v.size());
+    if(d->deref())
+      delete d;
+    d = copy;
+
+    return *this;
+  }
+
+  resize(originalSize + appendSize);
+  ::memcpy(DATA(d) + originalSize, DATA(v.d), appendSize);
 
   return *this;
 }
@@ -504,7 +524,12 @@ TagLib::uint ByteVector::size() const
 ByteVector &ByteVector::resize(uint size, char padding)
 {
   if(d->size < size) {
-    d->data.reserve(size);
+
+    // Grow the capacity geometrically, so that a vector built up by appending
+    // to it isn't copied on every append.
+
+    if(size > d->data.capacity())
+      d->data.reserve(size > 2 * d->data.capacity() ? size : 2 * d->data.capacity());
     d->data.insert(d->data.end(), size - d->size, padding);
   }
   else
@@ -660,8 +685,10 @@ ByteVector &ByteVector::operator=(const char *data)
 void ByteVector::detach()
 {
   if(d->count() > 1) {
-    d->deref();
-    d = new ByteVectorPrivate(d->data);
+    ByteVectorPrivate *copy = new ByteVectorPrivate(d->data);
+    if(d->deref())
+      delete d;
+    d = copy;
   }
 }
 
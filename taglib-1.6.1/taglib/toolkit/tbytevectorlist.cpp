@@ -24,6 +24,7 @@
  ***************************************************************************/
 
 #include "tbytevectorlist.h"
+#include "tbytevectorwriter.h"
 
 using namespace TagLib;
 
@@ -87,16 +88,23 @@ ByteVectorList::~ByteVectorList()
 
 ByteVector ByteVectorList::toByteVector(const ByteVector &separator) const
 {
-  ByteVector v;
+  if(isEmpty())
+    return ByteVector();
+
+  uint size = separator.size() * (this->size() - 1);
+  for(ConstIterator it = begin(); it != end(); ++it)
+    size += it->size();
+
+  ByteVectorWriter writer(size);
 
   ConstIterator it = begin();
 
   while(it != end()) {
-    v.append(*it);
+    writer.writeBlock(*it);
     it++;
     if(it != end())
-      v.append(separator);
+      writer.writeBlock(separator);
   }
 
-  return v;
+  return writer.data();
 }
@@ -0,0 +1,185 @@
+/***************************************************************************
+ *   This library is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Lesser General Public License version   *
+ *   2.1 as published by the Free Software Foundation.                     *
+ *                                                                         *
+ *   This library is distributed in the hope that it will be useful, but   *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU     *
+ *   Lesser General Public License for more details.                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU Lesser General Public      *
+ *   License along with this library; if not, write to the Free Software   *
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  *
+ *   USA                                                                   *
+ *                                                                         *
+ *   Alternatively, this file is available under the Mozilla Public        *
+ *   License Version 1.1.  You may obtain a copy of the License at         *
+ *   http://www.mozilla.org/MPL/                                           *
+ ***************************************************************************/
+
+#include "tbytevectorreader.h"
+
+using namespace TagLib;
+
+// The integers are put together with shifts, which GCC and clang compile
+// into a single load (and a byte swap where the byte order differs from the
+// host's), so no platform specific intrinsics are needed.
+
+// The bytes are taken from the const \a data: the non-const data() of the
+// copy would detach it and copy the whole vector.
+
+ByteVectorReader::ByteVectorReader(const ByteVector &data, uint offset) :
+  vector(data),
+  bytes(reinterpret_cast<const uchar *>(data.data())),
+  size(vector.size()),
+  position(0),
+  valid(true)
+{
+  seek(offset);
+}
+
+uint ByteVectorReader::offset() const
+{
+  return position;
+}
+
+void ByteVectorReader::seek(uint offset)
+{
+  if(offset > size) {
+    position = size;
+    valid = false;
+  }
+  else
+    position = offset;
+}
+
+void ByteVectorReader::skip(uint length)
+{
+  advance(length);
+}
+
+uint ByteVectorReader::remaining() const
+{
+  return size - position;
+}
+
+bool ByteVectorReader::atEnd() const
+{
+  return position == size;
+}
+
+bool ByteVectorReader::isValid() const
+{
+  return valid;
+}
+
+uchar ByteVectorReader::readByte()
+{
+  const uchar *p = advance(1);
+  return p ? p[0] : 0;
+}
+
+unsigned short ByteVectorReader::readUInt16(bool mostSignificantByteFirst)
+{
+  const uchar *p = advance(2);
+  if(!p)
+    return 0;
+  if(mostSignificantByteFirst)
+    return (p[0] << 8) | p[1];
+  return (p[1] << 8) | p[0];
+}
+
+TagLib::uint ByteVectorReader::readUInt24(bool mostSignificantByteFirst)
+{
+  const uchar *p = advance(3);
+  if(!p)
+    return 0;
+  if(mostSignificantByteFirst)
+    return (uint(p[0]) << 16) | (uint(p[1]) << 8) | p[2];
+  return (uint(p[2]) << 16) | (uint(p[1]) << 8) | p[0];
+}
+
+TagLib::uint ByteVectorReader::readUInt32(bool mostSignificantByteFirst)
+{
+  const uchar *p = advance(4);
+  if(!p)
+    return 0;
+  if(mostSignificantByteFirst)
+    return (uint(p[0]) << 24) | (uint(p[1]) << 16) | (uint(p[2]) << 8) | p[3];
+  return (uint(p[3]) << 24) | (uint(p[2]) << 16) | (uint(p[1]) << 8) | p[0];
+}
+
+unsigned long long ByteVectorReader::readUInt64(bool mostSignificantByteFirst)
+{
+  uint first = readUInt32(mostSignificantByteFirst);
+  uint second = readUInt32(mostSignificantByteFirst);
+  if(mostSignificantByteFirst)
+    return ((unsigned long long)first << 32) | second;
+  return ((unsigned long long)second << 32) | first;
+}
+
+TagLib::uint ByteVectorReader::readSynchSafeUInt32()
+{
+  const uchar *p = advance(4);
+  if(!p)
+    return 0;
+  return (uint(p[0] & 0x7f) << 21) | (uint(p[1] & 0x7f) << 14) |
+    (uint(p[2] & 0x7f) << 7) | uint(p[3] & 0x7f);
+}
+
+ByteVector ByteVectorReader::readBlock(uint length)
+{
+  const uchar *p = advance(length);
+  if(!p)
+    return ByteVector::null;
+  return ByteVector(reinterpret_cast<const char *>(p), length);
+}
+
+String ByteVectorReader::readString(uint length, String::Type type)
+{
+  const uchar *p = advance(length);
+  if(!p)
+    return String::null;
+  return String(ByteVector(reinterpret_cast<const char *>(p), length), type);
+}
+
+String ByteVectorReader::readLengthPrefixedString(String::Type type, uint lengthSize,
+                                                  bool mostSignificantByteFirst)
+{
+  uint length;
+
+  switch(lengthSize) {
+  case 1:
+    length = readByte();
+    break;
+  case 2:
+    length = readUInt16(mostSignificantByteFirst);
+    break;
+  case 3:
+    length = readUInt24(mostSignificantByteFirst);
+    break;
+  default:
+    length = readUInt32(mostSignificantByteFirst);
+    break;
+  }
+
+  return readString(length, type);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// private members
+////////////////////////////////////////////////////////////////////////////////
+
+const TagLib::uchar *ByteVectorReader::advance(uint length)
+{
+  if(!valid || length > size - position) {
+    position = size;
+    valid = false;
+    return 0;
+  }
+
+  const uchar *p = bytes + position;
+  position += length;
+  return p;
+}
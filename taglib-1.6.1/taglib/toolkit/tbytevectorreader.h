@@ -0,0 +1,173 @@
+/***************************************************************************
+ *   This library is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Lesser General Public License version   *
+ *   2.1 as published by the Free Software Foundation.                     *
+ *                                                                         *
+ *   This library is distributed in the hope that it will be useful, but   *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU     *
+ *   Lesser General Public License for more details.                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU Lesser General Public      *
+ *   License along with this library; if not, write to the Free Software   *
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  *
+ *   USA                                                                   *
+ *                                                                         *
+ *   Alternatively, this file is available under the Mozilla Public        *
+ *   License Version 1.1.  You may obtain a copy of the License at         *
+ *   http://www.mozilla.org/MPL/                                           *
+ ***************************************************************************/
+
+#ifndef TAGLIB_BYTEVECTORREADER_H
+#define TAGLIB_BYTEVECTORREADER_H
+
+#include "taglib_export.h"
+#include "tbytevector.h"
+#include "tstring.h"
+
+namespace TagLib {
+
+  //! A cursor for reading binary fields from a ByteVector
+
+  /*!
+   * This reads integers, strings and blocks of bytes one after the other
+   * from a ByteVector.  Unlike \code data.mid(pos, 4).toUInt() \endcode it
+   * does not create a temporary vector for every field it reads.  For
+   * example:
+   *
+   * \code
+   *
+   * ByteVectorReader reader(data);
+   * uint count = reader.readUInt32(false);
+   * for(uint i = 0; i < count && reader.isValid(); i++)
+   *   fields.append(reader.readLengthPrefixedString(String::UTF8, 4, false));
+   *
+   * \endcode
+   *
+   * Every read is bounds checked.  A read past the end of the data returns 0
+   * (or an empty vector or string), moves the reader to the end and makes
+   * isValid() return false, so a parser may read a whole structure and check
+   * for truncation once.
+   *
+   * The reader keeps a shallow copy of the data, which is cheap because
+   * ByteVector is implicitly shared.
+   */
+
+  class TAGLIB_EXPORT ByteVectorReader
+  {
+  public:
+    /*!
+     * Constructs a reader for \a data, starting at \a offset.
+     */
+    explicit ByteVectorReader(const ByteVector &data, uint offset = 0);
+
+    /*!
+     * Returns the position of the next byte to be read.
+     */
+    uint offset() const;
+
+    /*!
+     * Moves the reader to \a offset.  Moving past the end of the data makes
+     * the reader invalid.
+     */
+    void seek(uint offset);
+
+    /*!
+     * Skips \a length bytes.  Skipping past the end of the data makes the
+     * reader invalid.
+     */
+    void skip(uint length);
+
+    /*!
+     * Returns the number of bytes left to read.
+     */
+    uint remaining() const;
+
+    /*!
+     * Returns true if all of the data has been read.
+     */
+    bool atEnd() const;
+
+    /*!
+     * Returns false if a read went past the end of the data.
+     */
+    bool isValid() const;
+
+    /*!
+     * Reads one byte.
+     */
+    uchar readByte();
+
+    /*!
+     * Reads a 16 bit unsigned integer.
+     *
+     * \see ByteVector::toShort()
+     */
+    unsigned short readUInt16(bool mostSignificantByteFirst = true);
+
+    /*!
+     * Reads a 24 bit unsigned integer, as used for the block sizes of FLAC
+     * and the frame sizes of ID3v2.2.
+     */
+    uint readUInt24(bool mostSignificantByteFirst = true);
+
+    /*!
+     * Reads a 32 bit unsigned integer.
+     *
+     * \see ByteVector::toUInt()
+     */
+    uint readUInt32(bool mostSignificantByteFirst = true);
+
+    /*!
+     * Reads a 64 bit unsigned integer.
+     *
+     * \see ByteVector::toLongLong()
+     */
+    unsigned long long readUInt64(bool mostSignificantByteFirst = true);
+
+    /*!
+     * Reads a 32 bit ID3v2 synch safe integer, which stores 7 bits in each
+     * byte.
+     *
+     * \see ID3v2::SynchData::toUInt()
+     */
+    uint readSynchSafeUInt32();
+
+    /*!
+     * Reads \a length bytes.
+     */
+    ByteVector readBlock(uint length);
+
+    /*!
+     * Reads a string of \a length bytes in the encoding \a type.
+     */
+    String readString(uint length, String::Type type = String::Latin1);
+
+    /*!
+     * Reads a string in the encoding \a type that follows its length in
+     * bytes.  The length is a \a lengthSize byte (1, 2, 3 or 4) unsigned
+     * integer.
+     */
+    String readLengthPrefixedString(String::Type type, uint lengthSize = 4,
+                                    bool mostSignificantByteFirst = true);
+
+  private:
+    /*!
+     * Returns a pointer to the next \a length bytes and moves past them, or
+     * null if there are not that many left.
+     */
+    const uchar *advance(uint length);
+
+    // The fields are held directly, rather than in a private class, so that
+    // a reader on the stack costs no allocation.
+
+    ByteVector vector;
+    const uchar *bytes;
+    uint size;
+    uint position;
+    bool valid;
+  };
+
+}
+
+#endif
@@ -0,0 +1,157 @@
+/***************************************************************************
+ *   This library is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Lesser General Public License version   *
+ *   2.1 as published by the Free Software Foundation.                     *
+ *                                                                         *
+ *   This library is distributed in the hope that it will be useful, but   *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU     *
+ *   Lesser General Public License for more details.                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU Lesser General Public      *
+ *   License along with this library; if not, write to the Free Software   *
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  *
+ *   USA                                                                   *
+ *                                                                         *
+ *   Alternatively, this file is available under the Mozilla Public        *
+ *   License Version 1.1.  You may obtain a copy of the License at         *
+ *   http://www.mozilla.org/MPL/                                           *
+ ***************************************************************************/
+
+#include <string.h>
+
+#include "tbytevectorwriter.h"
+
+using namespace TagLib;
+
+ByteVectorWriter::ByteVectorWriter(uint size) :
+  vector(size, 0),
+  bytes(0),
+  capacity(size),
+  position(0),
+  end(0)
+{
+}
+
+TagLib::uint ByteVectorWriter::offset() const
+{
+  return position;
+}
+
+void ByteVectorWriter::seek(uint offset)
+{
+  if(offset > end) {
+    position = end;
+    fill(offset - end);
+  }
+  else
+    position = offset;
+}
+
+TagLib::uint ByteVectorWriter::size() const
+{
+  return end;
+}
+
+void ByteVectorWriter::writeByte(uchar value)
+{
+  advance(1)[0] = value;
+}
+
+void ByteVectorWriter::writeUInt16(unsigned short value, bool mostSignificantByteFirst)
+{
+  uchar *p = advance(2);
+  if(mostSignificantByteFirst) {
+    p[0] = uchar(value >> 8);
+    p[1] = uchar(value);
+  }
+  else {
+    p[0] = uchar(value);
+    p[1] = uchar(value >> 8);
+  }
+}
+
+void ByteVectorWriter::writeUInt24(uint value, bool mostSignificantByteFirst)
+{
+  uchar *p = advance(3);
+  for(int i = 0; i < 3; i++)
+    p[mostSignificantByteFirst ? 2 - i : i] = uchar(value >> (i * 8));
+}
+
+void ByteVectorWriter::writeUInt32(uint value, bool mostSignificantByteFirst)
+{
+  uchar *p = advance(4);
+  for(int i = 0; i < 4; i++)
+    p[mostSignificantByteFirst ? 3 - i : i] = uchar(value >> (i * 8));
+}
+
+void ByteVectorWriter::writeUInt64(unsigned long long value, bool mostSignificantByteFirst)
+{
+  uchar *p = advance(8);
+  for(int i = 0; i < 8; i++)
+    p[mostSignificantByteFirst ? 7 - i : i] = uchar(value >> (i * 8));
+}
+
+void ByteVectorWriter::writeSynchSafeUInt32(uint value)
+{
+  uchar *p = advance(4);
+  for(int i = 0; i < 4; i++)
+    p[3 - i] = uchar((value >> (i * 7)) & 0x7f);
+}
+
+void ByteVectorWriter::writeBlock(const ByteVector &data)
+{
+  writeBlock(data.data(), data.size());
+}
+
+void ByteVectorWriter::writeBlock(const char *data, uint length)
+{
+  if(length > 0)
+    ::memcpy(advance(length), data, length);
+}
+
+void ByteVectorWriter::fill(uint length, char c)
+{
+  if(length > 0)
+    ::memset(advance(length), c, length);
+}
+
+ByteVector ByteVectorWriter::data()
+{
+  // Shrinking the vector doesn't reallocate it.  The pointer is dropped so
+  // that a later write detaches from the copy handed out here.
+
+  vector.resize(end);
+  capacity = end;
+  bytes = 0;
+  return vector;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// private members
+////////////////////////////////////////////////////////////////////////////////
+
+uchar *ByteVectorWriter::advance(uint length)
+{
+  if(!bytes || position + length > capacity) {
+
+    // ByteVector::resize() doesn't detach, so detach from any copy handed out
+    // by data() before growing.
+
+    vector.data();
+
+    if(position + length > capacity) {
+      const uint grown = capacity * 2;
+      capacity = position + length > grown ? position + length : grown;
+      vector.resize(capacity);
+    }
+
+    bytes = reinterpret_cast<uchar *>(vector.data());
+  }
+
+  uchar *p = bytes + position;
+  position += length;
+  if(position > end)
+    end = position;
+  return p;
+}
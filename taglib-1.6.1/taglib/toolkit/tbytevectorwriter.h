@@ -0,0 +1,157 @@
+/***************************************************************************
+ *   This library is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Lesser General Public License version   *
+ *   2.1 as published by the Free Software Foundation.                     *
+ *                                                                         *
+ *   This library is distributed in the hope that it will be useful, but   *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU     *
+ *   Lesser General Public License for more details.                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU Lesser General Public      *
+ *   License along with this library; if not, write to the Free Software   *
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  *
+ *   USA                                                                   *
+ *                                                                         *
+ *   Alternatively, this file is available under the Mozilla Public        *
+ *   License Version 1.1.  You may obtain a copy of the License at         *
+ *   http://www.mozilla.org/MPL/                                           *
+ ***************************************************************************/
+
+#ifndef TAGLIB_BYTEVECTORWRITER_H
+#define TAGLIB_BYTEVECTORWRITER_H
+
+#include "taglib_export.h"
+#include "tbytevector.h"
+
+namespace TagLib {
+
+  //! A cursor for writing binary fields into a ByteVector
+
+  /*!
+   * This is the counterpart of ByteVectorReader.  It allocates the vector
+   * once, at the size it is given, and writes integers and blocks of bytes
+   * into it in place, so a serializer that works out how big its output will
+   * be doesn't build and concatenate a temporary vector for every field.
+   * For example:
+   *
+   * \code
+   *
+   * ByteVectorWriter writer(4 + name.size() + value.size());
+   * writer.writeUInt32(value.size(), false);
+   * writer.writeBlock(name);
+   * writer.writeBlock(value);
+   * return writer.data();
+   *
+   * \endcode
+   *
+   * If a write doesn't fit, the vector grows geometrically, so a size that was
+   * worked out too small costs a copy rather than corrupting the output.
+   */
+
+  class TAGLIB_EXPORT ByteVectorWriter
+  {
+  public:
+    /*!
+     * Constructs a writer for a vector of \a size bytes.
+     */
+    explicit ByteVectorWriter(uint size);
+
+    /*!
+     * Returns the position of the next byte to be written.
+     */
+    uint offset() const;
+
+    /*!
+     * Moves the writer to \a offset, for example to go back and fill in a size
+     * once what follows it has been written.  Moving past the bytes written
+     * so far fills the gap with zeros.
+     */
+    void seek(uint offset);
+
+    /*!
+     * Returns the number of bytes written, counting up to the furthest
+     * position the writer has reached.
+     */
+    uint size() const;
+
+    /*!
+     * Writes one byte.
+     */
+    void writeByte(uchar value);
+
+    /*!
+     * Writes a 16 bit unsigned integer.
+     *
+     * \see ByteVector::fromShort()
+     */
+    void writeUInt16(unsigned short value, bool mostSignificantByteFirst = true);
+
+    /*!
+     * Writes a 24 bit unsigned integer.
+     */
+    void writeUInt24(uint value, bool mostSignificantByteFirst = true);
+
+    /*!
+     * Writes a 32 bit unsigned integer.
+     *
+     * \see ByteVector::fromUInt()
+     */
+    void writeUInt32(uint value, bool mostSignificantByteFirst = true);
+
+    /*!
+     * Writes a 64 bit unsigned integer.
+     *
+     * \see ByteVector::fromLongLong()
+     */
+    void writeUInt64(unsigned long long value, bool mostSignificantByteFirst = true);
+
+    /*!
+     * Writes a 32 bit ID3v2 synch safe integer, which stores 7 bits in each
+     * byte.
+     *
+     * \see ID3v2::SynchData::fromUInt()
+     */
+    void writeSynchSafeUInt32(uint value);
+
+    /*!
+     * Writes the bytes of \a data.
+     */
+    void writeBlock(const ByteVector &data);
+
+    /*!
+     * Writes \a length bytes from \a data.
+     */
+    void writeBlock(const char *data, uint length);
+
+    /*!
+     * Writes \a length copies of \a c.
+     */
+    void fill(uint length, char c = 0);
+
+    /*!
+     * Returns the bytes written.  This is a shallow copy of the writer's
+     * vector; writing more afterwards detaches the writer from it first.
+     */
+    ByteVector data();
+
+  private:
+    /*!
+     * Returns a pointer to room for the next \a length bytes, growing the
+     * vector if needed, and moves past them.
+     */
+    uchar *advance(uint length);
+
+    // The fields are held directly, rather than in a private class, so that
+    // a writer on the stack costs only the vector's allocation.
+
+    ByteVector vector;
+    uchar *bytes;
+    uint capacity;
+    uint position;
+    uint end;
+  };
+
+}
+
+#endif
@@ -24,24 +24,16 @@
  ***************************************************************************/
 
 #include "tfile.h"
+#include "tfilestream.h"
 #include "tstring.h"
 #include "tdebug.h"
 
-#include <stdio.h>
-#include <string.h>
-#include <sys/stat.h>
-
 #ifdef _WIN32
-# include <wchar.h>
-# include <windows.h>
 # include <io.h>
-# define ftruncate _chsize
 #else
 # include <unistd.h>
 #endif
 
-#include <stdlib.h>
-
 #ifndef R_OK
 # define R_OK 4
 #endif
@@ -51,71 +43,22 @@
 
 using namespace TagLib;
 
-#ifdef _WIN32
-
-typedef FileName FileNameHandle;
-
-#else
-
-struct FileNameHandle : public std::string
-{
-  FileNameHandle(FileName name) : std::string(name) {}
-  operator FileName () const { return c_str(); }
-};
-
-#endif
-
 class File::FilePrivate
 {
 public:
-  FilePrivate(FileName fileName);
+  FilePrivate(IOStream *stream, bool owner);
 
-  FILE *file;
-
-  FileNameHandle name;
-
-  bool readOnly;
+  IOStream *stream;
+  bool streamOwner;
   bool valid;
-  ulong size;
   static const uint bufferSize = 1024;
 };
 
-File::FilePrivate::FilePrivate(FileName fileName) :
-  file(0),
-  name(fileName),
-  readOnly(true),
-  valid(true),
-  size(0)
+File::FilePrivate::FilePrivate(IOStream *stream, bool owner) :
+  stream(stream),
+  streamOwner(owner),
+  valid(true)
 {
-  // First try with read / write mode, if that fails, fall back to read only.
-
-#ifdef _WIN32
-
-  if(wcslen((const wchar_t *) fileName) > 0) {
-
-    file = _wfopen(name, L"rb+");
-
-    if(file)
-      readOnly = false;
-    else
-      file = _wfopen(name, L"rb");
-
-    if(file)
-      return;
-
-  }
-
-#endif
-
-  file = fopen(name, "rb+");
-
-  if(file)
-    readOnly = false;
-  else
-    file = fopen(name, "rb");
-
-  if(!file)
-    debug("Could not open file " + String((const char *) name));
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -124,59 +67,44 @@ File::FilePrivate::FilePrivate(FileName fileName) :
 
 File::File(FileName file)
 {
-  d = new FilePrivate(file);
+  d = new FilePrivate(new FileStream(file), true);
+}
+
+File::File(IOStream *stream)
+{
+  d = new FilePrivate(stream, false);
 }
 
 File::~File()
 {
-  if(d->file)
-    fclose(d->file);
+  if(d->streamOwner)
+    delete d->stream;
   delete d;
 }
 
 FileName File::name() const
 {
-  return d->name;
+  return d->stream->name();
 }
 
-ByteVector File::readBlock(ulong length)
+bool File::audioRange(long &, long &)
 {
-  if(!d->file) {
-    debug("File::readBlock() -- Invalid File");
-    return ByteVector::null;
-  }
-
-  if(length == 0)
-    return ByteVector::null;
-
-  if(length > FilePrivate::bufferSize &&
-     length > ulong(File::length()))
-  {
-    length = File::length();
-  }
+  return false;
+}
 
-  ByteVector v(static_cast<uint>(length));
-  const int count = fread(v.data(), sizeof(char), length, d->file);
-  v.resize(count);
-  return v;
+ByteVector File::readBlock(ulong length)
+{
+  return d->stream->readBlock(length);
 }
 
 void File::writeBlock(const ByteVector &data)
 {
-  if(!d->file)
-    return;
-
-  if(d->readOnly) {
-    debug("File::writeBlock() -- attempted to write to a file that is not writable");
-    return;
-  }
-
-  fwrite(data.data(), sizeof(char), data.size(), d->file);
+  d->stream->writeBlock(data);
 }
 
 long File::find(const ByteVector &pattern, long fromOffset, const ByteVector &before)
 {
-  if(!d->file || pattern.size() > d->bufferSize)
+  if(!isOpen() || pattern.size() > d->bufferSize)
       return -1;
 
   // The position in the file that the current buffer starts at.
@@ -272,7 +200,7 @@ long File::find(const ByteVector &pattern, long fromOffset, const ByteVector &be
 
 long File::rfind(const ByteVector &pattern, long fromOffset, const ByteVector &before)
 {
-  if(!d->file || pattern.size() > d->bufferSize)
+  if(!isOpen() || pattern.size() > d->bufferSize)
       return -1;
 
   // The position in the file that the current buffer starts at.
@@ -340,137 +268,17 @@ long File::rfind(const ByteVector &pattern, long fromOffset, const ByteVector &b
 
 void File::insert(const ByteVector &data, ulong start, ulong replace)
 {
-  if(!d->file)
-    return;
-
-  if(data.size() == replace) {
-    seek(start);
-    writeBlock(data);
-    return;
-  }
-  else if(data.size() < replace) {
-      seek(start);
-      writeBlock(data);
-      removeBlock(start + data.size(), replace - data.size());
-      return;
-  }
-
-  // Woohoo!  Faster (about 20%) than id3lib at last.  I had to get hardcore
-  // and avoid TagLib's high level API for rendering just copying parts of
-  // the file that don't contain tag data.
-  //
-  // Now I'll explain the steps in this ugliness:
-
-  // First, make sure that we're working with a buffer that is longer than
-  // the *differnce* in the tag sizes.  We want to avoid overwriting parts
-  // that aren't yet in memory, so this is necessary.
-
-  ulong bufferLength = bufferSize();
-
-  while(data.size() - replace > bufferLength)
-    bufferLength += bufferSize();
-
-  // Set where to start the reading and writing.
-
-  long readPosition = start + replace;
-  long writePosition = start;
-
-  ByteVector buffer;
-  ByteVector aboutToOverwrite(static_cast<uint>(bufferLength));
-
-  // This is basically a special case of the loop below.  Here we're just
-  // doing the same steps as below, but since we aren't using the same buffer
-  // size -- instead we're using the tag size -- this has to be handled as a
-  // special case.  We're also using File::writeBlock() just for the tag.
-  // That's a bit slower than using char *'s so, we're only doing it here.
-
-  seek(readPosition);
-  int bytesRead = fread(aboutToOverwrite.data(), sizeof(char), bufferLength, d->file);
-  readPosition += bufferLength;
-
-  seek(writePosition);
-  writeBlock(data);
-  writePosition += data.size();
-
-  buffer = aboutToOverwrite;
-
-  // In case we've already reached the end of file...
-
-  buffer.resize(bytesRead);
-
-  // Ok, here's the main loop.  We want to loop until the read fails, which
-  // means that we hit the end of the file.
-
-  while(!buffer.isEmpty()) {
-
-    // Seek to the current read position and read the data that we're about
-    // to overwrite.  Appropriately increment the readPosition.
-
-    seek(readPosition);
-    bytesRead = fread(aboutToOverwrite.data(), sizeof(char), bufferLength, d->file);
-    aboutToOverwrite.resize(bytesRead);
-    readPosition += bufferLength;
-
-    // Check to see if we just read the last block.  We need to call clear()
-    // if we did so that the last write succeeds.
-
-    if(ulong(bytesRead) < bufferLength)
-      clear();
-
-    // Seek to the write position and write our buffer.  Increment the
-    // writePosition.
-
-    seek(writePosition);
-    fwrite(buffer.data(), sizeof(char), buffer.size(), d->file);
-    writePosition += buffer.size();
-
-    // Make the current buffer the data that we read in the beginning.
-
-    buffer = aboutToOverwrite;
-
-    // Again, we need this for the last write.  We don't want to write garbage
-    // at the end of our file, so we need to set the buffer size to the amount
-    // that we actually read.
-
-    bufferLength = bytesRead;
-  }
+  d->stream->insert(data, start, replace);
 }
 
 void File::removeBlock(ulong start, ulong length)
 {
-  if(!d->file)
-    return;
-
-  ulong bufferLength = bufferSize();
-
-  long readPosition = start + length;
-  long writePosition = start;
-
-  ByteVector buffer(static_cast<uint>(bufferLength));
-
-  ulong bytesRead = 1;
-
-  while(bytesRead != 0) {
-    seek(readPosition);
-    bytesRead = fread(buffer.data(), sizeof(char), bufferLength, d->file);
-    readPosition += bytesRead;
-
-    // Check to see if we just read the last block.  We need to call clear()
-    // if we did so that the last write succeeds.
-
-    if(bytesRead < bufferLength)
-      clear();
-
-    seek(writePosition);
-    fwrite(buffer.data(), sizeof(char), bytesRead, d->file);
-    writePosition += bytesRead;
-  }
-  truncate(writePosition);
+  d->stream->removeBlock(start, length);
 }
 
 bool File::readOnly() const
 {
-  return d->readOnly;
+  return d->stream->readOnly();
 }
 
 bool File::isReadable(const char *file)
@@ -480,7 +288,7 @@ bool File::isReadable(const char *file)
 
 bool File::isOpen() const
 {
-  return (d->file != NULL);
+  return d->stream->isOpen();
 }
 
 bool File::isValid() const
@@ -490,53 +298,22 @@ bool File::isValid() const
 
 void File::seek(long offset, Position p)
 {
-  if(!d->file) {
-    debug("File::seek() -- trying to seek in a file that isn't opened.");
-    return;
-  }
-
-  switch(p) {
-  case Beginning:
-    fseek(d->file, offset, SEEK_SET);
-    break;
-  case Current:
-    fseek(d->file, offset, SEEK_CUR);
-    break;
-  case End:
-    fseek(d->file, offset, SEEK_END);
-    break;
-  }
+  d->stream->seek(offset, IOStream::Position(p));
 }
 
 void File::clear()
 {
-  clearerr(d->file);
+  d->stream->clear();
 }
 
 long File::tell() const
 {
-  return ftell(d->file);
+  return d->stream->tell();
 }
 
 long File::length()
 {
-  // Do some caching in case we do multiple calls.
-
-  if(d->size > 0)
-    return d->size;
-
-  if(!d->file)
-    return 0;
-
-  long curpos = tell();
-
-  seek(0, End);
-  long endpos = tell();
-
-  seek(curpos, Beginning);
-
-  d->size = endpos;
-  return endpos;
+  return d->stream->length();
 }
 
 bool File::isWritable(const char *file)
@@ -555,7 +332,12 @@ void File::setValid(bool valid)
 
 void File::truncate(long length)
 {
-  ftruncate(fileno(d->file), length);
+  d->stream->truncate(length);
+}
+
+IOStream *File::stream() const
+{
+  return d->stream;
 }
 
 TagLib::uint File::bufferSize()
@@ -29,6 +29,7 @@
 #include "taglib_export.h"
 #include "taglib.h"
 #include "tbytevector.h"
+#include "tiostream.h"
 
 namespace TagLib {
 
@@ -36,28 +37,15 @@ namespace TagLib {
   class Tag;
   class AudioProperties;
 
-#ifdef _WIN32
-  class TAGLIB_EXPORT FileName
-  {
-  public:
-    FileName(const wchar_t *name) : m_wname(name) {}
-    FileName(const char *name) : m_name(name) {}
-    operator const wchar_t *() const { return m_wname.c_str(); }
-    operator const char *() const { return m_name.c_str(); }
-  private:
-    std::string m_name;
-    std::wstring m_wname;
-  };
-#else
-  typedef const char *FileName;
-#endif
-
   //! A file class with some useful methods for tag manipulation
 
   /*!
    * This class is a basic file class with some methods that are particularly
    * useful for tag editors.  It has methods to take advantage of
    * ByteVector and a binary search method for finding patterns in a file.
+   *
+   * All of the I/O goes through an IOStream, which is a FileStream unless the
+   * File was constructed from another stream.
    */
 
   class TAGLIB_EXPORT File
@@ -110,6 +98,20 @@ namespace TagLib {
      */
     virtual bool save() = 0;
 
+    /*!
+     * Sets \a offset and \a length to the part of the file that holds the
+     * audio data, leaving out the tags and other metadata around it, and
+     * returns true.  Returns false if the file is not valid or its format
+     * does not say where the audio is, which is what this implementation
+     * does.
+     *
+     * The range is that of the file as it was read; it is not updated by
+     * save().
+     *
+     * \see AudioHash
+     */
+    virtual bool audioRange(long &offset, long &length);
+
     /*!
      * Reads a block of size \a length at the current get pointer.
      */
@@ -240,6 +242,15 @@ namespace TagLib {
      */
     File(FileName file);
 
+    /*!
+     * Construct a File object that reads from and writes to \a stream.  The
+     * stream is not owned by the File and must outlive it.
+     *
+     * \note Constructor is protected since this class should only be
+     * instantiated through subclasses.
+     */
+    File(IOStream *stream);
+
     /*!
      * Marks the file as valid or invalid.
      *
@@ -252,6 +263,11 @@ namespace TagLib {
      */
     void truncate(long length);
 
+    /*!
+     * Returns the stream that the file reads from and writes to.
+     */
+    IOStream *stream() const;
+
     /*!
      * Returns the buffer size that is used for internal buffering.
      */
@@ -0,0 +1,148 @@
+/***************************************************************************
+ *   This library is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Lesser General Public License version   *
+ *   2.1 as published by the Free Software Foundation.                     *
+ *                                                                         *
+ *   This library is distributed in the hope that it will be useful, but   *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU     *
+ *   Lesser General Public License for more details.                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU Lesser General Public      *
+ *   License along with this library; if not, write to the Free Software   *
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  *
+ *   USA                                                                   *
+ *                                                                         *
+ *   Alternatively, this file is available under the Mozilla Public        *
+ *   License Version 1.1.  You may obtain a copy of the License at         *
+ *   http://www.mozilla.org/MPL/                                           *
+ ***************************************************************************/
+
+#ifndef TAGLIB_IOSTREAM_H
+#define TAGLIB_IOSTREAM_H
+
+#include "taglib_export.h"
+#include "taglib.h"
+#include "tbytevector.h"
+
+namespace TagLib {
+
+#ifdef _WIN32
+  class TAGLIB_EXPORT FileName
+  {
+  public:
+    FileName(const wchar_t *name) : m_wname(name) {}
+    FileName(const char *name) : m_name(name) {}
+    operator const wchar_t *() const { return m_wname.c_str(); }
+    operator const char *() const { return m_name.c_str(); }
+  private:
+    std::string m_name;
+    std::wstring m_wname;
+  };
+#else
+  typedef const char *FileName;
+#endif
+
+  //! An abstract class that provides the I/O operations used by File
+
+  /*!
+   * TagLib::File does all of its I/O through an IOStream.  FileStream, which
+   * is used when a File is constructed from a file name, reads and writes a
+   * file on disk.  Other implementations may serve the data from memory, for
+   * example data that has already been read ahead of time.
+   */
+
+  class TAGLIB_EXPORT IOStream
+  {
+  public:
+    /*!
+     * Position in the stream used for seeking.
+     */
+    enum Position {
+      //! Seek from the beginning of the stream.
+      Beginning,
+      //! Seek from the current position in the stream.
+      Current,
+      //! Seek from the end of the stream.
+      End
+    };
+
+    IOStream();
+
+    /*!
+     * Destroys this IOStream instance.
+     */
+    virtual ~IOStream();
+
+    /*!
+     * Returns the stream name in the local file system encoding.
+     */
+    virtual FileName name() const = 0;
+
+    /*!
+     * Reads a block of size \a length at the current get pointer.
+     */
+    virtual ByteVector readBlock(ulong length) = 0;
+
+    /*!
+     * Attempts to write the block \a data at the current get pointer.
+     */
+    virtual void writeBlock(const ByteVector &data) = 0;
+
+    /*!
+     * Insert \a data at position \a start in the stream overwriting \a replace
+     * bytes of the original content.
+     */
+    virtual void insert(const ByteVector &data, ulong start = 0, ulong replace = 0) = 0;
+
+    /*!
+     * Removes a block of the stream starting a \a start and continuing for
+     * \a length bytes.
+     */
+    virtual void removeBlock(ulong start = 0, ulong length = 0) = 0;
+
+    /*!
+     * Returns true if the stream is read only.
+     */
+    virtual bool readOnly() const = 0;
+
+    /*!
+     * Returns true if the stream is open.
+     */
+    virtual bool isOpen() const = 0;
+
+    /*!
+     * Move the I/O pointer to \a offset in the stream from position \a p.
+     * Seeking to before the beginning of the stream leaves the pointer where
+     * it was.
+     */
+    virtual void seek(long offset, Position p = Beginning) = 0;
+
+    /*!
+     * Reset the end-of-stream and error flags on the stream.
+     */
+    virtual void clear();
+
+    /*!
+     * Returns the current offset within the stream.
+     */
+    virtual long tell() const = 0;
+
+    /*!
+     * Returns the length of the stream.
+     */
+    virtual long length() = 0;
+
+    /*!
+     * Truncates the stream to a \a length.
+     */
+    virtual void truncate(long length) = 0;
+
+  private:
+    IOStream(const IOStream &);
+    IOStream &operator=(const IOStream &);
+  };
+
+}
+
+#endif
@@ -28,7 +28,7 @@
 
 #include "taglib.h"
 
-#include <list>
+#include <vector>
 
 namespace TagLib {
 
@@ -48,14 +48,19 @@ namespace TagLib {
    * return types of functions.  The above example will just copy a pointer rather
    * than copying the data in the list.  When your \e shared list's data changes,
    * only \e then will the data be copied.
+   *
+   * The items are stored contiguously, so indexing is constant time and
+   * appending is amortized constant time.  As with std::vector, inserting
+   * or appending items may invalidate iterators into the list, and erasing
+   * an item invalidates the iterators to it and the items after it.
    */
 
   template <class T> class List
   {
   public:
 #ifndef DO_NOT_DOCUMENT
-    typedef typename std::list<T>::iterator Iterator;
-    typedef typename std::list<T>::const_iterator ConstIterator;
+    typedef typename std::vector<T>::iterator Iterator;
+    typedef typename std::vector<T>::const_iterator ConstIterator;
 #endif
 
     /*!
@@ -78,25 +83,25 @@ namespace TagLib {
 
     /*!
      * Returns an STL style iterator to the beginning of the list.  See
-     * std::list::const_iterator for the semantics.
+     * std::vector::const_iterator for the semantics.
      */
     Iterator begin();
 
     /*!
      * Returns an STL style constant iterator to the beginning of the list.  See
-     * std::list::iterator for the semantics.
+     * std::vector::iterator for the semantics.
      */
     ConstIterator begin() const;
 
     /*!
      * Returns an STL style iterator to the end of the list.  See
-     * std::list::iterator for the semantics.
+     * std::vector::iterator for the semantics.
      */
     Iterator end();
 
     /*!
      * Returns an STL style constant iterator to the end of the list.  See
-     * std::list::const_iterator for the semantics.
+     * std::vector::const_iterator for the semantics.
      */
     ConstIterator end() const;
 
@@ -202,15 +207,11 @@ namespace TagLib {
 
     /*!
      * Returns a reference to item \a i in the list.
-     *
-     * \warning This method is slow.  Use iterators to loop through the list.
      */
     T &operator[](uint i);
 
     /*!
      * Returns a const reference to item \a i in the list.
-     *
-     * \warning This method is slow.  Use iterators to loop through the list.
      */
     const T &operator[](uint i) const;
 
@@ -227,6 +228,12 @@ namespace TagLib {
      */
     bool operator==(const List<T> &l) const;
 
+    /*!
+     * Compares this list with \a l and returns true if any of the elements
+     * differ.
+     */
+    bool operator!=(const List<T> &l) const;
+
   protected:
     /*
      * If this List is being shared via implicit sharing, do a deep copy of the
@@ -52,11 +52,11 @@ template <class TP> class List<T>::ListPrivate  : public ListPrivateBase
 {
 public:
   ListPrivate() : ListPrivateBase() {}
-  ListPrivate(const std::list<TP> &l) : ListPrivateBase(), list(l) {}
+  ListPrivate(const std::vector<TP> &l) : ListPrivateBase(), list(l) {}
   void clear() {
     list.clear();
   }
-  std::list<TP> list;
+  std::vector<TP> list;
 };
 
 // A partial specialization for all pointer types that implements the
@@ -67,19 +67,19 @@ template <class TP> class List<T>::ListPrivate<TP *>  : public ListPrivateBase
 {
 public:
   ListPrivate() : ListPrivateBase() {}
-  ListPrivate(const std::list<TP *> &l) : ListPrivateBase(), list(l) {}
+  ListPrivate(const std::vector<TP *> &l) : ListPrivateBase(), list(l) {}
   ~ListPrivate() {
     clear();
   }
   void clear() {
     if(autoDelete) {
-      typename std::list<TP *>::const_iterator it = list.begin();
+      typename std::vector<TP *>::const_iterator it = list.begin();
       for(; it != list.end(); ++it)
         delete *it;
     }
     list.clear();
   }
-  std::list<TP *> list;
+  std::vector<TP *> list;
 };
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -163,7 +163,13 @@ template <class T>
 List<T> &List<T>::append(const List<T> &l)
 {
   detach();
-  d->list.insert(d->list.end(), l.begin(), l.end());
+  if(l.d == d) {
+    // A vector can't insert a range of itself, so copy it first.
+    std::vector<T> items(l.d->list);
+    d->list.insert(d->list.end(), items.begin(), items.end());
+  }
+  else
+    d->list.insert(d->list.end(), l.d->list.begin(), l.d->list.end());
   return *this;
 }
 
@@ -171,7 +177,7 @@ template <class T>
 List<T> &List<T>::prepend(const T &item)
 {
   detach();
-  d->list.push_front(item);
+  d->list.insert(d->list.begin(), item);
   return *this;
 }
 
@@ -179,7 +185,12 @@ template <class T>
 List<T> &List<T>::prepend(const List<T> &l)
 {
   detach();
-  d->list.insert(d->list.begin(), l.begin(), l.end());
+  if(l.d == d) {
+    std::vector<T> items(l.d->list);
+    d->list.insert(d->list.begin(), items.begin(), items.end());
+  }
+  else
+    d->list.insert(d->list.begin(), l.d->list.begin(), l.d->list.end());
   return *this;
 }
 
@@ -262,23 +273,13 @@ T &List<T>::back()
 template <class T>
 T &List<T>::operator[](uint i)
 {
-  Iterator it = d->list.begin();
-
-  for(uint j = 0; j < i; j++)
-    ++it;
-
-  return *it;
+  return d->list[i];
 }
 
 template <class T>
 const T &List<T>::operator[](uint i) const
 {
-  ConstIterator it = d->list.begin();
-
-  for(uint j = 0; j < i; j++)
-    ++it;
-
-  return *it;
+  return d->list[i];
 }
 
 template <class T>
@@ -300,6 +301,12 @@ bool List<T>::operator==(const List<T> &l) const
   return d->list == l.d->list;
 }
 
+template <class T>
+bool List<T>::operator!=(const List<T> &l) const
+{
+  return d->list != l.d->list;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // protected members
 ////////////////////////////////////////////////////////////////////////////////
@@ -308,8 +315,15 @@ template <class T>
 void List<T>::detach()
 {
   if(d->count() > 1) {
-    d->deref();
-    d = new ListPrivate<T>(d->list);
+    ListPrivate<T> *copy = new ListPrivate<T>(d->list);
+    if(d->deref()) {
+      // The other references were dropped meanwhile, so keep the original,
+      // which owns the items if auto deletion is on.
+      d->ref();
+      delete copy;
+    }
+    else
+      d = copy;
   }
 }
 
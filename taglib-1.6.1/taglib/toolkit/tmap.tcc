@@ -188,8 +188,10 @@ template <class Key, class T>
 void Map<Key, T>::detach()
 {
   if(d->count() > 1) {
-    d->deref();
-    d = new MapPrivate<Key, T>(d->map);
+    MapPrivate<Key, T> *copy = new MapPrivate<Key, T>(d->map);
+    if(d->deref())
+      delete d;
+    d = copy;
   }
 }
 
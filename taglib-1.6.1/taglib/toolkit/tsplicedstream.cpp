@@ -0,0 +1,227 @@
+/***************************************************************************
+ *   This library is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Lesser General Public License version   *
+ *   2.1 as published by the Free Software Foundation.                     *
+ *                                                                         *
+ *   This library is distributed in the hope that it will be useful, but   *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU     *
+ *   Lesser General Public License for more details.                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU Lesser General Public      *
+ *   License along with this library; if not, write to the Free Software   *
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  *
+ *   USA                                                                   *
+ *                                                                         *
+ *   Alternatively, this file is available under the Mozilla Public        *
+ *   License Version 1.1.  You may obtain a copy of the License at         *
+ *   http://www.mozilla.org/MPL/                                           *
+ ***************************************************************************/
+
+#include <string.h>
+#include <algorithm>
+
+#include "tsplicedstream.h"
+#include "tlist.h"
+#include "tstring.h"
+#include "tdebug.h"
+
+using namespace TagLib;
+
+namespace
+{
+  struct Piece
+  {
+    Piece() : stream(0), offset(0), length(0), start(0) {}
+
+    ByteVector data;
+    IOStream *stream;
+    long offset;
+    long length;
+
+    // Where the piece starts in the spliced stream.
+    long start;
+  };
+}
+
+class SplicedStream::SplicedStreamPrivate
+{
+public:
+  SplicedStreamPrivate() : length(0), position(0), current(0) {}
+
+  void append(const Piece &piece);
+
+  List<Piece> pieces;
+  long length;
+  long position;
+
+  // The piece that was last read from; reads are mostly sequential, so the
+  // next one usually starts there.
+  uint current;
+};
+
+void SplicedStream::SplicedStreamPrivate::append(const Piece &piece)
+{
+  pieces.append(piece);
+  pieces.back().start = length;
+  length += piece.length;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+// public members
+////////////////////////////////////////////////////////////////////////////////
+
+SplicedStream::SplicedStream() : IOStream()
+{
+  d = new SplicedStreamPrivate;
+}
+
+SplicedStream::~SplicedStream()
+{
+  delete d;
+}
+
+void SplicedStream::appendData(const ByteVector &data)
+{
+  if(data.isEmpty())
+    return;
+
+  Piece piece;
+  piece.data = data;
+  piece.length = data.size();
+  d->append(piece);
+}
+
+void SplicedStream::appendRange(IOStream *stream, long offset, long length)
+{
+  if(!stream || offset < 0 || length <= 0)
+    return;
+
+  Piece piece;
+  piece.stream = stream;
+  piece.offset = offset;
+  piece.length = length;
+  d->append(piece);
+}
+
+FileName SplicedStream::name() const
+{
+  for(List<Piece>::ConstIterator it = d->pieces.begin(); it != d->pieces.end(); ++it) {
+    if(it->stream)
+      return it->stream->name();
+  }
+  return "";
+}
+
+ByteVector SplicedStream::readBlock(ulong length)
+{
+  if(d->position >= d->length || length == 0)
+    return ByteVector::null;
+
+  if(length > ulong(d->length - d->position))
+    length = d->length - d->position;
+
+  if(d->current >= d->pieces.size() || d->pieces[d->current].start > d->position)
+    d->current = 0;
+
+  while(d->pieces[d->current].start + d->pieces[d->current].length <= d->position)
+    d->current++;
+
+  // A read that falls within a single range is handed straight to its stream.
+
+  const Piece &first = d->pieces[d->current];
+  const long firstOffset = d->position - first.start;
+
+  if(first.stream && firstOffset + long(length) <= first.length) {
+    first.stream->seek(first.offset + firstOffset);
+    ByteVector v = first.stream->readBlock(length);
+    d->position += v.size();
+    return v;
+  }
+
+  ByteVector v(static_cast<uint>(length));
+  ulong filled = 0;
+
+  while(filled < length) {
+    const Piece &piece = d->pieces[d->current];
+    const long pieceOffset = d->position - piece.start;
+    const ulong count = std::min<ulong>(length - filled, piece.length - pieceOffset);
+
+    if(piece.stream) {
+      piece.stream->seek(piece.offset + pieceOffset);
+      const ByteVector block = piece.stream->readBlock(count);
+      ::memcpy(v.data() + filled, block.data(), block.size());
+      filled += block.size();
+      d->position += block.size();
+
+      if(block.size() < count) {
+        debug("SplicedStream::readBlock() -- A stream ended before its range did.");
+        break;
+      }
+    }
+    else {
+      ::memcpy(v.data() + filled, piece.data.data() + pieceOffset, count);
+      filled += count;
+      d->position += count;
+    }
+
+    if(pieceOffset + long(count) == piece.length && d->current + 1 < d->pieces.size())
+      d->current++;
+  }
+
+  v.resize(filled);
+  return v;
+}
+
+void SplicedStream::writeBlock(const ByteVector &)
+{
+  debug("SplicedStream::writeBlock() -- The stream is read only.");
+}
+
+void SplicedStream::insert(const ByteVector &, ulong, ulong)
+{
+  debug("SplicedStream::insert() -- The stream is read only.");
+}
+
+void SplicedStream::removeBlock(ulong, ulong)
+{
+  debug("SplicedStream::removeBlock() -- The stream is read only.");
+}
+
+bool SplicedStream::readOnly() const
+{
+  return true;
+}
+
+bool SplicedStream::isOpen() const
+{
+  return true;
+}
+
+void SplicedStream::seek(long offset, Position p)
+{
+  long position = offset;
+
+  if(p == Current)
+    position += d->position;
+  else if(p == End)
+    position += d->length;
+
+  if(position >= 0)
+    d->position = position;
+}
+
+long SplicedStream::tell() const
+{
+  return d->position;
+}
+
+long SplicedStream::length()
+{
+  return d->length;
+}
+
+void SplicedStream::truncate(long)
+{
+  debug("SplicedStream::truncate() -- The stream is read only.");
+}
@@ -0,0 +1,142 @@
+/***************************************************************************
+ *   This library is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Lesser General Public License version   *
+ *   2.1 as published by the Free Software Foundation.                     *
+ *                                                                         *
+ *   This library is distributed in the hope that it will be useful, but   *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU     *
+ *   Lesser General Public License for more details.                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU Lesser General Public      *
+ *   License along with this library; if not, write to the Free Software   *
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  *
+ *   USA                                                                   *
+ *                                                                         *
+ *   Alternatively, this file is available under the Mozilla Public        *
+ *   License Version 1.1.  You may obtain a copy of the License at         *
+ *   http://www.mozilla.org/MPL/                                           *
+ ***************************************************************************/
+
+#ifndef TAGLIB_SPLICEDSTREAM_H
+#define TAGLIB_SPLICEDSTREAM_H
+
+#include "taglib_export.h"
+#include "taglib.h"
+#include "tbytevector.h"
+#include "tiostream.h"
+
+namespace TagLib {
+
+  //! A read only stream made of blocks of data and ranges of other streams
+
+  /*!
+   * This presents a file that doesn't exist on disk: a list of pieces that are
+   * read one after the other, each of which is either a ByteVector -- such as
+   * a rendered tag -- or a range of another stream.  The ranges aren't copied;
+   * reads are passed on to their stream as the SplicedStream is read.
+   *
+   * This is used to hand out a copy of a file with different tags, for
+   * example to upload it, without writing the copy anywhere first.
+   *
+   * \see MPEG::File::splicedStream()
+   */
+
+  class TAGLIB_EXPORT SplicedStream : public IOStream
+  {
+  public:
+    /*!
+     * Constructs an empty stream.
+     */
+    SplicedStream();
+
+    /*!
+     * Destroys this SplicedStream instance.  The streams that it reads from
+     * are not deleted.
+     */
+    virtual ~SplicedStream();
+
+    /*!
+     * Adds \a data to the end of the stream.
+     */
+    void appendData(const ByteVector &data);
+
+    /*!
+     * Adds the \a length bytes of \a stream starting at \a offset to the end of
+     * the stream.  \a stream is not owned by the SplicedStream and must
+     * outlive it.
+     */
+    void appendRange(IOStream *stream, long offset, long length);
+
+    /*!
+     * Returns the name of the first stream that a range was added from, or an
+     * empty name if there isn't one.
+     */
+    FileName name() const;
+
+    /*!
+     * Reads a block of size \a length at the current get pointer.  Fewer bytes
+     * are returned at the end of the stream, or if one of the streams that it
+     * reads from comes up short.
+     */
+    ByteVector readBlock(ulong length);
+
+    /*!
+     * The stream is read only, so this does nothing.
+     */
+    void writeBlock(const ByteVector &data);
+
+    /*!
+     * The stream is read only, so this does nothing.
+     */
+    void insert(const ByteVector &data, ulong start = 0, ulong replace = 0);
+
+    /*!
+     * The stream is read only, so this does nothing.
+     */
+    void removeBlock(ulong start = 0, ulong length = 0);
+
+    /*!
+     * Returns true.
+     */
+    bool readOnly() const;
+
+    /*!
+     * Returns true.
+     */
+    bool isOpen() const;
+
+    /*!
+     * Move the I/O pointer to \a offset in the stream from position \a p.
+     *
+     * \see Position
+     */
+    void seek(long offset, Position p = Beginning);
+
+    /*!
+     * Returns the current offset within the stream.
+     */
+    long tell() const;
+
+    /*!
+     * Returns the length of the stream, which is known as soon as the pieces
+     * have been added.
+     */
+    long length();
+
+    /*!
+     * The stream is read only, so this does nothing.
+     */
+    void truncate(long length);
+
+  private:
+    SplicedStream(const SplicedStream &);
+    SplicedStream &operator=(const SplicedStream &);
+
+    class SplicedStreamPrivate;
+    SplicedStreamPrivate *d;
+  };
+
+}
+
+#endif
@@ -0,0 +1,202 @@
+/***************************************************************************
+ *   This library is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Lesser General Public License version   *
+ *   2.1 as published by the Free Software Foundation.                     *
+ *                                                                         *
+ *   This library is distributed in the hope that it will be useful, but   *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU     *
+ *   Lesser General Public License for more details.                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU Lesser General Public      *
+ *   License along with this library; if not, write to the Free Software   *
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  *
+ *   USA                                                                   *
+ *                                                                         *
+ *   Alternatively, this file is available under the Mozilla Public        *
+ *   License Version 1.1.  You may obtain a copy of the License at         *
+ *   http://www.mozilla.org/MPL/                                           *
+ ***************************************************************************/
+
+#include <string.h>
+
+#include "tstreamhash.h"
+
+using namespace TagLib;
+
+namespace
+{
+  typedef unsigned long long u64;
+
+  const u64 prime1 = 11400714785074694791ULL;
+  const u64 prime2 = 14029467366897019727ULL;
+  const u64 prime3 =  1609587929392839161ULL;
+  const u64 prime4 =  9650029242287828579ULL;
+  const u64 prime5 =  2870177450012600261ULL;
+
+  inline u64 rotate(u64 x, int bits)
+  {
+    return (x << bits) | (x >> (64 - bits));
+  }
+
+  // XXH64 is defined on little endian words.  As in ByteVectorReader, the
+  // shifts compile into a single load on little endian hosts.
+
+  inline u64 read64(const uchar *p)
+  {
+    return  u64(p[0])        | (u64(p[1]) << 8)  | (u64(p[2]) << 16) | (u64(p[3]) << 24) |
+           (u64(p[4]) << 32) | (u64(p[5]) << 40) | (u64(p[6]) << 48) | (u64(p[7]) << 56);
+  }
+
+  inline u64 read32(const uchar *p)
+  {
+    return u64(p[0]) | (u64(p[1]) << 8) | (u64(p[2]) << 16) | (u64(p[3]) << 24);
+  }
+
+  inline u64 mix(u64 acc, u64 input)
+  {
+    acc += input * prime2;
+    return rotate(acc, 31) * prime1;
+  }
+
+  inline u64 merge(u64 acc, u64 value)
+  {
+    acc ^= mix(0, value);
+    return acc * prime1 + prime4;
+  }
+}
+
+class StreamHash::StreamHashPrivate
+{
+public:
+  StreamHashPrivate(u64 seed) :
+    seed(seed),
+    total(0),
+    buffered(0)
+  {
+    lanes[0] = seed + prime1 + prime2;
+    lanes[1] = seed + prime2;
+    lanes[2] = seed;
+    lanes[3] = seed - prime1;
+  }
+
+  // Runs the four lanes over the whole 32 byte stripes at p and returns the
+  // number of bytes used.
+
+  uint consume(const uchar *p, uint length)
+  {
+    u64 v1 = lanes[0], v2 = lanes[1], v3 = lanes[2], v4 = lanes[3];
+    const uchar *end = p + (length & ~31U);
+    for(const uchar *q = p; q < end; q += 32) {
+      v1 = mix(v1, read64(q));
+      v2 = mix(v2, read64(q + 8));
+      v3 = mix(v3, read64(q + 16));
+      v4 = mix(v4, read64(q + 24));
+    }
+    lanes[0] = v1; lanes[1] = v2; lanes[2] = v3; lanes[3] = v4;
+    return length & ~31U;
+  }
+
+  u64 seed;
+  u64 lanes[4];
+  u64 total;
+  uchar buffer[32];
+  uint buffered;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// public members
+////////////////////////////////////////////////////////////////////////////////
+
+StreamHash::StreamHash(unsigned long long seed)
+{
+  d = new StreamHashPrivate(seed);
+}
+
+StreamHash::~StreamHash()
+{
+  delete d;
+}
+
+void StreamHash::update(const char *data, uint length)
+{
+  const uchar *p = reinterpret_cast<const uchar *>(data);
+  d->total += length;
+
+  // Top up a partial stripe left over from the last call first.
+
+  if(d->buffered > 0) {
+    uint n = 32 - d->buffered;
+    if(n > length)
+      n = length;
+    ::memcpy(d->buffer + d->buffered, p, n);
+    d->buffered += n;
+    p += n;
+    length -= n;
+    if(d->buffered < 32)
+      return;
+    d->consume(d->buffer, 32);
+    d->buffered = 0;
+  }
+
+  uint used = d->consume(p, length);
+  d->buffered = length - used;
+  ::memcpy(d->buffer, p + used, d->buffered);
+}
+
+void StreamHash::update(const ByteVector &data)
+{
+  update(data.data(), data.size());
+}
+
+unsigned long long StreamHash::digest() const
+{
+  u64 h;
+
+  if(d->total >= 32) {
+    h = rotate(d->lanes[0], 1) + rotate(d->lanes[1], 7) +
+        rotate(d->lanes[2], 12) + rotate(d->lanes[3], 18);
+    for(int i = 0; i < 4; i++)
+      h = merge(h, d->lanes[i]);
+  }
+  else
+    h = d->seed + prime5;
+
+  h += d->total;
+
+  const uchar *p = d->buffer;
+  const uchar *end = d->buffer + d->buffered;
+
+  for(; p + 8 <= end; p += 8) {
+    h ^= mix(0, read64(p));
+    h = rotate(h, 27) * prime1 + prime4;
+  }
+  if(p + 4 <= end) {
+    h ^= read32(p) * prime1;
+    h = rotate(h, 23) * prime2 + prime3;
+    p += 4;
+  }
+  for(; p < end; p++) {
+    h ^= *p * prime5;
+    h = rotate(h, 11) * prime1;
+  }
+
+  h ^= h >> 33;
+  h *= prime2;
+  h ^= h >> 29;
+  h *= prime3;
+  h ^= h >> 32;
+  return h;
+}
+
+unsigned long long StreamHash::length() const
+{
+  return d->total;
+}
+
+unsigned long long StreamHash::hash(const ByteVector &data, unsigned long long seed)
+{
+  StreamHash h(seed);
+  h.update(data);
+  return h.digest();
+}
@@ -0,0 +1,91 @@
+/***************************************************************************
+ *   This library is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Lesser General Public License version   *
+ *   2.1 as published by the Free Software Foundation.                     *
+ *                                                                         *
+ *   This library is distributed in the hope that it will be useful, but   *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU     *
+ *   Lesser General Public License for more details.                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU Lesser General Public      *
+ *   License along with this library; if not, write to the Free Software   *
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  *
+ *   USA                                                                   *
+ *                                                                         *
+ *   Alternatively, this file is available under the Mozilla Public        *
+ *   License Version 1.1.  You may obtain a copy of the License at         *
+ *   http://www.mozilla.org/MPL/                                           *
+ ***************************************************************************/
+
+#ifndef TAGLIB_STREAMHASH_H
+#define TAGLIB_STREAMHASH_H
+
+#include "taglib_export.h"
+#include "tbytevector.h"
+
+namespace TagLib {
+
+  //! A fast 64 bit hash of a stream of bytes
+
+  /*!
+   * This is the XXH64 hash: the data is fed to update() in pieces of any
+   * size and digest() returns the same value as hashing it in one go.  It
+   * works through the data in four independent lanes of 8 bytes, which keeps
+   * it well above disk speed on any CPU.
+   *
+   * It is meant for spotting identical data, not for security.
+   */
+
+  class TAGLIB_EXPORT StreamHash
+  {
+  public:
+    /*!
+     * Constructs a hash with \a seed; hashes with different seeds give
+     * unrelated values for the same data.
+     */
+    StreamHash(unsigned long long seed = 0);
+
+    /*!
+     * Destroys this StreamHash instance.
+     */
+    ~StreamHash();
+
+    /*!
+     * Adds the \a length bytes at \a data to the hash.
+     */
+    void update(const char *data, uint length);
+
+    /*!
+     * Adds \a data to the hash.
+     */
+    void update(const ByteVector &data);
+
+    /*!
+     * Returns the hash of all the data added so far.  More data may still be
+     * added afterwards.
+     */
+    unsigned long long digest() const;
+
+    /*!
+     * Returns the number of bytes added so far.
+     */
+    unsigned long long length() const;
+
+    /*!
+     * Returns the hash of \a data.
+     */
+    static unsigned long long hash(const ByteVector &data,
+                                   unsigned long long seed = 0);
+
+  private:
+    StreamHash(const StreamHash &);
+    StreamHash &operator=(const StreamHash &);
+
+    class StreamHashPrivate;
+    StreamHashPrivate *d;
+  };
+
+} // namespace TagLib
+
+#endif
@@ -367,20 +367,30 @@ bool String::isNull() const
 
 ByteVector String::data(Type t) const
 {
-  ByteVector v;
+  // Apart from UTF8, the size of the result is known up front, so the vector
+  // is allocated once and filled in place.
+
+  if(t == UTF8) {
+    std::string s = to8Bit(true);
+    return ByteVector(s.c_str(), s.length());
+  }
+
+  const uint charSize = t == Latin1 ? 1 : 2;
+  const uint bomSize = t == UTF16 ? 2 : 0;
+
+  ByteVector v(bomSize + charSize * d->data.size(), 0);
+
+  if(v.isEmpty())
+    return v;
+
+  char *p = v.data();
 
   switch(t) {
 
   case Latin1:
   {
     for(wstring::const_iterator it = d->data.begin(); it != d->data.end(); it++)
-      v.append(char(*it));
-    break;
-  }
-  case UTF8:
-  {
-    std::string s = to8Bit(true);
-    v.setData(s.c_str(), s.length());
+      *p++ = char(*it);
     break;
   }
   case UTF16:
@@ -388,43 +398,33 @@ ByteVector String::data(Type t) const
     // Assume that if we're doing UTF16 and not UTF16BE that we want little
     // endian encoding.  (Byte Order Mark)
 
-    v.append(char(0xff));
-    v.append(char(0xfe));
+    *p++ = char(0xff);
+    *p++ = char(0xfe);
 
     for(wstring::const_iterator it = d->data.begin(); it != d->data.end(); it++) {
-
-      char c1 = *it & 0xff;
-      char c2 = *it >> 8;
-
-      v.append(c1);
-      v.append(c2);
+      *p++ = char(*it & 0xff);
+      *p++ = char(*it >> 8);
     }
     break;
   }
   case UTF16BE:
   {
     for(wstring::const_iterator it = d->data.begin(); it != d->data.end(); it++) {
-
-      char c1 = *it >> 8;
-      char c2 = *it & 0xff;
-
-      v.append(c1);
-      v.append(c2);
+      *p++ = char(*it >> 8);
+      *p++ = char(*it & 0xff);
     }
     break;
   }
   case UTF16LE:
   {
     for(wstring::const_iterator it = d->data.begin(); it != d->data.end(); it++) {
-
-      char c1 = *it & 0xff;
-      char c2 = *it >> 8;
-
-      v.append(c1);
-      v.append(c2);
+      *p++ = char(*it & 0xff);
+      *p++ = char(*it >> 8);
     }
     break;
   }
+  default:
+    break;
   }
 
   return v;
@@ -536,6 +536,11 @@ bool String::operator==(const String &s) const
   return d == s.d || d->data == s.d->data;
 }
 
+bool String::operator!=(const String &s) const
+{
+  return !operator==(s);
+}
+
 String &String::operator+=(const String &s)
 {
   detach();
@@ -696,8 +701,10 @@ bool String::operator<(const String &s) const
 void String::detach()
 {
   if(d->count() > 1) {
-    d->deref();
-    d = new StringPrivate(d->data);
+    StringPrivate *copy = new StringPrivate(d->data);
+    if(d->deref())
+      delete d;
+    d = copy;
   }
 }
 
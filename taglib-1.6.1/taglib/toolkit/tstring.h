@@ -330,6 +330,12 @@ namespace TagLib {
      */
     bool operator==(const String &s) const;
 
+    /*!
+     * Compares each character of the String with each character of \a s and
+     * returns false if the strings match.
+     */
+    bool operator!=(const String &s) const;
+
     /*!
      * Appends \a s to the end of the String.
      */
@@ -0,0 +1,583 @@
+/***************************************************************************
+ *   This library is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Lesser General Public License version   *
+ *   2.1 as published by the Free Software Foundation.                     *
+ *                                                                         *
+ *   This library is distributed in the hope that it will be useful, but   *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU     *
+ *   Lesser General Public License for more details.                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU Lesser General Public      *
+ *   License along with this library; if not, write to the Free Software   *
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  *
+ *   USA                                                                   *
+ *                                                                         *
+ *   Alternatively, this file is available under the Mozilla Public        *
+ *   License Version 1.1.  You may obtain a copy of the License at         *
+ *   http://www.mozilla.org/MPL/                                           *
+ ***************************************************************************/
+
+#ifdef HAVE_CONFIG_H
+#include <config.h>
+#endif
+
+#include <tstringlist.h>
+
+#include "trackinfo.h"
+#include "fileref.h"
+#include "tag.h"
+#include "mpegfile.h"
+#include "flacfile.h"
+#include "trueaudiofile.h"
+#include "xiphcomment.h"
+#include "id3v2tag.h"
+#include "id3v2framefactory.h"
+#include "frames/textidentificationframe.h"
+#include "frames/attachedpictureframe.h"
+
+#ifdef TAGLIB_WITH_MP4
+#include "mp4tag.h"
+#include "mp4coverart.h"
+#endif
+
+#ifdef TAGLIB_WITH_ASF
+#include "asftag.h"
+#endif
+
+using namespace TagLib;
+
+namespace
+{
+  // The tags that keep the fields Tag has no room for.  Only one of them is
+  // set, apart from FLAC files with no Xiph comment but an old ID3v2 tag.
+
+  struct Extras
+  {
+    Extras(File *file, bool create);
+
+    ID3v2::Tag *id3v2;
+    Ogg::XiphComment *xiph;
+#ifdef TAGLIB_WITH_MP4
+    MP4::Tag *mp4;
+#endif
+#ifdef TAGLIB_WITH_ASF
+    ASF::Tag *asf;
+#endif
+  };
+
+  Extras::Extras(File *file, bool create) :
+    id3v2(0),
+    xiph(0)
+  {
+#ifdef TAGLIB_WITH_MP4
+    mp4 = 0;
+#endif
+#ifdef TAGLIB_WITH_ASF
+    asf = 0;
+#endif
+
+    if(MPEG::File *f = dynamic_cast<MPEG::File *>(file))
+      id3v2 = f->ID3v2Tag(create);
+    else if(FLAC::File *f = dynamic_cast<FLAC::File *>(file)) {
+      xiph = f->xiphComment(create);
+      if(!xiph)
+        id3v2 = f->ID3v2Tag();
+    }
+    else if(TrueAudio::File *f = dynamic_cast<TrueAudio::File *>(file))
+      id3v2 = f->ID3v2Tag(create);
+    else {
+      Tag *tag = file->tag();
+
+      // WAV and AIFF files return their ID3v2 tag and Ogg files their Xiph
+      // comment.
+
+      id3v2 = dynamic_cast<ID3v2::Tag *>(tag);
+      xiph = dynamic_cast<Ogg::XiphComment *>(tag);
+#ifdef TAGLIB_WITH_MP4
+      mp4 = dynamic_cast<MP4::Tag *>(tag);
+#endif
+#ifdef TAGLIB_WITH_ASF
+      asf = dynamic_cast<ASF::Tag *>(tag);
+#endif
+    }
+  }
+
+  // Splits "n/m" into its two numbers.
+
+  void splitPair(const String &s, uint &first, uint &second)
+  {
+    StringList parts = StringList::split(s, "/");
+    first = parts.isEmpty() ? 0 : parts[0].toInt();
+    second = parts.size() < 2 ? 0 : parts[1].toInt();
+  }
+
+  String joinPair(uint first, uint second)
+  {
+    if(second == 0)
+      return first == 0 ? String::null : String::number(first);
+    return String::number(first) + "/" + String::number(second);
+  }
+
+  String id3v2Text(const ID3v2::Tag *tag, const char *id)
+  {
+    const ID3v2::FrameListMap &frames = tag->frameListMap();
+    if(!frames.contains(id) || frames[id].isEmpty())
+      return String::null;
+    return frames[id].front()->toString();
+  }
+
+  void setID3v2Text(ID3v2::Tag *tag, const char *id, const String &value)
+  {
+    const ID3v2::FrameListMap &frames = tag->frameListMap();
+
+    if(value.isEmpty())
+      tag->removeFrames(id);
+    else if(frames.contains(id) && !frames[id].isEmpty())
+      frames[id].front()->setText(value);
+    else {
+      ID3v2::TextIdentificationFrame *frame =
+        new ID3v2::TextIdentificationFrame(id, ID3v2::FrameFactory::instance()->defaultTextEncoding());
+      tag->addFrame(frame);
+      frame->setText(value);
+    }
+  }
+
+  uint xiphNumber(const Ogg::XiphComment *tag, const char *key, const char *otherKey = 0)
+  {
+    const Ogg::FieldListMap &fields = tag->fieldListMap();
+    if(fields.contains(key) && !fields[key].isEmpty())
+      return fields[key].front().toInt();
+    if(otherKey && fields.contains(otherKey) && !fields[otherKey].isEmpty())
+      return fields[otherKey].front().toInt();
+    return 0;
+  }
+
+  void setXiphNumber(Ogg::XiphComment *tag, const char *key, uint value,
+                     const char *otherKey = 0)
+  {
+    if(otherKey)
+      tag->removeField(otherKey);
+    if(value == 0)
+      tag->removeField(key);
+    else
+      tag->addField(key, String::number(value));
+  }
+}
+
+class TrackInfo::TrackInfoPrivate
+{
+public:
+  TrackInfoPrivate() :
+    null(true),
+    year(0),
+    track(0),
+    trackTotal(0),
+    disc(0),
+    discTotal(0),
+    length(0),
+    bitrate(0),
+    sampleRate(0),
+    channels(0) {}
+
+  bool null;
+
+  String title;
+  String artist;
+  String album;
+  String comment;
+  String genre;
+  uint year;
+  uint track;
+  uint trackTotal;
+  uint disc;
+  uint discTotal;
+
+  ByteVector picture;
+  String pictureMimeType;
+
+  int length;
+  int bitrate;
+  int sampleRate;
+  int channels;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+// public members
+////////////////////////////////////////////////////////////////////////////////
+
+TrackInfo::TrackInfo()
+{
+  d = new TrackInfoPrivate;
+}
+
+TrackInfo::TrackInfo(File *file)
+{
+  d = new TrackInfoPrivate;
+
+  if(!file || !file->isValid() || !file->tag())
+    return;
+
+  d->null = false;
+
+  const Tag *tag = file->tag();
+  d->title = tag->title();
+  d->artist = tag->artist();
+  d->album = tag->album();
+  d->comment = tag->comment();
+  d->genre = tag->genre();
+  d->year = tag->year();
+  d->track = tag->track();
+
+  const AudioProperties *properties = file->audioProperties();
+  if(properties) {
+    d->length = properties->length();
+    d->bitrate = properties->bitrate();
+    d->sampleRate = properties->sampleRate();
+    d->channels = properties->channels();
+  }
+
+  Extras extras(file, false);
+
+  if(extras.id3v2) {
+    // An empty ID3v2 tag is kept in MPEG files alongside ID3v1, so only take
+    // the track number from ID3v2 if it has one.
+
+    const String trck = id3v2Text(extras.id3v2, "TRCK");
+    if(!trck.isEmpty())
+      splitPair(trck, d->track, d->trackTotal);
+    splitPair(id3v2Text(extras.id3v2, "TPOS"), d->disc, d->discTotal);
+
+    const ID3v2::FrameListMap &frames = extras.id3v2->frameListMap();
+    const ID3v2::FrameList l = frames.contains("APIC") ? frames["APIC"] : ID3v2::FrameList();
+    ID3v2::AttachedPictureFrame *picture = 0;
+    for(ID3v2::FrameList::ConstIterator it = l.begin(); it != l.end(); ++it) {
+      ID3v2::AttachedPictureFrame *frame = static_cast<ID3v2::AttachedPictureFrame *>(*it);
+      if(!picture || frame->type() == ID3v2::AttachedPictureFrame::FrontCover)
+        picture = frame;
+      if(frame->type() == ID3v2::AttachedPictureFrame::FrontCover)
+        break;
+    }
+    if(picture) {
+      d->picture = picture->picture();
+      d->pictureMimeType = picture->mimeType();
+    }
+  }
+
+  if(extras.xiph) {
+    d->trackTotal = xiphNumber(extras.xiph, "TRACKTOTAL", "TOTALTRACKS");
+    d->disc = xiphNumber(extras.xiph, "DISCNUMBER");
+    d->discTotal = xiphNumber(extras.xiph, "DISCTOTAL", "TOTALDISCS");
+  }
+
+#ifdef TAGLIB_WITH_MP4
+  if(extras.mp4) {
+    const MP4::ItemListMap &items = extras.mp4->itemListMap();
+    if(items.contains("trkn")) {
+      d->track = items["trkn"].toIntPair().first;
+      d->trackTotal = items["trkn"].toIntPair().second;
+    }
+    if(items.contains("disk")) {
+      d->disc = items["disk"].toIntPair().first;
+      d->discTotal = items["disk"].toIntPair().second;
+    }
+    if(items.contains("covr")) {
+      MP4::CoverArtList covers = items["covr"].toCoverArtList();
+      if(!covers.isEmpty()) {
+        d->picture = covers.front().data();
+        d->pictureMimeType = covers.front().format() == MP4::CoverArt::PNG ?
+          "image/png" : "image/jpeg";
+      }
+    }
+  }
+#endif
+
+#ifdef TAGLIB_WITH_ASF
+  if(extras.asf) {
+    const ASF::AttributeListMap &attributes = extras.asf->attributeListMap();
+    if(attributes.contains("WM/PartOfSet") && !attributes["WM/PartOfSet"].isEmpty())
+      splitPair(attributes["WM/PartOfSet"].front().toString(), d->disc, d->discTotal);
+  }
+#endif
+}
+
+TrackInfo::TrackInfo(const TrackInfo &info)
+{
+  d = new TrackInfoPrivate(*info.d);
+}
+
+TrackInfo::~TrackInfo()
+{
+  delete d;
+}
+
+TrackInfo &TrackInfo::operator=(const TrackInfo &info)
+{
+  if(&info != this)
+    *d = *info.d;
+  return *this;
+}
+
+TrackInfo TrackInfo::read(FileName file, bool readAudioProperties,
+                          AudioProperties::ReadStyle audioPropertiesStyle)
+{
+  FileRef ref(file, readAudioProperties, audioPropertiesStyle);
+  return TrackInfo(ref.file());
+}
+
+bool TrackInfo::isNull() const
+{
+  return d->null;
+}
+
+String TrackInfo::title() const
+{
+  return d->title;
+}
+
+String TrackInfo::artist() const
+{
+  return d->artist;
+}
+
+String TrackInfo::album() const
+{
+  return d->album;
+}
+
+String TrackInfo::comment() const
+{
+  return d->comment;
+}
+
+String TrackInfo::genre() const
+{
+  return d->genre;
+}
+
+TagLib::uint TrackInfo::year() const
+{
+  return d->year;
+}
+
+TagLib::uint TrackInfo::track() const
+{
+  return d->track;
+}
+
+TagLib::uint TrackInfo::trackTotal() const
+{
+  return d->trackTotal;
+}
+
+TagLib::uint TrackInfo::disc() const
+{
+  return d->disc;
+}
+
+TagLib::uint TrackInfo::discTotal() const
+{
+  return d->discTotal;
+}
+
+ByteVector TrackInfo::picture() const
+{
+  return d->picture;
+}
+
+String TrackInfo::pictureMimeType() const
+{
+  return d->pictureMimeType;
+}
+
+int TrackInfo::length() const
+{
+  return d->length;
+}
+
+int TrackInfo::bitrate() const
+{
+  return d->bitrate;
+}
+
+int TrackInfo::sampleRate() const
+{
+  return d->sampleRate;
+}
+
+int TrackInfo::channels() const
+{
+  return d->channels;
+}
+
+void TrackInfo::setTitle(const String &s)
+{
+  d->title = s;
+}
+
+void TrackInfo::setArtist(const String &s)
+{
+  d->artist = s;
+}
+
+void TrackInfo::setAlbum(const String &s)
+{
+  d->album = s;
+}
+
+void TrackInfo::setComment(const String &s)
+{
+  d->comment = s;
+}
+
+void TrackInfo::setGenre(const String &s)
+{
+  d->genre = s;
+}
+
+void TrackInfo::setYear(uint i)
+{
+  d->year = i;
+}
+
+void TrackInfo::setTrack(uint i)
+{
+  d->track = i;
+}
+
+void TrackInfo::setTrackTotal(uint i)
+{
+  d->trackTotal = i;
+}
+
+void TrackInfo::setDisc(uint i)
+{
+  d->disc = i;
+}
+
+void TrackInfo::setDiscTotal(uint i)
+{
+  d->discTotal = i;
+}
+
+void TrackInfo::setPicture(const ByteVector &data, const String &mimeType)
+{
+  d->picture = data;
+  d->pictureMimeType = data.isEmpty() ? String::null : mimeType;
+}
+
+bool TrackInfo::save(File *file) const
+{
+  if(!file || !file->isValid() || file->readOnly() || !file->tag())
+    return false;
+
+  const TrackInfo current(file);
+  Tag *tag = file->tag();
+
+  if(d->title != current.d->title)
+    tag->setTitle(d->title);
+  if(d->artist != current.d->artist)
+    tag->setArtist(d->artist);
+  if(d->album != current.d->album)
+    tag->setAlbum(d->album);
+  if(d->comment != current.d->comment)
+    tag->setComment(d->comment);
+  if(d->genre != current.d->genre)
+    tag->setGenre(d->genre);
+  if(d->year != current.d->year)
+    tag->setYear(d->year);
+
+  const bool trackChanged =
+    d->track != current.d->track || d->trackTotal != current.d->trackTotal;
+  const bool discChanged =
+    d->disc != current.d->disc || d->discTotal != current.d->discTotal;
+  const bool pictureChanged =
+    d->picture != current.d->picture || d->pictureMimeType != current.d->pictureMimeType;
+
+  if(!trackChanged && !discChanged && !pictureChanged)
+    return file->save();
+
+  // Tags without room for the totals (ID3v1, APE) get the track number
+  // alone.  The ones that do have room are written below, over this.
+
+  if(trackChanged)
+    tag->setTrack(d->track);
+
+  Extras extras(file, true);
+
+  if(extras.id3v2) {
+    if(trackChanged)
+      setID3v2Text(extras.id3v2, "TRCK", joinPair(d->track, d->trackTotal));
+    if(discChanged)
+      setID3v2Text(extras.id3v2, "TPOS", joinPair(d->disc, d->discTotal));
+
+    if(pictureChanged) {
+      extras.id3v2->removeFrames("APIC");
+      if(!d->picture.isEmpty()) {
+        ID3v2::AttachedPictureFrame *frame = new ID3v2::AttachedPictureFrame;
+        frame->setMimeType(d->pictureMimeType);
+        frame->setType(ID3v2::AttachedPictureFrame::FrontCover);
+        frame->setPicture(d->picture);
+        extras.id3v2->addFrame(frame);
+      }
+    }
+  }
+
+  if(extras.xiph) {
+    if(trackChanged)
+      setXiphNumber(extras.xiph, "TRACKTOTAL", d->trackTotal, "TOTALTRACKS");
+    if(discChanged) {
+      setXiphNumber(extras.xiph, "DISCNUMBER", d->disc);
+      setXiphNumber(extras.xiph, "DISCTOTAL", d->discTotal, "TOTALDISCS");
+    }
+  }
+
+#ifdef TAGLIB_WITH_MP4
+  if(extras.mp4) {
+    if(trackChanged || discChanged || pictureChanged) {
+      MP4::ItemListMap &items = extras.mp4->itemListMap();
+
+      if(trackChanged) {
+        if(d->track == 0 && d->trackTotal == 0)
+          items.erase("trkn");
+        else
+          items["trkn"] = MP4::Item(d->track, d->trackTotal);
+      }
+      if(discChanged) {
+        if(d->disc == 0 && d->discTotal == 0)
+          items.erase("disk");
+        else
+          items["disk"] = MP4::Item(d->disc, d->discTotal);
+      }
+      if(pictureChanged) {
+        if(d->picture.isEmpty())
+          items.erase("covr");
+        else {
+          MP4::CoverArtList covers;
+          covers.append(MP4::CoverArt(d->pictureMimeType == "image/png" ?
+                                      MP4::CoverArt::PNG : MP4::CoverArt::JPEG,
+                                      d->picture));
+          items["covr"] = MP4::Item(covers);
+        }
+      }
+    }
+  }
+#endif
+
+#ifdef TAGLIB_WITH_ASF
+  if(extras.asf && discChanged) {
+    if(d->disc == 0 && d->discTotal == 0)
+      extras.asf->removeItem("WM/PartOfSet");
+    else
+      extras.asf->setAttribute("WM/PartOfSet", joinPair(d->disc, d->discTotal));
+  }
+#endif
+
+  return file->save();
+}
+
+bool TrackInfo::save(FileName file) const
+{
+  FileRef ref(file, false);
+  return save(ref.file());
+}
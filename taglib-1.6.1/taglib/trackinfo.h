@@ -0,0 +1,192 @@
+/***************************************************************************
+ *   This library is free software; you can redistribute it and/or modify  *
+ *   it under the terms of the GNU Lesser General Public License version   *
+ *   2.1 as published by the Free Software Foundation.                     *
+ *                                                                         *
+ *   This library is distributed in the hope that it will be useful, but   *
+ *   WITHOUT ANY WARRANTY; without even the implied warranty of            *
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU     *
+ *   Lesser General Public License for more details.                       *
+ *                                                                         *
+ *   You should have received a copy of the GNU Lesser General Public      *
+ *   License along with this library; if not, write to the Free Software   *
+ *   Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  *
+ *   USA                                                                   *
+ *                                                                         *
+ *   Alternatively, this file is available under the Mozilla Public        *
+ *   License Version 1.1.  You may obtain a copy of the License at         *
+ *   http://www.mozilla.org/MPL/                                           *
+ ***************************************************************************/
+
+#ifndef TAGLIB_TRACKINFO_H
+#define TAGLIB_TRACKINFO_H
+
+#include "tfile.h"
+#include "tstring.h"
+#include "tbytevector.h"
+
+#include "taglib_export.h"
+#include "audioproperties.h"
+
+namespace TagLib {
+
+  //! Everything a player needs to know about a track, read in one go
+
+  /*!
+   * FileRef gives the fields that all tag formats share, but the track and
+   * disc totals and the cover picture are kept differently by each format,
+   * so getting them meant opening the file a second time as its concrete
+   * type.  TrackInfo reads all of it, along with the audio properties, from
+   * one File, and writes it back with a single save.
+   *
+   * \code
+   *
+   * TagLib::TrackInfo info = TagLib::TrackInfo::read("song.mp3");
+   * info.setTrack(3);
+   * info.save("song.mp3");
+   *
+   * \endcode
+   *
+   * The totals and the picture are read from and written to ID3v2 (in MPEG,
+   * FLAC, TrueAudio, WAV and AIFF files), Xiph comments, MP4 and ASF tags,
+   * except that pictures aren't handled in Xiph comments and ASF tags.
+   */
+
+  class TAGLIB_EXPORT TrackInfo
+  {
+  public:
+    /*!
+     * Constructs a null TrackInfo.
+     */
+    TrackInfo();
+
+    /*!
+     * Reads the tags and audio properties of \a file.  The TrackInfo is null
+     * if \a file is null or isn't valid.
+     */
+    explicit TrackInfo(File *file);
+
+    /*!
+     * Constructs a copy of \a info.
+     */
+    TrackInfo(const TrackInfo &info);
+
+    /*!
+     * Destroys this TrackInfo instance.
+     */
+    ~TrackInfo();
+
+    /*!
+     * Copies \a info into this TrackInfo.
+     */
+    TrackInfo &operator=(const TrackInfo &info);
+
+    /*!
+     * Opens \a file, reads it and closes it again.  If \a readAudioProperties
+     * is false the audio properties are left at 0.
+     */
+    static TrackInfo read(FileName file, bool readAudioProperties = true,
+                          AudioProperties::ReadStyle
+                          audioPropertiesStyle = AudioProperties::Average);
+
+    /*!
+     * Returns true if nothing could be read.
+     */
+    bool isNull() const;
+
+    String title() const;
+    String artist() const;
+    String album() const;
+    String comment() const;
+    String genre() const;
+    uint year() const;
+
+    /*!
+     * Returns the track number, or 0 if there is none.
+     */
+    uint track() const;
+
+    /*!
+     * Returns the number of tracks on the album, or 0 if it isn't known.
+     */
+    uint trackTotal() const;
+
+    /*!
+     * Returns the disc number, or 0 if there is none.
+     */
+    uint disc() const;
+
+    /*!
+     * Returns the number of discs in the set, or 0 if it isn't known.
+     */
+    uint discTotal() const;
+
+    /*!
+     * Returns the front cover, or the first picture if none is marked as the
+     * front cover, or an empty vector if there is no picture.
+     */
+    ByteVector picture() const;
+
+    /*!
+     * Returns the MIME type of picture().
+     */
+    String pictureMimeType() const;
+
+    /*!
+     * Returns the length of the audio in seconds, or 0 if the audio
+     * properties weren't read.
+     */
+    int length() const;
+
+    /*!
+     * Returns the bitrate in kb/s.
+     */
+    int bitrate() const;
+
+    /*!
+     * Returns the sample rate in Hz.
+     */
+    int sampleRate() const;
+
+    /*!
+     * Returns the number of audio channels.
+     */
+    int channels() const;
+
+    void setTitle(const String &s);
+    void setArtist(const String &s);
+    void setAlbum(const String &s);
+    void setComment(const String &s);
+    void setGenre(const String &s);
+    void setYear(uint i);
+    void setTrack(uint i);
+    void setTrackTotal(uint i);
+    void setDisc(uint i);
+    void setDiscTotal(uint i);
+
+    /*!
+     * Sets the front cover to \a data, of the MIME type \a mimeType.  An
+     * empty \a data removes the pictures.
+     */
+    void setPicture(const ByteVector &data, const String &mimeType);
+
+    /*!
+     * Writes the fields that differ from those in \a file into its tags and
+     * saves it once.  Fields that are the same are left alone, so if nothing
+     * changed nothing is written.  Returns true if the save succeeds.
+     */
+    bool save(File *file) const;
+
+    /*!
+     * Opens \a file, saves this TrackInfo to it and closes it again.
+     */
+    bool save(FileName file) const;
+
+  private:
+    class TrackInfoPrivate;
+    TrackInfoPrivate *d;
+  };
+
+} // namespace TagLib
+
+#endif
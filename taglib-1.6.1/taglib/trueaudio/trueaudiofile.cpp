@@ -101,6 +101,15 @@ TrueAudio::File::File(FileName file, ID3v2::FrameFactory *frameFactory,
     read(readProperties, propertiesStyle);
 }
 
+TrueAudio::File::File(IOStream *stream, ID3v2::FrameFactory *frameFactory,
+                 bool readProperties, Properties::ReadStyle propertiesStyle) :
+  TagLib::File(stream)
+{
+  d = new FilePrivate(frameFactory);
+  if(isOpen())
+    read(readProperties, propertiesStyle);
+}
+
 TrueAudio::File::~File()
 {
   delete d;
@@ -131,15 +140,18 @@ bool TrueAudio::File::save()
   // Update ID3v2 tag
 
   if(ID3v2Tag() && !ID3v2Tag()->isEmpty()) {
-    if(!d->hasID3v2) {
-      d->ID3v2Location = 0;
-      d->ID3v2OriginalSize = 0;
+    if(!d->hasID3v2 || ID3v2Tag()->isModified()) {
+      if(!d->hasID3v2) {
+        d->ID3v2Location = 0;
+        d->ID3v2OriginalSize = 0;
+      }
+      ByteVector data = ID3v2Tag()->render();
+      insert(data, d->ID3v2Location, d->ID3v2OriginalSize);
+      d->ID3v1Location -= d->ID3v2OriginalSize - data.size();
+      d->ID3v2OriginalSize = data.size();
+      d->hasID3v2 = true;
+      ID3v2Tag()->setModified(false);
     }
-    ByteVector data = ID3v2Tag()->render();
-    insert(data, d->ID3v2Location, d->ID3v2OriginalSize);
-    d->ID3v1Location -= d->ID3v2OriginalSize - data.size();
-    d->ID3v2OriginalSize = data.size();
-    d->hasID3v2 = true;
   }
   else if(d->hasID3v2) {
     removeBlock(d->ID3v2Location, d->ID3v2OriginalSize);
@@ -152,14 +164,17 @@ bool TrueAudio::File::save()
   // Update ID3v1 tag
 
   if(ID3v1Tag() && !ID3v1Tag()->isEmpty()) {
-    if(!d->hasID3v1) {
-      seek(0, End);
-      d->ID3v1Location = tell();
+    if(!d->hasID3v1 || ID3v1Tag()->isModified()) {
+      if(!d->hasID3v1) {
+        seek(0, End);
+        d->ID3v1Location = tell();
+      }
+      else
+        seek(d->ID3v1Location);
+      writeBlock(ID3v1Tag()->render());
+      d->hasID3v1 = true;
+      ID3v1Tag()->setModified(false);
     }
-    else
-      seek(d->ID3v1Location);
-    writeBlock(ID3v1Tag()->render());
-    d->hasID3v1 = true;
   }
   else if(d->hasID3v1) {
     removeBlock(d->ID3v1Location, 128);
@@ -195,6 +210,22 @@ void TrueAudio::File::strip(int tags)
   }
 }
 
+bool TrueAudio::File::audioRange(long &offset, long &length)
+{
+  if(!isValid())
+    return false;
+
+  long start = d->hasID3v2 ? d->ID3v2Location + long(d->ID3v2OriginalSize) : 0;
+  long end = File::length();
+
+  if(d->hasID3v1 && d->ID3v1Location >= start && d->ID3v1Location < end)
+    end = d->ID3v1Location;
+
+  offset = start;
+  length = end > start ? end - start : 0;
+  return true;
+}
+
 
 ////////////////////////////////////////////////////////////////////////////////
 // private members
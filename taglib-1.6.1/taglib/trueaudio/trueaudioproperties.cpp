@@ -28,6 +28,7 @@
  ***************************************************************************/
 
 #include <tstring.h>
+#include <tbytevectorreader.h>
 #include <tdebug.h>
 #include <bitset>
 
@@ -115,21 +116,16 @@ void TrueAudio::Properties::read()
   if(!d->data.startsWith("TTA"))
     return;
 
-  int pos = 3;
+  ByteVectorReader reader(d->data, 3);
 
-  d->version = d->data[pos] - '0';
-  pos += 1 + 2;
+  d->version = reader.readByte() - '0';
+  reader.skip(2);
 
-  d->channels = d->data.mid(pos, 2).toShort(false);
-  pos += 2;
+  d->channels = reader.readUInt16(false);
+  d->bitsPerSample = reader.readUInt16(false);
+  d->sampleRate = reader.readUInt32(false);
 
-  d->bitsPerSample = d->data.mid(pos, 2).toShort(false);
-  pos += 2;
-
-  d->sampleRate = d->data.mid(pos, 4).toUInt(false);
-  pos += 4;
-
-  unsigned long samples = d->data.mid(pos, 4).toUInt(false);
+  unsigned long samples = reader.readUInt32(false);
   d->length = samples / d->sampleRate;
 
   d->bitrate = d->length > 0 ? ((d->streamLength * 8L) / d->length) / 1000 : 0;
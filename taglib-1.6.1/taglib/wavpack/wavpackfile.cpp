@@ -90,6 +90,13 @@ WavPack::File::File(FileName file, bool readProperties,
   read(readProperties, propertiesStyle);
 }
 
+WavPack::File::File(IOStream *stream, bool readProperties,
+                Properties::ReadStyle propertiesStyle) : TagLib::File(stream)
+{
+  d = new FilePrivate;
+  read(readProperties, propertiesStyle);
+}
+
 WavPack::File::~File()
 {
   delete d;
@@ -116,8 +123,10 @@ bool WavPack::File::save()
 
   if(ID3v1Tag()) {
     if(d->hasID3v1) {
-      seek(d->ID3v1Location);
-      writeBlock(ID3v1Tag()->render());
+      if(ID3v1Tag()->isModified()) {
+        seek(d->ID3v1Location);
+        writeBlock(ID3v1Tag()->render());
+      }
     }
     else {
       seek(0, End);
@@ -125,6 +134,7 @@ bool WavPack::File::save()
       writeBlock(ID3v1Tag()->render());
       d->hasID3v1 = true;
     }
+    ID3v1Tag()->setModified(false);
   }
   else {
     if(d->hasID3v1) {
@@ -140,8 +150,15 @@ bool WavPack::File::save()
   // Update APE tag
 
   if(APETag()) {
-    if(d->hasAPE)
-      insert(APETag()->render(), d->APELocation, d->APESize);
+    if(d->hasAPE) {
+      if(APETag()->isModified()) {
+        const long oldSize = d->APESize;
+        insert(APETag()->render(), d->APELocation, d->APESize);
+        d->APESize = APETag()->footer()->completeTagSize();
+        if(d->hasID3v1 && d->ID3v1Location > d->APELocation)
+          d->ID3v1Location += long(d->APESize) - oldSize;
+      }
+    }
     else {
       if(d->hasID3v1)  {
         insert(APETag()->render(), d->ID3v1Location, 0);
@@ -158,6 +175,7 @@ bool WavPack::File::save()
         d->hasAPE = true;
       }
     }
+    APETag()->setModified(false);
   }
   else {
     if(d->hasAPE) {
@@ -199,6 +217,24 @@ void WavPack::File::strip(int tags)
   }
 }
 
+bool WavPack::File::audioRange(long &offset, long &length)
+{
+  if(!isValid())
+    return false;
+
+  long start = 0;
+  long end = File::length();
+
+  if(d->hasAPE && d->APELocation >= start && d->APELocation < end)
+    end = d->APELocation;
+  if(d->hasID3v1 && d->ID3v1Location >= start && d->ID3v1Location < end)
+    end = d->ID3v1Location;
+
+  offset = start;
+  length = end > start ? end - start : 0;
+  return true;
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 // private members
 ////////////////////////////////////////////////////////////////////////////////
@@ -0,0 +1,142 @@
+#include <cppunit/extensions/HelperMacros.h>
+#include <string>
+#include <tag.h>
+#include <fileref.h>
+#include <audiohash.h>
+#include <tstreamhash.h>
+#include <mpegfile.h>
+#include <id3v2tag.h>
+#include <id3v1tag.h>
+#include "utils.h"
+
+using namespace std;
+using namespace TagLib;
+
+class TestAudioHash : public CppUnit::TestFixture
+{
+  CPPUNIT_TEST_SUITE(TestAudioHash);
+  CPPUNIT_TEST(testStreamHash);
+  CPPUNIT_TEST(testStreamHashPieces);
+  CPPUNIT_TEST(testRanges);
+  CPPUNIT_TEST(testRetagged);
+  CPPUNIT_TEST(testSampled);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+
+  void testStreamHash()
+  {
+    // Reference values of XXH64.
+    CPPUNIT_ASSERT_EQUAL(0xef46db3751d8e999ULL, StreamHash::hash(ByteVector()));
+    CPPUNIT_ASSERT_EQUAL(0xd24ec4f1a98c6e5bULL, StreamHash::hash("a"));
+    CPPUNIT_ASSERT_EQUAL(0x44bc2cf5ad770999ULL, StreamHash::hash("abc"));
+    CPPUNIT_ASSERT(StreamHash::hash("abc", 1) != StreamHash::hash("abc"));
+  }
+
+  void testStreamHashPieces()
+  {
+    ByteVector data;
+    for(int i = 0; i < 1000; i++)
+      data.append(char(i * 7));
+
+    unsigned long long whole = StreamHash::hash(data, 5);
+
+    for(uint step = 1; step < 70; step += 3) {
+      StreamHash h(5);
+      for(uint i = 0; i < data.size(); i += step)
+        h.update(data.mid(i, step));
+      CPPUNIT_ASSERT_EQUAL(whole, h.digest());
+      CPPUNIT_ASSERT_EQUAL(1000ULL, h.length());
+    }
+  }
+
+  void testRanges()
+  {
+    const char *files[] = {
+      "data/xing.mp3", "data/no-tags.flac", "data/empty.ogg", "data/empty.spx",
+      "data/empty_flac.oga", "data/empty.aiff", "data/empty.tta", "data/click.mpc",
+      "data/click.wv",
+#ifdef TAGLIB_WITH_MP4
+      "data/has-tags.m4a",
+#endif
+#ifdef TAGLIB_WITH_ASF
+      "data/silence-1.wma",
+#endif
+      0
+    };
+
+    for(int i = 0; files[i]; i++) {
+      FileRef ref(files[i]);
+      CPPUNIT_ASSERT(!ref.isNull());
+      long offset = -1, length = -1;
+      CPPUNIT_ASSERT(ref.file()->audioRange(offset, length));
+      CPPUNIT_ASSERT(offset >= 0);
+      CPPUNIT_ASSERT(length > 0);
+      CPPUNIT_ASSERT(offset + length <= ref.file()->length());
+    }
+  }
+
+  void testRetagged()
+  {
+    string tagged = copyFile("xing", ".mp3");
+
+    AudioHash hasher;
+    ByteVector before;
+    long offset, length;
+    {
+      MPEG::File f(tagged.c_str());
+      CPPUNIT_ASSERT(f.audioRange(offset, length));
+      before = hasher.hash(&f);
+      CPPUNIT_ASSERT_EQUAL(TagLib::uint(8), before.size());
+      CPPUNIT_ASSERT_EQUAL(ulong(length), hasher.bytesRead());
+    }
+    {
+      MPEG::File f(tagged.c_str());
+      f.ID3v2Tag(true)->setTitle(String(string(5000, 't')));
+      f.ID3v1Tag(true)->setArtist("artist");
+      f.save();
+    }
+    {
+      MPEG::File f(tagged.c_str());
+      long newOffset, newLength;
+      CPPUNIT_ASSERT(f.audioRange(newOffset, newLength));
+      CPPUNIT_ASSERT(newOffset > offset);
+      CPPUNIT_ASSERT_EQUAL(length, newLength);
+      CPPUNIT_ASSERT_EQUAL(before, hasher.hash(&f));
+
+      // The whole file hashes differently, as do other files.
+      f.seek(0);
+      CPPUNIT_ASSERT(ByteVector::fromLongLong(StreamHash::hash(f.readBlock(f.length())))
+                     != before);
+      MPEG::File other("data/mpeg2.mp3");
+      CPPUNIT_ASSERT(hasher.hash(&other) != before);
+    }
+
+    deleteFile(tagged);
+
+    CPPUNIT_ASSERT(hasher.hash(0).isEmpty());
+  }
+
+  void testSampled()
+  {
+    AudioHash whole;
+    AudioHash sampled;
+    sampled.setSampled(4, 256);
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(4), sampled.windows());
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(256), sampled.windowSize());
+
+    MPEG::File f("data/xing.mp3");
+    ByteVector h = sampled.hash(&f);
+    CPPUNIT_ASSERT_EQUAL(ulong(4 * 256), sampled.bytesRead());
+    CPPUNIT_ASSERT(h != whole.hash(&f));
+    CPPUNIT_ASSERT_EQUAL(h, sampled.hash(&f));
+
+    // Audio shorter than the windows is read whole.
+    AudioHash large;
+    large.setSampled(4, 1024 * 1024);
+    CPPUNIT_ASSERT_EQUAL(whole.hash(&f), large.hash(&f));
+  }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestAudioHash);
@@ -37,6 +37,7 @@ class TestByteVector : public CppUnit::TestFixture
   CPPUNIT_TEST(testFind2);
   CPPUNIT_TEST(testRfind1);
   CPPUNIT_TEST(testRfind2);
+  CPPUNIT_TEST(testAppend);
   CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -173,6 +174,26 @@ public:
     CPPUNIT_ASSERT_EQUAL(10, r4.rfind("OggS", 12));
   }
 
+  void testAppend()
+  {
+    ByteVector v("abc");
+    v.append(v);
+    CPPUNIT_ASSERT_EQUAL(ByteVector("abcabc"), v);
+
+    ByteVector shared = v;
+    v.append(v);
+    CPPUNIT_ASSERT_EQUAL(ByteVector("abcabcabcabc"), v);
+    CPPUNIT_ASSERT_EQUAL(ByteVector("abcabc"), shared);
+
+    ByteVector grown;
+    for(int i = 0; i < 1000; i++)
+      grown.append(char(i));
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(1000), grown.size());
+    CPPUNIT_ASSERT_EQUAL(char(999), grown[999]);
+    grown.resize(1);
+    CPPUNIT_ASSERT_EQUAL(ByteVector(1, '\0'), grown);
+  }
+
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(TestByteVector);
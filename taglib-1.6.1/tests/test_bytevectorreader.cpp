@@ -0,0 +1,121 @@
+#include <cppunit/extensions/HelperMacros.h>
+#include <tbytevector.h>
+#include <tbytevectorreader.h>
+
+using namespace std;
+using namespace TagLib;
+
+class TestByteVectorReader : public CppUnit::TestFixture
+{
+  CPPUNIT_TEST_SUITE(TestByteVectorReader);
+  CPPUNIT_TEST(testIntegers);
+  CPPUNIT_TEST(testSynchSafe);
+  CPPUNIT_TEST(testStrings);
+  CPPUNIT_TEST(testOffset);
+  CPPUNIT_TEST(testPastEnd);
+  CPPUNIT_TEST(testMatchesByteVector);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+
+  void testIntegers()
+  {
+    ByteVector v("\x01\x02\x03\x04\x05\x06\x07\x08\x09\x0a\x0b\x0c\x0d\x0e\x0f\x10"
+                 "\x11\x12\x13\x14\x15\x16\x17\x18\x19\x1a\x1b\x1c\x1d\x1e\x1f\x20", 32);
+    ByteVectorReader reader(v);
+
+    CPPUNIT_ASSERT_EQUAL(uchar(0x01), reader.readByte());
+    CPPUNIT_ASSERT_EQUAL((unsigned short)0x0203, reader.readUInt16());
+    CPPUNIT_ASSERT_EQUAL((unsigned short)0x0504, reader.readUInt16(false));
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(0x060708), reader.readUInt24());
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(0x0b0a09), reader.readUInt24(false));
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(0x0c0d0e0f), reader.readUInt32());
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(0x13121110), reader.readUInt32(false));
+    CPPUNIT_ASSERT_EQUAL(0x1415161718191a1bULL, reader.readUInt64());
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(27), reader.offset());
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(5), reader.remaining());
+    CPPUNIT_ASSERT(reader.isValid());
+
+    ByteVectorReader little(ByteVector("\x80\x00\x00\x00\x00\x00\x00\xff", 8));
+    CPPUNIT_ASSERT_EQUAL(0xff00000000000080ULL, little.readUInt64(false));
+    CPPUNIT_ASSERT(little.atEnd());
+  }
+
+  void testSynchSafe()
+  {
+    ByteVectorReader reader(ByteVector("\x00\x00\x02\x01\x7f\x7f\x7f\x7f", 8));
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(257), reader.readSynchSafeUInt32());
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(0x0fffffff), reader.readSynchSafeUInt32());
+  }
+
+  void testStrings()
+  {
+    ByteVector v("\x05\x00\x00\x00vendor\x00\x03" "abcde", 17);
+    ByteVectorReader reader(v);
+
+    CPPUNIT_ASSERT_EQUAL(String("vendo"), reader.readLengthPrefixedString(String::UTF8, 4, false));
+    CPPUNIT_ASSERT_EQUAL(ByteVector("r"), reader.readBlock(1));
+    CPPUNIT_ASSERT_EQUAL(String("abc"), reader.readLengthPrefixedString(String::Latin1, 2));
+    CPPUNIT_ASSERT_EQUAL(String("de"), reader.readString(2));
+    CPPUNIT_ASSERT(reader.atEnd());
+    CPPUNIT_ASSERT(reader.isValid());
+  }
+
+  void testOffset()
+  {
+    ByteVector v("\x00\x00\x12\x34\x56\x78", 6);
+    ByteVectorReader reader(v, 2);
+
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(2), reader.offset());
+    CPPUNIT_ASSERT_EQUAL((unsigned short)0x1234, reader.readUInt16());
+    reader.seek(1);
+    reader.skip(2);
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(0x345678), reader.readUInt24());
+    CPPUNIT_ASSERT(reader.atEnd());
+    CPPUNIT_ASSERT(reader.isValid());
+  }
+
+  void testPastEnd()
+  {
+    ByteVectorReader reader(ByteVector("\x01\x02\x03", 3));
+
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(0), reader.readUInt32());
+    CPPUNIT_ASSERT(!reader.isValid());
+    CPPUNIT_ASSERT(reader.atEnd());
+
+    // Once a read has failed, nothing else is read.
+    reader.seek(0);
+    CPPUNIT_ASSERT_EQUAL(uchar(0), reader.readByte());
+    CPPUNIT_ASSERT(!reader.isValid());
+
+    ByteVectorReader strings(ByteVector("\xff\xff\xff\xff" "abc", 7));
+    CPPUNIT_ASSERT(strings.readLengthPrefixedString(String::UTF8).isEmpty());
+    CPPUNIT_ASSERT(strings.readBlock(1).isEmpty());
+    CPPUNIT_ASSERT(!strings.isValid());
+
+    ByteVectorReader skipped(ByteVector("\x01\x02", 2), 3);
+    CPPUNIT_ASSERT(!skipped.isValid());
+    ByteVectorReader empty(ByteVector::null);
+    CPPUNIT_ASSERT(empty.atEnd());
+    CPPUNIT_ASSERT(empty.isValid());
+    empty.skip(1);
+    CPPUNIT_ASSERT(!empty.isValid());
+  }
+
+  void testMatchesByteVector()
+  {
+    ByteVector v("\xfe\xdc\xba\x98\x76\x54\x32\x10", 8);
+
+    ByteVectorReader reader(v);
+    CPPUNIT_ASSERT_EQUAL(v.mid(0, 2).toShort(), short(reader.readUInt16()));
+    CPPUNIT_ASSERT_EQUAL(v.mid(2, 4).toUInt(false), reader.readUInt32(false));
+
+    reader.seek(0);
+    CPPUNIT_ASSERT_EQUAL(v.toLongLong(), (long long)reader.readUInt64());
+    reader.seek(1);
+    CPPUNIT_ASSERT_EQUAL(v.mid(1, 3).toUInt(), reader.readUInt24());
+  }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestByteVectorReader);
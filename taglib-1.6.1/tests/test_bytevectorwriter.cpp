@@ -0,0 +1,116 @@
+#include <cppunit/extensions/HelperMacros.h>
+#include <tbytevector.h>
+#include <tbytevectorreader.h>
+#include <tbytevectorwriter.h>
+
+using namespace std;
+using namespace TagLib;
+
+class TestByteVectorWriter : public CppUnit::TestFixture
+{
+  CPPUNIT_TEST_SUITE(TestByteVectorWriter);
+  CPPUNIT_TEST(testIntegers);
+  CPPUNIT_TEST(testSynchSafe);
+  CPPUNIT_TEST(testBlocks);
+  CPPUNIT_TEST(testSeek);
+  CPPUNIT_TEST(testGrow);
+  CPPUNIT_TEST(testDataDetaches);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+
+  void testIntegers()
+  {
+    ByteVectorWriter writer(27);
+    writer.writeByte(0x01);
+    writer.writeUInt16(0x0203);
+    writer.writeUInt16(0x0405, false);
+    writer.writeUInt24(0x060708);
+    writer.writeUInt24(0x090a0b, false);
+    writer.writeUInt32(0x0c0d0e0f);
+    writer.writeUInt32(0x10111213, false);
+    writer.writeUInt64(0x1415161718191a1bULL);
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(27), writer.offset());
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(27), writer.size());
+
+    CPPUNIT_ASSERT_EQUAL(ByteVector("\x01\x02\x03\x05\x04\x06\x07\x08\x0b\x0a\x09\x0c\x0d\x0e"
+                                    "\x0f\x13\x12\x11\x10\x14\x15\x16\x17\x18\x19\x1a\x1b", 27),
+                         writer.data());
+
+    ByteVectorWriter little(8);
+    little.writeUInt64(0xff00000000000080ULL, false);
+    CPPUNIT_ASSERT_EQUAL(ByteVector("\x80\x00\x00\x00\x00\x00\x00\xff", 8), little.data());
+  }
+
+  void testSynchSafe()
+  {
+    ByteVectorWriter writer(8);
+    writer.writeSynchSafeUInt32(257);
+    writer.writeSynchSafeUInt32(0x0fffffff);
+    CPPUNIT_ASSERT_EQUAL(ByteVector("\x00\x00\x02\x01\x7f\x7f\x7f\x7f", 8), writer.data());
+  }
+
+  void testBlocks()
+  {
+    ByteVectorWriter writer(10);
+    writer.writeBlock(ByteVector("abc"));
+    writer.writeBlock(ByteVector());
+    writer.writeBlock("de\0f", 4);
+    writer.fill(2, 'x');
+    writer.fill(1);
+    CPPUNIT_ASSERT_EQUAL(ByteVector("abcde\0fxx\0", 10), writer.data());
+  }
+
+  void testSeek()
+  {
+    // Write a placeholder for the size, then go back and fill it in.
+    ByteVectorWriter writer(8);
+    writer.fill(4);
+    writer.writeBlock(ByteVector("data"));
+    writer.seek(0);
+    writer.writeUInt32(writer.size());
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(4), writer.offset());
+    CPPUNIT_ASSERT_EQUAL(ByteVector("\x00\x00\x00\x08" "data", 8), writer.data());
+
+    // Seeking past the end pads with zeros.
+    ByteVectorWriter gap(2);
+    gap.writeByte('a');
+    gap.seek(4);
+    gap.writeByte('b');
+    CPPUNIT_ASSERT_EQUAL(ByteVector("a\0\0\0b", 5), gap.data());
+  }
+
+  void testGrow()
+  {
+    // A size that was worked out too small still gives the right result.
+    ByteVectorWriter writer(1);
+    for(uint i = 0; i < 1000; i++)
+      writer.writeUInt32(i);
+    ByteVector data = writer.data();
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(4000), data.size());
+
+    ByteVectorReader reader(data);
+    for(uint i = 0; i < 1000; i++)
+      CPPUNIT_ASSERT_EQUAL(i, reader.readUInt32());
+
+    // Nothing written gives an empty vector, whatever the size given.
+    CPPUNIT_ASSERT(ByteVectorWriter(16).data().isEmpty());
+  }
+
+  void testDataDetaches()
+  {
+    ByteVectorWriter writer(4);
+    writer.writeBlock(ByteVector("abcd"));
+    ByteVector first = writer.data();
+
+    writer.seek(0);
+    writer.writeByte('x');
+    writer.seek(4);
+    writer.writeByte('e');
+    CPPUNIT_ASSERT_EQUAL(ByteVector("abcd"), first);
+    CPPUNIT_ASSERT_EQUAL(ByteVector("xbcde"), writer.data());
+  }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestByteVectorWriter);
@@ -0,0 +1,154 @@
+#include <cppunit/extensions/HelperMacros.h>
+#include <string>
+#include <map>
+#include <tag.h>
+#include <fileref.h>
+#include <filescanner.h>
+#include <tfilestream.h>
+
+using namespace std;
+using namespace TagLib;
+
+namespace
+{
+  class Recorder : public FileScanner::Handler
+  {
+  public:
+    void scanned(const String &path, const FileRef &ref)
+    {
+      calls++;
+      if(ref.isNull())
+        found[path] = "null";
+      else
+        found[path] = describe(ref);
+    }
+
+    static String describe(const FileRef &ref)
+    {
+      String s = ref.tag()->title() + "/" + ref.tag()->artist() + "/" +
+        String::number(ref.tag()->track());
+      if(ref.audioProperties())
+        s += "/" + String::number(ref.audioProperties()->length()) + "/" +
+          String::number(ref.audioProperties()->bitrate()) + "/" +
+          String::number(ref.audioProperties()->sampleRate());
+      return s;
+    }
+
+    Recorder() : calls(0) {}
+
+    int calls;
+    map<String, String> found;
+  };
+}
+
+class TestFileScanner : public CppUnit::TestFixture
+{
+  CPPUNIT_TEST_SUITE(TestFileScanner);
+  CPPUNIT_TEST(testStream);
+  CPPUNIT_TEST(testThreads);
+  CPPUNIT_TEST(testAutomatic);
+  CPPUNIT_TEST(testSmallPrefetch);
+  CPPUNIT_TEST(testReadOnly);
+  CPPUNIT_TEST_SUITE_END();
+
+  StringList paths()
+  {
+    StringList l;
+    l.append("data/xing.mp3");
+    l.append("data/mpeg2.mp3");
+    l.append("data/click.mpc");
+    l.append("data/click.wv");
+    l.append("data/empty.ogg");
+    l.append("data/empty.spx");
+    l.append("data/empty.tta");
+    l.append("data/empty_flac.oga");
+    l.append("data/no-tags.flac");
+    l.append("data/empty.aiff");
+#ifdef TAGLIB_WITH_MP4
+    l.append("data/has-tags.m4a");
+#endif
+    l.append("data/does-not-exist.mp3");
+    l.append("data/005411.id3");
+    return l;
+  }
+
+  void checkScan(FileScanner &scanner)
+  {
+    StringList l = paths();
+    Recorder recorder;
+
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(l.size() - 2), scanner.scan(l, &recorder));
+    CPPUNIT_ASSERT_EQUAL(int(l.size()), recorder.calls);
+
+    for(StringList::ConstIterator it = l.begin(); it != l.end(); ++it) {
+      FileRef ref(it->toCString());
+      CPPUNIT_ASSERT(recorder.found.find(*it) != recorder.found.end());
+      CPPUNIT_ASSERT_EQUAL(ref.isNull() ? String("null") : Recorder::describe(ref),
+                           recorder.found[*it]);
+    }
+  }
+
+public:
+
+  void testStream()
+  {
+    FileStream stream("data/xing.mp3");
+    FileRef ref(&stream);
+    CPPUNIT_ASSERT(!ref.isNull());
+    CPPUNIT_ASSERT_EQUAL(Recorder::describe(FileRef("data/xing.mp3")), Recorder::describe(ref));
+  }
+
+  void testThreads()
+  {
+    FileScanner scanner;
+    scanner.setBackend(FileScanner::Threads);
+    scanner.setMaxInFlight(4);
+    checkScan(scanner);
+    CPPUNIT_ASSERT_EQUAL(FileScanner::Threads, scanner.backend());
+  }
+
+  void testAutomatic()
+  {
+    FileScanner scanner;
+    checkScan(scanner);
+    CPPUNIT_ASSERT(scanner.backend() != FileScanner::Automatic);
+  }
+
+  void testSmallPrefetch()
+  {
+    // Most reads now miss the prefetched data and go to the file.
+    FileScanner scanner;
+    scanner.setMaxInFlight(2);
+    scanner.setPrefetchSize(16, 16);
+    checkScan(scanner);
+    CPPUNIT_ASSERT(scanner.extraReads() > 0);
+  }
+
+  void testReadOnly()
+  {
+    class Saver : public FileScanner::Handler
+    {
+    public:
+      void scanned(const String &, const FileRef &ref)
+      {
+        FileRef copy(ref);
+        copy.tag()->setTitle("changed");
+        saved = copy.save();
+        kept = copy;
+      }
+      bool saved;
+      FileRef kept;
+    } saver;
+
+    StringList l;
+    l.append("data/xing.mp3");
+    FileScanner().scan(l, &saver);
+    CPPUNIT_ASSERT(!saver.saved);
+    // The ref outlives the scanner, along with its stream.
+    CPPUNIT_ASSERT_EQUAL(String("changed"), saver.kept.tag()->title());
+    CPPUNIT_ASSERT(saver.kept.audioProperties()->length() > 0);
+  }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestFileScanner);
@@ -11,6 +11,11 @@
 #include <relativevolumeframe.h>
 #include <popularimeterframe.h>
 #include <urllinkframe.h>
+#include <unknownframe.h>
+#include <commentsframe.h>
+#include <unsynchronizedlyricsframe.h>
+#include <privateframe.h>
+#include <tbytevectorwriter.h>
 #include <tdebug.h>
 #include "utils.h"
 
@@ -29,6 +34,26 @@ class PublicFrame : public ID3v2::Frame
     virtual ByteVector renderFields() const { return ByteVector::null; }
 };
 
+class CustomFrame : public ID3v2::Frame
+{
+  public:
+    static ID3v2::Frame *create(const ByteVector &data, Header *h)
+      { return new CustomFrame(data, h); }
+    virtual String toString() const { return String(value); }
+    virtual void parseFields(const ByteVector &data) { value = data; }
+    virtual ByteVector renderFields() const { return value; }
+    ByteVector value;
+  private:
+    CustomFrame(const ByteVector &data, Header *h) : ID3v2::Frame(h)
+      { parseFields(fieldData(data)); }
+};
+
+class UTF16FrameFactory : public ID3v2::FrameFactory
+{
+  public:
+    UTF16FrameFactory() { setDefaultTextEncoding(String::UTF16); }
+};
+
 class TestID3v2 : public CppUnit::TestFixture
 {
   CPPUNIT_TEST_SUITE(TestID3v2);
@@ -40,6 +65,8 @@ class TestID3v2 : public CppUnit::TestFixture
   CPPUNIT_TEST(testParseAPIC_UTF16_BOM);
   CPPUNIT_TEST(testParseAPICv22);
   CPPUNIT_TEST(testDontRender22);
+  CPPUNIT_TEST(testUpdateFrame22);
+  CPPUNIT_TEST(testFrameCreator);
   CPPUNIT_TEST(testParseGEOB);
   CPPUNIT_TEST(testPOPMtoString);
   CPPUNIT_TEST(testParsePOPM);
@@ -59,6 +86,12 @@ class TestID3v2 : public CppUnit::TestFixture
   CPPUNIT_TEST(testUpdateGenre23_1);
   CPPUNIT_TEST(testUpdateGenre23_2);
   CPPUNIT_TEST(testUpdateGenre24);
+  CPPUNIT_TEST(testModified);
+  CPPUNIT_TEST(testSaveUnchanged);
+  CPPUNIT_TEST(testKeepUnchangedFrames);
+  CPPUNIT_TEST(testSaveTwice);
+  CPPUNIT_TEST(testDefaultEncodingOnSave);
+  CPPUNIT_TEST(testRenderedSize);
   CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -173,6 +206,47 @@ public:
     CPPUNIT_ASSERT_EQUAL(TagLib::uint(1034), tag.render().size());
   }
 
+  void testUpdateFrame22()
+  {
+    ID3v2::FrameFactory *factory = ID3v2::FrameFactory::instance();
+    ID3v2::Frame *frame = factory->createFrame(ByteVector("TT2"
+                                                          "\x00\x00\x04"
+                                                          "\x00"
+                                                          "abc", 10), TagLib::uint(2));
+    CPPUNIT_ASSERT(dynamic_cast<ID3v2::TextIdentificationFrame *>(frame));
+    CPPUNIT_ASSERT_EQUAL(ByteVector("TIT2"), frame->frameID());
+    CPPUNIT_ASSERT_EQUAL(String("abc"), frame->toString());
+    delete frame;
+
+    frame = factory->createFrame(ByteVector("CRM"
+                                            "\x00\x00\x04"
+                                            "\x00"
+                                            "abc", 10), TagLib::uint(2));
+    CPPUNIT_ASSERT(dynamic_cast<ID3v2::UnknownFrame *>(frame));
+    delete frame;
+  }
+
+  void testFrameCreator()
+  {
+    ID3v2::FrameFactory *factory = ID3v2::FrameFactory::instance();
+    ByteVector data("XTST"
+                    "\x00\x00\x00\x03"
+                    "\x00\x00"
+                    "abc", 13);
+
+    factory->registerFrameCreator("XTST", CustomFrame::create);
+    ID3v2::Frame *frame = factory->createFrame(data);
+    factory->registerFrameCreator("XTST", 0);
+    CustomFrame *custom = dynamic_cast<CustomFrame *>(frame);
+    CPPUNIT_ASSERT(custom);
+    CPPUNIT_ASSERT_EQUAL(ByteVector("abc"), custom->value);
+    delete frame;
+
+    frame = factory->createFrame(data);
+    CPPUNIT_ASSERT(dynamic_cast<ID3v2::UnknownFrame *>(frame));
+    delete frame;
+  }
+
   // http://bugs.kde.org/show_bug.cgi?id=151078
   void testParseGEOB()
   {
@@ -439,6 +513,259 @@ public:
     CPPUNIT_ASSERT_EQUAL(String("R&B Eurodisco"), tag.genre());
   }
 
+  void testModified()
+  {
+    ID3v2::Tag tag;
+    CPPUNIT_ASSERT(!tag.isModified());
+    tag.setTitle("Title");
+    CPPUNIT_ASSERT(tag.isModified());
+
+    tag.setModified(false);
+    CPPUNIT_ASSERT(!tag.isModified());
+    CPPUNIT_ASSERT(!tag.frameList("TIT2").front()->isModified());
+
+    tag.setTitle("Title");
+    CPPUNIT_ASSERT(!tag.isModified());
+    tag.frameList("TIT2").front()->setText("Other");
+    CPPUNIT_ASSERT(tag.frameList("TIT2").front()->isModified());
+    CPPUNIT_ASSERT(tag.isModified());
+
+    // The same goes through a pointer to the base class.
+    TagLib::Tag *base = &tag;
+    CPPUNIT_ASSERT(base->isModified());
+    base->setModified(false);
+    CPPUNIT_ASSERT(!tag.frameList("TIT2").front()->isModified());
+    tag.frameList("TIT2").front()->setText("Title");
+
+    tag.setModified(false);
+    tag.setTitle("");
+    CPPUNIT_ASSERT(tag.isModified());
+  }
+
+  void testSaveUnchanged()
+  {
+    string newname = copyFile("xing", ".mp3");
+    {
+      MPEG::File f(newname.c_str());
+      f.tag()->setTitle("Title");
+      f.save();
+      // A tag that has been saved isn't changed until it is set again.
+      CPPUNIT_ASSERT(!f.ID3v2Tag()->isModified());
+      f.tag()->setArtist(string(2000, 'x'));
+      CPPUNIT_ASSERT(f.save());
+      f.tag()->setArtist("Artist");
+      CPPUNIT_ASSERT(f.save());
+    }
+
+    MPEG::File f(newname.c_str());
+    CPPUNIT_ASSERT(!f.ID3v2Tag()->isModified());
+    CPPUNIT_ASSERT_EQUAL(String("Artist"), f.tag()->artist());
+    CPPUNIT_ASSERT(f.audioProperties()->length() > 0);
+
+    f.seek(0);
+    const ByteVector before = f.readBlock(f.length());
+
+    f.tag()->setTitle("Title");
+    f.tag()->setArtist("Artist");
+    CPPUNIT_ASSERT(!f.ID3v2Tag()->isModified());
+    CPPUNIT_ASSERT(f.save());
+
+    f.seek(0);
+    CPPUNIT_ASSERT(before == f.readBlock(f.length()));
+    deleteFile(newname);
+  }
+
+  void testKeepUnchangedFrames()
+  {
+    // The TIT2 frame ends with a terminator that TagLib wouldn't write.
+    ByteVector tit2("TIT2"
+                    "\x00\x00\x00\x07"
+                    "\x00\x00"
+                    "\x00" "Title\x00", 17);
+    ByteVector tpe1("TPE1"
+                    "\x00\x00\x00\x07"
+                    "\x00\x00"
+                    "\x00" "Artist", 17);
+    ByteVector tag("ID3\x04\x00\x00\x00\x00\x00\x2c", 10);
+    tag.append(tit2);
+    tag.append(tpe1);
+    tag.append(ByteVector(10, '\0'));
+
+    string newname = copyFile("xing", ".mp3");
+    {
+      MPEG::File f(newname.c_str());
+      f.strip();
+      f.insert(tag, 0, 0);
+    }
+    {
+      MPEG::File f(newname.c_str());
+      CPPUNIT_ASSERT_EQUAL(String("Title"), f.tag()->title());
+      CPPUNIT_ASSERT_EQUAL(String("Artist"), f.tag()->artist());
+      CPPUNIT_ASSERT(!f.ID3v2Tag()->isModified());
+      f.tag()->setArtist("Someone else");
+      CPPUNIT_ASSERT(f.save(MPEG::File::ID3v2));
+    }
+
+    MPEG::File f(newname.c_str());
+    CPPUNIT_ASSERT_EQUAL(String("Title"), f.tag()->title());
+    CPPUNIT_ASSERT_EQUAL(String("Someone else"), f.tag()->artist());
+    f.seek(0);
+    CPPUNIT_ASSERT_EQUAL(10, f.readBlock(100).find(tit2));
+    deleteFile(newname);
+  }
+
+  string copyWithTitle24(const String &title)
+  {
+    ByteVector tit2("TIT2", 4);
+    tit2.append(ByteVector::fromUInt(title.size() + 1));
+    tit2.append(ByteVector(2, '\0'));
+    tit2.append('\0');
+    tit2.append(title.data(String::Latin1));
+    ByteVector tag("ID3\x04\x00\x00", 6);
+    tag.append(ByteVector::fromUInt(tit2.size()));
+    tag.append(tit2);
+
+    string newname = copyFile("xing", ".mp3");
+    MPEG::File f(newname.c_str());
+    f.strip();
+    f.insert(tag, 0, 0);
+    return newname;
+  }
+
+  void testSaveTwice()
+  {
+    // The second save mustn't copy the frame changed by the first one from
+    // the bytes that were read.
+    string newname = copyWithTitle24("Hello");
+    {
+      MPEG::File f(newname.c_str());
+      CPPUNIT_ASSERT_EQUAL(String("Hello"), f.tag()->title());
+      f.tag()->setTitle("World");
+      CPPUNIT_ASSERT(f.save());
+      f.tag()->setArtist("Other!");
+      CPPUNIT_ASSERT(f.save());
+    }
+
+    MPEG::File f(newname.c_str());
+    CPPUNIT_ASSERT_EQUAL(String("World"), f.tag()->title());
+    CPPUNIT_ASSERT_EQUAL(String("Other!"), f.tag()->artist());
+    deleteFile(newname);
+  }
+
+  void testDefaultEncodingOnSave()
+  {
+    string newname = copyWithTitle24("Hello");
+    UTF16FrameFactory factory;
+    {
+      // Even a save without edits converts the frames.
+      MPEG::File f(newname.c_str(), &factory);
+      CPPUNIT_ASSERT(f.ID3v2Tag()->isModified());
+      CPPUNIT_ASSERT(f.save());
+    }
+
+    MPEG::File f(newname.c_str());
+    f.seek(0);
+    const ByteVector data = f.readBlock(100);
+    const int tit2 = data.find("TIT2");
+    CPPUNIT_ASSERT(tit2 > 0);
+    CPPUNIT_ASSERT_EQUAL(char(String::UTF16), data[tit2 + 10]);
+    CPPUNIT_ASSERT_EQUAL(String("Hello"), f.tag()->title());
+    deleteFile(newname);
+  }
+
+  void testRenderedSize()
+  {
+    const String::Type encodings[] = {
+      String::Latin1, String::UTF16, String::UTF16BE, String::UTF8
+    };
+
+    for(int i = 0; i < 4; i++) {
+      ID3v2::TextIdentificationFrame text("TXXX", encodings[i]);
+      StringList values;
+      values.append("description");
+      values.append("first");
+      values.append("second");
+      text.setText(values);
+
+      ID3v2::CommentsFrame comment(encodings[i]);
+      comment.setLanguage("eng");
+      comment.setDescription("description");
+      comment.setText("comment");
+
+      ID3v2::UnsynchronizedLyricsFrame lyrics(encodings[i]);
+      lyrics.setText("lyrics");
+
+      ID3v2::AttachedPictureFrame picture;
+      picture.setTextEncoding(encodings[i]);
+      picture.setMimeType("image/png");
+      picture.setDescription("cover");
+      picture.setPicture(ByteVector(1000, 'p'));
+
+      ID3v2::GeneralEncapsulatedObjectFrame object;
+      object.setTextEncoding(encodings[i]);
+      object.setMimeType("text/plain");
+      object.setFileName("file.txt");
+      object.setDescription("object");
+      object.setObject(ByteVector("contents"));
+
+      ID3v2::PrivateFrame priv;
+      priv.setOwner("owner");
+      priv.setData(ByteVector("private"));
+
+      ID3v2::UniqueFileIdentifierFrame ufid("owner", "id");
+
+      const ID3v2::Frame *frames[] = {
+        &text, &comment, &lyrics, &picture, &object, &priv, &ufid
+      };
+
+      for(int j = 0; j < 7; j++) {
+        const ByteVector data = frames[j]->render();
+        CPPUNIT_ASSERT_EQUAL(data.size(), frames[j]->renderedSize());
+
+        ByteVectorWriter writer(1);
+        writer.writeByte('x');
+        frames[j]->render(writer);
+        CPPUNIT_ASSERT_EQUAL(ByteVector("x") + data, writer.data());
+      }
+    }
+
+    // A tag with many frames and a large picture reads back the same.
+    ID3v2::Tag tag;
+    for(int i = 0; i < 500; i++) {
+      ID3v2::TextIdentificationFrame *frame = new ID3v2::TextIdentificationFrame("TXXX");
+      StringList values;
+      values.append("key" + String::number(i));
+      values.append("value");
+      frame->setText(values);
+      tag.addFrame(frame);
+    }
+    ID3v2::AttachedPictureFrame *picture = new ID3v2::AttachedPictureFrame;
+    picture->setPicture(ByteVector(2 * 1024 * 1024, 'p'));
+    tag.addFrame(picture);
+
+    ByteVector data = tag.render();
+    CPPUNIT_ASSERT_EQUAL(ByteVector("ID3"), data.mid(0, 3));
+
+    ID3v2::Header header(data.mid(0, 10));
+    CPPUNIT_ASSERT_EQUAL(data.size(), header.completeTagSize());
+
+    string newname = copyFile("xing", ".mp3");
+    {
+      MPEG::File f(newname.c_str());
+      f.strip();
+      f.insert(data, 0, 0);
+    }
+    {
+      MPEG::File f(newname.c_str());
+      CPPUNIT_ASSERT_EQUAL(TagLib::uint(500), f.ID3v2Tag()->frameListMap()["TXXX"].size());
+      ID3v2::FrameList apic = f.ID3v2Tag()->frameListMap()["APIC"];
+      CPPUNIT_ASSERT_EQUAL(TagLib::uint(1), apic.size());
+      CPPUNIT_ASSERT_EQUAL(ByteVector(2 * 1024 * 1024, 'p'),
+                           static_cast<ID3v2::AttachedPictureFrame *>(apic.front())->picture());
+    }
+    deleteFile(newname);
+  }
+
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(TestID3v2);
@@ -32,6 +32,9 @@ class TestList : public CppUnit::TestFixture
 {
   CPPUNIT_TEST_SUITE(TestList);
   CPPUNIT_TEST(testList);
+  CPPUNIT_TEST(testIndex);
+  CPPUNIT_TEST(testAppendSelf);
+  CPPUNIT_TEST(testEraseInsert);
   CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -53,6 +56,59 @@ public:
     CPPUNIT_ASSERT(l1 == l3);
   }
 
+  void testIndex()
+  {
+    List<int> l1;
+    for(int i = 0; i < 1000; i++)
+      l1.append(i);
+    List<int> l2 = l1;
+    l2.front() = -1;
+    CPPUNIT_ASSERT_EQUAL(1000U, l1.size());
+    CPPUNIT_ASSERT_EQUAL(0, l1[0]);
+    CPPUNIT_ASSERT_EQUAL(-1, l2[0]);
+    CPPUNIT_ASSERT_EQUAL(999, l1[999]);
+    CPPUNIT_ASSERT_EQUAL(999, l2.back());
+  }
+
+  void testAppendSelf()
+  {
+    List<int> l1;
+    l1.append(1);
+    l1.append(2);
+    l1.append(l1);
+    l1.prepend(l1);
+    List<int> l2;
+    for(int i = 0; i < 4; i++) {
+      l2.append(1);
+      l2.append(2);
+    }
+    CPPUNIT_ASSERT(l1 == l2);
+  }
+
+  void testEraseInsert()
+  {
+    List<int> l1;
+    for(int i = 0; i < 10; i++)
+      l1.append(i);
+    List<int>::Iterator it = l1.begin();
+    while(it != l1.end()) {
+      if(*it % 2)
+        it = l1.erase(it);
+      else
+        ++it;
+    }
+    it = l1.insert(l1.begin() + 1, 1);
+    CPPUNIT_ASSERT_EQUAL(1, *it);
+    l1.sortedInsert(3);
+    l1.sortedInsert(4, true);
+    l1.sortedInsert(9);
+    List<int> l2;
+    l2.append(0).append(1).append(2).append(3).append(4).append(6).append(8).append(9);
+    CPPUNIT_ASSERT(l1 == l2);
+    CPPUNIT_ASSERT(l1.contains(9));
+    CPPUNIT_ASSERT(l1.find(5) == l1.end());
+  }
+
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(TestList);
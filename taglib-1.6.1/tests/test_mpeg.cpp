@@ -2,6 +2,10 @@
 #include <string>
 #include <stdio.h>
 #include <mpegfile.h>
+#include <id3v2tag.h>
+#include <id3v1tag.h>
+#include <tsplicedstream.h>
+#include "utils.h"
 
 using namespace std;
 using namespace TagLib;
@@ -10,6 +14,7 @@ class TestMPEG : public CppUnit::TestFixture
 {
   CPPUNIT_TEST_SUITE(TestMPEG);
   CPPUNIT_TEST(testVersion2DurationWithXingHeader);
+  CPPUNIT_TEST(testSplicedStream);
   CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -20,6 +25,47 @@ public:
     CPPUNIT_ASSERT_EQUAL(5387, f.audioProperties()->length());
   }
 
+  void testSplicedStream()
+  {
+    string saved = copyFile("xing", ".mp3");
+    string spliced = copyFile("xing", ".mp3");
+
+    // Give both copies an ID3v1 and an ID3v2 tag to start with.
+
+    const string names[] = { saved, spliced };
+    for(int i = 0; i < 2; i++) {
+      MPEG::File f(names[i].c_str());
+      f.ID3v2Tag(true)->setTitle("Title");
+      f.ID3v2Tag()->setArtist("Artist");
+      f.ID3v1Tag(true)->setTitle("Title");
+      f.save();
+    }
+
+    ByteVector expected;
+    {
+      MPEG::File f(saved.c_str());
+      f.ID3v2Tag()->setArtist(string(3000, 'x'));
+      f.save(MPEG::File::ID3v2, true);
+      f.seek(0);
+      expected = f.readBlock(f.length());
+    }
+
+    MPEG::File f(spliced.c_str());
+    const long length = f.length();
+    f.ID3v2Tag()->setArtist(string(3000, 'x'));
+
+    SplicedStream *s = f.splicedStream(MPEG::File::ID3v2);
+    CPPUNIT_ASSERT_EQUAL(long(expected.size()), s->length());
+    CPPUNIT_ASSERT(expected == s->readBlock(s->length() + 100));
+    delete s;
+
+    // Nothing was written to the file itself.
+    CPPUNIT_ASSERT_EQUAL(length, f.length());
+
+    deleteFile(saved);
+    deleteFile(spliced);
+  }
+
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(TestMPEG);
@@ -0,0 +1,111 @@
+#include <cppunit/extensions/HelperMacros.h>
+#include <string>
+#include <stdio.h>
+#include <tbytevector.h>
+#include <tstring.h>
+#include <tfilestream.h>
+#include <tsplicedstream.h>
+
+using namespace std;
+using namespace TagLib;
+
+class TestSplicedStream : public CppUnit::TestFixture
+{
+  CPPUNIT_TEST_SUITE(TestSplicedStream);
+  CPPUNIT_TEST(testEmpty);
+  CPPUNIT_TEST(testPieces);
+  CPPUNIT_TEST(testSeek);
+  CPPUNIT_TEST(testReadOnly);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+
+  void testEmpty()
+  {
+    SplicedStream s;
+    CPPUNIT_ASSERT_EQUAL(0L, s.length());
+    CPPUNIT_ASSERT(s.readBlock(10).isEmpty());
+    s.appendData(ByteVector::null);
+    CPPUNIT_ASSERT_EQUAL(0L, s.length());
+  }
+
+  void testPieces()
+  {
+    FileStream file("data/empty.aiff");
+    file.seek(0);
+    const ByteVector original = file.readBlock(file.length());
+
+    SplicedStream s;
+    s.appendData("head");
+    s.appendRange(&file, 4, 100);
+    s.appendData("middle");
+    s.appendRange(&file, 200, 8);
+    s.appendData("tail");
+
+    CPPUNIT_ASSERT_EQUAL(4L + 100 + 6 + 8 + 4, s.length());
+    CPPUNIT_ASSERT_EQUAL(String("data/empty.aiff"), String(s.name()));
+
+    ByteVector expected("head");
+    expected.append(original.mid(4, 100));
+    expected.append("middle");
+    expected.append(original.mid(200, 8));
+    expected.append("tail");
+
+    // In one read, and then a few bytes at a time across the pieces.
+
+    CPPUNIT_ASSERT(expected == s.readBlock(1000));
+    CPPUNIT_ASSERT(s.readBlock(1).isEmpty());
+
+    s.seek(0);
+    ByteVector pieces;
+    while(true) {
+      const ByteVector block = s.readBlock(7);
+      if(block.isEmpty())
+        break;
+      pieces.append(block);
+    }
+    CPPUNIT_ASSERT(expected == pieces);
+  }
+
+  void testSeek()
+  {
+    FileStream file("data/empty.aiff");
+    file.seek(0);
+    const ByteVector original = file.readBlock(file.length());
+
+    SplicedStream s;
+    s.appendData("abc");
+    s.appendRange(&file, 0, 20);
+
+    s.seek(-5, IOStream::End);
+    CPPUNIT_ASSERT_EQUAL(18L, s.tell());
+    CPPUNIT_ASSERT(original.mid(15, 5) == s.readBlock(10));
+
+    s.seek(1);
+    s.seek(-10, IOStream::Current);
+    CPPUNIT_ASSERT_EQUAL(1L, s.tell());
+    CPPUNIT_ASSERT_EQUAL(ByteVector("bc") + original.mid(0, 2), s.readBlock(4));
+
+    // Reading from the file directly doesn't disturb the stream.
+    file.seek(50);
+    file.readBlock(3);
+    CPPUNIT_ASSERT(original.mid(2, 3) == s.readBlock(3));
+  }
+
+  void testReadOnly()
+  {
+    SplicedStream s;
+    s.appendData("abc");
+    CPPUNIT_ASSERT(s.readOnly());
+    s.writeBlock("xyz");
+    s.insert("xyz", 0, 1);
+    s.removeBlock(0, 1);
+    s.truncate(1);
+    CPPUNIT_ASSERT_EQUAL(3L, s.length());
+    s.seek(0);
+    CPPUNIT_ASSERT_EQUAL(ByteVector("abc"), s.readBlock(3));
+  }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestSplicedStream);
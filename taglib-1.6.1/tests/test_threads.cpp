@@ -0,0 +1,155 @@
+#include <cppunit/extensions/HelperMacros.h>
+#include <pthread.h>
+#include <tbytevector.h>
+#include <tstring.h>
+#include <tstringlist.h>
+#include <tmap.h>
+
+using namespace std;
+using namespace TagLib;
+
+namespace
+{
+  const int threadCount = 8;
+  const int iterations = 20000;
+
+  struct Shared
+  {
+    String title;
+    ByteVector data;
+    StringList genres;
+    Map<String, StringList> fields;
+  };
+
+  struct Worker
+  {
+    const Shared *shared;
+    int id;
+    bool ok;
+  };
+
+  void *work(void *arg)
+  {
+    Worker *w = static_cast<Worker *>(arg);
+    w->ok = true;
+    for(int i = 0; i < iterations; i++) {
+      // Copies share the data with the other threads until they change
+      String title = w->shared->title;
+      ByteVector data = w->shared->data;
+      StringList genres = w->shared->genres;
+      Map<String, StringList> fields = w->shared->fields;
+
+      if(title.size() != 5 || data.size() != 1024 || genres.size() != 3 ||
+         fields["ARTIST"].size() != 2) {
+        w->ok = false;
+      }
+
+      if(i % 4 == w->id % 4) {
+        title += String::number(w->id);
+        data[0] = char(w->id);
+        genres.append("Jazz");
+        fields["ARTIST"].append("Someone");
+        if(title.size() != 5 + String::number(w->id).size() ||
+           data[0] != char(w->id) || genres.size() != 4 ||
+           fields["ARTIST"].size() != 3) {
+          w->ok = false;
+        }
+      }
+    }
+    return 0;
+  }
+
+  // Counts how often the items that are shared between lists are deleted.
+
+  int deleted = 0;
+
+  struct Item
+  {
+    ~Item() { __atomic_add_fetch(&deleted, 1, __ATOMIC_RELAXED); }
+  };
+
+  struct Dropper
+  {
+    List<Item *> *list;
+    volatile bool *go;
+  };
+
+  void *drop(void *arg)
+  {
+    Dropper *dropper = static_cast<Dropper *>(arg);
+    while(!*dropper->go)
+      ;
+    delete dropper->list;
+    return 0;
+  }
+}
+
+class TestThreads : public CppUnit::TestFixture
+{
+  CPPUNIT_TEST_SUITE(TestThreads);
+  CPPUNIT_TEST(testSharedValues);
+  CPPUNIT_TEST(testDetachWhileDropped);
+  CPPUNIT_TEST_SUITE_END();
+
+public:
+
+  void testSharedValues()
+  {
+    Shared shared;
+    shared.title = "Title";
+    shared.data = ByteVector(1024, 'x');
+    shared.genres.append("Rock");
+    shared.genres.append("Pop");
+    shared.genres.append("Blues");
+    shared.fields["ARTIST"].append("Artist");
+    shared.fields["ARTIST"].append("Other");
+
+    pthread_t threads[threadCount];
+    Worker workers[threadCount];
+    for(int i = 0; i < threadCount; i++) {
+      workers[i].shared = &shared;
+      workers[i].id = i;
+      CPPUNIT_ASSERT(pthread_create(&threads[i], 0, work, &workers[i]) == 0);
+    }
+    for(int i = 0; i < threadCount; i++) {
+      pthread_join(threads[i], 0);
+      CPPUNIT_ASSERT(workers[i].ok);
+    }
+
+    CPPUNIT_ASSERT_EQUAL(String("Title"), shared.title);
+    CPPUNIT_ASSERT_EQUAL(ByteVector(1024, 'x'), shared.data);
+    CPPUNIT_ASSERT_EQUAL(3U, shared.genres.size());
+    CPPUNIT_ASSERT_EQUAL(String("Blues"), shared.genres.back());
+    CPPUNIT_ASSERT_EQUAL(2U, shared.fields["ARTIST"].size());
+  }
+
+  void testDetachWhileDropped()
+  {
+    // One thread detaches a list while another drops its copy.  Whichever
+    // way it goes, the item must be deleted once the last list is gone.
+    const int rounds = 2000;
+    deleted = 0;
+
+    for(int i = 0; i < rounds; i++) {
+      List<Item *> list;
+      list.setAutoDelete(true);
+      list.append(new Item);
+
+      volatile bool go = false;
+      Dropper dropper = { new List<Item *>(list), &go };
+      pthread_t thread;
+      CPPUNIT_ASSERT(pthread_create(&thread, 0, drop, &dropper) == 0);
+
+      go = true;
+      list.begin();
+      pthread_join(thread, 0);
+    }
+
+    CPPUNIT_ASSERT_EQUAL(rounds, __atomic_load_n(&deleted, __ATOMIC_RELAXED));
+  }
+
+};
+
+#ifndef TAGLIB_NO_ATOMIC_REFCOUNT
+CPPUNIT_TEST_SUITE_REGISTRATION(TestThreads);
+#endif
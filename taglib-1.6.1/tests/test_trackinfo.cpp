@@ -0,0 +1,246 @@
+#include <cppunit/extensions/HelperMacros.h>
+#include <string>
+#include <tag.h>
+#include <fileref.h>
+#include <trackinfo.h>
+#include <mpegfile.h>
+#include <id3v2tag.h>
+#include <id3v1tag.h>
+#include <textidentificationframe.h>
+#include <attachedpictureframe.h>
+#include <tfilestream.h>
+#include "utils.h"
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+using namespace std;
+using namespace TagLib;
+
+class TestTrackInfo : public CppUnit::TestFixture
+{
+  CPPUNIT_TEST_SUITE(TestTrackInfo);
+  CPPUNIT_TEST(testNull);
+  CPPUNIT_TEST(testReadID3v2);
+  CPPUNIT_TEST(testReadID3v1Only);
+  CPPUNIT_TEST(testSaveMPEG);
+  CPPUNIT_TEST(testSaveUnchanged);
+  CPPUNIT_TEST(testSaveVorbis);
+  CPPUNIT_TEST(testSaveFLAC);
+#ifdef TAGLIB_WITH_MP4
+  CPPUNIT_TEST(testSaveMP4);
+#endif
+#ifdef TAGLIB_WITH_ASF
+  CPPUNIT_TEST(testSaveASF);
+#endif
+  CPPUNIT_TEST_SUITE_END();
+
+  void fill(TrackInfo &info, bool withPicture)
+  {
+    info.setTitle("title");
+    info.setArtist("artist");
+    info.setAlbum("album");
+    info.setGenre("Rock");
+    info.setYear(1999);
+    info.setTrack(3);
+    info.setTrackTotal(12);
+    info.setDisc(1);
+    info.setDiscTotal(2);
+    if(withPicture)
+      info.setPicture(ByteVector("\x89PNG\r\n\x1a\n", 8), "image/png");
+  }
+
+  void check(const TrackInfo &info, bool withPicture)
+  {
+    CPPUNIT_ASSERT(!info.isNull());
+    CPPUNIT_ASSERT_EQUAL(String("title"), info.title());
+    CPPUNIT_ASSERT_EQUAL(String("artist"), info.artist());
+    CPPUNIT_ASSERT_EQUAL(String("album"), info.album());
+    CPPUNIT_ASSERT_EQUAL(String("Rock"), info.genre());
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(1999), info.year());
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(3), info.track());
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(12), info.trackTotal());
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(1), info.disc());
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(2), info.discTotal());
+    if(withPicture) {
+      CPPUNIT_ASSERT_EQUAL(ByteVector("\x89PNG\r\n\x1a\n", 8), info.picture());
+      CPPUNIT_ASSERT_EQUAL(String("image/png"), info.pictureMimeType());
+    }
+  }
+
+  void checkRoundTrip(const string &name, const string &ext, bool withPicture)
+  {
+    string copy = copyFile(name, ext);
+
+    TrackInfo info = TrackInfo::read(copy.c_str());
+    CPPUNIT_ASSERT(!info.isNull());
+    fill(info, withPicture);
+    CPPUNIT_ASSERT(info.save(copy.c_str()));
+
+    TrackInfo saved = TrackInfo::read(copy.c_str());
+    check(saved, withPicture);
+    CPPUNIT_ASSERT_EQUAL(info.length(), saved.length());
+    CPPUNIT_ASSERT_EQUAL(info.sampleRate(), saved.sampleRate());
+
+    // The common fields are the ones FileRef sees.
+    FileRef ref(copy.c_str());
+    CPPUNIT_ASSERT_EQUAL(String("title"), ref.tag()->title());
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(3), ref.tag()->track());
+
+    // Clearing the totals and the picture removes them.
+    saved.setTrackTotal(0);
+    saved.setDisc(0);
+    saved.setDiscTotal(0);
+    saved.setPicture(ByteVector::null, String::null);
+    CPPUNIT_ASSERT(saved.save(copy.c_str()));
+
+    TrackInfo cleared = TrackInfo::read(copy.c_str());
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(3), cleared.track());
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(0), cleared.trackTotal());
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(0), cleared.disc());
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(0), cleared.discTotal());
+    CPPUNIT_ASSERT(cleared.picture().isEmpty());
+
+    deleteFile(copy);
+  }
+
+public:
+
+  void testNull()
+  {
+    CPPUNIT_ASSERT(TrackInfo().isNull());
+    CPPUNIT_ASSERT(TrackInfo(0).isNull());
+    CPPUNIT_ASSERT(TrackInfo::read("data/does-not-exist.mp3").isNull());
+    CPPUNIT_ASSERT(!TrackInfo().save(static_cast<File *>(0)));
+  }
+
+  void testReadID3v2()
+  {
+    string copy = copyFile("xing", ".mp3");
+    {
+      MPEG::File f(copy.c_str());
+      ID3v2::Tag *tag = f.ID3v2Tag(true);
+      tag->setTitle("title");
+
+      ID3v2::TextIdentificationFrame *trck = new ID3v2::TextIdentificationFrame("TRCK");
+      trck->setText("5/9");
+      tag->addFrame(trck);
+
+      // The front cover wins over a picture that comes before it.
+      ID3v2::AttachedPictureFrame *other = new ID3v2::AttachedPictureFrame;
+      other->setType(ID3v2::AttachedPictureFrame::BackCover);
+      other->setMimeType("image/png");
+      other->setPicture("back");
+      tag->addFrame(other);
+      ID3v2::AttachedPictureFrame *front = new ID3v2::AttachedPictureFrame;
+      front->setType(ID3v2::AttachedPictureFrame::FrontCover);
+      front->setMimeType("image/jpeg");
+      front->setPicture("front");
+      tag->addFrame(front);
+      f.save();
+    }
+
+    TrackInfo info = TrackInfo::read(copy.c_str());
+    CPPUNIT_ASSERT_EQUAL(String("title"), info.title());
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(5), info.track());
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(9), info.trackTotal());
+    CPPUNIT_ASSERT_EQUAL(ByteVector("front"), info.picture());
+    CPPUNIT_ASSERT_EQUAL(String("image/jpeg"), info.pictureMimeType());
+
+    FileRef ref(copy.c_str());
+    CPPUNIT_ASSERT_EQUAL(ref.audioProperties()->length(), info.length());
+    CPPUNIT_ASSERT_EQUAL(ref.audioProperties()->bitrate(), info.bitrate());
+    CPPUNIT_ASSERT_EQUAL(ref.audioProperties()->sampleRate(), info.sampleRate());
+    CPPUNIT_ASSERT_EQUAL(ref.audioProperties()->channels(), info.channels());
+    CPPUNIT_ASSERT(info.length() > 0);
+
+    TrackInfo noProperties = TrackInfo::read(copy.c_str(), false);
+    CPPUNIT_ASSERT_EQUAL(String("title"), noProperties.title());
+    CPPUNIT_ASSERT_EQUAL(0, noProperties.length());
+
+    deleteFile(copy);
+  }
+
+  void testReadID3v1Only()
+  {
+    string copy = copyFile("xing", ".mp3");
+    {
+      MPEG::File f(copy.c_str());
+      f.ID3v1Tag(true)->setTrack(7);
+      f.save(MPEG::File::ID3v1);
+    }
+
+    TrackInfo info = TrackInfo::read(copy.c_str());
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(7), info.track());
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(0), info.trackTotal());
+
+    deleteFile(copy);
+  }
+
+  void testSaveMPEG()
+  {
+    checkRoundTrip("xing", ".mp3", true);
+  }
+
+  void testSaveUnchanged()
+  {
+    string copy = copyFile("xing", ".mp3");
+
+    TrackInfo info = TrackInfo::read(copy.c_str());
+    fill(info, true);
+    CPPUNIT_ASSERT(info.save(copy.c_str()));
+
+    ByteVector before;
+    {
+      FileStream stream(copy.c_str());
+      before = stream.readBlock(stream.length());
+    }
+
+    // Saving the same fields again leaves the file alone.
+    TrackInfo::read(copy.c_str()).save(copy.c_str());
+    CPPUNIT_ASSERT(info.save(copy.c_str()));
+
+    FileStream stream(copy.c_str());
+    CPPUNIT_ASSERT_EQUAL(before, stream.readBlock(stream.length()));
+
+    deleteFile(copy);
+  }
+
+  void testSaveVorbis()
+  {
+    checkRoundTrip("empty", ".ogg", false);
+  }
+
+  void testSaveFLAC()
+  {
+    checkRoundTrip("no-tags", ".flac", false);
+  }
+
+  void testSaveMP4()
+  {
+    checkRoundTrip("has-tags", ".m4a", true);
+  }
+
+  void testSaveASF()
+  {
+    string copy = copyFile("silence-1", ".wma");
+
+    TrackInfo info = TrackInfo::read(copy.c_str());
+    info.setTitle("title");
+    info.setTrack(3);
+    info.setDisc(1);
+    info.setDiscTotal(2);
+    CPPUNIT_ASSERT(info.save(copy.c_str()));
+
+    TrackInfo saved = TrackInfo::read(copy.c_str());
+    CPPUNIT_ASSERT_EQUAL(String("title"), saved.title());
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(3), saved.track());
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(1), saved.disc());
+    CPPUNIT_ASSERT_EQUAL(TagLib::uint(2), saved.discTotal());
+
+    deleteFile(copy);
+  }
+
+};
+
+CPPUNIT_TEST_SUITE_REGISTRATION(TestTrackInfo);
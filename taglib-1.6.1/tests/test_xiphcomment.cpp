@@ -15,6 +15,7 @@ class TestXiphComment : public CppUnit::TestFixture
   CPPUNIT_TEST(testSetYear);
   CPPUNIT_TEST(testTrack);
   CPPUNIT_TEST(testSetTrack);
+  CPPUNIT_TEST(testModified);
   CPPUNIT_TEST_SUITE_END();
 
 public:
@@ -59,6 +60,22 @@ public:
     CPPUNIT_ASSERT_EQUAL(String("3"), cmt.fieldListMap()["TRACKNUMBER"].front());
   }
 
+  void testModified()
+  {
+    Ogg::XiphComment cmt;
+    CPPUNIT_ASSERT(!cmt.isModified());
+    cmt.setTitle("Title");
+    CPPUNIT_ASSERT(cmt.isModified());
+
+    Ogg::XiphComment copy(cmt.render());
+    CPPUNIT_ASSERT(!copy.isModified());
+    copy.setTitle("Title");
+    copy.removeField("ARTIST");
+    CPPUNIT_ASSERT(!copy.isModified());
+    copy.addField("TITLE", "Subtitle", false);
+    CPPUNIT_ASSERT(copy.isModified());
+  }
+
 };
 
 CPPUNIT_TEST_SUITE_REGISTRATION(TestXiphComment);